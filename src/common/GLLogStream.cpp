@@ -26,7 +26,6 @@
 #include <QStringList>
 
 #ifdef MESHLAB_LOG_FILE_ENABLED
-#include <QThread>
 #include <QTextStream>
 #include <QFile>
 #include "globals.h"
@@ -42,12 +41,14 @@ GLLogStream::GLLogStream() :
 
 void GLLogStream::realTimeLog(const QString& Id, const QString &meshName, const QString& text)
 {
+	QMutexLocker locker(&mutex);
 	this->realTimeLogText.insert(Id,qMakePair(meshName,text) );
 }
 
 
 void GLLogStream::save(int /*Level*/, const char * filename )
 {
+	QMutexLocker locker(&mutex);
 	FILE *fp=fopen(filename,"wb");
 	QList<pair <int,QString> > ::iterator li;
 	for(li=logTextList.begin();li!=logTextList.end();++li)
@@ -56,38 +57,45 @@ void GLLogStream::save(int /*Level*/, const char * filename )
 
 void GLLogStream::clearBookmark()
 {
+	QMutexLocker locker(&mutex);
 	bookmark = -1;
 }
 
 void GLLogStream::setBookmark()
 {
+	QMutexLocker locker(&mutex);
 	bookmark=logTextList.size();
 }
 
 void GLLogStream::backToBookmark()
 {
+	QMutexLocker locker(&mutex);
 	if(bookmark<0) return;
 	while(logTextList.size() > bookmark )
 		logTextList.removeLast();
 }
 
-const QList<std::pair<int, QString> >& GLLogStream::logStringList() const
+QList<std::pair<int, QString> > GLLogStream::logStringList() const
 {
+	QMutexLocker locker(&mutex);
 	return logTextList;
 }
 
-const QMultiMap<QString, QPair<QString, QString> >& GLLogStream::realTimeLogMultiMap() const
+QMultiMap<QString, QPair<QString, QString> > GLLogStream::realTimeLogMultiMap() const
 {
+	QMutexLocker locker(&mutex);
 	return realTimeLogText;
 }
 
 void GLLogStream::clearRealTimeLog()
 {
+	QMutexLocker locker(&mutex);
 	realTimeLogText.clear();
 }
 
 void GLLogStream::print(QStringList &out) const
 {
+	QMutexLocker locker(&mutex);
 	out.clear();
 	for (const pair <int,QString>& p : logTextList)
 		out.push_back(p.second);
@@ -95,16 +103,17 @@ void GLLogStream::print(QStringList &out) const
 
 void GLLogStream::clear()
 {
+	QMutexLocker locker(&mutex);
 	logTextList.clear();
 }
 
 void GLLogStream::log(int level, const char * buf )
 {
 	QString tmp(buf);
+	QMutexLocker locker(&mutex);
 	logTextList.push_back(std::make_pair(level,tmp));
 	qDebug("LOG: %i %s",level,buf);
 #ifdef MESHLAB_LOG_FILE_ENABLED
-	QThread::msleep(100);
 	QFile f(meshlab::logDebugFileName());
 	f.open(QIODevice::Append);
 	QTextStream stream(&f);
@@ -112,6 +121,7 @@ void GLLogStream::log(int level, const char * buf )
 	stream.flush();
 	f.close();
 #endif
+	locker.unlock();
 	emit logUpdated();
 }
 
@@ -28,6 +28,7 @@
 #include <list>
 #include <utility>
 #include <QMultiMap>
+#include <QMutex>
 #include <QPair>
 #include <QString>
 #include <QObject>
@@ -85,9 +86,10 @@ public:
 	void setBookmark();
 	void clearBookmark();
 	void backToBookmark();
-	const QList<std::pair<int, QString> >& logStringList() const;
+	// copies, since the log can be written by other threads while it is read
+	QList<std::pair<int, QString> > logStringList() const;
 
-	const QMultiMap<QString, QPair<QString, QString> >& realTimeLogMultiMap() const;
+	QMultiMap<QString, QPair<QString, QString> > realTimeLogMultiMap() const;
 	void clearRealTimeLog();
 
 	template <typename... Ts>
@@ -107,6 +109,7 @@ signals:
 	void logUpdated();
 
 private:
+	mutable QMutex mutex; /// log() can be called from any thread
 	int bookmark; /// this field is used to place a bookmark for restoring the log. Useful for previeweing
 	QList<std::pair<int, QString> > logTextList;
 
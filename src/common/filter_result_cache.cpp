@@ -0,0 +1,690 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2021                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "filter_result_cache.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QtXml/QDomDocument>
+
+#include "globals.h"
+#include "plugins/interfaces/filter_plugin.h"
+
+namespace {
+
+const quint32 CACHE_MAGIC   = 0x4D4C4643; // "MLFC"
+const quint32 CACHE_VERSION = 2;
+
+// per element attributes that can be hashed, stored and restored
+const int STORABLE_MASK =
+	MeshModel::MM_VERTCOORD | MeshModel::MM_VERTNORMAL | MeshModel::MM_VERTCOLOR |
+	MeshModel::MM_VERTQUALITY | MeshModel::MM_VERTTEXCOORD | MeshModel::MM_FACEVERT |
+	MeshModel::MM_FACENORMAL | MeshModel::MM_FACECOLOR | MeshModel::MM_FACEQUALITY |
+	MeshModel::MM_WEDGTEXCOORD | MeshModel::MM_VERTFLAGSELECT | MeshModel::MM_FACEFLAGSELECT |
+	MeshModel::MM_TRANSFMATRIX | MeshModel::MM_COLOR;
+
+// attributes that are recomputed when needed and therefore do not need to be stored
+const int RECOMPUTABLE_MASK =
+	MeshModel::MM_VERTFLAG | MeshModel::MM_FACEFLAG | MeshModel::MM_VERTMARK |
+	MeshModel::MM_FACEMARK | MeshModel::MM_VERTFACETOPO | MeshModel::MM_FACEFACETOPO |
+	MeshModel::MM_VERTNUMBER | MeshModel::MM_FACENUMBER | MeshModel::MM_UNKNOWN;
+
+const int TOPOLOGY_CHANGE_MASK =
+	MeshModel::MM_VERTNUMBER | MeshModel::MM_FACENUMBER | MeshModel::MM_FACEVERT |
+	MeshModel::MM_UNKNOWN;
+
+/**
+ * Collects small chunks of data before feeding them to the hash function,
+ * avoiding a call to QCryptographicHash::addData for each element.
+ */
+class BufferedHash
+{
+public:
+	BufferedHash() : hash(QCryptographicHash::Sha1) { buffer.reserve(BUFFER_SIZE); }
+
+	template<typename T>
+	void add(const T& v)
+	{
+		const char* p = reinterpret_cast<const char*>(&v);
+		buffer.insert(buffer.end(), p, p + sizeof(T));
+		if (buffer.size() >= BUFFER_SIZE)
+			flush();
+	}
+
+	void add(const QByteArray& a)
+	{
+		add(a.size());
+		flush();
+		hash.addData(a);
+	}
+
+	QByteArray result()
+	{
+		flush();
+		return hash.result();
+	}
+
+private:
+	void flush()
+	{
+		hash.addData(buffer.data(), (int) buffer.size());
+		buffer.clear();
+	}
+
+	static const std::size_t BUFFER_SIZE = 1 << 20;
+	QCryptographicHash hash;
+	std::vector<char> buffer;
+};
+
+template<typename T>
+void writeArray(QDataStream& out, const std::vector<T>& v)
+{
+	out.writeRawData(reinterpret_cast<const char*>(v.data()), int(v.size() * sizeof(T)));
+}
+
+// a size read from a corrupted entry must not trigger a huge allocation
+bool canRead(QDataStream& in, qint64 size)
+{
+	return size <= std::numeric_limits<int>::max() &&
+		   (in.device() == nullptr || in.device()->bytesAvailable() >= size);
+}
+
+bool readRaw(QDataStream& in, void* data, qint64 size)
+{
+	return canRead(in, size) && in.readRawData(reinterpret_cast<char*>(data), int(size)) == size;
+}
+
+template<typename T>
+bool readArray(QDataStream& in, std::vector<T>& v, std::size_t n)
+{
+	qint64 size = qint64(n) * qint64(sizeof(T));
+	if (!canRead(in, size))
+		return false;
+	v.resize(n);
+	return in.readRawData(reinterpret_cast<char*>(v.data()), int(size)) == size;
+}
+
+/**
+ * Output values are stored only if they have a type that QDataStream can
+ * always serialize.
+ */
+bool isValueStorable(const QVariant& v)
+{
+	switch (v.userType()) {
+	case QMetaType::Bool:
+	case QMetaType::Int:
+	case QMetaType::UInt:
+	case QMetaType::LongLong:
+	case QMetaType::ULongLong:
+	case QMetaType::Float:
+	case QMetaType::Double:
+	case QMetaType::QString: return true;
+	default: return false;
+	}
+}
+
+/**
+ * A layer of a cache entry. The whole entry is read before changing the
+ * document, so that a truncated or corrupted entry leaves it untouched.
+ */
+struct LayerEntry
+{
+	qint32       sourceId = -1; // -1 for a layer created by the filter
+	QString      label;
+	qint32       mask     = 0; // attributes stored
+	qint32       dataMask = 0; // attributes enabled on the layer
+	bool         full     = false;
+	qint32       vn       = 0;
+	qint32       fn       = 0;
+	Matrix44m    tr;
+	vcg::Color4b color;
+
+	std::vector<Point3m>         vertPos, vertNormal;
+	std::vector<vcg::Color4b>    vertColor;
+	std::vector<Scalarm>         vertQuality;
+	std::vector<vcg::TexCoord2f> vertTex;
+	std::vector<char>            vertSel;
+
+	std::vector<int>             faceVert;
+	std::vector<Point3m>         faceNormal;
+	std::vector<vcg::Color4b>    faceColor;
+	std::vector<Scalarm>         faceQuality;
+	std::vector<vcg::TexCoord2f> wedgeTex;
+	std::vector<char>            faceSel;
+};
+
+bool readLayer(QDataStream& in, LayerEntry& l)
+{
+	in >> l.sourceId >> l.label >> l.mask >> l.full >> l.dataMask >> l.vn >> l.fn;
+	if (in.status() != QDataStream::Ok || l.vn < 0 || l.fn < 0)
+		return false;
+	if ((l.mask & MeshModel::MM_TRANSFMATRIX) && !readRaw(in, l.tr.V(), 16 * sizeof(Scalarm)))
+		return false;
+	if ((l.mask & MeshModel::MM_COLOR) && !readRaw(in, &l.color, sizeof(vcg::Color4b)))
+		return false;
+
+	auto count = [&](int bit, std::size_t n) { return (l.mask & bit) ? n : 0; };
+	bool ok =
+		readArray(in, l.vertPos, count(MeshModel::MM_VERTCOORD, l.vn)) &&
+		readArray(in, l.vertNormal, count(MeshModel::MM_VERTNORMAL, l.vn)) &&
+		readArray(in, l.vertColor, count(MeshModel::MM_VERTCOLOR, l.vn)) &&
+		readArray(in, l.vertQuality, count(MeshModel::MM_VERTQUALITY, l.vn)) &&
+		readArray(in, l.vertTex, count(MeshModel::MM_VERTTEXCOORD, l.vn)) &&
+		readArray(in, l.vertSel, count(MeshModel::MM_VERTFLAGSELECT, l.vn)) &&
+		readArray(in, l.faceVert, l.full ? 3 * std::size_t(l.fn) : 0) &&
+		readArray(in, l.faceNormal, count(MeshModel::MM_FACENORMAL, l.fn)) &&
+		readArray(in, l.faceColor, count(MeshModel::MM_FACECOLOR, l.fn)) &&
+		readArray(in, l.faceQuality, count(MeshModel::MM_FACEQUALITY, l.fn)) &&
+		readArray(in, l.wedgeTex, count(MeshModel::MM_WEDGTEXCOORD, 3 * std::size_t(l.fn))) &&
+		readArray(in, l.faceSel, count(MeshModel::MM_FACEFLAGSELECT, l.fn));
+	if (!ok)
+		return false;
+	for (int vi : l.faceVert)
+		if (vi < 0 || vi >= l.vn)
+			return false;
+	return true;
+}
+
+/**
+ * Writes a validated layer entry in the mesh; if the entry is not full, the
+ * mesh has the same number of vertices and faces of the entry.
+ */
+void applyLayer(const LayerEntry& l, MeshModel& m)
+{
+	CMeshO& cm = m.cm;
+	if (l.full) {
+		cm.Clear();
+		m.updateDataMask(l.dataMask & STORABLE_MASK);
+		vcg::tri::Allocator<CMeshO>::AddVertices(cm, l.vn);
+		vcg::tri::Allocator<CMeshO>::AddFaces(cm, l.fn);
+	}
+	else {
+		vcg::tri::Allocator<CMeshO>::CompactEveryVector(cm);
+		m.updateDataMask(l.mask & STORABLE_MASK);
+	}
+
+	if (l.mask & MeshModel::MM_TRANSFMATRIX)
+		cm.Tr = l.tr;
+	if (l.mask & MeshModel::MM_COLOR)
+		cm.C() = l.color;
+
+	for (int i = 0; i < l.vn; ++i) {
+		CVertexO& v = cm.vert[i];
+		if (l.mask & MeshModel::MM_VERTCOORD)    v.P() = l.vertPos[i];
+		if (l.mask & MeshModel::MM_VERTNORMAL)   v.N() = l.vertNormal[i];
+		if (l.mask & MeshModel::MM_VERTCOLOR)    v.C() = l.vertColor[i];
+		if (l.mask & MeshModel::MM_VERTQUALITY)  v.Q() = l.vertQuality[i];
+		if (l.mask & MeshModel::MM_VERTTEXCOORD) v.T() = l.vertTex[i];
+		if (l.mask & MeshModel::MM_VERTFLAGSELECT) {
+			if (l.vertSel[i]) v.SetS(); else v.ClearS();
+		}
+	}
+	for (int i = 0; i < l.fn; ++i) {
+		CFaceO& f = cm.face[i];
+		if (l.full)
+			for (int j = 0; j < 3; ++j)
+				f.V(j) = &cm.vert[l.faceVert[3 * i + j]];
+		if (l.mask & MeshModel::MM_FACENORMAL)  f.N() = l.faceNormal[i];
+		if (l.mask & MeshModel::MM_FACECOLOR)   f.C() = l.faceColor[i];
+		if (l.mask & MeshModel::MM_FACEQUALITY) f.Q() = l.faceQuality[i];
+		if (l.mask & MeshModel::MM_WEDGTEXCOORD)
+			for (int j = 0; j < 3; ++j)
+				f.WT(j) = l.wedgeTex[3 * i + j];
+		if (l.mask & MeshModel::MM_FACEFLAGSELECT) {
+			if (l.faceSel[i]) f.SetS(); else f.ClearS();
+		}
+	}
+
+	if (l.full) {
+		// adjacency is not stored: it is rebuilt if it was enabled on the layer
+		m.updateDataMask(l.dataMask & (MeshModel::MM_FACEFACETOPO | MeshModel::MM_VERTFACETOPO));
+		if (!(l.mask & MeshModel::MM_VERTNORMAL))
+			m.updateBoxAndNormals();
+	}
+	vcg::tri::UpdateBounding<CMeshO>::Box(cm);
+}
+
+void hashLayer(BufferedHash& h, const MeshModel& m)
+{
+	const CMeshO& cm = m.cm;
+	int mask = m.dataMask() & STORABLE_MASK;
+	h.add(m.id());
+	h.add(m.isVisible());
+	h.add(mask);
+	h.add(cm.vn);
+	h.add(cm.fn);
+	for (int i = 0; i < 16; ++i)
+		h.add(cm.Tr.V()[i]);
+	h.add(cm.C());
+	for (const CVertexO& v : cm.vert) {
+		if (v.IsD())
+			continue;
+		h.add(v.cP());
+		h.add(v.IsS());
+		if (mask & MeshModel::MM_VERTNORMAL)
+			h.add(v.cN());
+		if (mask & MeshModel::MM_VERTCOLOR)
+			h.add(v.cC());
+		if (mask & MeshModel::MM_VERTQUALITY)
+			h.add(v.cQ());
+		if (mask & MeshModel::MM_VERTTEXCOORD) {
+			h.add(v.cT().u());
+			h.add(v.cT().v());
+			h.add(v.cT().n());
+		}
+	}
+	for (const CFaceO& f : cm.face) {
+		if (f.IsD())
+			continue;
+		for (int j = 0; j < 3; ++j)
+			h.add((int) vcg::tri::Index(cm, f.cV(j)));
+		h.add(f.IsS());
+		if (mask & MeshModel::MM_FACECOLOR)
+			h.add(f.cC());
+		if (mask & MeshModel::MM_FACEQUALITY)
+			h.add(f.cQ());
+		if (mask & MeshModel::MM_WEDGTEXCOORD)
+			for (int j = 0; j < 3; ++j) {
+				h.add(f.cWT(j).u());
+				h.add(f.cWT(j).v());
+				h.add(f.cWT(j).n());
+			}
+	}
+}
+
+} // namespace
+
+FilterResultCache::FilterResultCache(const QString& cacheDir, qint64 maxSizeBytes) :
+		dir(cacheDir), maxBytes(maxSizeBytes)
+{
+	QDir().mkpath(dir);
+}
+
+const QString& FilterResultCache::cacheDirectory() const
+{
+	return dir;
+}
+
+qint64 FilterResultCache::maxSize() const
+{
+	return maxBytes;
+}
+
+void FilterResultCache::setMaxSize(qint64 maxSizeBytes)
+{
+	maxBytes = maxSizeBytes;
+	enforceSizeLimit();
+}
+
+/**
+ * @brief Returns the set of layers that are read by the given filter: the
+ * current mesh and the meshes referred by the parameters, or all the layers
+ * of the document for filters with VARIABLE arity and for the ones run with
+ * their "allLayers" parameter checked.
+ */
+std::set<int> FilterResultCache::inputLayers(
+	const FilterPlugin&      filter,
+	const QAction*           action,
+	const RichParameterList& params,
+	const MeshDocument&      md)
+{
+	bool allLayers = filter.filterArity(action) == FilterPlugin::VARIABLE;
+	for (const RichParameter& p : params) {
+		if (p.isOfType<RichBool>() && p.name() == "allLayers" && p.value().getBool())
+			allLayers = true;
+	}
+
+	std::set<int> layers;
+	if (allLayers) {
+		for (const MeshModel& m : md.meshIterator())
+			layers.insert(m.id());
+	}
+	else {
+		if (md.mm() != nullptr)
+			layers.insert(md.mm()->id());
+		for (const RichParameter& p : params) {
+			if (p.isOfType<RichMesh>() && md.getMesh(p.value().getInt()) != nullptr)
+				layers.insert(p.value().getInt());
+		}
+	}
+	return layers;
+}
+
+FilterResultCache::InputState FilterResultCache::inputState(
+	const MeshDocument&  md,
+	const std::set<int>& inputLayers)
+{
+	InputState s;
+	s.inputLayers = inputLayers;
+	for (const MeshModel& m : md.meshIterator())
+		s.layerSizes[m.id()] = std::make_pair(m.cm.VN(), m.cm.FN());
+	return s;
+}
+
+/**
+ * @brief Computes the key of the entry corresponding to the execution of the
+ * given filter, with the given parameters, on the input layers of the document.
+ */
+QByteArray FilterResultCache::computeKey(
+	const QString&           filterName,
+	const RichParameterList& params,
+	const MeshDocument&      md,
+	const InputState&        input)
+{
+	BufferedHash h;
+	h.add(QByteArray::fromStdString(meshlab::meshlabVersion()));
+	h.add(sizeof(Scalarm));
+	h.add(filterName.toUtf8());
+
+	QDomDocument doc("FilterResultCache");
+	QDomElement root = doc.createElement("filter");
+	doc.appendChild(root);
+	for (const RichParameter& rp : params)
+		root.appendChild(rp.fillToXMLDocument(doc, false));
+	h.add(doc.toByteArray());
+
+	for (int id : input.inputLayers) {
+		const MeshModel* m = md.getMesh(id);
+		if (m != nullptr)
+			hashLayer(h, *m);
+	}
+	return h.result().toHex();
+}
+
+/**
+ * @brief Looks for the entry with the given key and, if it exists, applies it
+ * to the document and returns the output values of the filter. Returns false
+ * on cache miss, or if the entry is not valid: in that case the document is
+ * not modified.
+ */
+bool FilterResultCache::restore(
+	const QByteArray&                key,
+	MeshDocument&                    md,
+	unsigned int&                    postConditionMask,
+	std::map<std::string, QVariant>& outputValues)
+{
+	QFile file(entryFileName(key));
+	if (!file.exists() || !file.open(QIODevice::ReadWrite))
+		return false;
+
+	QDataStream in(&file);
+	quint32 magic, version, scalarSize, postMask;
+	in >> magic >> version >> scalarSize >> postMask;
+	if (in.status() != QDataStream::Ok || magic != CACHE_MAGIC || version != CACHE_VERSION ||
+		scalarSize != sizeof(Scalarm))
+		return false;
+
+	qint32 nRemoved;
+	in >> nRemoved;
+	if (in.status() != QDataStream::Ok || nRemoved < 0 || (unsigned int) nRemoved > md.meshNumber())
+		return false;
+	std::vector<int> removed;
+	for (qint32 i = 0; i < nRemoved; ++i) {
+		qint32 id;
+		in >> id;
+		if (in.status() != QDataStream::Ok || md.getMesh(id) == nullptr)
+			return false;
+		removed.push_back(id);
+	}
+
+	qint32 nLayers;
+	in >> nLayers;
+	if (in.status() != QDataStream::Ok || nLayers < 0)
+		return false;
+	std::vector<LayerEntry> layers;
+	for (qint32 i = 0; i < nLayers; ++i) {
+		LayerEntry l;
+		if (!readLayer(in, l))
+			return false;
+		if (l.sourceId >= 0) {
+			const MeshModel* m = md.getMesh(l.sourceId);
+			if (m == nullptr || std::find(removed.begin(), removed.end(), l.sourceId) != removed.end())
+				return false;
+			if (!l.full && (m->cm.VN() != l.vn || m->cm.FN() != l.fn))
+				return false;
+		}
+		layers.push_back(std::move(l));
+	}
+
+	qint32 currentLayer, currentId, nValues;
+	in >> currentLayer >> currentId >> nValues;
+	if (in.status() != QDataStream::Ok || currentLayer >= nLayers || nValues < 0)
+		return false;
+	std::map<std::string, QVariant> values;
+	for (qint32 i = 0; i < nValues; ++i) {
+		QString name;
+		QVariant value;
+		in >> name >> value;
+		if (in.status() != QDataStream::Ok)
+			return false;
+		values[name.toStdString()] = value;
+	}
+
+	// the entry is valid: it can be applied
+	for (int id : removed)
+		md.delMesh(id);
+	for (qint32 i = 0; i < nLayers; ++i) {
+		const LayerEntry& l = layers[i];
+		MeshModel* m = (l.sourceId < 0) ? md.addNewMesh("", l.label, false) : md.getMesh(l.sourceId);
+		applyLayer(l, *m);
+		if (i == currentLayer)
+			currentId = m->id();
+	}
+	if (currentId >= 0 && md.getMesh(currentId) != nullptr)
+		md.setCurrentMesh(currentId);
+	postConditionMask = postMask;
+	outputValues = values;
+
+	// the entry has been used: it becomes the most recent one
+	file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+	return true;
+}
+
+/**
+ * @brief Stores in the cache the changes made by a filter to the document.
+ * Returns false if the changes cannot be represented by a cache entry (e.g.
+ * the filter created textures or changed attributes that are not supported).
+ */
+bool FilterResultCache::store(
+	const QByteArray&                      key,
+	const MeshDocument&                    md,
+	const InputState&                      before,
+	unsigned int                           postConditionMask,
+	const std::map<std::string, QVariant>& outputValues)
+{
+	for (const auto& p : outputValues) {
+		if (!isValueStorable(p.second))
+			return false;
+	}
+
+	std::vector<int> removed;
+	for (const auto& p : before.layerSizes) {
+		if (md.getMesh(p.first) == nullptr)
+			removed.push_back(p.first);
+	}
+
+	// a layer is stored if it is new or if it is an input layer
+	std::vector<std::pair<const MeshModel*, bool>> toStore;
+	for (const MeshModel& m : md.meshIterator()) {
+		auto it = before.layerSizes.find(m.id());
+		bool isNew = it == before.layerSizes.end();
+		if (!isNew && before.inputLayers.count(m.id()) == 0)
+			continue;
+		if (!isLayerStorable(m))
+			return false;
+		bool full = isNew || (postConditionMask & TOPOLOGY_CHANGE_MASK) ||
+					it->second != std::make_pair(m.cm.VN(), m.cm.FN());
+		if (!full) {
+			int notStorable = postConditionMask & m.dataMask() & ~(STORABLE_MASK | RECOMPUTABLE_MASK);
+			if (notStorable != 0)
+				return false;
+		}
+		toStore.emplace_back(&m, full);
+	}
+
+	// the current layer, as an index in toStore if it is stored (the ids of the
+	// new layers change when the entry is restored), or as an id
+	qint32 currentLayer = -1;
+	qint32 currentId = (md.mm() != nullptr) ? md.mm()->id() : -1;
+	for (unsigned int i = 0; i < toStore.size(); ++i) {
+		if (toStore[i].first == md.mm())
+			currentLayer = i;
+	}
+
+	QString fileName = entryFileName(key);
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+
+	QDataStream out(&file);
+	out << CACHE_MAGIC << CACHE_VERSION << (quint32) sizeof(Scalarm) << (quint32) postConditionMask;
+	out << (qint32) removed.size();
+	for (int id : removed)
+		out << (qint32) id;
+	out << (qint32) toStore.size();
+	for (const auto& p : toStore) {
+		const MeshModel& m = *p.first;
+		bool isNew = before.layerSizes.count(m.id()) == 0;
+		int mask = p.second ? (m.dataMask() & STORABLE_MASK) : (postConditionMask & m.dataMask() & STORABLE_MASK);
+		writeLayer(out, m, isNew ? -1 : m.id(), mask, p.second);
+	}
+	out << currentLayer << currentId << (qint32) outputValues.size();
+	for (const auto& p : outputValues)
+		out << QString::fromStdString(p.first) << p.second;
+	file.close();
+
+	if (out.status() != QDataStream::Ok || file.size() > maxBytes) {
+		QFile::remove(fileName);
+		return false;
+	}
+	enforceSizeLimit();
+	return true;
+}
+
+/**
+ * @brief Removes all the entries of the cache.
+ */
+void FilterResultCache::clear()
+{
+	QDir d(dir);
+	for (const QFileInfo& fi : d.entryInfoList(QStringList("*.mlfc"), QDir::Files))
+		QFile::remove(fi.absoluteFilePath());
+}
+
+QString FilterResultCache::defaultCacheDirectory()
+{
+	return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/FilterResults";
+}
+
+QString FilterResultCache::entryFileName(const QByteArray& key) const
+{
+	return dir + "/" + QString::fromLatin1(key) + ".mlfc";
+}
+
+/**
+ * Removes the least recently used entries until the size of the cache
+ * directory is below the limit.
+ */
+void FilterResultCache::enforceSizeLimit()
+{
+	QDir d(dir);
+	// sorted from the newest to the oldest
+	QFileInfoList entries = d.entryInfoList(QStringList("*.mlfc"), QDir::Files, QDir::Time);
+	qint64 total = 0;
+	for (const QFileInfo& fi : entries) {
+		total += fi.size();
+		if (total > maxBytes)
+			QFile::remove(fi.absoluteFilePath());
+	}
+}
+
+bool FilterResultCache::isLayerStorable(const MeshModel& m)
+{
+	return m.cm.EN() == 0 && m.cm.textures.empty() &&
+		   !m.hasDataMask(MeshModel::MM_POLYGONAL);
+}
+
+void FilterResultCache::writeLayer(
+	QDataStream&     out,
+	const MeshModel& m,
+	int              sourceId,
+	int              mask,
+	bool             full)
+{
+	const CMeshO& cm = m.cm;
+	out << (qint32) sourceId << m.label() << (qint32) mask << full << (qint32) m.dataMask();
+	out << (qint32) cm.VN() << (qint32) cm.FN();
+	if (mask & MeshModel::MM_TRANSFMATRIX)
+		out.writeRawData(reinterpret_cast<const char*>(cm.Tr.V()), 16 * sizeof(Scalarm));
+	if (mask & MeshModel::MM_COLOR)
+		out.writeRawData(reinterpret_cast<const char*>(&cm.C()), sizeof(vcg::Color4b));
+
+	std::vector<Point3m> pos, nrm;
+	std::vector<vcg::Color4b> col;
+	std::vector<Scalarm> qual;
+	std::vector<vcg::TexCoord2f> tex;
+	std::vector<char> sel;
+	std::vector<int> vidx(cm.vert.size(), -1);
+	int k = 0;
+	for (size_t i = 0; i < cm.vert.size(); ++i) {
+		const CVertexO& v = cm.vert[i];
+		if (v.IsD())
+			continue;
+		vidx[i] = k++;
+		if (mask & MeshModel::MM_VERTCOORD)      pos.push_back(v.cP());
+		if (mask & MeshModel::MM_VERTNORMAL)     nrm.push_back(v.cN());
+		if (mask & MeshModel::MM_VERTCOLOR)      col.push_back(v.cC());
+		if (mask & MeshModel::MM_VERTQUALITY)    qual.push_back(v.cQ());
+		if (mask & MeshModel::MM_VERTTEXCOORD)   tex.push_back(v.cT());
+		if (mask & MeshModel::MM_VERTFLAGSELECT) sel.push_back(v.IsS());
+	}
+	writeArray(out, pos); writeArray(out, nrm); writeArray(out, col);
+	writeArray(out, qual); writeArray(out, tex); writeArray(out, sel);
+
+	std::vector<int> fv;
+	pos.clear(); col.clear(); qual.clear(); tex.clear(); sel.clear();
+	for (const CFaceO& f : cm.face) {
+		if (f.IsD())
+			continue;
+		if (full)
+			for (int j = 0; j < 3; ++j)
+				fv.push_back(vidx[vcg::tri::Index(cm, f.cV(j))]);
+		if (mask & MeshModel::MM_FACENORMAL)     pos.push_back(f.cN());
+		if (mask & MeshModel::MM_FACECOLOR)      col.push_back(f.cC());
+		if (mask & MeshModel::MM_FACEQUALITY)    qual.push_back(f.cQ());
+		if (mask & MeshModel::MM_WEDGTEXCOORD)
+			for (int j = 0; j < 3; ++j)
+				tex.push_back(f.cWT(j));
+		if (mask & MeshModel::MM_FACEFLAGSELECT) sel.push_back(f.IsS());
+	}
+	writeArray(out, fv); writeArray(out, pos); writeArray(out, col);
+	writeArray(out, qual); writeArray(out, tex); writeArray(out, sel);
+}
@@ -0,0 +1,120 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005-2021                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef MESHLAB_FILTER_RESULT_CACHE_H
+#define MESHLAB_FILTER_RESULT_CACHE_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+
+class FilterPlugin;
+class MeshDocument;
+class MeshModel;
+class RichParameterList;
+class QAction;
+class QDataStream;
+
+/**
+ * @brief The FilterResultCache class is an opt-in, on-disk memoization of
+ * the results of the filters.
+ *
+ * The key of an entry is a hash computed over the name of the filter, the
+ * serialized parameters and the content of the input layers (all the per
+ * element attributes that are enabled on the layers after the requirements of
+ * the filter have been satisfied, the selection and the transformation matrix).
+ * The value is what the filter changed in the document:
+ * - the new layers, stored entirely;
+ * - for the layers that existed before the filter, only the attributes listed in
+ *   the postCondition mask, or the whole layer if its topology has been changed;
+ * - the ids of the layers removed by the filter;
+ * - the layer that was current after the filter, and its output values.
+ *
+ * Only the filters that declare FilterPlugin::isFilterResultCacheable can be
+ * cached. The total size of the cache directory is kept below a given limit by
+ * removing the least recently used entries.
+ */
+class FilterResultCache
+{
+public:
+	/**
+	 * @brief The InputState struct keeps the layers read by a filter and the
+	 * number of elements of all the layers before its execution.
+	 */
+	struct InputState
+	{
+		std::set<int> inputLayers;
+		std::map<int, std::pair<int, int>> layerSizes;
+	};
+
+	FilterResultCache(const QString& cacheDir, qint64 maxSizeBytes);
+
+	const QString& cacheDirectory() const;
+	qint64 maxSize() const;
+	void setMaxSize(qint64 maxSizeBytes);
+
+	static std::set<int> inputLayers(
+		const FilterPlugin&      filter,
+		const QAction*           action,
+		const RichParameterList& params,
+		const MeshDocument&      md);
+
+	static InputState inputState(const MeshDocument& md, const std::set<int>& inputLayers);
+
+	static QByteArray computeKey(
+		const QString&           filterName,
+		const RichParameterList& params,
+		const MeshDocument&      md,
+		const InputState&        input);
+
+	bool restore(
+		const QByteArray&                key,
+		MeshDocument&                    md,
+		unsigned int&                    postConditionMask,
+		std::map<std::string, QVariant>& outputValues);
+	bool store(
+		const QByteArray&                      key,
+		const MeshDocument&                    md,
+		const InputState&                      before,
+		unsigned int                           postConditionMask,
+		const std::map<std::string, QVariant>& outputValues);
+
+	void clear();
+
+	static QString defaultCacheDirectory();
+
+private:
+	QString entryFileName(const QByteArray& key) const;
+	void enforceSizeLimit();
+
+	static bool isLayerStorable(const MeshModel& m);
+	static void writeLayer(QDataStream& out, const MeshModel& m, int sourceId, int mask, bool full);
+
+	QString dir;
+	qint64 maxBytes;
+};
+
+#endif // MESHLAB_FILTER_RESULT_CACHE_H
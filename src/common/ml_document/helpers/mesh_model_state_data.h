@@ -25,6 +25,7 @@
 #define MESHLAB_MESH_MODEL_STATE_DATA_H
 
 #include <cstddef>
+#include <cstdint>
 
 struct MeshModelStateData
 {
@@ -32,9 +33,10 @@ struct MeshModelStateData
 	size_t _nvert;
 	size_t _nface;
 	size_t _nedge;
+	std::uint64_t _version; // MeshModel::version() of the mesh
 
-	MeshModelStateData(int mask, size_t nvert, size_t nface, size_t nedge):
-		_mask(mask), _nvert(nvert), _nface(nface), _nedge(nedge)
+	MeshModelStateData(int mask, size_t nvert, size_t nface, size_t nedge, std::uint64_t version = 0):
+		_mask(mask), _nvert(nvert), _nface(nface), _nedge(nedge), _version(version)
 	{}
 };
 
@@ -31,10 +31,24 @@
 #include <wrap/gl/math.h>
 
 #include <QDir>
+#include <algorithm>
+#include <atomic>
 #include <utility>
 
 using namespace vcg;
 
+namespace {
+
+// the elements that change the result of spatial queries on the mesh
+const int GEOMETRY_MASK =
+	MeshModel::MM_VERTCOORD | MeshModel::MM_VERTNUMBER | MeshModel::MM_FACEVERT |
+	MeshModel::MM_FACENUMBER | MeshModel::MM_TRANSFMATRIX;
+
+// shared by all the meshes, so that a version value is never reused
+std::atomic<std::uint64_t> lastVersion(0);
+
+} // namespace
+
 MeshModel::MeshModel(int id, const QString& fullFileName, const QString& labelName) :
 	visible(true)
 {
@@ -57,6 +71,7 @@ void MeshModel::clear()
 	cm.Tr.SetIdentity();
 	cm.sfn=0;
 	cm.svn=0;
+	setChanged(MM_ALL);
 }
 
 void MeshModel::updateBoxAndNormals()
@@ -66,6 +81,62 @@ void MeshModel::updateBoxAndNormals()
 		tri::UpdateNormal<CMeshO>::PerFaceNormalized(cm);
 		tri::UpdateNormal<CMeshO>::PerVertexAngleWeighted(cm);
 	}
+	// this is the notification that the coordinates changed: it cannot be skipped by looking
+	// at the versions, which are updated from the filter postcondition only after it returns
+	setChanged(MM_VERTCOORD | MM_VERTNORMAL | MM_FACENORMAL);
+}
+
+void MeshModel::setChanged(int changedMask)
+{
+	const std::uint64_t v = ++lastVersion;
+	for (int i = 0; i < 32; ++i)
+		if (changedMask & (1u << i))
+			versions[i] = v;
+	if (changedMask & GEOMETRY_MASK)
+		spatialIndexCache.clear();
+}
+
+void MeshModel::setGeometryChanged()
+{
+	setChanged(GEOMETRY_MASK);
+}
+
+std::uint64_t MeshModel::version(int mask) const
+{
+	std::uint64_t v = 0;
+	for (int i = 0; i < 32; ++i)
+		if (mask & (1u << i))
+			v = std::max(v, versions[i]);
+	return v;
+}
+
+int MeshModel::changedSince(std::uint64_t v) const
+{
+	int mask = MM_NONE;
+	for (int i = 0; i < 32; ++i)
+		if (versions[i] > v)
+			mask |= int(1u << i);
+	return mask;
+}
+
+std::uint64_t MeshModel::geometryVersion() const
+{
+	return version(GEOMETRY_MASK);
+}
+
+std::shared_ptr<meshlab::SpatialIndexCache::VertexGrid> MeshModel::vertexGrid()
+{
+	return spatialIndexCache.vertexGrid(cm, geometryVersion());
+}
+
+std::shared_ptr<meshlab::SpatialIndexCache::FaceGrid> MeshModel::faceGrid()
+{
+	return spatialIndexCache.faceGrid(cm, geometryVersion());
+}
+
+std::shared_ptr<const meshlab::FaceBvh> MeshModel::faceBvh()
+{
+	return spatialIndexCache.faceBvh(cm, geometryVersion());
 }
 
 QString MeshModel::relativePathName(const QString& path) const
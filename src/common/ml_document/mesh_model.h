@@ -27,12 +27,14 @@
 
 #include <stdio.h>
 #include <time.h>
+#include <cstdint>
 #include <map>
 
 #include "cmesh.h"
 #include "../GLLogStream.h"
 #include "../filterscript.h"
 #include "../ml_shared_data_context/ml_plugin_gl_context.h"
+#include "../utilities/spatial_index_cache.h"
 
 #include <vcg/complex/algorithms/update/bounding.h>
 #include <vcg/complex/algorithms/update/color.h>
@@ -128,6 +130,22 @@ public:
 
 	void clear();
 	void updateBoxAndNormals(); // This is the STANDARD method that you should call after changing coords.
+
+	// Each MeshElement has a version, that setChanged gives a value never used before by any
+	// mesh: whoever caches data computed from a mesh can tell if it is still valid by
+	// comparing versions. They are driven by updateBoxAndNormals, by the postcondition mask
+	// of the filters applied to the mesh and by the rendering attributes marked as updated.
+	void setChanged(int changedMask);
+	void setGeometryChanged(); // coordinates, faces or matrix
+	std::uint64_t version(int mask = MM_ALL) const; // the most recent among the elements in mask
+	int changedSince(std::uint64_t v) const; // mask of the elements changed after version v
+	std::uint64_t geometryVersion() const;
+
+	// spatial indices, rebuilt only when the geometry version changes
+	std::shared_ptr<meshlab::SpatialIndexCache::VertexGrid> vertexGrid();
+	std::shared_ptr<meshlab::SpatialIndexCache::FaceGrid> faceGrid();
+	std::shared_ptr<const meshlab::FaceBvh> faceBvh();
+
 	inline int id() const {return _id;}
 
 	int idInFile() const {return idInsideFile;}
@@ -218,6 +236,9 @@ private:
 
 	//textures associated to mesh
 	std::map<std::string, QImage> textures;
+
+	std::uint64_t versions[32]; // one per MeshElement bit
+	meshlab::SpatialIndexCache spatialIndexCache;
 };// end class MeshModel
 
 #endif
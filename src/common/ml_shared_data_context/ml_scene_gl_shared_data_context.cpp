@@ -336,6 +336,13 @@ void MLSceneGLSharedDataContext::meshAttributesUpdated(int mmid,bool conntectivi
 	MeshModel* mm = _md.getMesh(mmid);
 	if (mm == NULL)
 		return;
+	// the tools that edit a mesh in place (e.g. painting) report their changes only here:
+	// the data computed from the updated attributes is no longer valid
+	int changed = MLPoliciesStandAloneFunctions::fromMLRenderingAttsToMeshModelMask(atts);
+	if (conntectivitychanged)
+		changed |= MeshModel::MM_VERTNUMBER | MeshModel::MM_FACENUMBER | MeshModel::MM_FACEVERT;
+	if (changed != MeshModel::MM_NONE)
+		mm->setChanged(changed);
 	PerMeshMultiViewManager* man = meshAttributesMultiViewerManager(mmid);
 	if (man != NULL)
 		man->meshAttributesUpdated(conntectivitychanged,atts);
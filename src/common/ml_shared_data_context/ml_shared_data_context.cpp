@@ -103,6 +103,26 @@ void MLPoliciesStandAloneFunctions::fromMeshModelMaskToMLRenderingAtts( int mesh
     atts[MLRenderingData::ATT_NAMES::ATT_WEDGETEXTURE] = bool(meshmodelmask & MeshModel::MM_WEDGTEXCOORD);
 }
 
+int MLPoliciesStandAloneFunctions::fromMLRenderingAttsToMeshModelMask(MLRenderingData::RendAtts atts)
+{
+    int meshmodelmask = MeshModel::MM_NONE;
+    if (atts[MLRenderingData::ATT_NAMES::ATT_VERTPOSITION])
+        meshmodelmask |= MeshModel::MM_VERTCOORD;
+    if (atts[MLRenderingData::ATT_NAMES::ATT_VERTNORMAL])
+        meshmodelmask |= MeshModel::MM_VERTNORMAL;
+    if (atts[MLRenderingData::ATT_NAMES::ATT_FACENORMAL])
+        meshmodelmask |= MeshModel::MM_FACENORMAL;
+    if (atts[MLRenderingData::ATT_NAMES::ATT_VERTCOLOR])
+        meshmodelmask |= MeshModel::MM_VERTCOLOR;
+    if (atts[MLRenderingData::ATT_NAMES::ATT_FACECOLOR])
+        meshmodelmask |= MeshModel::MM_FACECOLOR;
+    if (atts[MLRenderingData::ATT_NAMES::ATT_VERTTEXTURE])
+        meshmodelmask |= MeshModel::MM_VERTTEXCOORD;
+    if (atts[MLRenderingData::ATT_NAMES::ATT_WEDGETEXTURE])
+        meshmodelmask |= MeshModel::MM_WEDGTEXCOORD;
+    return meshmodelmask;
+}
+
 void MLPoliciesStandAloneFunctions::maskMeaninglessAttributesPerPrimitiveModality( MLRenderingData::PRIMITIVE_MODALITY pm,MLRenderingData::RendAtts& atts )
 {
     switch(pm)
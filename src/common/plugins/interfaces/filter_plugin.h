@@ -140,6 +140,24 @@ public:
 	 */
 	virtual bool requiresGLContext(const QAction*) const {return false;}
 
+	/**
+	 * @brief This function should return true if a filter that requires the
+	 * glContext has also a CPU path, taken when glContext is nullptr or not
+	 * valid (e.g. on machines without a GPU). When the context cannot be
+	 * created, the framework then runs the filter with glContext set to
+	 * nullptr instead of failing.
+	 */
+	virtual bool canRunWithoutGLContext(const QAction*) const {return false;}
+
+	/**
+	 * @brief This function should return true if the result of the filter
+	 * depends only on its parameters and on the per-element attributes of the
+	 * input meshes (no textures, rasters, cameras or custom attributes), so
+	 * that the framework can store it in the FilterResultCache and reuse it
+	 * when the filter is applied again on the same input.
+	 */
+	virtual bool isFilterResultCacheable(const QAction*) const {return false;}
+
 	/** 
 	 * @brief The FilterPrecondition mask is used to explicitate what kind of data a filter really needs to be applied.
 	 * For example algorithms that compute per face quality have as precondition the existence of faces
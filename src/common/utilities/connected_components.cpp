@@ -0,0 +1,197 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "connected_components.h"
+
+#include <algorithm>
+#include <atomic>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <vcg/space/triangle3.h>
+
+namespace meshlab {
+
+namespace {
+
+/* Union-find over the faces that can be updated concurrently; the root of a
+ * set is always its lowest element */
+class ConcurrentUnionFind
+{
+public:
+	explicit ConcurrentUnionFind(int n) : parent(n)
+	{
+#pragma omp parallel for
+		for (int i = 0; i < n; ++i)
+			parent[i].store(i, std::memory_order_relaxed);
+	}
+
+	int find(int x)
+	{
+		int p = parent[x].load(std::memory_order_relaxed);
+		while (p != x) {
+			// path halving: a stale write only makes the path a bit longer
+			int gp = parent[p].load(std::memory_order_relaxed);
+			if (gp != p)
+				parent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+			x = p;
+			p = parent[x].load(std::memory_order_relaxed);
+		}
+		return x;
+	}
+
+	void unite(int a, int b)
+	{
+		while (true) {
+			a = find(a);
+			b = find(b);
+			if (a == b)
+				return;
+			if (a < b)
+				std::swap(a, b);
+			int expected = a;
+			if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed))
+				return;
+		}
+	}
+
+private:
+	std::vector<std::atomic<int>> parent;
+};
+
+struct EdgeEntry
+{
+	int other; // highest vertex of the edge
+	int face;
+
+	bool operator<(const EdgeEntry& e) const
+	{
+		return other < e.other || (other == e.other && face < e.face);
+	}
+};
+
+} // namespace
+
+ConnectedComponents connectedComponents(const CMeshO& m)
+{
+	const int fn = (int) m.face.size();
+	const int vn = (int) m.vert.size();
+
+	// face edges, bucketed by their lowest vertex
+	std::vector<int> edgeStart(vn + 1, 0);
+#pragma omp parallel for
+	for (int i = 0; i < fn; ++i) {
+		const CFaceO& f = m.face[i];
+		if (f.IsD())
+			continue;
+		for (int k = 0; k < 3; ++k) {
+			int v0 = (int) vcg::tri::Index(m, f.cV(k));
+			int v1 = (int) vcg::tri::Index(m, f.cV((k + 1) % 3));
+#pragma omp atomic
+			edgeStart[std::min(v0, v1) + 1]++;
+		}
+	}
+	for (int i = 0; i < vn; ++i)
+		edgeStart[i + 1] += edgeStart[i];
+
+	std::vector<EdgeEntry> edges(edgeStart[vn]);
+	{
+		std::vector<std::atomic<int>> fill(vn);
+		for (int i = 0; i < vn; ++i)
+			fill[i].store(edgeStart[i], std::memory_order_relaxed);
+#pragma omp parallel for
+		for (int i = 0; i < fn; ++i) {
+			const CFaceO& f = m.face[i];
+			if (f.IsD())
+				continue;
+			for (int k = 0; k < 3; ++k) {
+				int v0 = (int) vcg::tri::Index(m, f.cV(k));
+				int v1 = (int) vcg::tri::Index(m, f.cV((k + 1) % 3));
+				int pos = fill[std::min(v0, v1)].fetch_add(1, std::memory_order_relaxed);
+				edges[pos] = {std::max(v0, v1), i};
+			}
+		}
+	}
+
+	// the faces sharing an edge are adjacent in the sorted buckets
+	ConcurrentUnionFind sets(fn);
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (int v = 0; v < vn; ++v) {
+		std::sort(edges.begin() + edgeStart[v], edges.begin() + edgeStart[v + 1]);
+		for (int j = edgeStart[v] + 1; j < edgeStart[v + 1]; ++j)
+			if (edges[j].other == edges[j - 1].other)
+				sets.unite(edges[j - 1].face, edges[j].face);
+	}
+	std::vector<EdgeEntry>().swap(edges);
+	std::vector<int>().swap(edgeStart);
+
+	std::vector<int> root(fn, -1);
+#pragma omp parallel for
+	for (int i = 0; i < fn; ++i)
+		if (!m.face[i].IsD())
+			root[i] = sets.find(i);
+
+	// the roots are the first faces of the components: numbering them in face
+	// order gives the same order of vcg::tri::Clean::ConnectedComponents
+	ConnectedComponents cc;
+	cc.faceComponent.assign(fn, -1);
+	int nComponents = 0;
+	for (int i = 0; i < fn; ++i)
+		if (root[i] == i)
+			cc.faceComponent[i] = nComponents++;
+#pragma omp parallel for
+	for (int i = 0; i < fn; ++i)
+		if (root[i] >= 0 && root[i] != i)
+			cc.faceComponent[i] = cc.faceComponent[root[i]];
+
+	// faces grouped by component, to compute the statistics of each one
+	std::vector<int> faceStart(nComponents + 1, 0);
+	for (int i = 0; i < fn; ++i)
+		if (cc.faceComponent[i] >= 0)
+			faceStart[cc.faceComponent[i] + 1]++;
+	for (int c = 0; c < nComponents; ++c)
+		faceStart[c + 1] += faceStart[c];
+	std::vector<int> faces(faceStart[nComponents]);
+	std::copy(faceStart.begin(), faceStart.end() - 1, root.begin());
+	for (int i = 0; i < fn; ++i)
+		if (cc.faceComponent[i] >= 0)
+			faces[root[cc.faceComponent[i]]++] = i;
+
+	cc.components.resize(nComponents);
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int c = 0; c < nComponents; ++c) {
+		ConnectedComponentStats& stats = cc.components[c];
+		stats.faceCount                = faceStart[c + 1] - faceStart[c];
+		for (int j = faceStart[c]; j < faceStart[c + 1]; ++j) {
+			const CFaceO& f = m.face[faces[j]];
+			for (int k = 0; k < 3; ++k)
+				stats.bbox.Add(f.cP(k));
+			stats.area += vcg::DoubleArea(f) / 2;
+		}
+	}
+	return cc;
+}
+
+} // namespace meshlab
@@ -0,0 +1,65 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef MESHLAB_CONNECTED_COMPONENTS_H
+#define MESHLAB_CONNECTED_COMPONENTS_H
+
+#include <vector>
+
+#include "../ml_document/cmesh.h"
+
+namespace meshlab {
+
+struct ConnectedComponentStats
+{
+	int     faceCount = 0;
+	Box3m   bbox;     // of the vertices of the faces; bbox.Diag() is the diameter
+	Scalarm area = 0;
+};
+
+struct ConnectedComponents
+{
+	/** component of each face, indexed as m.face; -1 for deleted faces */
+	std::vector<int> faceComponent;
+
+	std::vector<ConnectedComponentStats> components;
+
+	size_t size() const { return components.size(); }
+};
+
+/**
+ * @brief Labels the connected components of the faces of the mesh, where two
+ * faces are connected when they share an edge (also a non manifold one), as
+ * the components walked by vcg::tri::ConnectedComponentIterator through the
+ * FF adjacency. The components are numbered in order of their first face, like
+ * vcg::tri::Clean::ConnectedComponents does.
+ *
+ * The FF adjacency is not needed: the edges are matched on the vertex indices
+ * of the faces, and the faces are joined with a concurrent union-find; the
+ * statistics of the components are then computed in parallel.
+ */
+ConnectedComponents connectedComponents(const CMeshO& m);
+
+} // namespace meshlab
+
+#endif // MESHLAB_CONNECTED_COMPONENTS_H
@@ -0,0 +1,240 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "depth_map_cache.h"
+
+#include <algorithm>
+
+#include "shot_rasterizer.h"
+
+namespace meshlab {
+
+namespace {
+
+const std::uint64_t FNV_OFFSET = 0xCBF29CE484222325ull;
+const std::uint64_t FNV_PRIME  = 0x100000001B3ull;
+
+template<typename T>
+void hashValue(std::uint64_t& h, const T& v)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&v);
+	for (size_t i = 0; i < sizeof(T); ++i) {
+		h ^= bytes[i];
+		h *= FNV_PRIME;
+	}
+}
+
+std::size_t mapBytes(const DepthMap& map)
+{
+	return map.depth.size() * sizeof(float);
+}
+
+} // namespace
+
+DepthMapCache::DepthMapCache(std::size_t maxBytes) : maxBytes(maxBytes), usedBytes(0)
+{
+}
+
+void DepthMapCache::setMaxMemory(std::size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	maxBytes = bytes;
+	while (usedBytes > maxBytes && !lru.empty()) {
+		auto it = entries.find(lru.back());
+		usedBytes -= mapBytes(*it->second.map);
+		entries.erase(it);
+		lru.pop_back();
+	}
+}
+
+std::size_t DepthMapCache::usedMemory() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return usedBytes;
+}
+
+void DepthMapCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.clear();
+	lru.clear();
+	usedBytes = 0;
+}
+
+std::uint64_t DepthMapCache::meshVersion(const CMeshO& m)
+{
+	// blocks of elements are hashed in parallel, then the block hashes are
+	// combined in order
+	const int                  blockSize = 1 << 16;
+	const int                  vBlocks   = ((int) m.vert.size() + blockSize - 1) / blockSize;
+	const int                  fBlocks   = ((int) m.face.size() + blockSize - 1) / blockSize;
+	std::vector<std::uint64_t> blocks(vBlocks + fBlocks, FNV_OFFSET);
+
+#pragma omp parallel for schedule(static)
+	for (int b = 0; b < vBlocks + fBlocks; ++b) {
+		std::uint64_t& h = blocks[b];
+		if (b < vBlocks) {
+			const int end = std::min((int) m.vert.size(), (b + 1) * blockSize);
+			for (int i = b * blockSize; i < end; ++i) {
+				if (m.vert[i].IsD())
+					continue;
+				hashValue(h, i);
+				hashValue(h, m.vert[i].cP());
+			}
+		}
+		else {
+			const int end = std::min((int) m.face.size(), (b - vBlocks + 1) * blockSize);
+			for (int i = (b - vBlocks) * blockSize; i < end; ++i) {
+				const CFaceO& f = m.face[i];
+				if (f.IsD())
+					continue;
+				hashValue(h, i);
+				for (int k = 0; k < 3; ++k)
+					hashValue(h, vcg::tri::Index(m, f.cV(k)));
+			}
+		}
+	}
+
+	std::uint64_t h = FNV_OFFSET;
+	hashValue(h, m.vn);
+	hashValue(h, m.fn);
+	for (std::uint64_t b : blocks)
+		hashValue(h, b);
+	return h;
+}
+
+std::uint64_t DepthMapCache::shotKey(const Shotm& shot)
+{
+	const vcg::Camera<Scalarm>& c = shot.Intrinsics;
+	std::uint64_t               h = FNV_OFFSET;
+	hashValue(h, c.cameraType);
+	hashValue(h, c.FocalMm);
+	hashValue(h, c.ViewportPx);
+	hashValue(h, c.PixelSizeMm);
+	hashValue(h, c.CenterPx);
+	hashValue(h, c.DistorCenterPx);
+	for (int i = 0; i < 4; ++i)
+		hashValue(h, c.k[i]);
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 4; ++j)
+			hashValue(h, shot.Extrinsics.Rot()[i][j]);
+	hashValue(h, shot.Extrinsics.Tra());
+	return h;
+}
+
+std::vector<std::shared_ptr<const DepthMap>>
+DepthMapCache::depthMaps(const CMeshO& m, const std::vector<Shotm>& shots, int* rendered)
+{
+	return depthMaps(m, meshVersion(m), shots, rendered);
+}
+
+std::vector<std::shared_ptr<const DepthMap>> DepthMapCache::depthMaps(
+	const CMeshO&             m,
+	std::uint64_t             version,
+	const std::vector<Shotm>& shots,
+	int*                      rendered)
+{
+	// look up the maps, listing once each missing key; shots repeating a
+	// missing key are pointed to the shot that renders it
+	std::vector<std::shared_ptr<const DepthMap>> maps(shots.size());
+	std::vector<Key>                             keys(shots.size());
+	std::vector<int>                             missing;
+	std::vector<int>                             source(shots.size(), -1);
+	{
+		std::unordered_map<Key, int, KeyHash> firstMissing;
+		std::lock_guard<std::mutex>           lock(mutex);
+		for (int i = 0; i < (int) shots.size(); ++i) {
+			keys[i] = Key {version, shotKey(shots[i])};
+			auto it = entries.find(keys[i]);
+			if (it != entries.end()) {
+				maps[i] = it->second.map;
+				lru.splice(lru.begin(), lru, it->second.lru);
+			}
+			else {
+				auto ins = firstMissing.emplace(keys[i], i);
+				if (ins.second)
+					missing.push_back(i);
+				else
+					source[i] = ins.first->second;
+			}
+		}
+	}
+
+	const int nMissing = (int) missing.size();
+#pragma omp parallel if (nMissing > 1)
+	{
+		ShotRasterizer rasterizer;
+#pragma omp for schedule(dynamic)
+		for (int k = 0; k < nMissing; ++k) {
+			const Shotm& shot = shots[missing[k]];
+			rasterizer.resize(shot.Intrinsics.ViewportPx[0], shot.Intrinsics.ViewportPx[1]);
+			rasterizer.render(m, shot);
+
+			std::shared_ptr<DepthMap> map = std::make_shared<DepthMap>();
+			map->width  = rasterizer.width();
+			map->height = rasterizer.height();
+			map->depth  = rasterizer.depthBuffer();
+			maps[missing[k]] = map;
+		}
+	}
+
+	for (size_t i = 0; i < shots.size(); ++i)
+		if (source[i] >= 0)
+			maps[i] = maps[source[i]];
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (int i : missing)
+		insert(keys[i], maps[i]);
+	if (rendered != nullptr)
+		*rendered = nMissing;
+	return maps;
+}
+
+std::shared_ptr<const DepthMap> DepthMapCache::depthMap(const CMeshO& m, const Shotm& shot)
+{
+	return depthMaps(m, std::vector<Shotm>(1, shot))[0];
+}
+
+std::shared_ptr<const DepthMap>
+DepthMapCache::depthMap(const CMeshO& m, std::uint64_t version, const Shotm& shot)
+{
+	return depthMaps(m, version, std::vector<Shotm>(1, shot))[0];
+}
+
+void DepthMapCache::insert(const Key& k, const std::shared_ptr<const DepthMap>& map)
+{
+	const std::size_t bytes = mapBytes(*map);
+	if (bytes > maxBytes || entries.count(k) > 0)
+		return;
+	while (usedBytes + bytes > maxBytes && !lru.empty()) {
+		auto it = entries.find(lru.back());
+		usedBytes -= mapBytes(*it->second.map);
+		entries.erase(it);
+		lru.pop_back();
+	}
+	lru.push_front(k);
+	entries[k] = Entry {map, lru.begin()};
+	usedBytes += bytes;
+}
+
+} // namespace meshlab
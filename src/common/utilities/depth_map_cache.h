@@ -0,0 +1,141 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef MESHLAB_DEPTH_MAP_CACHE_H
+#define MESHLAB_DEPTH_MAP_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "../ml_document/cmesh.h"
+
+namespace meshlab {
+
+/**
+ * @brief Depth map of a mesh seen from a Shot, as large as its viewport.
+ *
+ * Values are camera space depths, +infinity where the mesh is not seen; rows
+ * are stored bottom-up, so that a point projected with Shot::Project falls in
+ * the pixel (int(p[0]), int(p[1])).
+ */
+struct DepthMap
+{
+	int                width  = 0;
+	int                height = 0;
+	std::vector<float> depth;
+
+	bool  isInside(int x, int y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+	float at(int x, int y) const { return depth[x + (size_t) y * width]; }
+};
+
+/**
+ * @brief Renders with ShotRasterizer the depth maps of a mesh from a set of
+ * cameras, and keeps the most recently used ones.
+ *
+ * This is the CPU replacement of the depth (shadow) maps that the raster
+ * based filters render with OpenGL. The maps missing from the cache are
+ * rendered concurrently, one camera per thread; a single map is rendered with
+ * the tiles of the rasterizer in parallel instead.
+ *
+ * A map is identified by the intrinsic and extrinsic parameters of the camera
+ * and by the version of the mesh, a hash of its vertex positions and faces:
+ * running again a filter on the same rasters reuses the maps, while any
+ * change of the geometry invalidates them. The least recently used maps are
+ * dropped when the total size exceeds the memory limit.
+ */
+class DepthMapCache
+{
+public:
+	DepthMapCache(std::size_t maxBytes = std::size_t(512) << 20);
+
+	std::size_t maxMemory() const { return maxBytes; }
+	void        setMaxMemory(std::size_t maxBytes);
+	std::size_t usedMemory() const;
+	void        clear();
+
+	/**
+	 * @brief Returns the depth maps of m seen from the given shots, in the same
+	 * order, rendering the ones that are not in the cache.
+	 *
+	 * @param rendered: if not null, set to the number of maps actually rendered
+	 */
+	std::vector<std::shared_ptr<const DepthMap>>
+	depthMaps(const CMeshO& m, const std::vector<Shotm>& shots, int* rendered = nullptr);
+
+	std::shared_ptr<const DepthMap> depthMap(const CMeshO& m, const Shotm& shot);
+
+	/**
+	 * @brief The same, with the version of m already computed by
+	 * meshVersion(): callers that look up the maps of an unchanged mesh one at
+	 * a time hash it only once.
+	 */
+	std::vector<std::shared_ptr<const DepthMap>> depthMaps(
+		const CMeshO&             m,
+		std::uint64_t             version,
+		const std::vector<Shotm>& shots,
+		int*                      rendered = nullptr);
+
+	std::shared_ptr<const DepthMap>
+	depthMap(const CMeshO& m, std::uint64_t version, const Shotm& shot);
+
+	/** @brief Version of the mesh used in the keys of the cache: a hash of the
+	 * positions of the vertices and of the vertex indices of the faces */
+	static std::uint64_t meshVersion(const CMeshO& m);
+	static std::uint64_t shotKey(const Shotm& shot);
+
+private:
+	struct Key
+	{
+		std::uint64_t mesh;
+		std::uint64_t shot;
+		bool operator==(const Key& k) const { return mesh == k.mesh && shot == k.shot; }
+	};
+	struct KeyHash
+	{
+		std::size_t operator()(const Key& k) const
+		{
+			return std::size_t(k.mesh ^ (k.shot * 0x9E3779B97F4A7C15ull));
+		}
+	};
+	struct Entry
+	{
+		std::shared_ptr<const DepthMap> map;
+		std::list<Key>::iterator        lru;
+	};
+
+	void insert(const Key& k, const std::shared_ptr<const DepthMap>& map);
+
+	mutable std::mutex                     mutex;
+	std::unordered_map<Key, Entry, KeyHash> entries;
+	std::list<Key>                         lru; // most recently used first
+	std::size_t                            maxBytes;
+	std::size_t                            usedBytes;
+};
+
+} // namespace meshlab
+
+#endif // MESHLAB_DEPTH_MAP_CACHE_H
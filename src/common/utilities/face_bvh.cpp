@@ -0,0 +1,216 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "face_bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace meshlab {
+
+namespace {
+
+const int LEAF_SIZE = 4;
+
+inline bool hitBox(const Box3m& b, const Point3m& o, const Point3m& invD, Scalarm tMax)
+{
+	Scalarm tMin = 0;
+	for (int k = 0; k < 3; ++k) {
+		Scalarm t0 = (b.min[k] - o[k]) * invD[k];
+		Scalarm t1 = (b.max[k] - o[k]) * invD[k];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tMin = std::max(tMin, t0);
+		tMax = std::min(tMax, t1);
+		if (tMax < tMin)
+			return false;
+	}
+	return true;
+}
+
+/** Moller-Trumbore, double sided */
+inline bool intersect(
+	const Point3m& v0,
+	const Point3m& e1,
+	const Point3m& e2,
+	const Point3m& o,
+	const Point3m& d,
+	Scalarm&       t)
+{
+	Point3m p   = d ^ e2;
+	Scalarm det = e1 * p;
+	if (std::abs(det) < std::numeric_limits<Scalarm>::min())
+		return false;
+	Scalarm invDet = 1 / det;
+	Point3m s      = o - v0;
+	Scalarm u      = (s * p) * invDet;
+	if (u < 0 || u > 1)
+		return false;
+	Point3m q = s ^ e1;
+	Scalarm v = (d * q) * invDet;
+	if (v < 0 || u + v > 1)
+		return false;
+	t = (e2 * q) * invDet;
+	return true;
+}
+
+} // namespace
+
+FaceBvh::FaceBvh(const CMeshO& m)
+{
+	normals.assign(m.face.size(), Point3m(0, 0, 0));
+	std::vector<Point3m> centers;
+	for (const CFaceO& f : m.face) {
+		if (f.IsD())
+			continue;
+		Triangle t;
+		t.v0   = f.cP(0);
+		t.e1   = f.cP(1) - f.cP(0);
+		t.e2   = f.cP(2) - f.cP(0);
+		t.face = (int) vcg::tri::Index(m, f);
+		for (int j = 0; j < 3; ++j)
+			t.vi[j] = (int) vcg::tri::Index(m, f.cV(j));
+		Point3m n   = t.e1 ^ t.e2;
+		Scalarm len = n.Norm();
+		if (len > 0)
+			normals[t.face] = n / len;
+		tris.push_back(t);
+		centers.push_back((f.cP(0) + f.cP(1) + f.cP(2)) / 3);
+	}
+	if (tris.empty())
+		return;
+
+	std::vector<int> order(tris.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = (int) i;
+	nodes.reserve(2 * tris.size() / LEAF_SIZE + 1);
+	nodes.push_back(Node());
+	build(0, order, 0, (int) order.size(), centers);
+
+	std::vector<Triangle> sorted(tris.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		sorted[i] = tris[order[i]];
+	tris.swap(sorted);
+}
+
+void FaceBvh::build(
+	int                         node,
+	std::vector<int>&           order,
+	int                         begin,
+	int                         end,
+	const std::vector<Point3m>& centers)
+{
+	Box3m box, centerBox;
+	for (int i = begin; i < end; ++i) {
+		const Triangle& t = tris[order[i]];
+		box.Add(t.v0);
+		box.Add(t.v0 + t.e1);
+		box.Add(t.v0 + t.e2);
+		centerBox.Add(centers[order[i]]);
+	}
+	nodes[node].box = box;
+	if (end - begin <= LEAF_SIZE) {
+		nodes[node].first = begin;
+		nodes[node].count = end - begin;
+		return;
+	}
+
+	// median split along the largest extent of the centers
+	const int axis = centerBox.MaxDim();
+	const int mid  = (begin + end) / 2;
+	std::nth_element(
+		order.begin() + begin, order.begin() + mid, order.begin() + end, [&](int a, int b) {
+			return centers[a][axis] < centers[b][axis];
+		});
+	const int left = (int) nodes.size();
+	nodes.resize(left + 2);
+	nodes[node].first = left;
+	nodes[node].count = 0;
+	build(left, order, begin, mid, centers);
+	build(left + 1, order, mid, end, centers);
+}
+
+template<class Visitor>
+void FaceBvh::traverse(const Point3m& o, const Point3m& d, Scalarm& tMax, Visitor visit) const
+{
+	if (nodes.empty())
+		return;
+	const Point3m invD(1 / d[0], 1 / d[1], 1 / d[2]);
+	// the median split keeps the depth logarithmic
+	int stack[128];
+	int top      = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+		if (!hitBox(node.box, o, invD, tMax))
+			continue;
+		if (node.count > 0) {
+			for (int i = node.first; i < node.first + node.count; ++i)
+				visit(tris[i], tMax);
+		}
+		else {
+			stack[top++] = node.first;
+			stack[top++] = node.first + 1;
+		}
+	}
+}
+
+bool FaceBvh::firstHit(
+	const Point3m& o,
+	const Point3m& d,
+	Scalarm        tMin,
+	Scalarm        tMax,
+	int            ignoreVertex,
+	int            ignoreFace,
+	int&           face,
+	Scalarm&       t) const
+{
+	face = -1;
+	traverse(o, d, tMax, [&](const Triangle& tri, Scalarm& tm) {
+		if (tri.face == ignoreFace || tri.vi[0] == ignoreVertex || tri.vi[1] == ignoreVertex ||
+			tri.vi[2] == ignoreVertex)
+			return;
+		Scalarm th;
+		if (intersect(tri.v0, tri.e1, tri.e2, o, d, th) && th > tMin && th < tm) {
+			tm   = th;
+			face = tri.face;
+		}
+	});
+	t = tMax;
+	return face >= 0;
+}
+
+int FaceBvh::countHits(const Point3m& o, const Point3m& d) const
+{
+	Scalarm tMax = std::numeric_limits<Scalarm>::max();
+	int     hits = 0;
+	traverse(o, d, tMax, [&](const Triangle& tri, Scalarm&) {
+		Scalarm th;
+		if (intersect(tri.v0, tri.e1, tri.e2, o, d, th) && th > 0)
+			++hits;
+	});
+	return hits;
+}
+
+} // namespace meshlab
@@ -0,0 +1,110 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef MESHLAB_FACE_BVH_H
+#define MESHLAB_FACE_BVH_H
+
+#include <vector>
+
+#include "../ml_document/cmesh.h"
+
+namespace meshlab {
+
+/**
+ * @brief Bounding volume hierarchy over the faces of a mesh, for casting rays
+ * concurrently from many threads: after the construction all the queries are
+ * const.
+ *
+ * The faces are indexed as in m.face; the deleted faces are skipped. The
+ * hierarchy is a copy of the geometry, it is not updated if the mesh changes.
+ */
+class FaceBvh
+{
+public:
+	explicit FaceBvh(const CMeshO& m);
+
+	/**
+	 * @brief Nearest face hit by the ray o + t*d with tMin < t < tMax, both
+	 * sides of the faces count. The faces incident to ignoreVertex and the
+	 * face ignoreFace (-1 for none) are skipped.
+	 *
+	 * @return false if no face is hit
+	 */
+	bool firstHit(
+		const Point3m& o,
+		const Point3m& d,
+		Scalarm        tMin,
+		Scalarm        tMax,
+		int            ignoreVertex,
+		int            ignoreFace,
+		int&           face,
+		Scalarm&       t) const;
+
+	/** @brief Number of faces crossed by the ray o + t*d with t > 0 */
+	int countHits(const Point3m& o, const Point3m& d) const;
+
+	/** @brief Unit normal of the face f, computed from its vertices */
+	const Point3m& faceNormal(int f) const { return normals[f]; }
+
+	Box3m bbox() const { return nodes.empty() ? Box3m() : nodes[0].box; }
+
+	/** @brief Bytes allocated by the hierarchy */
+	std::size_t memoryUsed() const
+	{
+		return nodes.capacity() * sizeof(Node) + tris.capacity() * sizeof(Triangle) +
+			   normals.capacity() * sizeof(Point3m);
+	}
+
+private:
+	struct Node
+	{
+		Box3m box;
+		int   first; // first child if count == 0, else first triangle
+		int   count;
+	};
+
+	struct Triangle
+	{
+		Point3m v0, e1, e2;
+		int     face;
+		int     vi[3];
+	};
+
+	void build(
+		int                         node,
+		std::vector<int>&           order,
+		int                         begin,
+		int                         end,
+		const std::vector<Point3m>& centers);
+
+	template<class Visitor>
+	void traverse(const Point3m& o, const Point3m& d, Scalarm& tMax, Visitor visit) const;
+
+	std::vector<Node>     nodes;
+	std::vector<Triangle> tris; // in leaf order
+	std::vector<Point3m>  normals;
+};
+
+} // namespace meshlab
+
+#endif // MESHLAB_FACE_BVH_H
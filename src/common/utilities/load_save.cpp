@@ -28,6 +28,7 @@
 
 #include "../globals.h"
 #include "../plugins/plugin_manager.h"
+#include "trace.h"
 
 #include <exif.h>
 
@@ -63,12 +64,14 @@ std::list<std::string> loadMesh(
 	std::list<std::string> unloadedTextures;
 	QFileInfo              fi(fileName);
 	QString                extension = fi.suffix();
+	TraceSpan              span("loadMesh " + fi.fileName().toStdString(), "io");
 
 	QDir oldDir = QDir::current();
 	QDir::setCurrent(fi.absolutePath());
 	ioPlugin->open(extension, fi.fileName(), meshList, maskList, prePar, cb);
 	QDir::setCurrent(oldDir.absolutePath());
 
+	long long loadedVertices = 0, loadedFaces = 0;
 	auto itmesh = meshList.begin();
 	auto itmask = maskList.begin();
 	for (unsigned int i = 0; i < meshList.size(); ++i) {
@@ -113,10 +116,14 @@ std::list<std::string> loadMesh(
 										.arg(delVertNum)
 										.arg(delFaceNum));
 
+		loadedVertices += mm->cm.VN();
+		loadedFaces += mm->cm.FN();
 		// computeRenderingDataOnLoading(mm,isareload, rendOpt);
 		++itmesh;
 		++itmask;
 	}
+	span.setCounter("vertices", loadedVertices);
+	span.setCounter("faces", loadedFaces);
 	return unloadedTextures;
 }
 
@@ -248,6 +255,9 @@ void saveMeshWithStandardParameters(
 {
 	QFileInfo fi(fileName);
 	QString   extension = fi.suffix().toLower();
+	TraceSpan span("saveMesh " + fi.fileName().toStdString(), "io");
+	span.setCounter("vertices", m.cm.VN());
+	span.setCounter("faces", m.cm.FN());
 
 	PluginManager& pm       = meshlab::pluginManagerInstance();
 	IOPlugin*      ioPlugin = pm.outputMeshPlugin(extension);
@@ -0,0 +1,376 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "merge_vertices.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <vcg/complex/algorithms/clean.h>
+
+namespace meshlab {
+
+namespace {
+
+const size_t NO_VERTEX = size_t(-1);
+
+inline uint64_t mix64(uint64_t x)
+{
+	// splitmix64 finalizer
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+inline uint64_t scalarBits(Scalarm v)
+{
+	if (v == Scalarm(0)) // +0 and -0 compare equal
+		v = Scalarm(0);
+	uint64_t bits = 0;
+	std::memcpy(&bits, &v, sizeof(Scalarm));
+	return bits;
+}
+
+inline bool isFinite(const Point3m& p)
+{
+	return std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]);
+}
+
+/* Number of buckets used to partition n items: a power of two, with a few
+ * hundreds of items per bucket, capped to keep the per-thread counters small */
+unsigned bucketCount(size_t n)
+{
+	unsigned nBuckets = 1;
+	while (nBuckets < (1u << 16) && (size_t) nBuckets * 256 < n)
+		nBuckets <<= 1;
+	return nBuckets;
+}
+
+inline unsigned bucketOfHash(uint64_t h, unsigned nBuckets)
+{
+	return (unsigned) (h & (nBuckets - 1));
+}
+
+/* Parallel counting sort of the indices [0, n) by bucket. bucket[i] is the
+ * bucket of item i, or nBuckets if the item must be skipped. On return, the
+ * items of bucket b are order[offsets[b]] ... order[offsets[b+1]-1], in
+ * increasing index order. */
+void partitionByBucket(
+	const std::vector<unsigned>& bucket,
+	unsigned                     nBuckets,
+	std::vector<size_t>&         order,
+	std::vector<size_t>&         offsets)
+{
+	const size_t n       = bucket.size();
+	int          nChunks = 1;
+#ifdef _OPENMP
+	nChunks = omp_get_max_threads();
+#endif
+	const size_t chunkSize = (n + nChunks - 1) / nChunks;
+	const size_t stride    = (size_t) nBuckets + 1;
+
+	std::vector<size_t> counts((size_t) nChunks * stride, 0);
+
+#pragma omp parallel for
+	for (int c = 0; c < nChunks; ++c) {
+		size_t* cnt = &counts[c * stride];
+		for (size_t i = c * chunkSize; i < std::min(n, (c + 1) * chunkSize); ++i)
+			cnt[bucket[i]]++;
+	}
+
+	// bucket-major prefix sum, so that each bucket keeps the index order
+	offsets.assign(nBuckets + 1, 0);
+	size_t sum = 0;
+	for (unsigned b = 0; b <= nBuckets; ++b) {
+		offsets[b] = sum;
+		for (int c = 0; c < nChunks; ++c) {
+			size_t t = counts[c * stride + b];
+			counts[c * stride + b] = sum;
+			sum += t;
+		}
+	}
+
+	order.resize(n);
+#pragma omp parallel for
+	for (int c = 0; c < nChunks; ++c) {
+		size_t* cnt = &counts[c * stride];
+		for (size_t i = c * chunkSize; i < std::min(n, (c + 1) * chunkSize); ++i)
+			order[cnt[bucket[i]]++] = i;
+	}
+}
+
+struct GridCell
+{
+	long long x, y, z;
+
+	bool operator==(const GridCell& c) const { return x == c.x && y == c.y && z == c.z; }
+	bool operator<(const GridCell& c) const
+	{
+		return (x != c.x) ? (x < c.x) : (y != c.y) ? (y < c.y) : (z < c.z);
+	}
+};
+
+inline long long cellCoord(Scalarm v, Scalarm radius)
+{
+	const double maxCoord = 4611686018427387904.0; // 2^62
+	double c = std::floor(double(v) / double(radius));
+	return (long long) std::max(-maxCoord, std::min(maxCoord, c));
+}
+
+inline uint64_t cellHash(const GridCell& c)
+{
+	return mix64(mix64(mix64(uint64_t(c.x)) ^ uint64_t(c.y)) ^ uint64_t(c.z));
+}
+
+/* Snaps the vertices closer than radius as vcg::tri::Clean::ClusterVertex
+ * does, and returns the number of snapped vertices. The mesh must be
+ * compact. */
+int clusterVertices(CMeshO& m, Scalarm radius)
+{
+	if (!(radius > 0)) // also rejects NaN; the grid cells would be empty
+		return 0;
+
+	const size_t   n        = m.vert.size();
+	const unsigned nBuckets = bucketCount(n);
+
+	// hash the vertices on a grid with cells of size radius: all the vertices
+	// closer than radius to a vertex lie in the 27 cells around it
+	std::vector<GridCell> cell(n);
+	std::vector<unsigned> bucket(n);
+#pragma omp parallel for
+	for (long long i = 0; i < (long long) n; ++i) {
+		const Point3m& p = m.vert[i].cP();
+		if (isFinite(p)) {
+			cell[i]   = {cellCoord(p[0], radius), cellCoord(p[1], radius), cellCoord(p[2], radius)};
+			bucket[i] = bucketOfHash(cellHash(cell[i]), nBuckets);
+		}
+		else {
+			bucket[i] = nBuckets; // never closer than radius to anything
+		}
+	}
+
+	std::vector<size_t> order, offsets;
+	partitionByBucket(bucket, nBuckets, order, offsets);
+
+#pragma omp parallel for schedule(dynamic, 64)
+	for (int b = 0; b < (int) nBuckets; ++b) {
+		std::sort(
+			order.begin() + offsets[b], order.begin() + offsets[b + 1], [&](size_t i, size_t j) {
+				return (cell[i] == cell[j]) ? (i < j) : (cell[i] < cell[j]);
+			});
+	}
+
+	auto forEachCloseVertex = [&](size_t v, auto&& fun) {
+		const Point3m& p = m.vert[v].cP();
+		const GridCell& c = cell[v];
+		for (long long dx = -1; dx <= 1; ++dx)
+			for (long long dy = -1; dy <= 1; ++dy)
+				for (long long dz = -1; dz <= 1; ++dz) {
+					GridCell nc = {c.x + dx, c.y + dy, c.z + dz};
+					unsigned nb = bucketOfHash(cellHash(nc), nBuckets);
+					auto     it = std::lower_bound(
+						order.begin() + offsets[nb],
+						order.begin() + offsets[nb + 1],
+						nc,
+						[&](size_t i, const GridCell& key) { return cell[i] < key; });
+					for (; it != order.begin() + offsets[nb + 1] && cell[*it] == nc; ++it) {
+						size_t u = *it;
+						if (u < v && vcg::Distance(m.vert[u].cP(), p) < radius)
+							fun(u);
+					}
+				}
+	};
+
+	// close vertices with a lower index, stored as a compressed adjacency
+	std::vector<size_t> lowerOffsets(n + 1, 0);
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (long long v = 0; v < (long long) n; ++v) {
+		if (bucket[v] == nBuckets)
+			continue;
+		size_t cnt = 0;
+		forEachCloseVertex(v, [&](size_t) { cnt++; });
+		lowerOffsets[v + 1] = cnt;
+	}
+	for (size_t v = 0; v < n; ++v)
+		lowerOffsets[v + 1] += lowerOffsets[v];
+
+	std::vector<size_t> lower(lowerOffsets[n]);
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (long long v = 0; v < (long long) n; ++v) {
+		if (bucket[v] == nBuckets)
+			continue;
+		size_t k = lowerOffsets[v];
+		forEachCloseVertex(v, [&](size_t u) { lower[k++] = u; });
+	}
+
+	// greedy visit in index order: a vertex is snapped by the first vertex that
+	// precedes it, is closer than radius and has not been snapped itself
+	std::vector<size_t> target(n, NO_VERTEX);
+	int                 merged = 0;
+	for (size_t v = 0; v < n; ++v) {
+		size_t best = NO_VERTEX;
+		for (size_t k = lowerOffsets[v]; k < lowerOffsets[v + 1]; ++k) {
+			size_t u = lower[k];
+			if (target[u] == NO_VERTEX && u < best)
+				best = u;
+		}
+		if (best != NO_VERTEX) {
+			target[v] = best;
+			merged++;
+		}
+	}
+
+#pragma omp parallel for
+	for (long long v = 0; v < (long long) n; ++v)
+		if (target[v] != NO_VERTEX)
+			m.vert[v].P() = m.vert[target[v]].cP();
+
+	return merged;
+}
+
+} // namespace
+
+int removeDuplicateVertices(CMeshO& m)
+{
+	if (m.vert.size() == 0 || m.vn == 0)
+		return 0;
+	if (m.tn > 0)
+		return vcg::tri::Clean<CMeshO>::RemoveDuplicateVertex(m);
+
+	const size_t   n        = m.vert.size();
+	const unsigned nBuckets = bucketCount(n);
+
+	// the vertices that are not finite are skipped, as they never compare equal
+	std::vector<uint64_t> posHash(n);
+	std::vector<unsigned> bucket(n);
+#pragma omp parallel for
+	for (long long i = 0; i < (long long) n; ++i) {
+		const Point3m& p = m.vert[i].cP();
+		if (isFinite(p)) {
+			posHash[i] = mix64(mix64(mix64(scalarBits(p[0])) ^ scalarBits(p[1])) ^ scalarBits(p[2]));
+			bucket[i] = bucketOfHash(posHash[i], nBuckets);
+		}
+		else {
+			bucket[i] = nBuckets;
+		}
+	}
+
+	std::vector<size_t> order, offsets;
+	partitionByBucket(bucket, nBuckets, order, offsets);
+
+	std::vector<size_t> remap(n);
+	for (size_t i = 0; i < n; ++i)
+		remap[i] = i;
+
+	// within a bucket, coincident vertices become contiguous and sorted by
+	// index; as in vcg, a deleted vertex interrupts the group it belongs to
+	int deleted = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+ : deleted)
+	for (int b = 0; b < (int) nBuckets; ++b) {
+		auto first = order.begin() + offsets[b];
+		auto last  = order.begin() + offsets[b + 1];
+		std::sort(first, last, [&](size_t i, size_t j) {
+			if (posHash[i] != posHash[j])
+				return posHash[i] < posHash[j];
+			const Point3m& pi = m.vert[i].cP();
+			const Point3m& pj = m.vert[j].cP();
+			return (pi == pj) ? (i < j) : (pi < pj);
+		});
+
+		size_t rep = NO_VERTEX;
+		for (auto it = first; it != last; ++it) {
+			size_t v = *it;
+			if (it != first && !(m.vert[v].cP() == m.vert[*(it - 1)].cP()))
+				rep = NO_VERTEX;
+			if (m.vert[v].IsD()) {
+				rep = NO_VERTEX;
+			}
+			else if (rep == NO_VERTEX) {
+				rep = v;
+			}
+			else {
+				remap[v] = rep;
+				m.vert[v].SetD();
+				deleted++;
+			}
+		}
+	}
+	m.vn -= deleted;
+
+	if (deleted > 0) {
+		CVertexO* base = &m.vert[0];
+#pragma omp parallel for
+		for (long long fi = 0; fi < (long long) m.face.size(); ++fi) {
+			CFaceO& f = m.face[fi];
+			if (f.IsD())
+				continue;
+			for (int k = 0; k < f.VN(); ++k) {
+				size_t vi = f.V(k) - base;
+				if (remap[vi] != vi)
+					f.V(k) = base + remap[vi];
+			}
+		}
+#pragma omp parallel for
+		for (long long ei = 0; ei < (long long) m.edge.size(); ++ei) {
+			CMeshO::EdgeType& e = m.edge[ei];
+			if (e.IsD())
+				continue;
+			for (int k = 0; k < 2; ++k) {
+				size_t vi = e.V(k) - base;
+				if (remap[vi] != vi)
+					e.V(k) = base + remap[vi];
+			}
+		}
+	}
+
+	vcg::tri::Clean<CMeshO>::RemoveDegenerateFace(m);
+	if (m.en > 0) {
+		vcg::tri::Clean<CMeshO>::RemoveDegenerateEdge(m);
+		vcg::tri::Clean<CMeshO>::RemoveDuplicateEdge(m);
+	}
+
+	return deleted;
+}
+
+int mergeCloseVertices(CMeshO& m, Scalarm radius)
+{
+	int merged = 0;
+	if (m.vn != 0) {
+		vcg::tri::Allocator<CMeshO>::CompactVertexVector(m);
+		merged = clusterVertices(m, radius);
+	}
+	removeDuplicateVertices(m);
+	return merged;
+}
+
+} // namespace meshlab
@@ -0,0 +1,66 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef MESHLAB_MERGE_VERTICES_H
+#define MESHLAB_MERGE_VERTICES_H
+
+#include "../ml_document/cmesh.h"
+
+namespace meshlab {
+
+/**
+ * @brief Merges the vertices that have exactly the same position, with the
+ * same result of vcg::tri::Clean::RemoveDuplicateVertex: in each group of
+ * coincident vertices the one with the lowest index is kept, the faces and
+ * the edges are redirected to it, the others are deleted, and the faces that
+ * became degenerate and the edges that became degenerate or duplicated are
+ * removed. Meshes with tetrahedra are handed to the vcg function.
+ *
+ * Instead of sorting all the vertex pointers, the vertices are partitioned by
+ * a hash of their position with a parallel counting sort; the buckets are then
+ * sorted and scanned concurrently, and face and edge references are updated
+ * in parallel.
+ *
+ * @return the number of deleted vertices
+ */
+int removeDuplicateVertices(CMeshO& m);
+
+/**
+ * @brief Merges the vertices closer than radius, with the same result of
+ * vcg::tri::Clean::MergeCloseVertex: visiting the vertices in index order,
+ * each vertex that has not been merged yet snaps to its position all the
+ * following unmerged vertices closer than radius, and coincident vertices are
+ * then removed with removeDuplicateVertices(). A radius that is not positive
+ * merges nothing.
+ *
+ * The close pairs are gathered in parallel on a hashed uniform grid with cells
+ * of size radius; only the greedy assignment, linear in the number of close
+ * pairs, is sequential.
+ *
+ * @return the number of merged vertices
+ */
+int mergeCloseVertices(CMeshO& m, Scalarm radius);
+
+} // namespace meshlab
+
+#endif // MESHLAB_MERGE_VERTICES_H
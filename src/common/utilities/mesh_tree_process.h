@@ -0,0 +1,344 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef MESHLAB_MESH_TREE_PROCESS_H
+#define MESHLAB_MESH_TREE_PROCESS_H
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+#include <vcg/complex/algorithms/meshtree.h>
+#include <vcg/math/histogram.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "../ml_document/mesh_model.h"
+
+namespace meshlab {
+
+/**
+ * @brief Adds the meshes, placed by their transformation matrices, to an
+ * occupancy grid that has already been initialized, with the same result of
+ * calling OccupancyGrid::AddMesh for each of them with their ids.
+ *
+ * The cells touched by the vertices of each mesh are found concurrently, one
+ * mesh per thread; then each mesh is added sequentially as a point cloud with
+ * a point in the center of each of its cells, so that only a few points per
+ * cell are left to the grid.
+ */
+template <class OccupancyGridType>
+void addMeshesToOccupancyGrid(OccupancyGridType& og, const std::vector<MeshModel*>& meshes)
+{
+	typedef typename std::remove_reference<decltype(og.G)>::type GridType;
+	typedef typename GridType::CoordType                         CoordType;
+	typedef typename CoordType::ScalarType                       GridScalar;
+
+	const vcg::Point3i siz = og.G.siz;
+	std::vector<std::vector<int>> cells(meshes.size());
+
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < (int) meshes.size(); ++i) {
+		const CMeshO&                   m  = meshes[i]->cm;
+		const vcg::Matrix44<GridScalar> tr = vcg::Matrix44<GridScalar>::Construct(m.Tr);
+		std::vector<bool>               touched(std::size_t(siz[0]) * siz[1] * siz[2], false);
+		for (const CVertexO& v : m.vert) {
+			if (v.IsD())
+				continue;
+			vcg::Point3i ip;
+			og.G.PToIP(tr * CoordType::Construct(v.cP()), ip);
+			for (int k = 0; k < 3; ++k)
+				ip[k] = std::min(std::max(ip[k], 0), siz[k] - 1);
+			std::size_t c = ip[0] + std::size_t(siz[0]) * (ip[1] + std::size_t(siz[1]) * ip[2]);
+			if (!touched[c]) {
+				touched[c] = true;
+				cells[i].push_back(int(c));
+			}
+		}
+	}
+
+	CMeshO cloud;
+	for (std::size_t i = 0; i < meshes.size(); ++i) {
+		cloud.Clear();
+		vcg::tri::Allocator<CMeshO>::AddVertices(cloud, cells[i].size());
+		for (std::size_t j = 0; j < cells[i].size(); ++j) {
+			int          c = cells[i][j];
+			vcg::Point3i ip(c % siz[0], (c / siz[0]) % siz[1], c / (siz[0] * siz[1]));
+			CoordType    center;
+			og.G.IPiToPf(ip, center);
+			center += og.G.voxel / GridScalar(2);
+			cloud.vert[j].P() = Point3m::Construct(center);
+		}
+		// the cloud is already in world coordinates; the matrix has the scalar of
+		// the mesh, as the mesh.cm.Tr passed by the serial version
+		og.AddMesh(cloud, Matrix44m::Identity(), meshes[i]->id());
+		std::vector<int>().swap(cells[i]);
+	}
+}
+
+/**
+ * @brief Same as vcg::MeshTree::Process: computes the overlaps of the glued
+ * meshes of the tree with its occupancy grid, aligns with ICP every pair that
+ * overlaps enough (an arc) and whose alignment is missing or among the worst
+ * ones, and then computes the global alignment.
+ *
+ * The occupancy grid is filled with addMeshesToOccupancyGrid(), and the arcs
+ * are aligned concurrently. Each mesh is converted and sampled once: the
+ * samples of a moving mesh are shared by all its arcs, and the arcs of the
+ * same fixed mesh are aligned one after another by the same thread, reusing
+ * its search grid (whose queries mark the faces of the converted mesh). The
+ * results are logged in the order of the arcs, as in the sequential process.
+ * Similarity matching keeps its state in static members of
+ * vcg::PointMatchingScale, so in that mode the arcs are aligned sequentially.
+ */
+template <class MeshTreeType>
+void processMeshTree(
+	MeshTreeType&                 tree,
+	vcg::AlignPair::Param&        ap,
+	typename MeshTreeType::Param& mtp)
+{
+	char buf[1024];
+	std::sprintf(
+		buf,
+		"Starting Processing of %i glued meshes out of %zu meshes\n",
+		tree.gluedNum(),
+		tree.nodeMap.size());
+	tree.cb(0, buf);
+
+	/******* Occupancy Grid Computation *************/
+	std::sprintf(buf, "Computing Overlaps %i glued meshes...\n", tree.gluedNum());
+	tree.cb(0, buf);
+
+	typedef typename std::remove_reference<decltype(tree.OG.G)>::type GridType;
+	typedef typename GridType::CoordType::ScalarType                  GridScalar;
+	tree.OG.Init(
+		static_cast<int>(tree.nodeMap.size()),
+		vcg::Box3<GridScalar>::Construct(tree.gluedBBox()),
+		mtp.OGSize);
+	std::vector<MeshModel*> glued;
+	for (auto& ni : tree.nodeMap)
+		if (ni.second->glued)
+			glued.push_back(ni.second->m);
+	addMeshesToOccupancyGrid(tree.OG, glued);
+	tree.OG.Compute();
+	tree.OG.Dump(stdout);
+	// Note: the s and t of the OG translate into fix and mov, respectively.
+
+	// count existing arcs within current error threshold
+	float percentileThr = 0;
+	if (!tree.resultList.empty()) {
+		vcg::Distribution<float> H;
+		for (auto& li : tree.resultList)
+			H.Add(li.err);
+		percentileThr = H.Percentile(1.0f - mtp.recalcThreshold);
+	}
+
+	std::size_t totalArcNum     = 0;
+	int         preservedArcNum = 0, recalcArcNum = 0;
+	while (totalArcNum < tree.OG.SVA.size() &&
+		   tree.OG.SVA[totalArcNum].norm_area > mtp.arcThreshold) {
+		vcg::AlignPair::Result* curResult =
+			tree.findResult(tree.OG.SVA[totalArcNum].s, tree.OG.SVA[totalArcNum].t);
+		if (curResult) {
+			if (curResult->err < percentileThr)
+				++preservedArcNum;
+			else
+				++recalcArcNum;
+		}
+		else {
+			tree.resultList.push_back(vcg::AlignPair::Result());
+			tree.resultList.back().FixName = tree.OG.SVA[totalArcNum].s;
+			tree.resultList.back().MovName = tree.OG.SVA[totalArcNum].t;
+			tree.resultList.back().err     = std::numeric_limits<double>::max();
+		}
+		++totalArcNum;
+	}
+
+	// if there are no arcs at all complain and return
+	if (totalArcNum == 0) {
+		std::sprintf(
+			buf,
+			"\n Failure. There are no overlapping meshes?\n No candidate alignment arcs. "
+			"Nothing Done.\n");
+		tree.cb(0, buf);
+		return;
+	}
+
+	std::sprintf(
+		buf, "Arc with good overlap %6zu (on  %6zu)\n", totalArcNum, tree.OG.SVA.size());
+	tree.cb(0, buf);
+	std::sprintf(buf, " %6i preserved %i Recalc \n", preservedArcNum, recalcArcNum);
+	tree.cb(0, buf);
+
+	/*************** The arcs to be computed, grouped by fixed mesh **************/
+	std::vector<vcg::AlignPair::Result*>                 results(totalArcNum);
+	std::vector<char>                                    recalc(totalArcNum, 0);
+	std::map<int, std::vector<int>>                      arcsOfFix;
+	std::map<int, std::vector<vcg::AlignPair::A2Vertex>> movSamples;
+	for (std::size_t i = 0; i < totalArcNum; ++i) {
+		const auto& arc = tree.OG.SVA[i];
+		results[i]      = tree.findResult(arc.s, arc.t);
+		// missing arcs and arcs with great error must be recomputed
+		if (results[i]->err >= percentileThr) {
+			recalc[i] = 1;
+			arcsOfFix[arc.s].push_back(int(i));
+			movSamples[arc.t];
+		}
+	}
+	std::vector<int> fixIds;
+	for (auto& fa : arcsOfFix) {
+		fixIds.push_back(fa.first);
+		tree.MM(fa.first)->updateDataMask(MeshModel::MM_FACEMARK);
+	}
+	std::vector<std::pair<MeshModel*, std::vector<vcg::AlignPair::A2Vertex>*>> movs;
+	for (auto& ms : movSamples) {
+		movs.push_back(std::make_pair(tree.MM(ms.first), &ms.second));
+		tree.MM(ms.first)->updateDataMask(MeshModel::MM_FACEMARK);
+	}
+	std::map<int, MeshModel*> meshes;
+	for (auto& ni : tree.nodeMap)
+		meshes[ni.first] = ni.second->m;
+
+	int nThreads = 1;
+#ifdef _OPENMP
+	if (ap.MatchMode != vcg::AlignPair::Param::MMSimilarity)
+		nThreads = omp_get_max_threads();
+#endif
+
+	// convert the moving meshes and sample <ap.SampleNum> points on them
+#pragma omp parallel for schedule(dynamic, 1) num_threads(nThreads)
+	for (int k = 0; k < (int) movs.size(); ++k) {
+		vcg::AlignPair aa;
+		aa.convertVertex(movs[k].first->cm.vert, *movs[k].second);
+		aa.sampleMovVert(*movs[k].second, ap.SampleNum, ap.SampleMode);
+	}
+
+	// convert each fixed mesh, put it into the grid, and align its arcs
+#pragma omp parallel for schedule(dynamic, 1) num_threads(nThreads)
+	for (int k = 0; k < (int) fixIds.size(); ++k) {
+		MeshModel*                 fixMesh = meshes.at(fixIds[k]);
+		vcg::AlignPair::Param      arcAp   = ap;
+		vcg::AlignPair::A2Mesh     fix;
+		vcg::AlignPair::A2Grid     UG;
+		vcg::AlignPair::A2GridVert VG;
+		vcg::AlignPair             converter;
+		converter.convertMesh<CMeshO>(fixMesh->cm, fix);
+		if (fixMesh->cm.fn == 0 || arcAp.UseVertexOnly) {
+			fix.initVert(vcg::Matrix44d::Identity());
+			vcg::AlignPair::InitFixVert(&fix, arcAp, VG);
+		}
+		else {
+			fix.init(vcg::Matrix44d::Identity());
+			vcg::AlignPair::initFix(&fix, arcAp, UG);
+		}
+
+		// the alignment is computed in the reference frame of the fixed mesh
+		vcg::Matrix44d fixInv = vcg::Inverse(vcg::Matrix44d::Construct(fixMesh->cm.Tr));
+		for (int i : arcsOfFix.at(fixIds[k])) {
+			const auto& arc = tree.OG.SVA[i];
+
+			// each arc gets its own copy of the shared samples
+			std::vector<vcg::AlignPair::A2Vertex> mov = movSamples.at(arc.t);
+			vcg::AlignPair                        aa;
+			aa.mov = &mov;
+			aa.fix = &fix;
+			aa.ap  = arcAp;
+			vcg::Matrix44d movToFix =
+				fixInv * vcg::Matrix44d::Construct(meshes.at(arc.t)->cm.Tr);
+			aa.align(movToFix, UG, VG, *results[i]);
+			results[i]->FixName = arc.s;
+			results[i]->MovName = arc.t;
+			results[i]->area    = arc.norm_area;
+		}
+	}
+
+	bool hasValidArcs = false;
+	for (std::size_t i = 0; i < totalArcNum; ++i) {
+		const auto& arc = tree.OG.SVA[i];
+		std::fprintf(
+			stdout,
+			"%4i -> %4i Area:%5i NormArea:%5.3f\n",
+			arc.s,
+			arc.t,
+			arc.area,
+			arc.norm_area);
+		if (!recalc[i])
+			continue;
+		if (results[i]->isValid()) {
+			hasValidArcs                 = true;
+			std::pair<double, double> dd = results[i]->computeAvgErr();
+			std::sprintf(
+				buf,
+				"(%3zu/%3zu) %2i -> %2i Aligned AvgErr dd=%f -> dd=%f \n",
+				i + 1,
+				totalArcNum,
+				arc.s,
+				arc.t,
+				dd.first,
+				dd.second);
+		}
+		else {
+			std::sprintf(
+				buf,
+				"(%3zu/%3zu) %2i -> %2i Failed Alignment of one arc %s\n",
+				i + 1,
+				totalArcNum,
+				arc.s,
+				arc.t,
+				vcg::AlignPair::errorMsg(results[i]->status));
+		}
+		tree.cb(0, buf);
+	}
+
+	// if there are no valid arcs complain and return
+	if (!hasValidArcs) {
+		std::sprintf(
+			buf,
+			"\n Failure. No successful arc among candidate Alignment arcs. Nothing Done.\n");
+		tree.cb(0, buf);
+		return;
+	}
+
+	vcg::Distribution<float> H; // stat for printing
+	for (auto& li : tree.resultList)
+		if (li.isValid())
+			H.Add(li.err);
+	std::sprintf(
+		buf,
+		"Completed Mesh-Mesh Alignment: Avg Err %5.3f; Median %5.3f; 90%% %5.3f\n",
+		H.Avg(),
+		H.Percentile(0.5f),
+		H.Percentile(0.9f));
+	tree.cb(0, buf);
+
+	tree.ProcessGlobal(ap);
+}
+
+} // namespace meshlab
+
+#endif // MESHLAB_MESH_TREE_PROCESS_H
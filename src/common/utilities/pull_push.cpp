@@ -0,0 +1,198 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "pull_push.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace meshlab {
+
+namespace {
+
+/* One level of the pyramid. The first level wraps the pixels of the image
+ * itself and detects holes comparing with the background color; the other
+ * levels own their texels and keep an explicit hole mask, since an average
+ * may be equal to the background color. */
+struct PullPushLevel
+{
+	QRgb*              texels = nullptr;
+	int                stride = 0;
+	int                w      = 0;
+	int                h      = 0;
+	QRgb               bkColor = 0;
+	std::vector<QRgb>  storage;
+	std::vector<uchar> filled;
+
+	PullPushLevel(QImage& img, QRgb bk) :
+			texels(reinterpret_cast<QRgb*>(img.bits())),
+			stride(img.bytesPerLine() / 4),
+			w(img.width()),
+			h(img.height()),
+			bkColor(bk)
+	{
+	}
+
+	PullPushLevel(int width, int height) :
+			w(width), h(height), storage((size_t) width * height), filled((size_t) width * height, 0)
+	{
+		texels = storage.data();
+		stride = width;
+	}
+
+	QRgb* row(int y) { return texels + (size_t) y * stride; }
+
+	bool isHole(int x, int y) const
+	{
+		if (filled.empty())
+			return texels[(size_t) y * stride + x] == bkColor;
+		return filled[(size_t) y * w + x] == 0;
+	}
+
+	void set(int x, int y, QRgb c)
+	{
+		texels[(size_t) y * stride + x] = c;
+		if (!filled.empty())
+			filled[(size_t) y * w + x] = 1;
+	}
+};
+
+/* Weighted sum of colors premultiplied by their alpha. The plain sum is kept
+ * as well for the (rare) case of non-hole texels that are fully transparent. */
+struct PremultipliedSum
+{
+	unsigned int r = 0, g = 0, b = 0, a = 0;
+	unsigned int pr = 0, pg = 0, pb = 0;
+	unsigned int weight = 0;
+
+	void add(QRgb c, unsigned int w)
+	{
+		const unsigned int wa = w * qAlpha(c);
+		r += wa * qRed(c);
+		g += wa * qGreen(c);
+		b += wa * qBlue(c);
+		a += wa;
+		pr += w * qRed(c);
+		pg += w * qGreen(c);
+		pb += w * qBlue(c);
+		weight += w;
+	}
+
+	QRgb result() const
+	{
+		const unsigned int alpha = (a + weight / 2) / weight;
+		if (a == 0)
+			return qRgba(
+				(pr + weight / 2) / weight, (pg + weight / 2) / weight, (pb + weight / 2) / weight, 0);
+		return qRgba((r + a / 2) / a, (g + a / 2) / a, (b + a / 2) / a, alpha);
+	}
+};
+
+/* The last row/column of the coarse level also takes the odd row/column of
+ * the finer level, so that nothing is lost on non power-of-two images. */
+void pull(PullPushLevel& fine, PullPushLevel& coarse)
+{
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < coarse.h; ++y) {
+		const int y0 = 2 * y;
+		const int y1 = (y == coarse.h - 1) ? fine.h - 1 : std::min(2 * y + 1, fine.h - 1);
+		QRgb* dst = coarse.row(y);
+		for (int x = 0; x < coarse.w; ++x) {
+			const int x0 = 2 * x;
+			const int x1 = (x == coarse.w - 1) ? fine.w - 1 : std::min(2 * x + 1, fine.w - 1);
+			PremultipliedSum sum;
+			for (int fy = y0; fy <= y1; ++fy) {
+				const QRgb* src = fine.row(fy);
+				for (int fx = x0; fx <= x1; ++fx)
+					if (!fine.isHole(fx, fy))
+						sum.add(src[fx], 1);
+			}
+			if (sum.weight > 0) {
+				dst[x] = sum.result();
+				coarse.filled[(size_t) y * coarse.w + x] = 1;
+			}
+		}
+	}
+}
+
+void push(PullPushLevel& fine, PullPushLevel& coarse)
+{
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < fine.h; ++y) {
+		const int cy = std::min(y / 2, coarse.h - 1);
+		const int ny = (y % 2 == 0) ? cy - 1 : cy + 1;
+		for (int x = 0; x < fine.w; ++x) {
+			if (!fine.isHole(x, y))
+				continue;
+			const int cx = std::min(x / 2, coarse.w - 1);
+			const int nx = (x % 2 == 0) ? cx - 1 : cx + 1;
+			const bool validX = nx >= 0 && nx < coarse.w;
+			const bool validY = ny >= 0 && ny < coarse.h;
+
+			PremultipliedSum sum;
+			if (!coarse.isHole(cx, cy))
+				sum.add(coarse.row(cy)[cx], 9);
+			if (validX && !coarse.isHole(nx, cy))
+				sum.add(coarse.row(cy)[nx], 3);
+			if (validY && !coarse.isHole(cx, ny))
+				sum.add(coarse.row(ny)[cx], 3);
+			if (validX && validY && !coarse.isHole(nx, ny))
+				sum.add(coarse.row(ny)[nx], 1);
+			if (sum.weight > 0)
+				fine.set(x, y, sum.result());
+		}
+	}
+}
+
+} // namespace
+
+void pullPush(QImage& img, QRgb bkColor)
+{
+	if (img.isNull())
+		return;
+
+	const QImage::Format origFormat = img.format();
+	if (origFormat != QImage::Format_ARGB32 && origFormat != QImage::Format_RGB32)
+		img = img.convertToFormat(QImage::Format_ARGB32);
+
+	std::vector<PullPushLevel> levels;
+	levels.reserve(32);
+	levels.emplace_back(img, bkColor);
+
+	// pull phase: build the pyramid down to a single texel
+	while (levels.back().w > 1 || levels.back().h > 1) {
+		const int w = std::max(1, levels.back().w / 2);
+		const int h = std::max(1, levels.back().h / 2);
+		levels.emplace_back(w, h);
+		pull(levels[levels.size() - 2], levels.back());
+	}
+
+	// push phase: fill the holes from the coarsest level up to the image
+	for (int i = (int) levels.size() - 1; i > 0; --i)
+		push(levels[i - 1], levels[i]);
+
+	if (img.format() != origFormat)
+		img = img.convertToFormat(origFormat);
+}
+
+} // namespace meshlab
@@ -0,0 +1,49 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef MESHLAB_PULL_PUSH_H
+#define MESHLAB_PULL_PUSH_H
+
+#include <QImage>
+
+namespace meshlab {
+
+/**
+ * @brief Fills the holes of an image with the pull-push algorithm.
+ *
+ * Texels equal to bkColor are holes. In the pull phase a pyramid of half
+ * resolution levels is built, each texel being the average of its non-hole
+ * children; in the push phase the holes of each level are filled, from the
+ * coarsest level to the image, with a 9-3-3-1 weighted average of the four
+ * nearest non-hole texels of the coarser level. Colors are accumulated
+ * premultiplied by their alpha, so partially transparent texels bleed less
+ * into the holes. Texels that are not holes are never modified.
+ *
+ * The levels are stored as raw ARGB32 buffers (images in other formats are
+ * converted back and forth) and every level is processed in parallel by rows.
+ */
+void pullPush(QImage& img, QRgb bkColor);
+
+} // namespace meshlab
+
+#endif // MESHLAB_PULL_PUSH_H
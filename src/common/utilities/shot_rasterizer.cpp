@@ -0,0 +1,277 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "shot_rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace meshlab {
+
+namespace {
+
+const int TILE_SIZE = 64;
+
+/** pixel rectangle covered by a face, empty if x0 > x1 */
+struct Rect
+{
+	int x0, y0, x1, y1;
+};
+
+/** edge function a*(x - x0) + b*(y - y0), positive inside; it is evaluated
+ * relative to a vertex, since the constant term of the expanded form cancels
+ * out most of the float precision for small faces far from the origin */
+struct Edge
+{
+	float x0, y0, a, b;
+
+	Edge() {}
+	Edge(float x0, float y0, float x1, float y1, float invArea) :
+			x0(x0), y0(y0), a((y0 - y1) * invArea), b((x1 - x0) * invArea)
+	{
+	}
+
+	float operator()(float x, float y) const { return a * (x - x0) + b * (y - y0); }
+};
+
+} // namespace
+
+ShotRasterizer::ShotRasterizer(int width, int height) : points(false), perspective(true)
+{
+	resize(width, height);
+}
+
+void ShotRasterizer::resize(int width, int height)
+{
+	w = width;
+	h = height;
+	depths.assign((size_t) w * h, std::numeric_limits<float>::infinity());
+	elements.assign((size_t) w * h, -1);
+}
+
+void ShotRasterizer::render(const CMeshO& m, const Shotm& shot)
+{
+	std::fill(depths.begin(), depths.end(), std::numeric_limits<float>::infinity());
+	std::fill(elements.begin(), elements.end(), -1);
+
+	perspective = shot.Intrinsics.cameraType == vcg::Camera<Scalarm>::PERSPECTIVE;
+	points      = m.fn == 0;
+
+	const float sx = float(w) / shot.Intrinsics.ViewportPx[0];
+	const float sy = float(h) / shot.Intrinsics.ViewportPx[1];
+	proj.resize(m.vert.size());
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < (int) m.vert.size(); ++i) {
+		const CVertexO& v = m.vert[i];
+		if (v.IsD())
+			continue;
+		vcg::Point2<Scalarm> p = shot.Project(v.cP());
+		proj[i].x = float(p[0]) * sx;
+		proj[i].y = float(p[1]) * sy;
+		proj[i].z = float(shot.ConvertWorldToCameraCoordinates(v.cP())[2]);
+	}
+
+	if (points)
+		rasterizePoints(m);
+	else
+		rasterizeFaces(m);
+}
+
+void ShotRasterizer::rasterizePoints(const CMeshO& m)
+{
+	// a point covers a single pixel, the binning would cost more than the
+	// depth test
+	for (size_t i = 0; i < m.vert.size(); ++i) {
+		const Projected& p = proj[i];
+		if (m.vert[i].IsD() || (perspective && p.z <= 0))
+			continue;
+		const int x = (int) std::floor(p.x);
+		const int y = (int) std::floor(p.y);
+		if (x < 0 || y < 0 || x >= w || y >= h)
+			continue;
+		const size_t k = x + (size_t) y * w;
+		if (p.z < depths[k]) {
+			depths[k]   = p.z;
+			elements[k] = (int) i;
+		}
+	}
+}
+
+void ShotRasterizer::rasterizeFaces(const CMeshO& m)
+{
+	const int nFaces = (int) m.face.size();
+	tris.resize(3 * (size_t) nFaces);
+
+	// pixels whose center may be inside each face
+	std::vector<Rect> rects(nFaces);
+#pragma omp parallel for schedule(static)
+	for (int f = 0; f < nFaces; ++f) {
+		Rect& r = rects[f];
+		r.x0 = r.y0 = 0;
+		r.x1 = r.y1 = -1;
+		const CFaceO& face = m.face[f];
+		if (face.IsD())
+			continue;
+		float minX = std::numeric_limits<float>::max(), maxX = -minX;
+		float minY = minX, maxY = -minX;
+		bool  visible = true;
+		for (int j = 0; j < 3; ++j) {
+			const int        vi = (int) vcg::tri::Index(m, face.cV(j));
+			const Projected& p  = proj[vi];
+			tris[3 * f + j]     = vi;
+			visible             = visible && (!perspective || p.z > 0);
+			minX                = std::min(minX, p.x);
+			maxX                = std::max(maxX, p.x);
+			minY                = std::min(minY, p.y);
+			maxY                = std::max(maxY, p.y);
+		}
+		if (!visible || maxX < 0.5f || maxY < 0.5f || minX > w - 0.5f || minY > h - 0.5f)
+			continue;
+		r.x0 = std::max(0, (int) std::ceil(minX - 0.5f));
+		r.y0 = std::max(0, (int) std::ceil(minY - 0.5f));
+		r.x1 = std::min(w - 1, (int) std::floor(maxX - 0.5f));
+		r.y1 = std::min(h - 1, (int) std::floor(maxY - 0.5f));
+	}
+
+	// bin the faces into tiles; chunks of consecutive faces are counted
+	// separately so that each tile lists its faces in index order, and ties
+	// in the depth test go to the lowest index regardless of the threads
+	const int tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+	const int tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+	const int nTiles = tilesX * tilesY;
+	int       nChunks = 1;
+#ifdef _OPENMP
+	nChunks = omp_get_max_threads();
+#endif
+	const int           chunkSize = (nFaces + nChunks - 1) / std::max(nChunks, 1);
+	std::vector<size_t> counts((size_t) nChunks * nTiles, 0);
+
+	auto forEachTile = [&](const Rect& r, auto visit) {
+		for (int ty = r.y0 / TILE_SIZE; ty <= r.y1 / TILE_SIZE; ++ty)
+			for (int tx = r.x0 / TILE_SIZE; tx <= r.x1 / TILE_SIZE; ++tx)
+				visit(tx + ty * tilesX);
+	};
+
+#pragma omp parallel for
+	for (int c = 0; c < nChunks; ++c) {
+		size_t* cnt = &counts[(size_t) c * nTiles];
+		for (int f = c * chunkSize; f < std::min(nFaces, (c + 1) * chunkSize); ++f)
+			if (rects[f].x0 <= rects[f].x1 && rects[f].y0 <= rects[f].y1)
+				forEachTile(rects[f], [&](int t) { cnt[t]++; });
+	}
+
+	std::vector<size_t> offsets(nTiles + 1, 0);
+	size_t              sum = 0;
+	for (int t = 0; t < nTiles; ++t) {
+		offsets[t] = sum;
+		for (int c = 0; c < nChunks; ++c) {
+			size_t n = counts[(size_t) c * nTiles + t];
+			counts[(size_t) c * nTiles + t] = sum;
+			sum += n;
+		}
+	}
+	offsets[nTiles] = sum;
+
+	std::vector<int> bins(sum);
+#pragma omp parallel for
+	for (int c = 0; c < nChunks; ++c) {
+		size_t* cnt = &counts[(size_t) c * nTiles];
+		for (int f = c * chunkSize; f < std::min(nFaces, (c + 1) * chunkSize); ++f)
+			if (rects[f].x0 <= rects[f].x1 && rects[f].y0 <= rects[f].y1)
+				forEachTile(rects[f], [&](int t) { bins[cnt[t]++] = f; });
+	}
+
+#pragma omp parallel for schedule(dynamic)
+	for (int t = 0; t < nTiles; ++t) {
+		const int tx0 = (t % tilesX) * TILE_SIZE;
+		const int ty0 = (t / tilesX) * TILE_SIZE;
+		const int tx1 = std::min(w, tx0 + TILE_SIZE) - 1;
+		const int ty1 = std::min(h, ty0 + TILE_SIZE) - 1;
+		for (size_t k = offsets[t]; k < offsets[t + 1]; ++k) {
+			const int        f  = bins[k];
+			const Projected& p0 = proj[tris[3 * f]];
+			const Projected& p1 = proj[tris[3 * f + 1]];
+			const Projected& p2 = proj[tris[3 * f + 2]];
+			const float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+			if (area == 0)
+				continue;
+			// both orientations are drawn, as there is no culling
+			const Edge  e0(p1.x, p1.y, p2.x, p2.y, 1 / area);
+			const Edge  e1(p2.x, p2.y, p0.x, p0.y, 1 / area);
+			const Edge  e2(p0.x, p0.y, p1.x, p1.y, 1 / area);
+			const float q0 = perspective ? 1 / p0.z : p0.z;
+			const float q1 = perspective ? 1 / p1.z : p1.z;
+			const float q2 = perspective ? 1 / p2.z : p2.z;
+
+			const Rect& r = rects[f];
+			for (int y = std::max(r.y0, ty0); y <= std::min(r.y1, ty1); ++y) {
+				const float cy = y + 0.5f;
+				for (int x = std::max(r.x0, tx0); x <= std::min(r.x1, tx1); ++x) {
+					const float cx = x + 0.5f;
+					const float l0 = e0(cx, cy), l1 = e1(cx, cy), l2 = e2(cx, cy);
+					if (l0 < 0 || l1 < 0 || l2 < 0)
+						continue;
+					// 1/z is linear in screen space for perspective cameras
+					const float q = l0 * q0 + l1 * q1 + l2 * q2;
+					const float z = perspective ? 1 / q : q;
+					const size_t i = x + (size_t) y * w;
+					if (z < depths[i]) {
+						depths[i]   = z;
+						elements[i] = f;
+					}
+				}
+			}
+		}
+	}
+}
+
+Point3m ShotRasterizer::barycentric(int x, int y) const
+{
+	const int f = element(x, y);
+	if (points || f < 0)
+		return Point3m(1, 0, 0);
+	const Projected& p0   = proj[tris[3 * f]];
+	const Projected& p1   = proj[tris[3 * f + 1]];
+	const Projected& p2   = proj[tris[3 * f + 2]];
+	const float      area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+	const float      cx = x + 0.5f, cy = y + 0.5f;
+	const float      invArea = 1 / area;
+	Point3m          l(
+		Edge(p1.x, p1.y, p2.x, p2.y, invArea)(cx, cy),
+		Edge(p2.x, p2.y, p0.x, p0.y, invArea)(cx, cy),
+		Edge(p0.x, p0.y, p1.x, p1.y, invArea)(cx, cy));
+	if (perspective) {
+		l[0] /= p0.z;
+		l[1] /= p1.z;
+		l[2] /= p2.z;
+		l /= l[0] + l[1] + l[2];
+	}
+	return l;
+}
+
+} // namespace meshlab
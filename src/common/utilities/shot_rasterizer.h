@@ -0,0 +1,95 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef MESHLAB_SHOT_RASTERIZER_H
+#define MESHLAB_SHOT_RASTERIZER_H
+
+#include <vector>
+
+#include "../ml_document/cmesh.h"
+
+namespace meshlab {
+
+/**
+ * @brief Software rasterizer of a mesh seen from a Shot, for the filters that
+ * need depth maps or renderings of the mesh without an OpenGL context.
+ *
+ * The result is a visibility buffer: for each pixel the camera space depth of
+ * the nearest surface and the element covering it. Any attribute can then be
+ * shaded by interpolating its vertex values with barycentric(). Rows are
+ * stored bottom-up, as read by glReadPixels, and the viewport of the shot is
+ * stretched over the whole buffer, as glViewport(0, 0, width, height) does.
+ *
+ * The faces are binned into square tiles that are rasterized concurrently.
+ * Faces having a vertex behind the camera are skipped instead of clipped, and
+ * a mesh without faces is drawn as one pixel points. Separate instances can
+ * render from different threads.
+ */
+class ShotRasterizer
+{
+public:
+	ShotRasterizer(int width = 0, int height = 0);
+
+	void resize(int width, int height);
+	int  width() const { return w; }
+	int  height() const { return h; }
+
+	void render(const CMeshO& m, const Shotm& shot);
+
+	/** @brief Index in m.face (m.vert for point clouds) of the element seen in
+	 * the pixel, -1 for the background */
+	int element(int x, int y) const { return elements[x + y * w]; }
+
+	/** @brief Camera space depth of the pixel, +infinity for the background */
+	float depth(int x, int y) const { return depths[x + y * w]; }
+
+	/** @brief Perspective correct barycentric coordinates of the pixel center
+	 * in the face element(x, y), (1, 0, 0) for points */
+	Point3m barycentric(int x, int y) const;
+
+	bool isPointCloud() const { return points; }
+
+	const std::vector<float>& depthBuffer() const { return depths; }
+
+private:
+	struct Projected
+	{
+		float x, y; // viewport pixels scaled to the buffer
+		float z;    // camera space depth
+	};
+
+	void rasterizeFaces(const CMeshO& m);
+	void rasterizePoints(const CMeshO& m);
+
+	int                    w, h;
+	bool                   points;
+	bool                   perspective;
+	std::vector<float>     depths;
+	std::vector<int>       elements;
+	std::vector<Projected> proj;
+	std::vector<int>       tris; // vertex indices of each face
+};
+
+} // namespace meshlab
+
+#endif // MESHLAB_SHOT_RASTERIZER_H
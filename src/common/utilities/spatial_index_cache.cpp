@@ -0,0 +1,193 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "spatial_index_cache.h"
+
+namespace meshlab {
+
+namespace {
+
+/* check and acquisition of the shared budget must be atomic, otherwise two
+ * caches could both see the same free memory */
+std::mutex budgetMutex;
+
+bool acquireMemory(std::ptrdiff_t mem)
+{
+	std::lock_guard<std::mutex> lock(budgetMutex);
+	MLThreadSafeMemoryInfo& info = SpatialIndexCache::memoryInfo();
+	if (!info.isAdditionalMemoryAvailable(mem))
+		return false;
+	info.acquiredMemory(mem);
+	return true;
+}
+
+void releaseMemory(std::ptrdiff_t mem)
+{
+	std::lock_guard<std::mutex> lock(budgetMutex);
+	SpatialIndexCache::memoryInfo().releasedMemory(mem);
+}
+
+/* a cell pointer for each cell, a (pointer, cell index) link for each element
+ * in each cell it overlaps */
+template<class Grid>
+std::ptrdiff_t gridMemory(const Grid& g, std::size_t links)
+{
+	std::ptrdiff_t cells = std::ptrdiff_t(g.siz[0] + 1) * (g.siz[1] + 1) * (g.siz[2] + 1);
+	return cells * sizeof(void*) + std::ptrdiff_t(links) * 2 * sizeof(void*);
+}
+
+} // namespace
+
+SpatialIndexCache::Stamp::Stamp(const CMeshO& m, std::uint64_t version) :
+		version(version),
+		vert(m.vert.empty() ? nullptr : &m.vert.front()),
+		face(m.face.empty() ? nullptr : &m.face.front()),
+		vertSize(m.vert.size()),
+		faceSize(m.face.size()),
+		vn(m.vn),
+		fn(m.fn)
+{
+}
+
+bool SpatialIndexCache::Stamp::operator==(const Stamp& s) const
+{
+	return version == s.version && vert == s.vert && face == s.face && vertSize == s.vertSize &&
+		   faceSize == s.faceSize && vn == s.vn && fn == s.fn;
+}
+
+template<class Index, class Build, class Measure>
+std::shared_ptr<Index> SpatialIndexCache::lookup(
+	Entry<Index>& e,
+	const CMeshO& m,
+	std::uint64_t version,
+	Build         build,
+	Measure       measure)
+{
+	if (m.Tr != Matrix44m::Identity())
+		return build();
+
+	Stamp s(m, version);
+	// the index is built under the lock: concurrent requests build it once
+	std::lock_guard<std::mutex> lock(mutex);
+	if (e.index && e.stamp == s)
+		return e.index;
+	drop(e);
+	std::shared_ptr<Index> index = build();
+	std::ptrdiff_t         mem   = measure(*index);
+	if (acquireMemory(mem)) {
+		e.stamp  = s;
+		e.index  = index;
+		e.memory = mem;
+	}
+	return index;
+}
+
+template<class Index>
+void SpatialIndexCache::drop(Entry<Index>& e)
+{
+	if (e.index)
+		releaseMemory(e.memory);
+	e = Entry<Index>();
+}
+
+SpatialIndexCache::SpatialIndexCache()
+{
+}
+
+SpatialIndexCache::~SpatialIndexCache()
+{
+	clear();
+}
+
+SpatialIndexCache::SpatialIndexCache(const SpatialIndexCache&)
+{
+}
+
+SpatialIndexCache& SpatialIndexCache::operator=(const SpatialIndexCache&)
+{
+	clear();
+	return *this;
+}
+
+MLThreadSafeMemoryInfo& SpatialIndexCache::memoryInfo()
+{
+	static MLThreadSafeMemoryInfo info(std::ptrdiff_t(1) << 30);
+	return info;
+}
+
+std::shared_ptr<SpatialIndexCache::VertexGrid>
+SpatialIndexCache::vertexGrid(CMeshO& m, std::uint64_t version)
+{
+	return lookup(
+		vertGridEntry,
+		m,
+		version,
+		[&m]() {
+			std::shared_ptr<VertexGrid> g = std::make_shared<VertexGrid>();
+			g->Set(m.vert.begin(), m.vert.end());
+			return g;
+		},
+		[&m](const VertexGrid& g) { return gridMemory(g, m.vert.size()); });
+}
+
+std::shared_ptr<SpatialIndexCache::FaceGrid>
+SpatialIndexCache::faceGrid(CMeshO& m, std::uint64_t version)
+{
+	return lookup(
+		faceGridEntry,
+		m,
+		version,
+		[&m]() {
+			std::shared_ptr<FaceGrid> g = std::make_shared<FaceGrid>();
+			g->Set(m.face.begin(), m.face.end());
+			return g;
+		},
+		// a face usually overlaps a few cells: count two on average
+		[&m](const FaceGrid& g) { return gridMemory(g, 2 * m.face.size()); });
+}
+
+std::shared_ptr<const FaceBvh> SpatialIndexCache::faceBvh(const CMeshO& m, std::uint64_t version)
+{
+	return lookup(
+		bvhEntry,
+		m,
+		version,
+		[&m]() { return std::make_shared<const FaceBvh>(m); },
+		[](const FaceBvh& b) { return std::ptrdiff_t(b.memoryUsed()); });
+}
+
+void SpatialIndexCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	drop(vertGridEntry);
+	drop(faceGridEntry);
+	drop(bvhEntry);
+}
+
+std::ptrdiff_t SpatialIndexCache::usedMemory() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return vertGridEntry.memory + faceGridEntry.memory + bvhEntry.memory;
+}
+
+} // namespace meshlab
@@ -0,0 +1,122 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef MESHLAB_SPATIAL_INDEX_CACHE_H
+#define MESHLAB_SPATIAL_INDEX_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include <vcg/space/index/grid_static_ptr.h>
+
+#include "../ml_document/cmesh.h"
+#include "../ml_thread_safe_memory_info.h"
+#include "face_bvh.h"
+
+namespace meshlab {
+
+/**
+ * @brief Spatial indices (uniform grids on the vertices and on the faces, and
+ * a face BVH) built on a mesh and kept until its geometry changes, so that
+ * consecutive filters on the same mesh do not build them again.
+ *
+ * Each index is built the first time it is asked and stored together with the
+ * geometry version given by the caller and with the size and the address of
+ * the vertex and face vectors: it is rebuilt when any of them differ. The
+ * version must be changed by whoever moves the vertices or changes the faces
+ * (see MeshModel::setGeometryChanged). Meshes with a transformation
+ * matrix different from the identity are never cached, since filters often
+ * apply the matrix in place to the coordinates and revert it at the end.
+ *
+ * The indices are returned as shared pointers: an index replaced in the cache
+ * stays valid as long as someone uses it. The memory of all the caches is
+ * accounted in memoryInfo(); when it is exhausted, the indices are still built
+ * but not stored.
+ *
+ * All the methods can be called concurrently.
+ */
+class SpatialIndexCache
+{
+public:
+	typedef vcg::GridStaticPtr<CVertexO, Scalarm> VertexGrid;
+	typedef vcg::GridStaticPtr<CFaceO, Scalarm>   FaceGrid;
+
+	SpatialIndexCache();
+	~SpatialIndexCache();
+
+	// copies of a mesh start with an empty cache
+	SpatialIndexCache(const SpatialIndexCache&);
+	SpatialIndexCache& operator=(const SpatialIndexCache&);
+
+	std::shared_ptr<VertexGrid>    vertexGrid(CMeshO& m, std::uint64_t version);
+	std::shared_ptr<FaceGrid>      faceGrid(CMeshO& m, std::uint64_t version);
+	std::shared_ptr<const FaceBvh> faceBvh(const CMeshO& m, std::uint64_t version);
+
+	void           clear();
+	std::ptrdiff_t usedMemory() const;
+
+	/** @brief Memory shared by the spatial indices of all the meshes */
+	static MLThreadSafeMemoryInfo& memoryInfo();
+
+private:
+	struct Stamp
+	{
+		std::uint64_t version  = 0;
+		const void*   vert     = nullptr;
+		const void*   face     = nullptr;
+		std::size_t   vertSize = 0;
+		std::size_t   faceSize = 0;
+		int           vn       = -1;
+		int           fn       = -1;
+
+		Stamp() {}
+		Stamp(const CMeshO& m, std::uint64_t version);
+		bool operator==(const Stamp& s) const;
+	};
+
+	template<class Index>
+	struct Entry
+	{
+		Stamp                  stamp;
+		std::shared_ptr<Index> index;
+		std::ptrdiff_t         memory = 0;
+	};
+
+	template<class Index, class Build, class Measure>
+	std::shared_ptr<Index>
+	lookup(Entry<Index>& e, const CMeshO& m, std::uint64_t version, Build build, Measure measure);
+
+	template<class Index>
+	void drop(Entry<Index>& e);
+
+	mutable std::mutex   mutex;
+	Entry<VertexGrid>    vertGridEntry;
+	Entry<FaceGrid>      faceGridEntry;
+	Entry<const FaceBvh> bvhEntry;
+};
+
+} // namespace meshlab
+
+#endif // MESHLAB_SPATIAL_INDEX_CACHE_H
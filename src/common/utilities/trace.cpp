@@ -0,0 +1,266 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "trace.h"
+
+#include <cstdlib>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+namespace meshlab {
+
+namespace {
+
+std::string jsonEscape(const std::string& s)
+{
+	std::string r;
+	r.reserve(s.size());
+	for (char c : s) {
+		switch (c) {
+		case '"': r += "\\\""; break;
+		case '\\': r += "\\\\"; break;
+		case '\n': r += "\\n"; break;
+		case '\t': r += "\\t"; break;
+		default:
+			if ((unsigned char) c < 0x20)
+				r += ' ';
+			else
+				r += c;
+		}
+	}
+	return r;
+}
+
+} // namespace
+
+Tracer& Tracer::instance()
+{
+	static Tracer tracer;
+	return tracer;
+}
+
+Tracer::Tracer() : enabled(false), origin(std::chrono::steady_clock::now())
+{
+	const char* f = std::getenv("MESHLAB_TRACE_FILE");
+	if (f != nullptr && f[0] != '\0') {
+		exitFileName = f;
+		enabled      = true;
+	}
+}
+
+Tracer::~Tracer()
+{
+	if (!exitFileName.empty())
+		exportChromeTrace(exitFileName);
+}
+
+void Tracer::setEnabled(bool enable)
+{
+	enabled.store(enable, std::memory_order_relaxed);
+}
+
+void Tracer::record(TraceEvent&& event)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	recordedEvents.push_back(std::move(event));
+}
+
+std::vector<TraceEvent> Tracer::events() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return recordedEvents;
+}
+
+void Tracer::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	recordedEvents.clear();
+}
+
+std::int64_t Tracer::elapsedUs() const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+			   std::chrono::steady_clock::now() - origin)
+		.count();
+}
+
+/**
+ * @brief Writes all the recorded events as complete ("X") events of the
+ * Chrome trace event format. The CPU time, the peak RSS and the counters of
+ * each span are stored in its args.
+ */
+bool Tracer::exportChromeTrace(const std::string& fileName) const
+{
+	std::vector<TraceEvent> evs = events();
+	std::ofstream out(fileName);
+	if (!out.is_open())
+		return false;
+	out << "{\"traceEvents\":[\n";
+	for (std::size_t i = 0; i < evs.size(); ++i) {
+		const TraceEvent& e = evs[i];
+		out << "{\"name\":\"" << jsonEscape(e.name) << "\",\"cat\":\"" << jsonEscape(e.category)
+			<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.threadId << ",\"ts\":" << e.startUs
+			<< ",\"dur\":" << e.durationUs << ",\"args\":{\"cpu_us\":" << e.cpuUs
+			<< ",\"peak_rss_kb\":" << e.peakRssKb;
+		for (const auto& c : e.counters)
+			out << ",\"" << jsonEscape(c.first) << "\":" << c.second;
+		out << "}}" << (i + 1 < evs.size() ? ",\n" : "\n");
+	}
+	out << "],\"displayTimeUnit\":\"ms\"}\n";
+	return out.good();
+}
+
+TraceSpan::TraceSpan(std::string name, std::string category)
+{
+	event.name     = std::move(name);
+	event.category = std::move(category);
+	event.threadId = currentTraceThreadId();
+	event.startUs  = Tracer::instance().elapsedUs();
+	// the CPU time costs a system call: it is measured only while tracing
+	startCpuUs = Tracer::instance().isEnabled() ? currentThreadCpuTimeUs() : -1;
+}
+
+TraceSpan::~TraceSpan()
+{
+	Tracer& tracer = Tracer::instance();
+	if (!tracer.isEnabled())
+		return;
+	event.durationUs = tracer.elapsedUs() - event.startUs;
+	event.cpuUs      = (startCpuUs >= 0) ? currentThreadCpuTimeUs() - startCpuUs : 0;
+	event.peakRssKb  = peakResidentSetSizeKb();
+	tracer.record(std::move(event));
+}
+
+void TraceSpan::setCounter(const std::string& counterName, long long value)
+{
+	for (auto& c : event.counters) {
+		if (c.first == counterName) {
+			c.second = value;
+			return;
+		}
+	}
+	event.counters.emplace_back(counterName, value);
+}
+
+double TraceSpan::wallTimeMs() const
+{
+	return (Tracer::instance().elapsedUs() - event.startUs) / 1000.0;
+}
+
+/**
+ * @brief Returns the CPU time of the calling thread since the construction of
+ * the span, or a negative value if tracing was disabled at that time.
+ */
+double TraceSpan::cpuTimeMs() const
+{
+	if (startCpuUs < 0)
+		return -1;
+	return (currentThreadCpuTimeUs() - startCpuUs) / 1000.0;
+}
+
+/**
+ * @brief Adds to the given map (e.g. the output values of a filter) the
+ * measures taken by the span until now, with the "trace_" prefix.
+ */
+void TraceSpan::fillSummary(std::map<std::string, QVariant>& values) const
+{
+	values["trace_wall_time_ms"] = wallTimeMs();
+	if (startCpuUs >= 0)
+		values["trace_cpu_time_ms"] = cpuTimeMs();
+	values["trace_peak_rss_kb"]  = (qlonglong) peakResidentSetSizeKb();
+	for (const auto& c : event.counters)
+		values["trace_" + c.first] = (qlonglong) c.second;
+}
+
+/**
+ * @brief Returns the CPU time consumed by the calling thread, in microseconds.
+ */
+std::int64_t currentThreadCpuTimeUs()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+		return 0;
+	ULARGE_INTEGER k, u;
+	k.LowPart  = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart  = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (std::int64_t) ((k.QuadPart + u.QuadPart) / 10); // 100ns units
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+	timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+		return 0;
+	return (std::int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return (std::int64_t) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 +
+		   ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+#endif
+}
+
+/**
+ * @brief Returns the peak resident set size of the process, in kilobytes.
+ */
+std::int64_t peakResidentSetSizeKb()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return 0;
+	return (std::int64_t) (pmc.PeakWorkingSetSize / 1024);
+#else
+	rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return 0;
+#ifdef __APPLE__
+	return (std::int64_t) ru.ru_maxrss / 1024; // bytes on macOS
+#else
+	return (std::int64_t) ru.ru_maxrss;
+#endif
+#endif
+}
+
+/**
+ * @brief Returns a small integer that identifies the calling thread in the
+ * exported traces.
+ */
+int currentTraceThreadId()
+{
+	static std::atomic<int> nextId(1);
+	thread_local int id = nextId++;
+	return id;
+}
+
+} // namespace meshlab
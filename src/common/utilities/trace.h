@@ -0,0 +1,120 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef MESHLAB_TRACE_H
+#define MESHLAB_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QVariant>
+
+/**
+ * Lightweight performance tracing.
+ *
+ * A TraceSpan measures the wall time, the CPU time of the calling thread (only
+ * while the Tracer is enabled) and the peak resident set size of the process
+ * between its construction and its destruction. When the Tracer is enabled, each span is recorded as an event
+ * that can be exported in the Chrome trace event format (chrome://tracing,
+ * ui.perfetto.dev). Spans can be created from any thread.
+ *
+ * Tracing is enabled by setting the MESHLAB_TRACE_FILE environment variable to
+ * the path of the json file that will be written at exit, or by calling
+ * Tracer::setEnabled.
+ */
+
+namespace meshlab {
+
+struct TraceEvent
+{
+	std::string  name;
+	std::string  category;
+	std::int64_t startUs    = 0;
+	std::int64_t durationUs = 0;
+	std::int64_t cpuUs      = 0;
+	std::int64_t peakRssKb  = 0;
+	int          threadId   = 0;
+	std::vector<std::pair<std::string, long long>> counters;
+};
+
+class Tracer
+{
+public:
+	static Tracer& instance();
+
+	bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+	void setEnabled(bool enable);
+
+	void record(TraceEvent&& event);
+	std::vector<TraceEvent> events() const;
+	void clear();
+
+	bool exportChromeTrace(const std::string& fileName) const;
+
+	std::int64_t elapsedUs() const;
+
+private:
+	Tracer();
+	~Tracer();
+
+	std::atomic<bool> enabled;
+	mutable std::mutex mutex;
+	std::vector<TraceEvent> recordedEvents;
+	std::chrono::steady_clock::time_point origin;
+	std::string exitFileName;
+};
+
+class TraceSpan
+{
+public:
+	TraceSpan(std::string name, std::string category = "meshlab");
+	~TraceSpan();
+
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan& operator=(const TraceSpan&) = delete;
+
+	void setCounter(const std::string& counterName, long long value);
+
+	double wallTimeMs() const;
+	double cpuTimeMs() const;
+
+	void fillSummary(std::map<std::string, QVariant>& values) const;
+
+private:
+	TraceEvent   event;
+	std::int64_t startCpuUs;
+};
+
+std::int64_t currentThreadCpuTimeUs();
+std::int64_t peakResidentSetSizeKb();
+int currentTraceThreadId();
+
+} // namespace meshlab
+
+#endif // MESHLAB_TRACE_H
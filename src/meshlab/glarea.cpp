@@ -728,16 +728,17 @@ void GLArea::displayRealTimeLog(QPainter *painter)
     doc.setDefaultFont(qFont);
     int startingpoint = border;
     //mQMultiMap<QString,std::pair<QString,QString> >::const_iterator it = md()->Log.RealTimeLogText.constBegin();it != md()->Log.RealTimeLogText.constEnd();++it)
-    for (QString keyIt : md()->Log.realTimeLogMultiMap().uniqueKeys() )
+    const QMultiMap<QString, QPair<QString,QString> > realTimeLog = md()->Log.realTimeLogMultiMap();
+    for (QString keyIt : realTimeLog.uniqueKeys() )
     {
-        QList< QPair<QString,QString> > valueList = md()->Log.realTimeLogMultiMap().values(keyIt);
+        QList< QPair<QString,QString> > valueList = realTimeLog.values(keyIt);
         QPair<QString,QString> itVal;
         // the map contains pairs of meshname, text
         // the meshname is used only to disambiguate when there are more than two boxes with the same title
         for(const QPair<QString,QString>& itVal: valueList)
         {
             QString HeadName = keyIt;
-            if(md()->Log.realTimeLogMultiMap().count(keyIt)>1)
+            if(realTimeLog.count(keyIt)>1)
                 HeadName += " - "+itVal.first;
             doc.clear();
             doc.setDocumentMargin(margin*0.75);
@@ -571,7 +571,7 @@ void LayerDialog::showContextMenu(const QPoint& pos)
 
 void LayerDialog::updateLog(const GLLogStream &log)
 {
-	const QList< pair<int,QString> > &logStringList=log.logStringList();
+	const QList< pair<int,QString> > logStringList=log.logStringList();
 	ui->logPlainTextEdit->clear();
 	//ui->logPlainTextEdit->setFont(QFont("Courier",10));
 
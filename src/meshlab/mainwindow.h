@@ -30,6 +30,7 @@
 #include <GL/glew.h>
 
 #include "common/plugins/plugin_manager.h"
+#include "common/filter_result_cache.h"
 
 #include <wrap/qt/qt_thread_safe_memory_info.h>
 
@@ -92,6 +93,12 @@ public:
   
 	int startupWindowHeight;
 	inline static QString startupWindowHeightParam() {return "MeshLab::System::startupWindowHeight";}
+
+	bool filterResultCacheEnabled;
+	inline static QString filterResultCacheEnabledParam() {return "MeshLab::System::filterResultCacheEnabled";}
+
+	qint64 filterResultCacheMaxSize;
+	inline static QString filterResultCacheMaxSizeParam() {return "MeshLab::System::filterResultCacheMaxSize";}
 };
 
 class MainWindow : public QMainWindow
@@ -165,6 +172,14 @@ public:
 	unsigned int viewsRequiringRenderingActions(int meshid,MLRenderingAction* act);
 
 	void updateSharedContextDataAfterFilterExecution(int postcondmask,int fclasses,bool& newmeshcreated);
+	std::map<std::string, QVariant> applyFilterUsingResultCache(
+			FilterPlugin* iFilter,
+			const QAction* action,
+			const RichParameterList& filterParams,
+			const RichParameterList& applyParams,
+			unsigned int& postCondMask);
+	void setMeshesChangedByFilter(
+			MeshDocumentStateData& before, const std::set<int>& inputLayers, unsigned int postCondMask, int filterClasses);
 	void readViewFromFile(QString const& filename);
 
 private slots:
@@ -288,6 +303,7 @@ private:
 	QSignalMapper *windowMapper;
 	vcg::QtThreadSafeMemoryInfo* gpumeminfo;
 	QProgressBar* nvgpumeminfo;
+	FilterResultCache* filterResultCache;
 
 	/*
 	Note this part should be detached from MainWindow just like the loading plugin part.
@@ -50,6 +50,7 @@ MainWindow::MainWindow() :
 		searcher(meshlab::actionSearcherInstance()),
 		httpReq(this),
 		gpumeminfo(NULL),
+		filterResultCache(NULL),
 		defaultGlobalParams(meshlab::defaultGlobalParameterList()),
 		lastUsedDirectory(QDir::home()),
 		PM(meshlab::pluginManagerInstance()),
@@ -127,6 +128,7 @@ MainWindow::MainWindow() :
 	createToolBars();
 	createMenus();
 	gpumeminfo = new vcg::QtThreadSafeMemoryInfo(mwsettings.maxgpumem);
+	filterResultCache = new FilterResultCache(FilterResultCache::defaultCacheDirectory(), mwsettings.filterResultCacheMaxSize);
 	filterDockDialog = nullptr;
 	setAcceptDrops(true);
 	mdiarea->setAcceptDrops(true);
@@ -153,6 +155,7 @@ MainWindow::MainWindow() :
 MainWindow::~MainWindow()
 {
 	delete gpumeminfo;
+	delete filterResultCache;
 }
 
 void MainWindow::createActions()
@@ -1301,6 +1304,9 @@ void MainWindowSetting::initGlobalParameterList(RichParameterList& gbllist)
 
 	gbllist.addParam(RichInt(startupWindowWidthParam(), 0, "Startup Window Width (in pixels)", "Window width on startup"));
 	gbllist.addParam(RichInt(startupWindowHeightParam(), 0, "Startup Window Height (in pixels)", "Window height on startup"));
+
+	gbllist.addParam(RichBool(filterResultCacheEnabledParam(), false, "Filter Result Cache", "If true, the results of the filters that support it (e.g. Poisson-disk Sampling, Screened Poisson) are stored on disk and reused when the same filter is applied again with the same parameters on the same meshes."));
+	gbllist.addParam(RichInt(filterResultCacheMaxSizeParam(), 2048, "Filter Result Cache Size (in MB)", "The maximum disk space used by the filter result cache. When exceeded, the least recently used results are removed."));
 }
 
 void MainWindowSetting::updateGlobalParameterList(const RichParameterList& rpl)
@@ -1314,6 +1320,8 @@ void MainWindowSetting::updateGlobalParameterList(const RichParameterList& rpl)
 	maxTextureMemory = (std::ptrdiff_t) rpl.getInt(this->maxTextureMemoryParam()) * (float)(1024 * 1024);
 	startupWindowWidth = rpl.getInt(startupWindowWidthParam());
 	startupWindowHeight = rpl.getInt(startupWindowHeightParam());
+	filterResultCacheEnabled = rpl.getBool(filterResultCacheEnabledParam());
+	filterResultCacheMaxSize = (qint64) rpl.getInt(filterResultCacheMaxSizeParam()) * (1024 * 1024);
 }
 
 void MainWindow::defaultPerViewRenderingData(MLRenderingData& dt) const
@@ -25,6 +25,7 @@
 
 #include "mainwindow.h"
 #include <exception>
+#include <memory>
 #include "ml_default_decorators.h"
 
 #ifdef MESHLAB_LOG_FILE_ENABLED
@@ -47,6 +48,7 @@
 #include <common/mlexception.h>
 #include <common/globals.h>
 #include <common/utilities/load_save.h>
+#include <common/utilities/trace.h>
 
 #include "rich_parameter_gui/richparameterlistdialog.h"
 
@@ -103,6 +105,7 @@ void MainWindow::updateRecentProjActions()
 void MainWindow::updateCustomSettings()
 {
 	mwsettings.updateGlobalParameterList(currentGlobalParams);
+	filterResultCache->setMaxSize(mwsettings.filterResultCacheMaxSize);
 	emit dispatchCustomSettings(currentGlobalParams);
 }
 
@@ -756,11 +759,41 @@ void MainWindow::showFilterScript()
 	}
 }
 
+/*
+ * Replays the filters stored in the filter history of the current document.
+ *
+ * The update of the GPU buffers is deferred at the end of the script: the
+ * postCondition masks and the classes of all the executed filters are merged
+ * and the shared context is updated just once. The only exception are the
+ * filters that require a GL context, since they could render the meshes using
+ * the shared buffers: in that case, before executing the filter, the pending
+ * updates are flushed. The plugin GL context is created only for these filters.
+ */
 void MainWindow::runFilterScript()
 {
 	if (meshDoc() == nullptr)
 		return;
 	QString filterName;
+	unsigned int pendingPostCondMask = 0;
+	int pendingClasses = 0;
+	bool pendingUpdate = false;
+	bool anyMeshCreation = false;
+
+	// merges in the shared context all the changes made by the filters executed
+	// since the last flush, and drops the snapshot of the document state
+	auto flushPendingUpdates = [&]() {
+		if (pendingUpdate) {
+			bool newmeshcreated = bool(pendingClasses & FilterPlugin::MeshCreation);
+			updateSharedContextDataAfterFilterExecution(pendingPostCondMask, pendingClasses, newmeshcreated);
+			pendingPostCondMask = 0;
+			pendingClasses = 0;
+			pendingUpdate = false;
+		}
+		meshDoc()->meshDocStateData().clear();
+	};
+
+	meshDoc()->meshDocStateData().clear();
+	meshDoc()->meshDocStateData().create(*meshDoc());
 	try {
 		for (FilterNameParameterValuesPair& pair : meshDoc()->filterHistory)
 		{
@@ -775,53 +808,81 @@ void MainWindow::runFilterScript()
 				meshDoc()->mm()->updateDataMask(req);
 			iFilter->setLog(&meshDoc()->Log);
 
-			bool created = false;
+			bool needsGLContext = iFilter->requiresGLContext(action);
 			MLSceneGLSharedDataContext* shar = NULL;
-			if (currentViewContainer() != NULL)
+			// the plugin context and its widget are released also when the filter throws;
+			// the context is declared last, so it is deleted before the widget it lives on
+			std::unique_ptr<QGLWidget> filterWidget;
+			auto releaseGLContext = [&](MLPluginGLContext* ctx) {
+				if (shar != NULL)
+					shar->removeView(ctx);
+				iFilter->glContext = nullptr;
+				delete ctx;
+			};
+			std::unique_ptr<MLPluginGLContext, decltype(releaseGLContext)> filterGLContext(nullptr, releaseGLContext);
+			if (needsGLContext)
 			{
-				shar = currentViewContainer()->sharedDataContext();
-				//GLA() is only the parent
-				QGLWidget* filterWidget = new QGLWidget(GLA(),shar);
-				QGLFormat defForm = QGLFormat::defaultFormat();
-				iFilter->glContext = new MLPluginGLContext(defForm,filterWidget->context()->device(),*shar);
-				created = iFilter->glContext->create(filterWidget->context());
-				shar->addView(iFilter->glContext);
-				MLRenderingData dt;
-				MLRenderingData::RendAtts atts;
-				atts[MLRenderingData::ATT_NAMES::ATT_VERTPOSITION] = true;
-				atts[MLRenderingData::ATT_NAMES::ATT_VERTNORMAL] = true;
-
-
-				if (iFilter->filterArity(action) == FilterPlugin::SINGLE_MESH) {
-					MLRenderingData::PRIMITIVE_MODALITY pm = MLPoliciesStandAloneFunctions::bestPrimitiveModalityAccordingToMesh(meshDoc()->mm());
-					if ((pm != MLRenderingData::PR_ARITY) && (meshDoc()->mm() != nullptr)) {
-						dt.set(pm,atts);
-						shar->setRenderingDataPerMeshView(meshDoc()->mm()->id(),iFilter->glContext,dt);
-					}
-				}
-				else {
-					for(const MeshModel& mm : meshDoc()->meshIterator()) {
-						MLRenderingData::PRIMITIVE_MODALITY pm = MLPoliciesStandAloneFunctions::bestPrimitiveModalityAccordingToMesh(&mm);
-						if ((pm != MLRenderingData::PR_ARITY)) {
+				// the filter could render the meshes: buffers must be up to date
+				flushPendingUpdates();
+				meshDoc()->meshDocStateData().create(*meshDoc());
+				bool created = false;
+				if (currentViewContainer() != NULL)
+				{
+					shar = currentViewContainer()->sharedDataContext();
+					//GLA() is only the parent
+					filterWidget.reset(new QGLWidget(GLA(),shar));
+					QGLFormat defForm = QGLFormat::defaultFormat();
+					filterGLContext.reset(new MLPluginGLContext(defForm,filterWidget->context()->device(),*shar));
+					iFilter->glContext = filterGLContext.get();
+					created = iFilter->glContext->create(filterWidget->context());
+					shar->addView(iFilter->glContext);
+					MLRenderingData dt;
+					MLRenderingData::RendAtts atts;
+					atts[MLRenderingData::ATT_NAMES::ATT_VERTPOSITION] = true;
+					atts[MLRenderingData::ATT_NAMES::ATT_VERTNORMAL] = true;
+
+
+					if (iFilter->filterArity(action) == FilterPlugin::SINGLE_MESH) {
+						MLRenderingData::PRIMITIVE_MODALITY pm = MLPoliciesStandAloneFunctions::bestPrimitiveModalityAccordingToMesh(meshDoc()->mm());
+						if ((pm != MLRenderingData::PR_ARITY) && (meshDoc()->mm() != nullptr)) {
 							dt.set(pm,atts);
-							shar->setRenderingDataPerMeshView(mm.id(),iFilter->glContext,dt);
+							shar->setRenderingDataPerMeshView(meshDoc()->mm()->id(),iFilter->glContext,dt);
+						}
+					}
+					else {
+						for(const MeshModel& mm : meshDoc()->meshIterator()) {
+							MLRenderingData::PRIMITIVE_MODALITY pm = MLPoliciesStandAloneFunctions::bestPrimitiveModalityAccordingToMesh(&mm);
+							if ((pm != MLRenderingData::PR_ARITY)) {
+								dt.set(pm,atts);
+								shar->setRenderingDataPerMeshView(mm.id(),iFilter->glContext,dt);
+							}
 						}
 					}
-				}
 
+				}
+				if ((!created) || (iFilter->glContext == nullptr) || (!iFilter->glContext->isValid())) {
+					if (!iFilter->canRunWithoutGLContext(action))
+						throw MLException("A valid GLContext is required by the filter to work.\n");
+					// the filter takes its CPU path
+					filterGLContext.reset();
+					filterWidget.reset();
+					iFilter->glContext = nullptr;
+					meshDoc()->Log.logf(GLLogStream::SYSTEM, "No valid GLContext for %s, running it without OpenGL", qUtf8Printable(filterName));
+				}
 			}
-			if ((!created) || (!iFilter->glContext->isValid()))
-				throw MLException("A valid GLContext is required by the filter to work.\n");
 			meshDoc()->setBusy(true);
-			iFilter->applyFilter(action, pair.second, *meshDoc(), postCondMask, QCallBack);
+			std::set<int> inputLayers = FilterResultCache::inputLayers(*iFilter, action, pair.second, *meshDoc());
+			MeshDocumentStateData layersBefore;
+			layersBefore.create(*meshDoc());
+			applyFilterUsingResultCache(iFilter, action, pair.second, pair.second, postCondMask);
 			if (postCondMask == MeshModel::MM_UNKNOWN)
 				postCondMask = iFilter->postCondition(action);
 			for (MeshModel* mm = meshDoc()->nextMesh(); mm != NULL; mm = meshDoc()->nextMesh(mm))
 				vcg::tri::Allocator<CMeshO>::CompactEveryVector(mm->cm);
+			setMeshesChangedByFilter(layersBefore, inputLayers, postCondMask, iFilter->getClass(action));
 			meshDoc()->setBusy(false);
-			if (shar != NULL)
-				shar->removeView(iFilter->glContext);
-			delete iFilter->glContext;
+			filterGLContext.reset();
+			filterWidget.reset();
 			classes = int(iFilter->getClass(action));
 
 			if (meshDoc()->mm() != NULL)
@@ -842,30 +903,35 @@ void MainWindow::runFilterScript()
 					meshDoc()->mm()->updateDataMask(MeshModel::MM_CAMERA);
 			}
 
-			bool newmeshcreated = false;
+			// the update of the shared context is deferred: we just keep track
+			// of what has been changed by the filter
+			pendingPostCondMask |= postCondMask;
+			pendingClasses |= classes;
+			pendingUpdate = true;
 			if (classes & FilterPlugin::MeshCreation)
-				newmeshcreated = true;
-			updateSharedContextDataAfterFilterExecution(postCondMask, classes, newmeshcreated);
-			meshDoc()->meshDocStateData().clear();
-
-			if(classes & FilterPlugin::MeshCreation)
-				GLA()->resetTrackBall();
-			/* to be changed */
+				anyMeshCreation = true;
 
 			qb->reset();
-			GLA()->update();
 			GLA()->Logf(GLLogStream::SYSTEM,"Re-Applied filter %s",qUtf8Printable(pair.filterName()));
-			if (_currviewcontainer != NULL)
-				_currviewcontainer->updateAllDecoratorsForAllViewers();
 		}
 	}
 	catch(const MLException& exc){
+		meshDoc()->setBusy(false);
 		QMessageBox::warning(
 				this,
 				tr("Filter Failure"),
 				"Failure of filter <font color=red>: '" + filterName + "'</font><br><br>" + exc.what());
 		meshDoc()->Log.log(GLLogStream::SYSTEM, filterName + " failed: " + exc.what());
 	}
+
+	// the steps executed before a failure must be anyway uploaded
+	flushPendingUpdates();
+
+	if (anyMeshCreation)
+		GLA()->resetTrackBall();
+	GLA()->update();
+	if (_currviewcontainer != NULL)
+		_currviewcontainer->updateAllDecoratorsForAllViewers();
 }
 
 // Receives the action that wants to show a tooltip and display it
@@ -996,14 +1062,18 @@ void MainWindow::updateSharedContextDataAfterFilterExecution(int postcondmask,in
 				{
 					shared->getRenderInfoPerMeshView(mm->id(),GLA()->context(),dttoberendered);
 
+					//the versions of a mesh that the filter did not touch (e.g. it was not one of its input layers) did not change:
+					//none of its attributes has to be uploaded again
+					int meshpostcondmask = (mm->version() > existit->_version) ? postcondmask : 0;
+
 					//masks differences bitwise operator (^) -> remove the attributes that didn't apparently change + the ones that for sure changed according to the postCondition function
 					//this operation has been introduced in order to minimize problems with filters that didn't declared properly the postCondition mask
-					int updatemask = (existit->_mask ^ mm->dataMask()) | postcondmask;
+					int updatemask = (existit->_mask ^ mm->dataMask()) | meshpostcondmask;
 					bool connectivitychanged = false;
 					if (((unsigned int)mm->cm.VN() != existit->_nvert) || ((unsigned int)mm->cm.FN() != existit->_nface) ||
-							bool(postcondmask & MeshModel::MM_UNKNOWN) || bool(postcondmask & MeshModel::MM_VERTNUMBER) ||
-							bool(postcondmask & MeshModel::MM_FACENUMBER) || bool(postcondmask & MeshModel::MM_FACEVERT) ||
-							bool(postcondmask & MeshModel::MM_VERTFACETOPO) || bool(postcondmask & MeshModel::MM_FACEFACETOPO))
+							bool(meshpostcondmask & MeshModel::MM_UNKNOWN) || bool(meshpostcondmask & MeshModel::MM_VERTNUMBER) ||
+							bool(meshpostcondmask & MeshModel::MM_FACENUMBER) || bool(meshpostcondmask & MeshModel::MM_FACEVERT) ||
+							bool(meshpostcondmask & MeshModel::MM_VERTFACETOPO) || bool(meshpostcondmask & MeshModel::MM_FACEFACETOPO))
 					{
 						connectivitychanged = true;
 					}
@@ -1012,7 +1082,8 @@ void MainWindow::updateSharedContextDataAfterFilterExecution(int postcondmask,in
 					//1) we convert the meshmodel updating mask to a RendAtts structure
 					MLPoliciesStandAloneFunctions::fromMeshModelMaskToMLRenderingAtts(updatemask,dttoupdate);
 					//2) The correspondent bos to the updated rendering attributes are set to invalid
-					shared->meshAttributesUpdated(mm->id(),connectivitychanged,dttoupdate);
+					if (connectivitychanged || (updatemask != 0))
+						shared->meshAttributesUpdated(mm->id(),connectivitychanged,dttoupdate);
 
 					//3) we took the current rendering modality for the mesh in the active gla
 					MLRenderingData curr;
@@ -1103,6 +1174,101 @@ void MainWindow::updateSharedContextDataAfterFilterExecution(int postcondmask,in
 	}
 }
 
+/*
+Applies the filter, reusing the result stored in the filter result cache
+when the cache is enabled and the filter declares that its result can be cached.
+The key of the cache is computed using only the filter parameters (not the
+global ones merged in applyParams).
+The execution is traced: the returned output values of the filter are
+completed with the trace summary (wall time, CPU time when tracing is enabled,
+peak memory, element counts).
+*/
+std::map<std::string, QVariant> MainWindow::applyFilterUsingResultCache(
+		FilterPlugin* iFilter,
+		const QAction* action,
+		const RichParameterList& filterParams,
+		const RichParameterList& applyParams,
+		unsigned int& postCondMask)
+{
+	QString fname = iFilter->filterName(action);
+	meshlab::TraceSpan span(fname.toStdString(), "filter");
+	if (meshDoc()->mm() != nullptr) {
+		span.setCounter("input_vertices", meshDoc()->mm()->cm.VN());
+		span.setCounter("input_faces", meshDoc()->mm()->cm.FN());
+	}
+
+	std::map<std::string, QVariant> outputValues;
+	if (!mwsettings.filterResultCacheEnabled || !iFilter->isFilterResultCacheable(action)) {
+		outputValues = iFilter->applyFilter(action, applyParams, *meshDoc(), postCondMask, QCallBack);
+		span.fillSummary(outputValues);
+		return outputValues;
+	}
+
+	QElapsedTimer tt; tt.start();
+	FilterResultCache::InputState input = FilterResultCache::inputState(
+				*meshDoc(), FilterResultCache::inputLayers(*iFilter, action, filterParams, *meshDoc()));
+	QByteArray key = FilterResultCache::computeKey(fname, filterParams, *meshDoc(), input);
+	if (filterResultCache->restore(key, *meshDoc(), postCondMask, outputValues)) {
+		meshDoc()->Log.logf(GLLogStream::SYSTEM, "Filter result cache hit for %s (%i msec)", qUtf8Printable(fname), tt.elapsed());
+		span.setCounter("cache_hit", 1);
+		span.fillSummary(outputValues);
+		return outputValues;
+	}
+
+	outputValues = iFilter->applyFilter(action, applyParams, *meshDoc(), postCondMask, QCallBack);
+	unsigned int storedMask = postCondMask;
+	if (storedMask == MeshModel::MM_UNKNOWN)
+		storedMask = iFilter->postCondition(action);
+	bool stored = filterResultCache->store(key, *meshDoc(), input, storedMask, outputValues);
+	meshDoc()->Log.logf(
+				GLLogStream::SYSTEM, "Filter result cache miss for %s%s", qUtf8Printable(fname),
+				stored ? "" : " (result not cacheable)");
+	span.setCounter("cache_hit", 0);
+	span.fillSummary(outputValues);
+	return outputValues;
+}
+
+/*
+Gives a new version to the elements in postCondMask of the meshes that the filter could
+have changed: its input layers and the ones it created. before is the state of the layers
+taken just before the filter ran (for each filter, not once per script, so that the changes
+of the previous filters do not count). The other meshes keep their versions, so that their
+decorations and buffers are not computed again, unless something shows that the filter
+reached them too: an unknown postcondition, a changed transformation matrix
+(transformations can be applied to all the visible layers), or a layer whose element counts
+or data mask differ from before. In those cases all the meshes get new versions. As in
+updateSharedContextDataAfterFilterExecution, the classes of the filter are trusted more than
+its postcondition for colors and quality.
+*/
+void MainWindow::setMeshesChangedByFilter(
+		MeshDocumentStateData& before, const std::set<int>& inputLayers, unsigned int postCondMask, int filterClasses)
+{
+	bool allLayers = bool(postCondMask & (MeshModel::MM_UNKNOWN | MeshModel::MM_TRANSFMATRIX));
+	for (const MeshModel& mm : meshDoc()->meshIterator()) {
+		auto state = before.find(mm.id());
+		if (state != before.end() && inputLayers.count(mm.id()) == 0 &&
+				(state->_nvert != (size_t) mm.cm.VN() || state->_nface != (size_t) mm.cm.FN() ||
+				 state->_nedge != (size_t) mm.cm.EN() || state->_mask != mm.dataMask()))
+			allLayers = true;
+	}
+
+	if (postCondMask & MeshModel::MM_UNKNOWN)
+		postCondMask = MeshModel::MM_ALL;
+	if (filterClasses & FilterPlugin::FaceColoring)
+		postCondMask |= MeshModel::MM_FACECOLOR;
+	if (filterClasses & FilterPlugin::VertexColoring)
+		postCondMask |= MeshModel::MM_VERTCOLOR;
+	if (filterClasses & FilterPlugin::MeshColoring)
+		postCondMask |= MeshModel::MM_COLOR;
+	if (filterClasses & FilterPlugin::Quality)
+		postCondMask |= MeshModel::MM_VERTQUALITY | MeshModel::MM_FACEQUALITY;
+	for (MeshModel& mm : meshDoc()->meshIterator()) {
+		bool created = before.find(mm.id()) == before.end();
+		if (allLayers || created || inputLayers.count(mm.id()) > 0)
+			mm.setChanged(postCondMask);
+	}
+}
+
 /*
 callback function that actually start the chosen filter.
 it is called once the parameters have been filled.
@@ -1149,7 +1315,14 @@ void MainWindow::executeFilter(
 		QGLFormat defForm = QGLFormat::defaultFormat();
 		iFilter->glContext = new MLPluginGLContext(defForm,filterWidget->context()->device(),*shar);
 		iFilter->glContext->create(filterWidget->context());
-		
+		if (!iFilter->glContext->isValid() && iFilter->canRunWithoutGLContext(action)) {
+			// the filter takes its CPU path
+			delete iFilter->glContext;
+			iFilter->glContext = nullptr;
+		}
+	}
+	if (iFilter->glContext != nullptr && shar != NULL)
+	{
 		MLRenderingData dt;
 		MLRenderingData::RendAtts atts;
 		atts[MLRenderingData::ATT_NAMES::ATT_VERTPOSITION] = true;
@@ -1177,14 +1350,23 @@ void MainWindow::executeFilter(
 		meshDoc()->meshDocStateData().clear();
 		meshDoc()->meshDocStateData().create(*meshDoc());
 		unsigned int postCondMask = MeshModel::MM_UNKNOWN;
-		iFilter->applyFilter(action, mergedenvironment, *(meshDoc()), postCondMask, QCallBack);
+		std::map<std::string, QVariant> filterOutputValues;
+		std::set<int> inputLayers = FilterResultCache::inputLayers(*iFilter, action, mergedenvironment, *meshDoc());
+		MeshDocumentStateData layersBefore;
+		layersBefore.create(*meshDoc());
+		if (isPreview)
+			iFilter->applyFilter(action, mergedenvironment, *(meshDoc()), postCondMask, QCallBack);
+		else
+			filterOutputValues = applyFilterUsingResultCache(iFilter, action, params, mergedenvironment, postCondMask);
 		if (postCondMask == MeshModel::MM_UNKNOWN)
 			postCondMask = iFilter->postCondition(action);
 		for (MeshModel& mm : meshDoc()->meshIterator())
 			vcg::tri::Allocator<CMeshO>::CompactEveryVector(mm.cm);
+		setMeshesChangedByFilter(layersBefore, inputLayers, postCondMask, iFilter->getClass(action));
 		
 		if (shar != NULL) {
-			shar->removeView(iFilter->glContext);
+			if (iFilter->glContext != nullptr)
+				shar->removeView(iFilter->glContext);
 			delete filterWidget;
 		}
 		
@@ -1195,6 +1377,12 @@ void MainWindow::executeFilter(
 		// (5) Apply post filter actions (e.g. recompute non updated stuff if needed)
 		
 		meshDoc()->Log.logf(GLLogStream::SYSTEM,"Applied filter %s in %i msec",qUtf8Printable(action->text()),tt.elapsed());
+		if (meshlab::Tracer::instance().isEnabled() && filterOutputValues.count("trace_cpu_time_ms") > 0) {
+			meshDoc()->Log.logf(
+						GLLogStream::SYSTEM, "  main thread CPU time %.0f msec, peak memory %lld KB",
+						filterOutputValues["trace_cpu_time_ms"].toDouble(),
+						filterOutputValues["trace_peak_rss_kb"].toLongLong());
+		}
 		if (meshDoc()->mm() != NULL)
 			meshDoc()->mm()->setMeshModified();
 		MainWindow::globalStatusBar()->showMessage("Filter successfully completed...",2000);
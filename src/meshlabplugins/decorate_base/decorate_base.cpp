@@ -625,16 +625,35 @@ void DecorateBasePlugin::endDecorate(const QAction * action, MeshModel &m, const
 	}
 }
 
+/* Records the inputs of the data of a decoration on a mesh, returning true if they differ
+ * from the ones of the last time */
+bool DecorateBasePlugin::decorationInputsChanged(MeshModel &m, int decoration, const QString &inputs)
+{
+	QString &last = decorationInputs[qMakePair(&m, decoration)];
+	if (last == inputs)
+		return false;
+	last = inputs;
+	return true;
+}
+
 bool DecorateBasePlugin::startDecorate(const QAction * action, MeshModel &m, const RichParameterList *rm, GLArea *gla)
 {
+	const int topologyMask = MeshModel::MM_VERTNUMBER | MeshModel::MM_FACEVERT | MeshModel::MM_FACENUMBER;
 	switch(ID(action))
 	{
 	case DP_SHOW_CURVATURE :
 	{
+		float NormalLen=rm->getFloat(CurvatureLength());
+		QString inputs = QString("%1 %2 %3 %4 %5")
+				.arg(m.version(MeshModel::MM_VERTCOORD | MeshModel::MM_VERTCURVDIR | MeshModel::MM_FACECURVDIR | topologyMask))
+				.arg(NormalLen).arg(rm->getBool(ShowPerVertexCurvature())).arg(rm->getBool(ShowPerFaceCurvature()))
+				.arg(m.dataMask());
+		bool changed = decorationInputsChanged(m, DP_SHOW_CURVATURE, inputs);
+		if (!changed && vcg::tri::HasPerMeshAttribute(m.cm, "CurvatureVector"))
+			break;
 		CMeshO::PerMeshAttributeHandle< vector<PointPC> > cvH = vcg::tri::Allocator<CMeshO>::GetPerMeshAttribute< vector<PointPC> >(m.cm,"CurvatureVector");
 		vector<PointPC> *CVp = &cvH();
 		CVp->clear();
-		float NormalLen=rm->getFloat(CurvatureLength());
 		float LineLen = m.cm.bbox.Diag()*NormalLen;
 		if (rm->getBool(this->ShowPerVertexCurvature()) && m.hasDataMask(MeshModel::MM_VERTCURVDIR))
 		{
@@ -670,6 +689,14 @@ bool DecorateBasePlugin::startDecorate(const QAction * action, MeshModel &m, con
 	case DP_SHOW_VERT_QUALITY_HISTOGRAM :
 	{
 		if(!(tri::HasPerVertexColor(m.cm)) ) return false;
+		QString inputs = QString("%1 %2 %3 %4 %5 %6")
+				.arg(m.version(MeshModel::MM_VERTQUALITY | MeshModel::MM_VERTCOLOR | MeshModel::MM_VERTCOORD | topologyMask))
+				.arg(rm->getBool(perVertexHistFixedParam())).arg(rm->getFloat(perVertexHistFixedMinParam()))
+				.arg(rm->getFloat(perVertexHistFixedMaxParam())).arg(rm->getInt(perVertexHistBinNumParam()))
+				.arg(rm->getBool(perVertexHistAreaParam()));
+		bool changed = decorationInputsChanged(m, DP_SHOW_VERT_QUALITY_HISTOGRAM, inputs);
+		if (!changed && vcg::tri::HasPerMeshAttribute(m.cm, "VertexQualityHist"))
+			break;
 		CMeshO::PerMeshAttributeHandle<CHist > qH = vcg::tri::Allocator<CMeshO>::GetPerMeshAttribute<CHist>(m.cm,"VertexQualityHist");
 		
 		CHist *H = &qH();
@@ -701,6 +728,14 @@ bool DecorateBasePlugin::startDecorate(const QAction * action, MeshModel &m, con
 	case DP_SHOW_FACE_QUALITY_HISTOGRAM :
 	{
 		if(!(tri::HasPerFaceColor(m.cm)) ) return false;
+		QString inputs = QString("%1 %2 %3 %4 %5 %6")
+				.arg(m.version(MeshModel::MM_FACEQUALITY | MeshModel::MM_FACECOLOR | MeshModel::MM_VERTCOORD | topologyMask))
+				.arg(rm->getBool(perFaceHistFixedParam())).arg(rm->getFloat(perFaceHistFixedMinParam()))
+				.arg(rm->getFloat(perFaceHistFixedMaxParam())).arg(rm->getInt(perFaceHistBinNumParam()))
+				.arg(rm->getBool(perFaceHistAreaParam()));
+		bool changed = decorationInputsChanged(m, DP_SHOW_FACE_QUALITY_HISTOGRAM, inputs);
+		if (!changed && vcg::tri::HasPerMeshAttribute(m.cm, "FaceQualityHist"))
+			break;
 		CMeshO::PerMeshAttributeHandle<CHist > qH = vcg::tri::Allocator<CMeshO>::GetPerMeshAttribute<CHist>(m.cm,"FaceQualityHist");
 		
 		CHist *H = &qH();
@@ -195,6 +195,11 @@ private:
 	vcg::Shotf curShot;
 	
 	QMap<MeshModel *, QGLShaderProgram *> contourShaderProgramMap;
+
+	// inputs (versions of the mesh and parameter values) of the data computed in startDecorate
+	// for each mesh and decoration: while they do not change the data is not computed again
+	QMap<QPair<MeshModel *, int>, QString> decorationInputs;
+	bool decorationInputsChanged(MeshModel &m, int decoration, const QString &inputs);
 };
 
 #endif
@@ -35,6 +35,7 @@ $Log: meshedit.cpp,v $
 #include "align/align_parameter.h"
 #include <vcg/space/point_matching.h>
 #include <vcg/complex/algorithms/point_matching_scale.h>
+#include <common/utilities/mesh_tree_process.h>
 
 #include <QMessageBox>
 
@@ -460,7 +461,7 @@ void EditAlignPlugin::process()
         return;
     }
     alignDialog->setEnabled(false);
-    meshTree.Process(defaultAP, defaultMTP);
+    meshlab::processMeshTree(meshTree, defaultAP, defaultMTP);
     alignDialog->rebuildTree();
     _gla->update();
     alignDialog->setEnabled(true);
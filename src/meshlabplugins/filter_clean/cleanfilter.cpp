@@ -22,10 +22,12 @@
  ****************************************************************************/
 
 #include "cleanfilter.h"
+#include "parallel_ball_pivoting.h"
 
 #include <QCoreApplication>
+#include <common/utilities/connected_components.h>
+#include <common/utilities/merge_vertices.h>
 #include <vcg/complex/algorithms/clean.h>
-#include <vcg/complex/algorithms/create/ball_pivoting.h>
 #include <vcg/complex/algorithms/create/platonic.h>
 #include <vcg/complex/algorithms/stat.h>
 #include <vcg/complex/algorithms/update/texture.h>
@@ -34,6 +36,10 @@ using namespace std;
 using namespace vcg;
 
 int SnapVertexBorder(CMeshO& m, Scalarm threshold, vcg::CallBackPos* cb);
+int DeleteConnectedComponents(
+	CMeshO&                             m,
+	const meshlab::ConnectedComponents& cc,
+	const std::vector<bool>&            toDelete);
 
 CleanFilter::CleanFilter()
 {
@@ -128,6 +134,8 @@ QString CleanFilter::filterInfo(ActionIDType filterId) const
 			"surface reconstruction algorithm uses the existing points without creating new ones. "
 			"Works better with uniformly sampled point clouds. If needed first perform a poisson "
 			"disk subsampling of the point cloud. <br>"
+			"Large point clouds without faces are split in spatial cells that are reconstructed "
+			"in parallel; the fronts are then joined across the cell boundaries. <br>"
 			"Bernardini F., Mittleman J., Rushmeier H., Silva C., Taubin G.<br>"
 			"<b>The ball-pivoting algorithm for surface reconstruction.</b><br>"
 			"IEEE TVCG 1999");
@@ -222,7 +230,7 @@ int CleanFilter::getRequirements(const QAction* action)
 	case FP_REMOVE_WRT_Q:
 	case FP_BALL_PIVOTING: return MeshModel::MM_VERTMARK;
 	case FP_REMOVE_ISOLATED_COMPLEXITY:
-	case FP_REMOVE_ISOLATED_DIAMETER: return MeshModel::MM_FACEFACETOPO | MeshModel::MM_FACEMARK;
+	case FP_REMOVE_ISOLATED_DIAMETER: return MeshModel::MM_NONE;
 	case FP_REMOVE_TVERTEX: return MeshModel::MM_FACEFACETOPO | MeshModel::MM_VERTMARK;
 	case FP_REPAIR_NON_MANIF_EDGE: return MeshModel::MM_FACEFACETOPO | MeshModel::MM_VERTMARK;
 	case FP_REMOVE_NON_MANIF_VERT: return MeshModel::MM_FACEFACETOPO | MeshModel::MM_VERTMARK;
@@ -431,19 +439,20 @@ std::map<std::string, QVariant> CleanFilter::applyFilter(
 			m.cm.face.resize(0);
 		}
 		m.updateDataMask(MeshModel::MM_VERTFACETOPO);
-		int                       startingFn = m.cm.fn;
-		tri::BallPivoting<CMeshO> pivot(m.cm, Radius, Clustering, CreaseThr);
-		// the main processing
-		pivot.BuildMesh(cb);
+		// the main processing; large clouds are split in cells pivoted concurrently
+		int addedFn = parallelBallPivoting(m.cm, Radius, Clustering, CreaseThr, cb);
 		m.clearDataMask(MeshModel::MM_FACEFACETOPO);
-		log("Reconstructed surface. Added %i faces", m.cm.fn - startingFn);
+		log("Reconstructed surface. Added %i faces", addedFn);
 	} break;
 
 	case FP_REMOVE_ISOLATED_DIAMETER: {
-		Scalarm             minCC = par.getAbsPerc("MinComponentDiag");
-		std::pair<int, int> delInfo =
-			tri::Clean<CMeshO>::RemoveSmallConnectedComponentsDiameter(m.cm, minCC);
-		log("Removed %i connected components out of %i", delInfo.second, delInfo.first);
+		Scalarm                      minCC = par.getAbsPerc("MinComponentDiag");
+		meshlab::ConnectedComponents cc    = meshlab::connectedComponents(m.cm);
+		std::vector<bool>            toDelete(cc.size());
+		for (size_t i = 0; i < cc.size(); ++i)
+			toDelete[i] = cc.components[i].bbox.Diag() < minCC;
+		int delCC = DeleteConnectedComponents(m.cm, cc, toDelete);
+		log("Removed %i connected components out of %i", delCC, (int) cc.size());
 		if (par.getBool("removeUnref")) {
 			int delvert = tri::Clean<CMeshO>::RemoveUnreferencedVertex(m.cm);
 			log("Removed %d unreferenced vertices", delvert);
@@ -451,10 +460,13 @@ std::map<std::string, QVariant> CleanFilter::applyFilter(
 		m.updateBoxAndNormals();
 	} break;
 	case FP_REMOVE_ISOLATED_COMPLEXITY: {
-		int                 minCC = par.getInt("MinComponentSize");
-		std::pair<int, int> delInfo =
-			tri::Clean<CMeshO>::RemoveSmallConnectedComponentsSize(m.cm, minCC);
-		log("Removed %i connected components out of %i", delInfo.second, delInfo.first);
+		int                          minCC = par.getInt("MinComponentSize");
+		meshlab::ConnectedComponents cc    = meshlab::connectedComponents(m.cm);
+		std::vector<bool>            toDelete(cc.size());
+		for (size_t i = 0; i < cc.size(); ++i)
+			toDelete[i] = cc.components[i].faceCount < minCC;
+		int delCC = DeleteConnectedComponents(m.cm, cc, toDelete);
+		log("Removed %i connected components out of %i", delCC, (int) cc.size());
 		if (par.getBool("removeUnref")) {
 			int delvert = tri::Clean<CMeshO>::RemoveUnreferencedVertex(m.cm);
 			log("Removed %d unreferenced vertices", delvert);
@@ -530,7 +542,7 @@ std::map<std::string, QVariant> CleanFilter::applyFilter(
 
 	case FP_MERGE_CLOSE_VERTEX: {
 		Scalarm threshold = par.getAbsPerc("Threshold");
-		int     total     = tri::Clean<CMeshO>::MergeCloseVertex(m.cm, threshold);
+		int     total     = meshlab::mergeCloseVertices(m.cm, threshold);
 		log("Successfully merged %d vertices", total);
 	} break;
 
@@ -584,7 +596,7 @@ std::map<std::string, QVariant> CleanFilter::applyFilter(
 	} break;
 
 	case FP_REMOVE_DUPLICATED_VERTEX: {
-		int delvert = tri::Clean<CMeshO>::RemoveDuplicateVertex(m.cm);
+		int delvert = meshlab::removeDuplicateVertices(m.cm);
 		log("Removed %d duplicated vertices", delvert);
 		if (delvert != 0)
 			m.updateBoxAndNormals();
@@ -605,6 +617,19 @@ std::map<std::string, QVariant> CleanFilter::applyFilter(
 	return std::map<std::string, QVariant>();
 }
 
+int DeleteConnectedComponents(
+	CMeshO&                             m,
+	const meshlab::ConnectedComponents& cc,
+	const std::vector<bool>&            toDelete)
+{
+	for (size_t i = 0; i < m.face.size(); ++i) {
+		int c = cc.faceComponent[i];
+		if (c >= 0 && toDelete[c])
+			tri::Allocator<CMeshO>::DeleteFace(m, m.face[i]);
+	}
+	return (int) std::count(toDelete.begin(), toDelete.end(), true);
+}
+
 int SnapVertexBorder(CMeshO& m, Scalarm threshold, vcg::CallBackPos* cb)
 {
 	tri::Allocator<CMeshO>::CompactEveryVector(m);
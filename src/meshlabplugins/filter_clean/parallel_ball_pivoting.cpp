@@ -0,0 +1,442 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "parallel_ball_pivoting.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <vcg/complex/algorithms/create/ball_pivoting.h>
+#include <vcg/complex/algorithms/update/bounding.h>
+#include <vcg/complex/algorithms/update/topology.h>
+
+using namespace vcg;
+
+namespace {
+
+typedef tri::BallPivoting<CMeshO> Pivot;
+typedef std::array<int, 3>        Triangle;
+
+const int BUCKET_SIZE     = 1024;   // points in the leaves of the kd-tree
+const int MIN_CELL_POINTS = 250000; // smaller clouds are pivoted as a whole
+
+/* Width of the band, in ball radii, left empty by a cell along its inner sides */
+const Scalarm GAP_RADII = 2;
+/* Half width of the strip of points pivoted to close a boundary, and of the
+ * band of the new triangles kept from it */
+const Scalarm STRIP_RADII      = 6;
+const Scalarm STRIP_KEEP_RADII = 3;
+
+/* kd-tree over the vertices, splitting the longest side of the boxes at the
+ * median point */
+class PointTree
+{
+public:
+	struct Node
+	{
+		Box3m   box;
+		int     axis   = -1; // -1 for leaves
+		Scalarm split  = 0;
+		int     child[2] = {-1, -1};
+		int     begin  = 0;  // range of the node points in order
+		int     end    = 0;
+		int     depth  = 0;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<int>  order;
+
+	PointTree(const CMeshO& m, const Box3m& box) : m(m)
+	{
+		order.reserve(m.vn);
+		for (int i = 0; i < (int) m.vert.size(); ++i)
+			if (!m.vert[i].IsD())
+				order.push_back(i);
+
+		Node root;
+		root.box = box;
+		root.end = (int) order.size();
+		nodes.push_back(root);
+
+		std::vector<int> stack(1, 0);
+		while (!stack.empty()) {
+			int n = stack.back();
+			stack.pop_back();
+			Node node = nodes[n];
+			if (node.end - node.begin <= BUCKET_SIZE)
+				continue;
+
+			int axis = node.box.MaxDim();
+			int mid  = (node.begin + node.end) / 2;
+			std::nth_element(
+				order.begin() + node.begin,
+				order.begin() + mid,
+				order.begin() + node.end,
+				[&](int a, int b) { return m.vert[a].cP()[axis] < m.vert[b].cP()[axis]; });
+			Scalarm split = m.vert[order[mid]].cP()[axis];
+
+			Node left, right;
+			left.box = right.box = node.box;
+			left.box.max[axis] = right.box.min[axis] = split;
+			left.begin = node.begin;
+			left.end = right.begin = mid;
+			right.end = node.end;
+			left.depth = right.depth = node.depth + 1;
+
+			nodes[n].axis     = axis;
+			nodes[n].split    = split;
+			nodes[n].child[0] = (int) nodes.size();
+			nodes[n].child[1] = (int) nodes.size() + 1;
+			stack.push_back((int) nodes.size());
+			stack.push_back((int) nodes.size() + 1);
+			nodes.push_back(left);
+			nodes.push_back(right);
+		}
+	}
+
+	int count(int n) const { return nodes[n].end - nodes[n].begin; }
+
+	/* Appends the points of the subtree of n that lie in the query box */
+	void collect(int n, const Box3m& query, std::vector<int>& out) const
+	{
+		std::vector<int> stack(1, n);
+		while (!stack.empty()) {
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+			if (!overlap(node.box, query))
+				continue;
+			if (node.axis >= 0) {
+				stack.push_back(node.child[0]);
+				stack.push_back(node.child[1]);
+				continue;
+			}
+			for (int i = node.begin; i < node.end; ++i)
+				if (query.IsIn(m.vert[order[i]].cP()))
+					out.push_back(order[i]);
+		}
+	}
+
+private:
+	const CMeshO& m;
+
+	static bool overlap(const Box3m& a, const Box3m& b)
+	{
+		for (int i = 0; i < 3; ++i)
+			if (a.min[i] > b.max[i] || a.max[i] < b.min[i])
+				return false;
+		return true;
+	}
+};
+
+/* True if p is in box, farther than gap from the sides of box that are inside
+ * the root box: these are the sides that some other cell shares */
+bool ownsPoint(const Box3m& box, const Box3m& root, const Point3m& p, Scalarm gap)
+{
+	for (int a = 0; a < 3; ++a) {
+		Scalarm lo = box.min[a] > root.min[a] ? box.min[a] + gap : box.min[a];
+		Scalarm hi = box.max[a] < root.max[a] ? box.max[a] - gap : box.max[a];
+		if (p[a] < lo || p[a] > hi)
+			return false;
+	}
+	return true;
+}
+
+/* BallPivoting reserves a vertex user bit when it is built and releases it
+ * when destroyed, through a counter that is shared by all the CMeshO; since
+ * every pivot works on its own mesh, all of them can use the same bit, so the
+ * counter is put back as it was around each construction and destruction */
+std::unique_ptr<Pivot> makePivot(CMeshO& sub, Scalarm radius, Scalarm clustering, Scalarm angle)
+{
+	std::unique_ptr<Pivot> pivot;
+#pragma omp critical(ballPivotingBitFlag)
+	{
+		int lastBit = CVertexO::LastBitFlag();
+		pivot.reset(new Pivot(sub, radius, clustering, angle));
+		CVertexO::LastBitFlag() = lastBit;
+	}
+	return pivot;
+}
+
+void releasePivot(std::unique_ptr<Pivot>& pivot)
+{
+#pragma omp critical(ballPivotingBitFlag)
+	{
+		int lastBit             = CVertexO::LastBitFlag();
+		CVertexO::LastBitFlag() = lastBit << 1;
+		pivot.reset();
+		CVertexO::LastBitFlag() = lastBit;
+	}
+}
+
+/* Builds a mesh with the given vertices of m and the given triangles (in
+ * indices of m, all of them among the vertices) */
+void buildSubMesh(
+	const CMeshO&                m,
+	const std::vector<int>&      verts,
+	const std::vector<Triangle>& tris,
+	const std::vector<int>&      localIndex,
+	CMeshO&                      sub)
+{
+	sub.vert.EnableVFAdjacency();
+	sub.vert.EnableMark();
+	sub.face.EnableVFAdjacency();
+
+	tri::Allocator<CMeshO>::AddVertices(sub, verts.size());
+	for (size_t i = 0; i < verts.size(); ++i) {
+		sub.vert[i].P() = m.vert[verts[i]].cP();
+		sub.vert[i].N() = m.vert[verts[i]].cN();
+	}
+	if (!tris.empty()) {
+		tri::Allocator<CMeshO>::AddFaces(sub, tris.size());
+		for (size_t i = 0; i < tris.size(); ++i)
+			for (int k = 0; k < 3; ++k)
+				sub.face[i].V(k) = &sub.vert[localIndex[tris[i][k]]];
+		tri::UpdateTopology<CMeshO>::VertexFace(sub);
+	}
+}
+
+/* Faces of sub from firstFace on, in indices of m, whose barycenter satisfies
+ * keep */
+template<class KeepFunction>
+void collectNewFaces(
+	const CMeshO&           sub,
+	size_t                  firstFace,
+	const std::vector<int>& verts,
+	KeepFunction            keep,
+	std::vector<Triangle>&  out)
+{
+	for (size_t i = firstFace; i < sub.face.size(); ++i) {
+		const CFaceO& f = sub.face[i];
+		if (f.IsD())
+			continue;
+		Point3m bary = (f.cP(0) + f.cP(1) + f.cP(2)) / 3;
+		if (keep(bary)) {
+			out.push_back(
+				{verts[tri::Index(sub, f.cV(0))],
+				 verts[tri::Index(sub, f.cV(1))],
+				 verts[tri::Index(sub, f.cV(2))]});
+		}
+	}
+}
+
+/* Compressed lists of the triangles, each one listed by its lowest vertex */
+void indexTrianglesByVertex(
+	int                          vertexCount,
+	const std::vector<Triangle>& tris,
+	std::vector<int>&            start,
+	std::vector<int>&            faces)
+{
+	start.assign(vertexCount + 1, 0);
+	for (const Triangle& t : tris)
+		start[*std::min_element(t.begin(), t.end()) + 1]++;
+	for (int i = 0; i < vertexCount; ++i)
+		start[i + 1] += start[i];
+	faces.resize(tris.size());
+	std::vector<int> pos(start.begin(), start.end() - 1);
+	for (size_t i = 0; i < tris.size(); ++i)
+		faces[pos[*std::min_element(tris[i].begin(), tris[i].end())]++] = (int) i;
+}
+
+int threadCount()
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+bool isMainThread()
+{
+#ifdef _OPENMP
+	return omp_get_thread_num() == 0;
+#else
+	return true;
+#endif
+}
+
+} // namespace
+
+int parallelBallPivoting(
+	CMeshO&           m,
+	Scalarm           radius,
+	Scalarm           clustering,
+	Scalarm           angle,
+	vcg::CallBackPos* cb)
+{
+	int startingFn = m.fn;
+	int nThreads   = threadCount();
+	if (m.fn > 0 || nThreads == 1 || m.vn < 2 * MIN_CELL_POINTS) {
+		Pivot pivot(m, radius, clustering, angle);
+		pivot.BuildMesh(cb);
+		return m.fn - startingFn;
+	}
+
+	tri::UpdateBounding<CMeshO>::Box(m);
+	if (radius == 0) // same guess of BallPivoting, done once for all the cells
+		radius = m.bbox.Diag() / std::sqrt((Scalarm) m.vn);
+	const Scalarm gap       = GAP_RADII * radius;
+	const Scalarm stripHalf = STRIP_RADII * radius;
+	const Scalarm stripKeep = STRIP_KEEP_RADII * radius;
+
+	// cells are the topmost nodes with few enough points, the nodes above
+	// them are the boundaries to close
+	const int cellPoints = std::max(MIN_CELL_POINTS, m.vn / (4 * nThreads));
+	PointTree tree(m, m.bbox);
+	const Box3m& root = m.bbox;
+
+	std::vector<int> cells, seams;
+	std::vector<int> stack(1, 0);
+	while (!stack.empty()) {
+		int n = stack.back();
+		stack.pop_back();
+		if (tree.count(n) <= cellPoints || tree.nodes[n].axis < 0) {
+			cells.push_back(n);
+		}
+		else {
+			seams.push_back(n);
+			stack.push_back(tree.nodes[n].child[0]);
+			stack.push_back(tree.nodes[n].child[1]);
+		}
+	}
+	// larger cells first, for a better balance
+	std::sort(cells.begin(), cells.end(), [&](int a, int b) {
+		return tree.count(a) > tree.count(b);
+	});
+
+	std::vector<Triangle> tris;
+	std::atomic<int>      done(0);
+
+	// pivoting of the cells
+	std::vector<std::vector<Triangle>> cellTris(cells.size());
+#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < (int) cells.size(); ++c) {
+		const PointTree::Node& node = tree.nodes[cells[c]];
+		Box3m query = node.box;
+		query.Offset(gap);
+		std::vector<int> verts;
+		tree.collect(0, query, verts);
+		if (verts.size() > 3) {
+			CMeshO sub;
+			buildSubMesh(m, verts, {}, {}, sub);
+			std::unique_ptr<Pivot> pivot = makePivot(sub, radius, clustering, angle);
+			pivot->BuildMesh();
+			collectNewFaces(
+				sub,
+				0,
+				verts,
+				[&](const Point3m& p) { return ownsPoint(node.box, root, p, gap); },
+				cellTris[c]);
+			releasePivot(pivot);
+		}
+
+		int cellsDone = done.fetch_add(1) + 1;
+		if (cb != nullptr && isMainThread())
+			cb(80 * cellsDone / (int) cells.size(), "Ball pivoting of the cells...");
+	}
+	for (std::vector<Triangle>& ct : cellTris) {
+		tris.insert(tris.end(), ct.begin(), ct.end());
+		std::vector<Triangle>().swap(ct);
+	}
+
+	// closing of the boundaries, from the deepest ones: the boundaries of the
+	// same depth are in disjoint subtrees
+	std::sort(seams.begin(), seams.end(), [&](int a, int b) {
+		return tree.nodes[a].depth > tree.nodes[b].depth;
+	});
+	std::vector<int> localIndex(m.vert.size(), -1);
+	std::vector<int> faceStart, faceList;
+	done.store(0);
+	for (size_t first = 0; first < seams.size();) {
+		size_t last = first;
+		while (last < seams.size() && tree.nodes[seams[last]].depth == tree.nodes[seams[first]].depth)
+			++last;
+
+		indexTrianglesByVertex((int) m.vert.size(), tris, faceStart, faceList);
+		std::vector<std::vector<Triangle>> seamTris(last - first);
+#pragma omp parallel for schedule(dynamic)
+		for (int s = (int) first; s < (int) last; ++s) {
+			const PointTree::Node& node = tree.nodes[seams[s]];
+			const int              axis = node.axis;
+			Box3m query = node.box;
+			query.min[axis] = std::max(query.min[axis], node.split - stripHalf);
+			query.max[axis] = std::min(query.max[axis], node.split + stripHalf);
+			std::vector<int> verts;
+			tree.collect(seams[s], query, verts);
+			if (verts.size() > 3) {
+				for (size_t i = 0; i < verts.size(); ++i)
+					localIndex[verts[i]] = (int) i;
+				std::vector<Triangle> stripTris;
+				for (int v : verts) {
+					for (int j = faceStart[v]; j < faceStart[v + 1]; ++j) {
+						const Triangle& t = tris[faceList[j]];
+						if (localIndex[t[0]] >= 0 && localIndex[t[1]] >= 0 && localIndex[t[2]] >= 0)
+							stripTris.push_back(t);
+					}
+				}
+				CMeshO sub;
+				buildSubMesh(m, verts, stripTris, localIndex, sub);
+				for (int v : verts)
+					localIndex[v] = -1;
+
+				std::unique_ptr<Pivot> pivot = makePivot(sub, radius, clustering, angle);
+				pivot->BuildMesh();
+				collectNewFaces(
+					sub,
+					stripTris.size(),
+					verts,
+					[&](const Point3m& p) {
+						return std::abs(p[axis] - node.split) <= stripKeep &&
+							   ownsPoint(node.box, root, p, gap);
+					},
+					seamTris[s - first]);
+				releasePivot(pivot);
+			}
+
+			int seamsDone = done.fetch_add(1) + 1;
+			if (cb != nullptr && isMainThread())
+				cb(80 + 20 * seamsDone / (int) seams.size(), "Merging the fronts of the cells...");
+		}
+		for (std::vector<Triangle>& st : seamTris)
+			tris.insert(tris.end(), st.begin(), st.end());
+		first = last;
+	}
+
+	CMeshO::FaceIterator fi = tri::Allocator<CMeshO>::AddFaces(m, tris.size());
+	for (const Triangle& t : tris) {
+		for (int k = 0; k < 3; ++k)
+			fi->V(k) = &m.vert[t[k]];
+		++fi;
+	}
+	if (tri::HasVFAdjacency(m))
+		tri::UpdateTopology<CMeshO>::VertexFace(m);
+	return m.fn - startingFn;
+}
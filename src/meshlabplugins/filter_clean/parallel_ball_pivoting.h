@@ -0,0 +1,55 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef FILTER_CLEAN_PARALLEL_BALL_PIVOTING_H
+#define FILTER_CLEAN_PARALLEL_BALL_PIVOTING_H
+
+#include <common/ml_document/cmesh.h>
+
+/**
+ * @brief Surface reconstruction with vcg::tri::BallPivoting, run concurrently
+ * on a spatial partition of the point cloud.
+ *
+ * The points are split by a kd-tree into cells of balanced size. Each cell
+ * is pivoted on its own, together with a thin margin of the neighbouring
+ * points, and keeps only the triangles lying inside it and away from its
+ * inner sides. The empty strips left along the cell boundaries are then
+ * closed, going up the tree, by pivoting each strip starting from the fronts
+ * of the two sides; strips of the same level are disjoint and are processed
+ * concurrently.
+ *
+ * Radius (0 means auto guess), clustering and angle have the same meaning as
+ * in vcg::tri::BallPivoting and are the same for all the cells. Small clouds,
+ * and meshes that already have faces to start from, are processed as before
+ * by a single pivoting over the whole mesh.
+ *
+ * @return the number of added faces
+ */
+int parallelBallPivoting(
+	CMeshO&           m,
+	Scalarm           radius,
+	Scalarm           clustering,
+	Scalarm           angle,
+	vcg::CallBackPos* cb = nullptr);
+
+#endif // FILTER_CLEAN_PARALLEL_BALL_PIVOTING_H
@@ -21,21 +21,30 @@
  *                                                                           *
  ****************************************************************************/
 
+#include <QElapsedTimer>
 #include <QFileDialog>
 
 #include <cmath>
+#include <condition_variable>
 #include <cstdlib>
 #include <ctime>
+#include <deque>
+#include <memory>
+#include <mutex>
 
 #include <vcg/space/colorspace.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "filter_color_projection.h"
 
 #include "floatbuffer.cpp"
 
 #include "render_helper.cpp"
 
-#include "pushpull.h"
+#include <common/utilities/pull_push.h>
 #include "rastering.h"
 #include <vcg/complex/algorithms/update/texture.h>
 
@@ -55,6 +64,20 @@ static QString extractFilenameWOExt(const MeshModel* mm)
 	QFileInfo fi(mm->fullName());
 	return fi.baseName();
 }
+
+// Memory of the per-thread accumulators of the multi-image projections: at 4096x4096 texels
+// the budget is enough for 8 threads
+static const std::size_t MAX_ACCUM_BYTES = std::size_t(2) << 30;
+
+// A raster of the multi-image projections; its depth is rendered on the GPU by the thread owning
+// the GL context, or on the CPU by the thread projecting it, and freed once its colors are
+// accumulated
+struct RasterProjection
+{
+	const RasterModel*           raster = nullptr;
+	int                          index  = 0; // position in the document, for near and far
+	std::unique_ptr<floatbuffer> depth;
+};
 //-----------------------------------------
 
 // Constructor
@@ -138,6 +161,18 @@ bool FilterColorProjectionPlugin::requiresGLContext(const QAction* action) const
 	return false;
 }
 
+bool FilterColorProjectionPlugin::canRunWithoutGLContext(const QAction* action) const
+{
+	// the depth maps are rendered on the CPU
+	switch (ID(action)) {
+	case FP_SINGLEIMAGEPROJ:
+	case FP_MULTIIMAGETRIVIALPROJ:
+	case FP_MULTIIMAGETRIVIALPROJTEXTURE: return true;
+	default: assert(0);
+	}
+	return false;
+}
+
 // This function define the needed parameters for each filter.
 RichParameterList
 FilterColorProjectionPlugin::initParameterList(const QAction* action, const MeshDocument& md)
@@ -209,6 +244,14 @@ FilterColorProjectionPlugin::initParameterList(const QAction* action, const Mesh
 			"possible to mask-out parts of the images that should not be projected on the mesh. "
 			"Please note this is not a transparency effect, but just influences the weigthing "
 			"between different images"));
+		parlst.addParam(RichInt(
+			"maxImages",
+			8,
+			"max resident images",
+			"Maximum number of rasters being projected at the same time. Their images, depth maps "
+			"and silhouette buffers stay in memory until their colors are accumulated, so this "
+			"bounds the memory used; rasters are projected concurrently, on up to this many "
+			"threads"));
 		QColor color1 = QColor(0, 0, 0, 255);
 		parlst.addParam(RichColor(
 			"blankColor",
@@ -274,755 +317,657 @@ FilterColorProjectionPlugin::initParameterList(const QAction* action, const Mesh
 			"possible to mask-out parts of the images that should not be projected on the mesh. "
 			"Please note this is not a transparency effect, but just influences the weigthing "
 			"between different images"));
+		parlst.addParam(RichInt(
+			"maxImages",
+			8,
+			"max resident images",
+			"Maximum number of rasters being projected at the same time. Their images, depth maps "
+			"and silhouette buffers stay in memory until their colors are accumulated, so this "
+			"bounds the memory used; rasters are projected concurrently, on up to this many "
+			"threads"));
 	} break;
 
 	default: break; // do not add any parameter for the other filters
 	}
+	parlst.addParam(RichBool(
+		"useGPU",
+		true,
+		"Use GPU depth rendering",
+		"If true, the depth maps of the rasters are rendered with OpenGL. Otherwise they are "
+		"rendered by a software rasterizer, several rasters at a time, and kept in memory for the "
+		"next runs on the same rasters and geometry; no OpenGL is needed"));
 	return parlst;
 }
 
-// Core Function doing the actual mesh processing.
-std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
-	const QAction*           filter,
-	const RichParameterList& par,
+// Accumulates the weighted colors of the visible rasters with a valid camera on nSamples points;
+// sample(i, p, n) sets position and normal of the i-th point, and returns false if the point is
+// not to be colored.
+// The rasters go through a pipeline on the OpenMP threads: the first one, owning the GL context,
+// renders the depth maps when on the GPU, while the others decode the images, compute the depth
+// maps on the CPU and the silhouettes, and accumulate the colors in their own buffers, summed at
+// the end. At most maxImages rasters are in flight, the first thread projects them too when the
+// limit is reached.
+template <class SampleFn>
+std::vector<FilterColorProjectionPlugin::ProjectionAccum>
+FilterColorProjectionPlugin::projectActiveRasters(
 	MeshDocument&            md,
-	unsigned int& /*postConditionMask*/,
-	vcg::CallBackPos* cb)
+	const RichParameterList& par,
+	bool                     useGPU,
+	int                      nSamples,
+	SampleFn                 sample,
+	vcg::CallBackPos*        cb)
 {
-	if (glContext != nullptr) {
-		// CMeshO::FaceIterator fi;
-		CMeshO::VertexIterator vi;
+	Scalarm eta            = par.getFloat("deptheta");
+	bool    useangle       = par.getBool("useangle");
+	bool    usedistance    = par.getBool("usedistance");
+	bool    useborders     = par.getBool("useborders");
+	bool    usesilhouettes = par.getBool("usesilhouettes");
+	bool    usealphamask   = par.getBool("usealpha");
+	int     maxImages      = std::max(1, par.getInt("maxImages"));
 
-		RenderHelper* rendermanager = NULL;
+	MeshModel* model = md.mm();
 
-		switch (ID(filter)) {
-			////--------------------------- project single trivial
-			///----------------------------------
+	// calculate accurate near/far for all cameras
+	std::vector<float> my_near;
+	std::vector<float> my_far;
+	calculateNearFarAccurate(md, &my_near, &my_far);
+
+	// min max depth for depth weight normalization, and the rasters to be projected
+	float                         allcammaxdepth = -1000000;
+	float                         allcammindepth = 1000000;
+	std::vector<RasterProjection> projections;
+	int                           cam_ind = 0;
+	for (const RasterModel& raster : md.rasterIterator()) {
+		if (my_far[cam_ind] > allcammaxdepth)
+			allcammaxdepth = my_far[cam_ind];
+		if (my_near[cam_ind] < allcammindepth)
+			allcammindepth = my_near[cam_ind];
+
+		if (raster.isVisible() && raster.shot.IsValid()) {
+			projections.emplace_back();
+			projections.back().raster = &raster;
+			projections.back().index  = cam_ind;
+		}
+		cam_ind++;
+	}
 
-		case FP_SINGLEIMAGEPROJ: {
-			bool    use_depth   = par.getBool("usedepth");
-			bool    onselection = par.getBool("onselection");
-			Scalarm eta         = par.getFloat("deptheta");
-			QColor  blank       = par.getColor("blankColor");
+	RenderHelper* rendermanager = NULL;
+	if (useGPU && !projections.empty()) {
+		glContext->makeCurrent();
+		rendermanager = new RenderHelper();
+		if (rendermanager->initializeGL(cb) != 0) {
+			delete rendermanager;
+			glContext->doneCurrent();
+			throw MLException("Failed on initializing GL rendermanager.");
+		}
+		log("init GL");
+		glContext->doneCurrent();
+	}
 
-			Scalarm depth  = 0; // depth of point (distance from camera)
-			Scalarm pdepth = 0; // depth value of projected point (from depth map)
+	// the mesh does not change while projecting: its version, hashed once,
+	// keys all the depth maps rendered on the CPU
+	const std::uint64_t meshVersion = useGPU ? 0 : meshlab::DepthMapCache::meshVersion(model->cm);
+
+	// accumulates the colors of a raster in the buffers of the calling thread
+	std::mutex mutex;
+	qint64     depthTime  = 0;
+	int        unreadable = 0;
+	auto project = [&](RasterProjection& proj, std::vector<ThreadAccum>& accum) {
+		const RasterModel& raster = *proj.raster;
+		const Shotm&       shot   = raster.shot;
+		if (!proj.depth) {
+			QElapsedTimer depthTimer;
+			depthTimer.start();
+			RenderHelper cpuDepth;
+			cpuDepth.setDepthMap(*depthMapCache.depthMap(model->cm, meshVersion, shot));
+			proj.depth.reset(cpuDepth.depth);
+			cpuDepth.depth = NULL;
+			std::lock_guard<std::mutex> lock(mutex);
+			depthTime += depthTimer.elapsed();
+		}
+		floatbuffer* depth = proj.depth.get();
+
+		// the image of the raster with 32 bit pixels, decoded again if it is not in memory
+		QImage image = raster.currentPlane->image;
+		if (image.isNull())
+			image = QImage(raster.currentPlane->fullPathFileName);
+		if (image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32)
+			image = image.convertToFormat(QImage::Format_ARGB32);
+		if (image.isNull()) {
+			proj.depth.reset();
+			std::lock_guard<std::mutex> lock(mutex);
+			unreadable++;
+			return;
+		}
 
-			// get current raster and model
-			RasterModel* raster = md.rm();
-			MeshModel*   model  = md.mm();
+		// If should be used silhouette weighting, it is needed to compute depth discontinuities
+		// and per-pixel distance from detected borders on the entire image here the weight is
+		// then applied later, per-sample, when needed
+		floatbuffer silhouette_buff;
+		float       maxsildist = depth->sx + depth->sy;
+		if (usesilhouettes) {
+			silhouette_buff.init(depth->sx, depth->sy);
+			silhouette_buff.applysobel(depth);
+			silhouette_buff.initborder(depth);
+			maxsildist = silhouette_buff.distancefield();
+		}
 
-			// no projection if camera not valid
-			if (!raster || !raster->shot.IsValid()) {
-				throw MLException("Raster or camera not valid.");
+		if (accum.empty())
+			accum.resize(nSamples);
+		const int     width     = shot.Intrinsics.ViewportPx[0];
+		const int     height    = shot.Intrinsics.ViewportPx[1];
+		const Point3m viewpoint = shot.GetViewPoint();
+		const Point3m viewdir   = -shot.Axis(2);
+		for (int i = 0; i < nSamples; i++) {
+			Point3m p, n;
+			if (!sample(i, p, n))
+				continue;
+
+			// pp is the projected point in image space
+			Point2m pp = shot.Project(p);
+			// pray is the vector from the point-to-be-colored to the camera center
+			Point3m pray = (viewpoint - p).Normalize();
+
+			// if inside image and facing the camera
+			if (pp[0] < 0 || pp[1] < 0 || pp[0] >= width || pp[1] >= height ||
+				pray.dot(viewdir) > 0.0)
+				continue;
+
+			Scalarm pdepth = shot.Depth(p);
+			if (pdepth > depth->getval(int(pp[0]), int(pp[1])) + eta)
+				continue;
+
+			// determine color
+			int px = int(pp[0]);
+			int py = std::min(int(height - pp[1]), height - 1);
+			if (px >= image.width() || py >= image.height())
+				continue;
+			QRgb pcolor = reinterpret_cast<const QRgb*>(image.constScanLine(py))[px];
+
+			// determine weight
+			double pweight = 1.0;
+
+			if (useangle) {
+				Point3m pixnorm = n;
+				pixnorm.Normalize();
+
+				float ang = abs(pixnorm * pray);
+				ang       = min(1.0f, ang);
+
+				pweight *= ang;
 			}
 
-			// the mesh has to be correctly transformed before mapping
-			tri::UpdatePosition<CMeshO>::Matrix(model->cm, model->cm.Tr, true);
-			tri::UpdateBounding<CMeshO>::Box(model->cm);
+			if (usedistance) {
+				float distw = pdepth;
+				distw       = 1.0 - (distw - (allcammindepth * 0.99)) /
+								  ((allcammaxdepth * 1.01) - (allcammindepth * 0.99));
 
-			// making context current
-			glContext->makeCurrent();
+				pweight *= distw;
+				pweight *= distw;
+			}
 
-			if (use_depth) {
-				// init rendermanager
-				rendermanager = new RenderHelper();
-				if (rendermanager->initializeGL(cb) != 0) {
-					delete rendermanager;
-					throw MLException("Failed on initializing GL rendermanager.");
-				}
-				log("init GL");
-				// if( rendermanager->initializeMeshBuffers(model, cb) != 0 )
-				//    return false;
-				// Log("init Buffers");
+			if (useborders) {
+				double xdist   = 1.0 - (abs(pp[0] - (width / 2.0)) / (width / 2.0));
+				double ydist   = 1.0 - (abs(pp[1] - (height / 2.0)) / (height / 2.0));
+				double borderw = min(xdist, ydist);
 
-				// render depth
-				rendermanager->renderScene(raster->shot, model, RenderHelper::FLAT, glContext);
+				pweight *= borderw;
 			}
 
-			// unmaking context current
-			glContext->doneCurrent();
+			if (usesilhouettes) {
+				// here the silhouette weight is applied, but it is calculated before, on a
+				// per-image basis
+				pweight *= silhouette_buff.getval(int(pp[0]), int(pp[1])) / maxsildist;
+			}
 
-			qDebug(
-				"Viewport %i %i",
-				raster->shot.Intrinsics.ViewportPx[0],
-				raster->shot.Intrinsics.ViewportPx[1]);
-			for (vi = model->cm.vert.begin(); vi != model->cm.vert.end(); ++vi) {
-				if (!(*vi).IsD() && (!onselection || (*vi).IsS())) {
-					Point2m pp = raster->shot.Project((*vi).P());
-					// pray is the vector from the point-to-be-colored to the camera center
-					Point3m pray = (raster->shot.GetViewPoint() - (*vi).P()).Normalize();
+			if (usealphamask) { // alpha channel of image is an additional mask
+				pweight *= (qAlpha(pcolor) / 255.0);
+			}
 
-					if ((blank.red() != 0) || (blank.green() != 0) || (blank.blue() != 0) ||
-						(blank.alpha() != 0))
-						(*vi).C() =
-							vcg::Color4b(blank.red(), blank.green(), blank.blue(), blank.alpha());
-
-					// if inside image
-					if (pp[0] > 0 && pp[1] > 0 && pp[0] < raster->shot.Intrinsics.ViewportPx[0] &&
-						pp[1] < raster->shot.Intrinsics.ViewportPx[1]) {
-						if ((pray.dot(-raster->shot.Axis(2))) <= 0.0) {
-							if (use_depth) {
-								depth  = raster->shot.Depth((*vi).P());
-								pdepth = rendermanager->depth->getval(
-									int(pp[0]), int(pp[1])); // rendermanager->depth[(int(pp[1]) *
-															 // raster->shot.Intrinsics.ViewportPx[0])
-															 // + int(pp[0])];
-							}
-
-							if (!use_depth || (depth <= (pdepth + eta))) {
-								QRgb pcolor = raster->currentPlane->image.pixel(
-									pp[0], raster->shot.Intrinsics.ViewportPx[1] - pp[1]);
-								(*vi).C() =
-									vcg::Color4b(qRed(pcolor), qGreen(pcolor), qBlue(pcolor), 255);
-							}
-						}
-					}
+			accum[i].weight += float(pweight);
+			accum[i].red += float(qRed(pcolor) * pweight / 255.0);
+			accum[i].green += float(qGreen(pcolor) * pweight / 255.0);
+			accum[i].blue += float(qBlue(pcolor) * pweight / 255.0);
+		}
+		proj.depth.reset();
+	};
+
+	// each projecting thread sums into its own copy of the nSamples
+	// accumulators; the threads are bounded so that the copies stay within
+	// MAX_ACCUM_BYTES
+	const std::size_t accumBytes = std::max<std::size_t>(1, nSamples * sizeof(ThreadAccum));
+	int               nThreads   = 1;
+#ifdef _OPENMP
+	nThreads = omp_get_max_threads();
+#endif
+	nThreads = (int) std::max<std::size_t>(
+		1, std::min<std::size_t>(nThreads, MAX_ACCUM_BYTES / accumBytes));
+	std::vector<std::vector<ThreadAccum>> threadAccums(nThreads);
+	std::condition_variable                   changed;
+	std::deque<int> ready;        // rasters waiting for their colors to be accumulated
+	int             inFlight = 0; // rasters being rendered, waiting or being projected
+	bool            fed      = false;
+
+	QElapsedTimer timer;
+	timer.start();
+#pragma omp parallel num_threads(nThreads)
+	{
+		int thread = 0;
+#ifdef _OPENMP
+		thread = omp_get_thread_num();
+#endif
+		std::vector<ThreadAccum>& accum = threadAccums[thread];
+
+		// projects the first waiting raster, called with the lock held
+		auto projectNext = [&](std::unique_lock<std::mutex>& lock) {
+			int next = ready.front();
+			ready.pop_front();
+			lock.unlock();
+			project(projections[next], accum);
+			lock.lock();
+			inFlight--;
+			changed.notify_all();
+		};
+
+		if (thread == 0) {
+			for (int k = 0; k < int(projections.size()); k++) {
+				std::unique_lock<std::mutex> lock(mutex);
+				while (inFlight >= maxImages) {
+					if (!ready.empty())
+						projectNext(lock);
+					else
+						changed.wait(lock);
+				}
+				inFlight++;
+				lock.unlock();
+
+				if (useGPU) {
+					QElapsedTimer depthTimer;
+					depthTimer.start();
+
+					// render normal & depth
+					glContext->makeCurrent();
+					rendermanager->renderScene(
+						projections[k].raster->shot,
+						model,
+						RenderHelper::NORMAL,
+						glContext,
+						my_near[projections[k].index] * 0.5,
+						my_far[projections[k].index] * 1.25);
+					glContext->doneCurrent();
+					projections[k].depth.reset(rendermanager->depth);
+					rendermanager->depth = NULL;
+
+					lock.lock();
+					depthTime += depthTimer.elapsed();
+				}
+				else {
+					lock.lock();
 				}
+				ready.push_back(k);
+				changed.notify_all();
 			}
-
-			// the mesh has to return to its original position
-			tri::UpdatePosition<CMeshO>::Matrix(model->cm, Inverse(model->cm.Tr), true);
-			tri::UpdateBounding<CMeshO>::Box(model->cm);
-
-			// delete rendermanager
-			if (rendermanager != NULL)
-				delete rendermanager;
+			std::lock_guard<std::mutex> lock(mutex);
+			fed = true;
+			changed.notify_all();
 		}
 
-		break;
-
-			////--------------------------- project multi trivial ----------------------------------
-
-		case FP_MULTIIMAGETRIVIALPROJ: {
-			bool    onselection    = par.getBool("onselection");
-			Scalarm eta            = par.getFloat("deptheta");
-			bool    useangle       = par.getBool("useangle");
-			bool    usedistance    = par.getBool("usedistance");
-			bool    useborders     = par.getBool("useborders");
-			bool    usesilhouettes = par.getBool("usesilhouettes");
-			bool    usealphamask   = par.getBool("usealpha");
-			QColor  blank          = par.getColor("blankColor");
-
-			Scalarm    depth  = 0; // depth of point (distance from camera)
-			Scalarm    pdepth = 0; // depth value of projected point (from depth map)
-			double     pweight;    // pixel weight
-			MeshModel* model;
-			bool       do_project;
-			int        cam_ind;
-
-			// min max depth for depth weight normalization
-			float allcammaxdepth;
-			float allcammindepth;
-
-			// max image size for border weight normalization
-			float allcammaximagesize;
-
-			// accumulation buffers for colors and weights
-			int     buff_ind;
-			double* weights;
-			double* acc_red;
-			double* acc_grn;
-			double* acc_blu;
-
-			// get current model
-			model = md.mm();
-
-			// the mesh has to be correctly transformed before mapping
-			tri::UpdatePosition<CMeshO>::Matrix(model->cm, model->cm.Tr, true);
-			tri::UpdateBounding<CMeshO>::Box(model->cm);
-
-			// init accumulation buffers for colors and weights
-			log("init color accumulation buffers");
-			weights = new double[model->cm.vn];
-			acc_red = new double[model->cm.vn];
-			acc_grn = new double[model->cm.vn];
-			acc_blu = new double[model->cm.vn];
-			for (int buff_ind = 0; buff_ind < model->cm.vn; buff_ind++) {
-				weights[buff_ind] = 0.0;
-				acc_red[buff_ind] = 0.0;
-				acc_grn[buff_ind] = 0.0;
-				acc_blu[buff_ind] = 0.0;
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			changed.wait(lock, [&] { return !ready.empty() || fed; });
+			if (ready.empty())
+				break;
+			projectNext(lock);
+		}
+	}
+	qint64 projectionTime = timer.elapsed();
+
+	if (rendermanager != NULL)
+		delete rendermanager;
+
+	std::vector<ProjectionAccum> accums(nSamples);
+#pragma omp parallel for
+	for (int i = 0; i < nSamples; i++) {
+		for (const std::vector<ThreadAccum>& threadAccum : threadAccums) {
+			if (!threadAccum.empty()) {
+				accums[i].weight += threadAccum[i].weight;
+				accums[i].red += threadAccum[i].red;
+				accums[i].green += threadAccum[i].green;
+				accums[i].blue += threadAccum[i].blue;
 			}
+		}
+	}
 
-			// calculate accuratenear/far for all cameras
-			std::vector<float> my_near;
-			std::vector<float> my_far;
-			calculateNearFarAccurate(md, &my_near, &my_far);
-
-			allcammaxdepth     = -1000000;
-			allcammindepth     = 1000000;
-			allcammaximagesize = -1000000;
-			cam_ind            = 0;
-			for (const RasterModel& rm : md.rasterIterator()) {
-				if (my_far[cam_ind] > allcammaxdepth)
-					allcammaxdepth = my_far[cam_ind];
-				if (my_near[cam_ind] < allcammindepth)
-					allcammindepth = my_near[cam_ind];
-
-				float imgdiag = sqrt(
-					double(rm.shot.Intrinsics.ViewportPx[0] * rm.shot.Intrinsics.ViewportPx[1]));
-				if (imgdiag > allcammaximagesize)
-					allcammaximagesize = imgdiag;
-				cam_ind++;
-			}
+	log("DEPTH MAPS (%s): %.3f sec.", useGPU ? "GPU" : "CPU", 0.001f * depthTime);
+	log("PROJECTION: %i rasters in %.3f sec., at most %i at a time on %i threads",
+		int(projections.size()),
+		0.001f * projectionTime,
+		maxImages,
+		nThreads);
+	if (unreadable > 0)
+		log(GLLogStream::WARNING, "%i raster images could not be read", unreadable);
+	return accums;
+}
 
-			//-- cycle all cameras
-			cam_ind = 0;
-			for (const RasterModel& raster : md.rasterIterator()) {
-				if (raster.isVisible()) {
-					do_project = true;
-
-					// no drawing if camera not valid
-					if (!raster.shot.IsValid())
-						do_project = false;
-
-					// no drawing if raster is not active
-					// if(!raster->shot.IsValid())
-					//  do_project = false;
-
-					if (do_project) {
-						// making context current
-						glContext->makeCurrent();
-
-						// delete & reinit rendermanager
-						if (rendermanager != NULL)
-							delete rendermanager;
-						rendermanager = new RenderHelper();
-						if (rendermanager->initializeGL(cb) != 0) {
-							delete rendermanager;
-							throw MLException("Failed on initializing GL rendermanager.");
-						}
-						log("init GL");
-						/*if( rendermanager->initializeMeshBuffers(model, cb) != 0 )
-							return false;
-						Log("init Buffers");*/
-
-						// render normal & depth
-						rendermanager->renderScene(
-							raster.shot,
-							model,
-							RenderHelper::NORMAL,
-							glContext,
-							my_near[cam_ind] * 0.5,
-							my_far[cam_ind] * 1.25);
-
-						// unmaking context current
-						glContext->doneCurrent();
-
-						buff_ind = 0;
-
-						// If should be used silhouette weighting, it is needed to compute depth
-						// discontinuities and per-pixel distance from detected borders on the
-						// entire image here the weight is then applied later, per-vertex, when
-						// needed
-						floatbuffer* silhouette_buff = NULL;
-						float maxsildist = rendermanager->depth->sx + rendermanager->depth->sy;
-						if (usesilhouettes) {
-							silhouette_buff = new floatbuffer();
-							silhouette_buff->init(
-								rendermanager->depth->sx, rendermanager->depth->sy);
-
-							silhouette_buff->applysobel(rendermanager->depth);
-							// sprintf(dumpFileName,"Abord%i.pfm",cam_ind);
-							// silhouette_buff->dumppfm(dumpFileName);
-
-							silhouette_buff->initborder(rendermanager->depth);
-							// sprintf(dumpFileName,"Bbord%i.pfm",cam_ind);
-							// silhouette_buff->dumppfm(dumpFileName);
-
-							maxsildist = silhouette_buff->distancefield();
-							// sprintf(dumpFileName,"Cbord%i.pfm",cam_ind);
-							// silhouette_buff->dumppfm(dumpFileName);
-						}
+// Core Function doing the actual mesh processing.
+std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
+	const QAction*           filter,
+	const RichParameterList& par,
+	MeshDocument&            md,
+	unsigned int& /*postConditionMask*/,
+	vcg::CallBackPos* cb)
+{
+	bool useGPU = par.getBool("useGPU");
+	if (useGPU && (glContext == nullptr || !glContext->isValid())) {
+		log(GLLogStream::SYSTEM, "No OpenGL context available, the depth maps are rendered on the CPU");
+		useGPU = false;
+	}
 
-						for (vi = model->cm.vert.begin(); vi != model->cm.vert.end(); ++vi) {
-							if (!(*vi).IsD() && (!onselection || (*vi).IsS())) {
-								// pp is the projected point in image space
-								Point2m pp = raster.shot.Project((*vi).P());
-								// pray is the vector from the point-to-be-colored to the camera
-								// center
-								Point3m pray = (raster.shot.GetViewPoint() - (*vi).P()).Normalize();
-
-								// if inside image
-								if (pp[0] >= 0 && pp[1] >= 0 &&
-									pp[0] < raster.shot.Intrinsics.ViewportPx[0] &&
-									pp[1] < raster.shot.Intrinsics.ViewportPx[1]) {
-									if ((pray.dot(-raster.shot.Axis(2))) <= 0.0) {
-										depth  = raster.shot.Depth((*vi).P());
-										pdepth = rendermanager->depth->getval(
-											int(pp[0]),
-											int(pp[1])); //  rendermanager->depth[(int(pp[1]) *
-														 //  raster->shot.Intrinsics.ViewportPx[0])
-														 //  + int(pp[0])];
-
-										if (depth <= (pdepth + eta)) {
-											// determine color
-											QRgb pcolor = raster.currentPlane->image.pixel(
-												pp[0],
-												raster.shot.Intrinsics.ViewportPx[1] - pp[1]);
-											// determine weight
-											pweight = 1.0;
-
-											if (useangle) {
-												Point3m pixnorm = (*vi).N();
-												Point3m viewaxis =
-													raster.shot.GetViewPoint() - (*vi).P();
-												pixnorm.Normalize();
-												viewaxis.Normalize();
-
-												float ang = abs(pixnorm * viewaxis);
-												ang       = min(1.0f, ang);
-
-												pweight *= ang;
-											}
-
-											if (usedistance) {
-												float distw = depth;
-												distw = 1.0 - (distw - (allcammindepth * 0.99)) /
-																  ((allcammaxdepth * 1.01) -
-																   (allcammindepth * 0.99));
-
-												pweight *= distw;
-												pweight *= distw;
-											}
-
-											if (useborders) {
-												double xdist =
-													1.0 -
-													(abs(pp[0] -
-														 (raster.shot.Intrinsics.ViewportPx[0] /
-														  2.0)) /
-													 (raster.shot.Intrinsics.ViewportPx[0] / 2.0));
-												double ydist =
-													1.0 -
-													(abs(pp[1] -
-														 (raster.shot.Intrinsics.ViewportPx[1] /
-														  2.0)) /
-													 (raster.shot.Intrinsics.ViewportPx[1] / 2.0));
-												double borderw = min(xdist, ydist);
-												// borderw = min(1.0,borderw); //debug debug
-												// borderw = max(0.0,borderw); //debug debug
-
-												pweight *= borderw;
-											}
-
-											if (usesilhouettes) {
-												// here the silhouette weight is applied, but it is
-												// calculated before, on a per-image basis
-												float silw = 1.0;
-												silw       = silhouette_buff->getval(
-                                                           int(pp[0]), int(pp[1])) /
-													   maxsildist;
-												// silw = min(1.0f,silw); //debug debug
-												// silw = max(0.0f,silw); //debug debug
-
-												pweight *= silw;
-											}
-
-											if (usealphamask) { // alpha channel of image is an
-																// additional mask
-												pweight *= (qAlpha(pcolor) / 255.0);
-											}
-
-											weights[buff_ind] += pweight;
-											acc_red[buff_ind] += (qRed(pcolor) * pweight / 255.0);
-											acc_grn[buff_ind] += (qGreen(pcolor) * pweight / 255.0);
-											acc_blu[buff_ind] += (qBlue(pcolor) * pweight / 255.0);
-										}
-									}
-								}
-							}
-							buff_ind++;
-						}
-						cam_ind++;
+	// CMeshO::FaceIterator fi;
+	CMeshO::VertexIterator vi;
 
-						if (usesilhouettes) {
-							delete silhouette_buff;
-						}
+	RenderHelper* rendermanager = NULL;
 
-					} // end foreach camera
-				}     // end foreach camera
-			}
+	switch (ID(filter)) {
+		////--------------------------- project single trivial
+		///----------------------------------
 
-			buff_ind = 0;
-			for (vi = model->cm.vert.begin(); vi != model->cm.vert.end(); ++vi) {
-				if (!(*vi).IsD() && (!onselection || (*vi).IsS())) {
-					if (weights[buff_ind] !=
-						0) // if 0, it has not found any valid projection on any camera
-					{
-						(*vi).C() = vcg::Color4b(
-							(acc_red[buff_ind] / weights[buff_ind]) * 255.0,
-							(acc_grn[buff_ind] / weights[buff_ind]) * 255.0,
-							(acc_blu[buff_ind] / weights[buff_ind]) * 255.0,
-							255);
-					}
-					else {
-						if ((blank.red() != 0) || (blank.green() != 0) || (blank.blue() != 0) ||
-							(blank.alpha() != 0))
-							(*vi).C() = vcg::Color4b(
-								blank.red(), blank.green(), blank.blue(), blank.alpha());
-					}
-				}
-				buff_ind++;
-			}
+	case FP_SINGLEIMAGEPROJ: {
+		bool    use_depth   = par.getBool("usedepth");
+		bool    onselection = par.getBool("onselection");
+		Scalarm eta         = par.getFloat("deptheta");
+		QColor  blank       = par.getColor("blankColor");
 
-			// the mesh has to return to its original position
-			tri::UpdatePosition<CMeshO>::Matrix(model->cm, Inverse(model->cm.Tr), true);
-			tri::UpdateBounding<CMeshO>::Box(model->cm);
+		Scalarm depth  = 0; // depth of point (distance from camera)
+		Scalarm pdepth = 0; // depth value of projected point (from depth map)
 
-			// delete rendermanager
-			if (rendermanager != NULL)
-				delete rendermanager;
+		// get current raster and model
+		RasterModel* raster = md.rm();
+		MeshModel*   model  = md.mm();
 
-			// delete accumulation buffers
-			delete[] weights;
-			delete[] acc_red;
-			delete[] acc_grn;
-			delete[] acc_blu;
+		// no projection if camera not valid
+		if (!raster || !raster->shot.IsValid()) {
+			throw MLException("Raster or camera not valid.");
+		}
 
-		} break;
+		// the mesh has to be correctly transformed before mapping
+		tri::UpdatePosition<CMeshO>::Matrix(model->cm, model->cm.Tr, true);
+		tri::UpdateBounding<CMeshO>::Box(model->cm);
 
-		case FP_MULTIIMAGETRIVIALPROJTEXTURE: {
-			if (!tri::HasPerWedgeTexCoord(md.mm()->cm)) {
-				throw MLException(
-					"Error: nothing have been done. Mesh has no Texture Coordinates.");
-			}
+		QElapsedTimer depthTimer;
+		depthTimer.start();
+		if (use_depth && useGPU) {
+			// making context current
+			glContext->makeCurrent();
 
-			// bool onselection = par.getBool("onselection");
-			int     texsize        = par.getInt("texsize");
-			bool    dorefill       = par.getBool("dorefill");
-			Scalarm eta            = par.getFloat("deptheta");
-			bool    useangle       = par.getBool("useangle");
-			bool    usedistance    = par.getBool("usedistance");
-			bool    useborders     = par.getBool("useborders");
-			bool    usesilhouettes = par.getBool("usesilhouettes");
-			bool    usealphamask   = par.getBool("usealpha");
-			QString textName       = par.getString("textName");
-
-			int textW = texsize;
-			int textH = texsize;
-
-			Scalarm    depth  = 0; // depth of point (distance from camera)
-			Scalarm    pdepth = 0; // depth value of projected point (from depth map)
-			double     pweight;    // pixel weight
-			MeshModel* model;
-			bool       do_project;
-			int        cam_ind;
-
-			// min max depth for depth weight normalization
-			float allcammaxdepth;
-			float allcammindepth;
-
-			// max image size for border weight normalization
-			float allcammaximagesize;
-
-			// get the working model
-			model = md.mm();
-
-			// the mesh has to be correctly transformed before mapping
-			tri::UpdatePosition<CMeshO>::Matrix(model->cm, model->cm.Tr, true);
-			tri::UpdateBounding<CMeshO>::Box(model->cm);
-
-			// texture file name
-			QString filePath(model->fullName());
-			filePath = filePath.left(
-				std::max<int>(filePath.lastIndexOf('\\'), filePath.lastIndexOf('/')) + 1);
-			// Check textName and eventually add .png ext
-			CheckError(textName.length() == 0, "Texture file not specified");
-			CheckError(
-				std::max<int>(textName.lastIndexOf("\\"), textName.lastIndexOf("/")) != -1,
-				"Path in Texture file not allowed");
-			if (!textName.endsWith(".png", Qt::CaseInsensitive))
-				textName.append(".png");
-			filePath.append(textName);
-
-			// Image creation
-			CheckError(textW <= 0, "Texture Width has an incorrect value");
-			CheckError(textH <= 0, "Texture Height has an incorrect value");
-			QImage img(QSize(textW, textH), QImage::Format_ARGB32);
-			img.fill(qRgba(0, 0, 0, 0)); // transparent black
-
-			// Compute (texture-space) border edges
-			if (dorefill) {
-				model->updateDataMask(MeshModel::MM_FACEFACETOPO);
-				tri::UpdateTopology<CMeshO>::FaceFaceFromTexCoord(model->cm);
-				tri::UpdateFlags<CMeshO>::FaceBorderFromFF(model->cm);
+			// init rendermanager
+			rendermanager = new RenderHelper();
+			if (rendermanager->initializeGL(cb) != 0) {
+				delete rendermanager;
+				throw MLException("Failed on initializing GL rendermanager.");
 			}
+			log("init GL");
+			// if( rendermanager->initializeMeshBuffers(model, cb) != 0 )
+			//    return false;
+			// Log("init Buffers");
 
-			// create a list of to-be-filled texels and accumulators
-			// storing texel 2d coords, texel mesh-space point, texel mesh normal
-
-			vector<TexelDesc> texels;
-			texels.clear();
-			texels.reserve(textW * textH); // just to avoid the 2x reallocate rule...
-
-			vector<TexelAccum> accums;
-			accums.clear();
-			accums.reserve(textW * textH); // just to avoid the 2x reallocate rule...
-
-			// Rasterizing triangles in the list of voxels
-			TexFillerSampler tfs(img);
-			tfs.texelspointer = &texels;
-			tfs.accumpointer  = &accums;
-			tfs.InitCallback(cb, model->cm.fn, 0, 80);
-			tri::SurfaceSampling<CMeshO, TexFillerSampler>::Texture(
-				model->cm, tfs, textW, textH, true);
-
-			// Revert alpha values for border edge pixels to 255
-			cb(81, "Cleaning up texture ...");
-			for (int y = 0; y < textH; ++y) {
-				for (int x = 0; x < textW; ++x) {
-					QRgb px = img.pixel(x, y);
-					if (qAlpha(px) < 255 && qAlpha(px) > 0)
-						img.setPixel(x, y, px | 0xff000000);
+			// render depth
+			rendermanager->renderScene(raster->shot, model, RenderHelper::FLAT, glContext);
+
+			// unmaking context current
+			glContext->doneCurrent();
+		}
+		else if (use_depth) {
+			rendermanager = new RenderHelper();
+			rendermanager->setDepthMap(*depthMapCache.depthMap(model->cm, raster->shot));
+		}
+		if (use_depth)
+			log("DEPTH MAP (%s): %.3f sec.", useGPU ? "GPU" : "CPU", 0.001f * depthTimer.elapsed());
+
+		qDebug(
+			"Viewport %i %i",
+			raster->shot.Intrinsics.ViewportPx[0],
+			raster->shot.Intrinsics.ViewportPx[1]);
+		for (vi = model->cm.vert.begin(); vi != model->cm.vert.end(); ++vi) {
+			if (!(*vi).IsD() && (!onselection || (*vi).IsS())) {
+				Point2m pp = raster->shot.Project((*vi).P());
+				// pray is the vector from the point-to-be-colored to the camera center
+				Point3m pray = (raster->shot.GetViewPoint() - (*vi).P()).Normalize();
+
+				if ((blank.red() != 0) || (blank.green() != 0) || (blank.blue() != 0) ||
+					(blank.alpha() != 0))
+					(*vi).C() =
+						vcg::Color4b(blank.red(), blank.green(), blank.blue(), blank.alpha());
+
+				// if inside image
+				if (pp[0] > 0 && pp[1] > 0 && pp[0] < raster->shot.Intrinsics.ViewportPx[0] &&
+					pp[1] < raster->shot.Intrinsics.ViewportPx[1]) {
+					if ((pray.dot(-raster->shot.Axis(2))) <= 0.0) {
+						if (use_depth) {
+							depth  = raster->shot.Depth((*vi).P());
+							pdepth = rendermanager->depth->getval(
+								int(pp[0]), int(pp[1])); // rendermanager->depth[(int(pp[1]) *
+														 // raster->shot.Intrinsics.ViewportPx[0])
+														 // + int(pp[0])];
+						}
+
+						if (!use_depth || (depth <= (pdepth + eta))) {
+							QRgb pcolor = raster->currentPlane->image.pixel(
+								pp[0], raster->shot.Intrinsics.ViewportPx[1] - pp[1]);
+							(*vi).C() =
+								vcg::Color4b(qRed(pcolor), qGreen(pcolor), qBlue(pcolor), 255);
+						}
+					}
 				}
 			}
+		}
 
-			// calculate accuratenear/far for all cameras
-			std::vector<float> my_near;
-			std::vector<float> my_far;
-			calculateNearFarAccurate(md, &my_near, &my_far);
-
-			allcammaxdepth     = -1000000;
-			allcammindepth     = 1000000;
-			allcammaximagesize = -1000000;
-			cam_ind            = 0;
-			for (const RasterModel& rm : md.rasterIterator()) {
-				if (my_far[cam_ind] > allcammaxdepth)
-					allcammaxdepth = my_far[cam_ind];
-				if (my_near[cam_ind] < allcammindepth)
-					allcammindepth = my_near[cam_ind];
-
-				float imgdiag = sqrt(
-					double(rm.shot.Intrinsics.ViewportPx[0] * rm.shot.Intrinsics.ViewportPx[1]));
-				if (imgdiag > allcammaximagesize)
-					allcammaximagesize = imgdiag;
-				cam_ind++;
-			}
+		// the mesh has to return to its original position
+		tri::UpdatePosition<CMeshO>::Matrix(model->cm, Inverse(model->cm.Tr), true);
+		tri::UpdateBounding<CMeshO>::Box(model->cm);
 
-			//-- cycle all cameras
-			cam_ind = 0;
-			for (const RasterModel& raster : md.rasterIterator()) {
-				if (raster.isVisible()) {
-					do_project = true;
-
-					// no drawing if camera not valid
-					if (!raster.shot.IsValid())
-						do_project = false;
-
-					// no drawing if raster is not active
-					// if(!raster->shot.IsValid())
-					//  do_project = false;
-
-					if (do_project) {
-						// making context current
-						glContext->makeCurrent();
-
-						// delete & reinit rendermanager
-						if (rendermanager != NULL)
-							delete rendermanager;
-						rendermanager = new RenderHelper();
-						if (rendermanager->initializeGL(cb) != 0) {
-							delete rendermanager;
-							throw MLException("Failed on initializing GL rendermanager.");
-						}
-						log("init GL");
-						/*if( rendermanager->initializeMeshBuffers(model, cb) != 0 )
-							return false;
-						Log("init Buffers");*/
-
-						// render normal & depth
-						rendermanager->renderScene(
-							raster.shot,
-							model,
-							RenderHelper::NORMAL,
-							glContext,
-							my_near[cam_ind] * 0.5,
-							my_far[cam_ind] * 1.25);
-
-						// unmaking context current
-						glContext->doneCurrent();
-
-						// If should be used silhouette weighting, it is needed to compute depth
-						// discontinuities and per-pixel distance from detected borders on the
-						// entire image here the weight is then applied later, per-vertex, when
-						// needed
-						floatbuffer* silhouette_buff = NULL;
-						float maxsildist = rendermanager->depth->sx + rendermanager->depth->sy;
-						if (usesilhouettes) {
-							silhouette_buff = new floatbuffer();
-							silhouette_buff->init(
-								rendermanager->depth->sx, rendermanager->depth->sy);
-
-							silhouette_buff->applysobel(rendermanager->depth);
-							// sprintf(dumpFileName,"Abord%i.bmp",cam_ind);
-							// silhouette_buff->dumpbmp(dumpFileName);
-
-							silhouette_buff->initborder(rendermanager->depth);
-							// sprintf(dumpFileName,"Bbord%i.bmp",cam_ind);
-							// silhouette_buff->dumpbmp(dumpFileName);
-
-							maxsildist = silhouette_buff->distancefield();
-							// sprintf(dumpFileName,"Cbord%i.bmp",cam_ind);
-							// silhouette_buff->dumpbmp(dumpFileName);
-						}
+		// delete rendermanager
+		if (rendermanager != NULL)
+			delete rendermanager;
+	}
 
-						for (size_t texcount = 0; texcount < texels.size(); texcount++) {
-							Point2m pp = raster.shot.Project(texels[texcount].meshpoint);
-							// pray is the vector from the point-to-be-colored to the camera center
-							Point3m pray = (raster.shot.GetViewPoint() - texels[texcount].meshpoint)
-											   .Normalize();
-
-							// if inside image
-							if (pp[0] > 0 && pp[1] > 0 &&
-								pp[0] < raster.shot.Intrinsics.ViewportPx[0] &&
-								pp[1] < raster.shot.Intrinsics.ViewportPx[1]) {
-								if ((pray.dot(-raster.shot.Axis(2))) <= 0.0) {
-									depth  = raster.shot.Depth(texels[texcount].meshpoint);
-									pdepth = rendermanager->depth->getval(
-										int(pp[0]),
-										int(pp[1])); //  rendermanager->depth[(int(pp[1]) *
-													 //  raster->shot.Intrinsics.ViewportPx[0]) +
-													 //  int(pp[0])];
-
-									if (depth <= (pdepth + eta)) {
-										// determine color
-										QRgb pcolor = raster.currentPlane->image.pixel(
-											pp[0], raster.shot.Intrinsics.ViewportPx[1] - pp[1]);
-										// determine weight
-										pweight = 1.0;
-
-										if (useangle) {
-											Point3m pixnorm = texels[texcount].meshnormal;
-											pixnorm.Normalize();
-
-											Point3m viewaxis = raster.shot.GetViewPoint() -
-															   texels[texcount].meshpoint;
-											viewaxis.Normalize();
-
-											float ang = abs(pixnorm * viewaxis);
-											ang       = min(1.0f, ang);
-
-											pweight *= ang;
-										}
-
-										if (usedistance) {
-											float distw = depth;
-											distw       = 1.0 - (distw - (allcammindepth * 0.99)) /
-															  ((allcammaxdepth * 1.01) -
-															   (allcammindepth * 0.99));
-
-											pweight *= distw;
-											pweight *= distw;
-										}
-
-										if (useborders) {
-											double xdist =
-												1.0 -
-												(abs(pp[0] -
-													 (raster.shot.Intrinsics.ViewportPx[0] / 2.0)) /
-												 (raster.shot.Intrinsics.ViewportPx[0] / 2.0));
-											double ydist =
-												1.0 -
-												(abs(pp[1] -
-													 (raster.shot.Intrinsics.ViewportPx[1] / 2.0)) /
-												 (raster.shot.Intrinsics.ViewportPx[1] / 2.0));
-											double borderw = min(xdist, ydist);
-
-											pweight *= borderw;
-										}
-
-										if (usesilhouettes) {
-											// here the silhouette weight is applied, but it is
-											// calculated before, on a per-image basis
-											float silw = 1.0;
-											silw = silhouette_buff->getval(int(pp[0]), int(pp[1])) /
-												   maxsildist;
-											pweight *= silw;
-										}
-
-										if (usealphamask) { // alpha channel of image is an
-															// additional mask
-											pweight *= (qAlpha(pcolor) / 255.0);
-										}
-
-										accums[texcount].weights += pweight;
-										accums[texcount].acc_red +=
-											(qRed(pcolor) * pweight / 255.0);
-										accums[texcount].acc_grn +=
-											(qGreen(pcolor) * pweight / 255.0);
-										accums[texcount].acc_blu +=
-											(qBlue(pcolor) * pweight / 255.0);
-									}
-								}
-							}
-
-						} // end foreach texel
-						cam_ind++;
-
-						if (usesilhouettes) {
-							delete silhouette_buff;
-						}
+	break;
 
-					} // end if(do_project)
-				}
-			} // end foreach camera
-
-			// for each texel.... divide accumulated values by weight and write to texture
-			for (size_t texcount = 0; texcount < texels.size(); texcount++) {
-				if (accums[texcount].weights > 0.0) {
-					float texel_red   = accums[texcount].acc_red / accums[texcount].weights;
-					float texel_green = accums[texcount].acc_grn / accums[texcount].weights;
-					float texel_blue  = accums[texcount].acc_blu / accums[texcount].weights;
-
-					img.setPixel(
-						texels[texcount].texcoord.X(),
-						img.height() - 1 - texels[texcount].texcoord.Y(),
-						qRgba(texel_red * 255.0, texel_green * 255.0, texel_blue * 255.0, 255));
-				}
-				else // if no projected data available, black (to be refilled later on
+		////--------------------------- project multi trivial ----------------------------------
+
+	case FP_MULTIIMAGETRIVIALPROJ: {
+		bool   onselection = par.getBool("onselection");
+		QColor blank       = par.getColor("blankColor");
+
+		// get current model
+		MeshModel* model = md.mm();
+
+		// the mesh has to be correctly transformed before mapping
+		tri::UpdatePosition<CMeshO>::Matrix(model->cm, model->cm.Tr, true);
+		tri::UpdateBounding<CMeshO>::Box(model->cm);
+
+		// accumulate colors and weights of all the cameras
+		const CMeshO&                cm     = model->cm;
+		std::vector<ProjectionAccum> accums = projectActiveRasters(
+			md,
+			par,
+			useGPU,
+			int(cm.vert.size()),
+			[&](int i, Point3m& p, Point3m& n) {
+				if (cm.vert[i].IsD() || (onselection && !cm.vert[i].IsS()))
+					return false;
+				p = cm.vert[i].cP();
+				n = cm.vert[i].cN();
+				return true;
+			},
+			cb);
+
+		int buff_ind = 0;
+		for (vi = model->cm.vert.begin(); vi != model->cm.vert.end(); ++vi) {
+			if (!(*vi).IsD() && (!onselection || (*vi).IsS())) {
+				if (accums[buff_ind].weight !=
+					0) // if 0, it has not found any valid projection on any camera
 				{
-					img.setPixel(
-						texels[texcount].texcoord.X(),
-						img.height() - 1 - texels[texcount].texcoord.Y(),
-						qRgba(0, 0, 0, 0));
+					(*vi).C() = vcg::Color4b(
+						(accums[buff_ind].red / accums[buff_ind].weight) * 255.0,
+						(accums[buff_ind].green / accums[buff_ind].weight) * 255.0,
+						(accums[buff_ind].blue / accums[buff_ind].weight) * 255.0,
+						255);
+				}
+				else {
+					if ((blank.red() != 0) || (blank.green() != 0) || (blank.blue() != 0) ||
+						(blank.alpha() != 0))
+						(*vi).C() = vcg::Color4b(
+							blank.red(), blank.green(), blank.blue(), blank.alpha());
 				}
 			}
+			buff_ind++;
+		}
 
-			// cleaning
-			texels.clear();
-			accums.clear();
+		// the mesh has to return to its original position
+		tri::UpdatePosition<CMeshO>::Matrix(model->cm, Inverse(model->cm.Tr), true);
+		tri::UpdateBounding<CMeshO>::Box(model->cm);
+	} break;
+
+	case FP_MULTIIMAGETRIVIALPROJTEXTURE: {
+		if (!tri::HasPerWedgeTexCoord(md.mm()->cm)) {
+			throw MLException(
+				"Error: nothing have been done. Mesh has no Texture Coordinates.");
+		}
 
-			// PullPush
-			if (dorefill) {
-				cb(85, "Filling texture holes...");
+		// bool onselection = par.getBool("onselection");
+		int     texsize  = par.getInt("texsize");
+		bool    dorefill = par.getBool("dorefill");
+		QString textName = par.getString("textName");
+
+		int textW = texsize;
+		int textH = texsize;
+
+		// get the working model
+		MeshModel* model = md.mm();
+
+		// the mesh has to be correctly transformed before mapping
+		tri::UpdatePosition<CMeshO>::Matrix(model->cm, model->cm.Tr, true);
+		tri::UpdateBounding<CMeshO>::Box(model->cm);
+
+		// texture file name
+		QString filePath(model->fullName());
+		filePath = filePath.left(
+			std::max<int>(filePath.lastIndexOf('\\'), filePath.lastIndexOf('/')) + 1);
+		// Check textName and eventually add .png ext
+		CheckError(textName.length() == 0, "Texture file not specified");
+		CheckError(
+			std::max<int>(textName.lastIndexOf("\\"), textName.lastIndexOf("/")) != -1,
+			"Path in Texture file not allowed");
+		if (!textName.endsWith(".png", Qt::CaseInsensitive))
+			textName.append(".png");
+		filePath.append(textName);
+
+		// Image creation
+		CheckError(textW <= 0, "Texture Width has an incorrect value");
+		CheckError(textH <= 0, "Texture Height has an incorrect value");
+		QImage img(QSize(textW, textH), QImage::Format_ARGB32);
+		img.fill(qRgba(0, 0, 0, 0)); // transparent black
+
+		// Compute (texture-space) border edges
+		if (dorefill) {
+			model->updateDataMask(MeshModel::MM_FACEFACETOPO);
+			tri::UpdateTopology<CMeshO>::FaceFaceFromTexCoord(model->cm);
+			tri::UpdateFlags<CMeshO>::FaceBorderFromFF(model->cm);
+		}
 
-				PullPush(img, qRgba(0, 0, 0, 0)); // atlas gaps
+		// create a list of to-be-filled texels and accumulators
+		// storing texel 2d coords, texel mesh-space point, texel mesh normal
+
+		vector<TexelDesc> texels;
+		texels.clear();
+		texels.reserve(textW * textH); // just to avoid the 2x reallocate rule...
+
+		vector<TexelAccum> accums;
+		accums.clear();
+		accums.reserve(textW * textH); // just to avoid the 2x reallocate rule...
+
+		// Rasterizing triangles in the list of voxels
+		TexFillerSampler tfs(img);
+		tfs.texelspointer = &texels;
+		tfs.accumpointer  = &accums;
+		tfs.InitCallback(cb, model->cm.fn, 0, 80);
+		tri::SurfaceSampling<CMeshO, TexFillerSampler>::Texture(
+			model->cm, tfs, textW, textH, true);
+
+		// Revert alpha values for border edge pixels to 255
+		cb(81, "Cleaning up texture ...");
+		for (int y = 0; y < textH; ++y) {
+			for (int x = 0; x < textW; ++x) {
+				QRgb px = img.pixel(x, y);
+				if (qAlpha(px) < 255 && qAlpha(px) > 0)
+					img.setPixel(x, y, px | 0xff000000);
 			}
+		}
 
-			// Undo topology changes
-			if (dorefill) {
-				tri::UpdateTopology<CMeshO>::FaceFace(model->cm);
-				tri::UpdateFlags<CMeshO>::FaceBorderFromFF(model->cm);
+		// accumulate colors and weights of all the cameras
+		std::vector<ProjectionAccum> texelAccums = projectActiveRasters(
+			md,
+			par,
+			useGPU,
+			int(texels.size()),
+			[&](int i, Point3m& p, Point3m& n) {
+				p = texels[i].meshpoint;
+				n = texels[i].meshnormal;
+				return true;
+			},
+			cb);
+
+		// for each texel.... divide accumulated values by weight and write to texture
+		for (size_t texcount = 0; texcount < texels.size(); texcount++) {
+			if (texelAccums[texcount].weight > 0.0) {
+				float texel_red   = texelAccums[texcount].red / texelAccums[texcount].weight;
+				float texel_green = texelAccums[texcount].green / texelAccums[texcount].weight;
+				float texel_blue  = texelAccums[texcount].blue / texelAccums[texcount].weight;
+
+				img.setPixel(
+					texels[texcount].texcoord.X(),
+					img.height() - 1 - texels[texcount].texcoord.Y(),
+					qRgba(texel_red * 255.0, texel_green * 255.0, texel_blue * 255.0, 255));
 			}
+			else // if no projected data available, black (to be refilled later on
+			{
+				img.setPixel(
+					texels[texcount].texcoord.X(),
+					img.height() - 1 - texels[texcount].texcoord.Y(),
+					qRgba(0, 0, 0, 0));
+			}
+		}
 
-			// Assign texture
-			cb(90, "Assigning texture ...");
-			model->clearTextures();
-			model->addTexture(textName.toStdString(), img);
+		// cleaning
+		texels.clear();
+		accums.clear();
 
-			// the mesh has to return to its original position
-			tri::UpdatePosition<CMeshO>::Matrix(model->cm, Inverse(model->cm.Tr), true);
-			tri::UpdateBounding<CMeshO>::Box(model->cm);
-		} break;
-		default: wrongActionCalled(filter);
+		// PullPush
+		if (dorefill) {
+			cb(85, "Filling texture holes...");
+
+			meshlab::pullPush(img, qRgba(0, 0, 0, 0)); // atlas gaps
 		}
-		return std::map<std::string, QVariant>();
-	}
-	else {
-		throw MLException("Fatal error: glContext not initialized");
+
+		// Undo topology changes
+		if (dorefill) {
+			tri::UpdateTopology<CMeshO>::FaceFace(model->cm);
+			tri::UpdateFlags<CMeshO>::FaceBorderFromFF(model->cm);
+		}
+
+		// Assign texture
+		cb(90, "Assigning texture ...");
+		model->clearTextures();
+		model->addTexture(textName.toStdString(), img);
+
+		// the mesh has to return to its original position
+		tri::UpdatePosition<CMeshO>::Matrix(model->cm, Inverse(model->cm.Tr), true);
+		tri::UpdateBounding<CMeshO>::Box(model->cm);
+	} break;
+	default: wrongActionCalled(filter);
 	}
+	return std::map<std::string, QVariant>();
 }
 
 FilterColorProjectionPlugin::FilterClass
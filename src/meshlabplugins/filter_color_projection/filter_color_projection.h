@@ -26,6 +26,7 @@
 
 #include <QObject>
 #include <common/plugins/interfaces/filter_plugin.h>
+#include <common/utilities/depth_map_cache.h>
 
 class FilterColorProjectionPlugin : public QObject, public FilterPlugin
 {
@@ -48,11 +49,34 @@ class FilterColorProjectionPlugin : public QObject, public FilterPlugin
 	RichParameterList initParameterList(const QAction*, const MeshDocument &/*m*/);
 	int getRequirements(const QAction*);
 	bool requiresGLContext(const QAction* action) const;
+	bool canRunWithoutGLContext(const QAction* action) const;
 	std::map<std::string, QVariant> applyFilter(const QAction* action, const RichParameterList & /*parent*/, MeshDocument &md, unsigned int& postConditionMask, vcg::CallBackPos * cb);
 
 	FilterArity filterArity(const QAction *) const {return SINGLE_MESH;}
 private:
+	// color and weight accumulated on a vertex or texel by the multi-image projections
+	struct ProjectionAccum
+	{
+		double weight = 0, red = 0, green = 0, blue = 0;
+	};
+	// the same, summed separately by each projecting thread; single precision
+	// halves the memory of the per-thread copies
+	struct ThreadAccum
+	{
+		float weight = 0, red = 0, green = 0, blue = 0;
+	};
+
 	int calculateNearFarAccurate(MeshDocument &md, std::vector<float> *near, std::vector<float> *far);
+	template <class SampleFn>
+	std::vector<ProjectionAccum> projectActiveRasters(
+		MeshDocument&            md,
+		const RichParameterList& par,
+		bool                     useGPU,
+		int                      nSamples,
+		SampleFn                 sample,
+		vcg::CallBackPos*        cb);
+
+	meshlab::DepthMapCache depthMapCache; // depth maps rendered on the CPU, kept between runs
 };
 
 #endif
@@ -341,6 +341,31 @@ void RenderHelper::renderScene(const Shotm &view, MeshModel *mesh, RenderingMode
 }
 
 
+void RenderHelper::setDepthMap(const meshlab::DepthMap& map)
+{
+  if(depth != NULL)  delete depth;
+
+  depth = new floatbuffer();
+  depth->init(map.width, map.height);
+
+  // depth in world units, 0 where the mesh is not seen
+  mindepth =  1000000;
+  maxdepth = -1000000;
+  for(int pixit = 0; pixit<map.width*map.height; pixit++)
+  {
+    if (std::isinf(map.depth[pixit]))
+      depth->data[pixit] = 0;
+    else
+      depth->data[pixit] = map.depth[pixit];
+
+    if(depth->data[pixit] > maxdepth)
+      maxdepth = depth->data[pixit];
+    if(depth->data[pixit] < mindepth)
+      mindepth = depth->data[pixit];
+  }
+}
+
+
 //-------------------------------------------------------------------------------------------------------
 //-------------------------------------------------------------------------------------------------------
 
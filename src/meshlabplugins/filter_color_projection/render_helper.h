@@ -30,6 +30,8 @@
 #include <wrap/gl/shot.h>
 #include <wrap/callback.h>
 
+#include <common/utilities/depth_map_cache.h>
+
 #include "floatbuffer.h"
 
 class QGLFramebufferObject;
@@ -65,6 +67,9 @@ class RenderHelper {
   // draw & readback
   void renderScene(const Shotm& view, MeshModel *mesh, RenderingMode mode, MLPluginGLContext* plugcontext, float camNear = 0, float camFar = 0);
 
+  // fills depth as renderScene does, from a depth map rendered on the CPU
+  void setDepthMap(const meshlab::DepthMap& map);
+
  private:
 
   GLuint createShaderFromFiles(QString basename); // converted into shader/basename.vert .frag
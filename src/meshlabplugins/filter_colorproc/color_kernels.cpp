@@ -0,0 +1,240 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2007                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "color_kernels.h"
+
+#include <algorithm>
+#include <ctime>
+#include <vector>
+
+#include <vcg/complex/algorithms/stat.h>
+#include <vcg/complex/algorithms/update/color.h>
+#include <vcg/math/perlin_noise.h>
+#include <vcg/math/random_generator.h>
+
+using namespace vcg;
+
+namespace colorproc {
+
+namespace {
+
+typedef tri::UpdateColor<CMeshO> UpdateColor;
+
+inline bool toProcess(const CVertexO& v, bool selected)
+{
+	return !v.IsD() && (!selected || v.IsS());
+}
+
+/* Calls f on each vertex to process, in parallel */
+template<class Function>
+void forEachVertex(CMeshO& m, bool selected, Function f)
+{
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < (int) m.vert.size(); ++i)
+		if (toProcess(m.vert[i], selected))
+			f(m.vert[i]);
+}
+
+inline float lightness(const Color4b& c)
+{
+	return (float(std::min({c[0], c[1], c[2]})) + float(std::max({c[0], c[1], c[2]}))) / 2;
+}
+
+/* Histograms of r, g, b and of the rounded lightness */
+struct ColorHistograms
+{
+	std::array<std::array<long long, 256>, 4> count {};
+
+	void add(const Color4b& c)
+	{
+		for (int k = 0; k < 3; ++k)
+			count[k][c[k]]++;
+		count[3][int(lightness(c) + 0.5f)]++;
+	}
+
+	void merge(const ColorHistograms& h)
+	{
+		for (int k = 0; k < 4; ++k)
+			for (int i = 0; i < 256; ++i)
+				count[k][i] += h.count[k][i];
+	}
+};
+
+/* Lookup table mapping each value to its position in the cumulative
+ * distribution, rescaled in [0, 255] */
+std::array<unsigned char, 256> equalizationTable(const std::array<long long, 256>& hist)
+{
+	std::array<long long, 256> cdf;
+	cdf[0] = hist[0];
+	for (int i = 1; i < 256; ++i)
+		cdf[i] = cdf[i - 1] + hist[i];
+
+	std::array<unsigned char, 256> table;
+	for (int i = 0; i < 256; ++i) {
+		if (cdf[255] == cdf[0])
+			table[i] = i;
+		else
+			table[i] = (unsigned char) (float(cdf[i] - cdf[0]) / float(cdf[255] - cdf[0]) * 255.0f);
+	}
+	return table;
+}
+
+} // namespace
+
+ChannelLut tabulate(const std::function<void(CMeshO&)>& kernel)
+{
+	CMeshO palette;
+	tri::Allocator<CMeshO>::AddVertices(palette, 256);
+	for (int i = 0; i < 256; ++i)
+		palette.vert[i].C() = Color4b(i, i, i, i);
+	kernel(palette);
+
+	ChannelLut lut;
+	for (int i = 0; i < 256; ++i)
+		for (int k = 0; k < 4; ++k)
+			lut[k][i] = palette.vert[i].C()[k];
+	return lut;
+}
+
+void applyLut(CMeshO& m, const ChannelLut& lut, bool selected)
+{
+	forEachVertex(m, selected, [&](CVertexO& v) {
+		Color4b& c = v.C();
+		c          = Color4b(lut[0][c[0]], lut[1][c[1]], lut[2][c[2]], lut[3][c[3]]);
+	});
+}
+
+void thresholding(CMeshO& m, Scalarm threshold, Color4b c1, Color4b c2, bool selected)
+{
+	forEachVertex(m, selected, [&](CVertexO& v) {
+		v.C() = lightness(v.C()) <= threshold ? c1 : c2;
+	});
+}
+
+void desaturation(CMeshO& m, int method, bool selected)
+{
+	forEachVertex(m, selected, [&](CVertexO& v) {
+		const Color4b& c = v.C();
+		int            gray;
+		switch (method) {
+		case 1: gray = int(0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2]); break;
+		case 2: gray = int(float(c[0] + c[1] + c[2]) / 3.0f); break;
+		default: gray = int(lightness(c));
+		}
+		v.C() = Color4b(gray, gray, gray, 255);
+	});
+}
+
+void equalize(CMeshO& m, unsigned char rgbMask, bool selected)
+{
+	ColorHistograms hist;
+#pragma omp parallel
+	{
+		ColorHistograms threadHist;
+#pragma omp for schedule(static) nowait
+		for (int i = 0; i < (int) m.vert.size(); ++i)
+			if (toProcess(m.vert[i], selected))
+				threadHist.add(m.vert[i].C());
+#pragma omp critical(colorprocEqualize)
+		hist.merge(threadHist);
+	}
+
+	if (rgbMask == UpdateColor::NO_CHANNELS) {
+		// equalization of the lightness, giving gray colors
+		std::array<unsigned char, 256> table = equalizationTable(hist.count[3]);
+		forEachVertex(m, selected, [&](CVertexO& v) {
+			unsigned char gray = table[int(lightness(v.C()) + 0.5f)];
+			v.C()              = Color4b(gray, gray, gray, 255);
+		});
+		return;
+	}
+
+	ChannelLut lut;
+	const unsigned char channels[3] = {
+		UpdateColor::RED_CHANNEL, UpdateColor::GREEN_CHANNEL, UpdateColor::BLUE_CHANNEL};
+	for (int k = 0; k < 3; ++k) {
+		if (rgbMask & channels[k]) {
+			lut[k] = equalizationTable(hist.count[k]);
+		}
+		else {
+			for (int i = 0; i < 256; ++i)
+				lut[k][i] = i;
+		}
+	}
+	lut[3].fill(255);
+	applyLut(m, lut, selected);
+}
+
+void perlinColoring(
+	CMeshO&        m,
+	Scalarm        period,
+	const Point3m& offset,
+	Color4b        c1,
+	Color4b        c2,
+	bool           selected)
+{
+	forEachVertex(m, selected, [&](CVertexO& v) {
+		Point3m p      = (v.P() / period) + offset;
+		double  factor = (math::Perlin::Noise(p[0], p[1], p[2]) + 1.0) / 2.0;
+		int     ch[4];
+		for (int k = 0; k < 4; ++k)
+			ch[k] = int((c1[k] * factor) + (c2[k] * (1.0 - factor)));
+		v.C() = Color4b(ch[0], ch[1], ch[2], ch[3]);
+	});
+}
+
+void addNoise(CMeshO& m, int noiseBits, bool selected)
+{
+	noiseBits = std::min(noiseBits, 8);
+	if (noiseBits < 1)
+		return;
+	const int          range     = 1 << noiseBits;
+	const int          blockSize = 1 << 16;
+	const int          nBlocks   = ((int) m.vert.size() + blockSize - 1) / blockSize;
+	const unsigned int seed      = (unsigned int) time(NULL);
+
+#pragma omp parallel for schedule(static)
+	for (int b = 0; b < nBlocks; ++b) {
+		math::SubtractiveRingRNG rnd(seed + b);
+		int end = std::min((int) m.vert.size(), (b + 1) * blockSize);
+		for (int i = b * blockSize; i < end; ++i) {
+			CVertexO& v = m.vert[i];
+			if (!toProcess(v, selected))
+				continue;
+			for (int k = 0; k < 3; ++k)
+				v.C()[k] = math::Clamp<int>(v.C()[k] + rnd.generate(2 * range) - range, 0, 255);
+		}
+	}
+}
+
+void qualityRamp(CMeshO& m, Scalarm minq, Scalarm maxq)
+{
+	if (minq == maxq) {
+		std::pair<Scalarm, Scalarm> minmax = tri::Stat<CMeshO>::ComputePerVertexQualityMinMax(m);
+		minq = minmax.first;
+		maxq = minmax.second;
+	}
+	forEachVertex(m, false, [&](CVertexO& v) { v.C().SetColorRamp(minq, maxq, v.Q()); });
+}
+
+} // namespace colorproc
@@ -0,0 +1,90 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2007                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef FILTERCOLORPROC_COLOR_KERNELS_H
+#define FILTERCOLORPROC_COLOR_KERNELS_H
+
+#include <array>
+#include <functional>
+
+#include <common/ml_document/cmesh.h>
+
+/*
+ * Per-vertex color kernels that work on ranges of vertices in parallel.
+ *
+ * The transforms that act on each channel separately (gamma, brightness and
+ * contrast, levels, colourisation, white balance, invert...) are evaluated
+ * once for each of the 256 values of a channel and applied to the vertices
+ * through a lookup table; the table is obtained by running the vcg kernel
+ * on a small palette mesh, so the result is exactly the one of the kernel.
+ * All the functions skip the deleted vertices and, if selected is true, the
+ * unselected ones.
+ */
+namespace colorproc {
+
+/** For each channel (r, g, b, a), the new value of each old value */
+typedef std::array<std::array<unsigned char, 256>, 4> ChannelLut;
+
+/**
+ * Tabulates a per-channel transform by calling kernel on a mesh that has a
+ * vertex for each gray level (v, v, v, v); kernel must transform all the
+ * vertices of the mesh it is given.
+ */
+ChannelLut tabulate(const std::function<void(CMeshO&)>& kernel);
+
+void applyLut(CMeshO& m, const ChannelLut& lut, bool selected);
+
+/** c1 where the lightness is at most threshold, c2 elsewhere */
+void thresholding(CMeshO& m, Scalarm threshold, Color4b c1, Color4b c2, bool selected);
+
+/** method: 0 lightness, 1 luminosity, 2 average */
+void desaturation(CMeshO& m, int method, bool selected);
+
+/**
+ * Equalizes the histogram of the channels in rgbMask (a mask of
+ * vcg::tri::UpdateColor channels), or of the lightness if the mask is empty;
+ * the histograms are built concurrently.
+ */
+void equalize(CMeshO& m, unsigned char rgbMask, bool selected);
+
+void perlinColoring(
+	CMeshO&        m,
+	Scalarm        period,
+	const Point3m& offset,
+	Color4b        c1,
+	Color4b        c2,
+	bool           selected);
+
+/**
+ * Adds to each rgb channel a random offset in [-2^noiseBits, 2^noiseBits);
+ * every block of vertices has its own generator, so the threads do not share
+ * any state.
+ */
+void addNoise(CMeshO& m, int noiseBits, bool selected);
+
+/** Same as UpdateColor::PerVertexQualityRamp */
+void qualityRamp(CMeshO& m, Scalarm minq, Scalarm maxq);
+
+} // namespace colorproc
+
+#endif // FILTERCOLORPROC_COLOR_KERNELS_H
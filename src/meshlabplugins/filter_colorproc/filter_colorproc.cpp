@@ -23,6 +23,7 @@
 
 #include <vcg/space/colorspace.h>
 #include "filter_colorproc.h"
+#include "color_kernels.h"
 
 #include <vcg/complex/algorithms/clean.h>
 #include <vcg/complex/algorithms/stat.h>
@@ -32,6 +33,7 @@
 #include <vcg/complex/algorithms/parametrization/distortion.h>
 #include <vcg/space/fitting3.h>
 #include <vcg/math/random_generator.h>
+#include <common/utilities/connected_components.h>
 
 #include <stdlib.h>
 #include <time.h>
@@ -449,7 +451,7 @@ std::map<std::string, QVariant> FilterColorProc::applyFilter(const QAction *filt
 			Color4b c2 = Color4b(temp.red(), temp.green(), temp.blue(), temp.alpha());
 			bool selected = par.getBool("onSelected");
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexThresholding(m->cm, threshold, c1, c2, selected);
+			colorproc::thresholding(m->cm, threshold, c1, c2, selected);
 			break;
 		}
 
@@ -460,8 +462,11 @@ std::map<std::string, QVariant> FilterColorProc::applyFilter(const QAction *filt
 			Scalarm gamma = math::Clamp<Scalarm>(par.getDynamicFloat("gamma"), 0.1, 5.0);
 			bool selected = par.getBool("onSelected");
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexGamma(m->cm, gamma, selected);
-			vcg::tri::UpdateColor<CMeshO>::PerVertexBrightnessContrast(m->cm, brightness/256.0,contrast/256.0 , selected);
+			colorproc::ChannelLut lut = colorproc::tabulate([&](CMeshO& palette) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexGamma(palette, gamma, false);
+				vcg::tri::UpdateColor<CMeshO>::PerVertexBrightnessContrast(palette, brightness/256.0,contrast/256.0, false);
+			});
+			colorproc::applyLut(m->cm, lut, selected);
 			break;
 		}
 
@@ -469,7 +474,10 @@ std::map<std::string, QVariant> FilterColorProc::applyFilter(const QAction *filt
 		{
 			bool selected = par.getBool("onSelected");
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexInvert(m->cm, selected);
+			colorproc::ChannelLut lut = colorproc::tabulate([](CMeshO& palette) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexInvert(palette, false);
+			});
+			colorproc::applyLut(m->cm, lut, selected);
 			break;
 		}
 
@@ -491,13 +499,16 @@ std::map<std::string, QVariant> FilterColorProc::applyFilter(const QAction *filt
 			//if no channels are checked, we intend to work on all rgb channels, so...
 			if(rgbMask == vcg::tri::UpdateColor<CMeshO>::NO_CHANNELS) rgbMask = vcg::tri::UpdateColor<CMeshO>::ALL_CHANNELS;
 
+			colorproc::ChannelLut lut = colorproc::tabulate([&](CMeshO& palette) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexLevels(palette, gamma, in_min, in_max, out_min, out_max, rgbMask, false);
+			});
 			if (all_levels) {
 				for(MeshModel& mm: md.meshIterator())
 					if (mm.isVisible())
-						vcg::tri::UpdateColor<CMeshO>::PerVertexLevels(mm.cm, gamma, in_min, in_max, out_min, out_max, rgbMask, selected);
+						colorproc::applyLut(mm.cm, lut, selected);
 			}
 			else {
-				vcg::tri::UpdateColor<CMeshO>::PerVertexLevels(m->cm, gamma, in_min, in_max, out_min, out_max, rgbMask, selected);
+				colorproc::applyLut(m->cm, lut, selected);
 			}
 			break;
 		}
@@ -515,7 +526,10 @@ std::map<std::string, QVariant> FilterColorProc::applyFilter(const QAction *filt
 			ColorSpace<unsigned char>::HSLtoRGB( (double)hue, (double)saturation, (double)luminance, r, g, b);
 			Color4b color = Color4b((int)(r*255), (int)(g*255), (int)(b*255), 255);
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexColourisation(m->cm, color, intensity, selected);
+			colorproc::ChannelLut lut = colorproc::tabulate([&](CMeshO& palette) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexColourisation(palette, color, intensity, false);
+			});
+			colorproc::applyLut(m->cm, lut, selected);
 			break;
 		}
 
@@ -524,7 +538,7 @@ std::map<std::string, QVariant> FilterColorProc::applyFilter(const QAction *filt
 			int method = par.getEnum("method");
 			bool selected = par.getBool("onSelected");
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexDesaturation(m->cm, method, selected);
+			colorproc::desaturation(m->cm, method, selected);
 			break;
 		}
 
@@ -537,7 +551,7 @@ std::map<std::string, QVariant> FilterColorProc::applyFilter(const QAction *filt
 			if(par.getBool("bCh")) rgbMask = rgbMask | vcg::tri::UpdateColor<CMeshO>::BLUE_CHANNEL;
 			bool selected = par.getBool("onSelected");
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexEqualize(m->cm, rgbMask, selected);
+			colorproc::equalize(m->cm, rgbMask, selected);
 			break;
 		}
 
@@ -547,7 +561,10 @@ std::map<std::string, QVariant> FilterColorProc::applyFilter(const QAction *filt
 			Color4b color = Color4b(tempColor.red(),tempColor.green(),tempColor.blue(), 255);
 			bool selected = par.getBool("onSelected");
 
-			vcg::tri::UpdateColor<CMeshO>::PerVertexWhiteBalance(m->cm, color, selected);
+			colorproc::ChannelLut lut = colorproc::tabulate([&](CMeshO& palette) {
+				vcg::tri::UpdateColor<CMeshO>::PerVertexWhiteBalance(palette, color, false);
+			});
+			colorproc::applyLut(m->cm, lut, selected);
 			break;
 		}
 
@@ -579,7 +596,7 @@ std::map<std::string, QVariant> FilterColorProc::applyFilter(const QAction *filt
 			Point3m offset = par.getPoint3m("offset");
 			bool selected = par.getBool("onSelected");
 
-			tri::UpdateColor<CMeshO>::PerVertexPerlinColoring(m->cm, period, offset, c1, c2, selected);
+			colorproc::perlinColoring(m->cm, period, offset, c1, c2, selected);
 			break;
 		}
 
@@ -588,7 +605,7 @@ std::map<std::string, QVariant> FilterColorProc::applyFilter(const QAction *filt
 			int noiseBits = par.getInt("noiseBits");
 			bool selected = par.getBool("onSelected");
 
-			tri::UpdateColor<CMeshO>::PerVertexAddNoise(m->cm, noiseBits, selected);
+			colorproc::addNoise(m->cm, noiseBits, selected);
 			break;
 		}
 
@@ -631,11 +648,11 @@ std::map<std::string, QVariant> FilterColorProc::applyFilter(const QAction *filt
 
 			if (usePerc)
 			{
-				tri::UpdateColor<CMeshO>::PerVertexQualityRamp(m->cm, PercLo, PercHi);
+				colorproc::qualityRamp(m->cm, PercLo, PercHi);
 				log("Quality Range: %f %f; Used (%f %f) percentile (%f %f) ", H.MinV(), H.MaxV(), PercLo, PercHi, par.getDynamicFloat("perc"), 100 - par.getDynamicFloat("perc"));
 			}
 			else {
-				tri::UpdateColor<CMeshO>::PerVertexQualityRamp(m->cm, RangeMin, RangeMax);
+				colorproc::qualityRamp(m->cm, RangeMin, RangeMax);
 				log("Quality Range: %f %f; Used (%f %f)", H.MinV(), H.MaxV(), RangeMin, RangeMax);
 			}
 			break;
@@ -869,9 +886,17 @@ std::map<std::string, QVariant> FilterColorProc::applyFilter(const QAction *filt
 
 		case CP_RANDOM_CONNECTED_COMPONENT:
 		{
-			m->updateDataMask(MeshModel::MM_FACEFACETOPO);
-			m->updateDataMask(MeshModel::MM_FACEMARK | MeshModel::MM_FACECOLOR);
-			vcg::tri::UpdateColor<CMeshO>::PerFaceRandomConnectedComponent(m->cm);
+			m->updateDataMask(MeshModel::MM_FACECOLOR);
+			meshlab::ConnectedComponents cc = meshlab::connectedComponents(m->cm);
+			// same colors of UpdateColor::PerFaceRandomConnectedComponent
+			int scatterSize = std::min(100, (int) cc.size());
+			std::vector<Color4b> ccColor(cc.size());
+			for (size_t i = 0; i < cc.size(); ++i)
+				ccColor[i] = Color4b::Scatter(scatterSize, i % scatterSize, .4f, .7f);
+#pragma omp parallel for
+			for (int i = 0; i < (int) m->cm.face.size(); ++i)
+				if (cc.faceComponent[i] >= 0)
+					m->cm.face[i].C() = ccColor[cc.faceComponent[i]];
 			break;
 		}
 
@@ -23,13 +23,22 @@
 
 #include "dirt_utils.h"
 
+/**
+Seed of the random stream of a block of faces or particles: the blocks are
+processed concurrently, and the result depends only on the seed and not on the
+number of threads
+*/
+static int StreamSeed(unsigned int seed,int block){
+    return int(seed*2654435761u+unsigned(block));
+}
+
 /**
 Return a random direction
 */
 
-CMeshO::CoordType getRandomDirection(){
+CMeshO::CoordType getRandomDirection(math::RandomGenerator &rnd){
     CMeshO::CoordType dir;
-    dir = Point3m(rand()/Scalarm(RAND_MAX),rand()/Scalarm(RAND_MAX),rand()/Scalarm(RAND_MAX))-Point3m(0.5f,0.5f,0.5f);
+    dir = Point3m(rnd.generate01(),rnd.generate01(),rnd.generate01())-Point3m(0.5f,0.5f,0.5f);
     dir = dir * 0.3f;
     return dir;
 }
@@ -83,8 +92,12 @@ Scalarm GetVelocity(CMeshO::CoordType o_p,CMeshO::CoordType n_p,CMeshO::FacePoin
 @return a triple of barycentric coordinates
 */
 CMeshO::CoordType RandomBaricentric(){
-    CMeshO::CoordType interp;
     static math::MarsenneTwisterRNG rnd;
+    return RandomBaricentric(rnd);
+}
+
+CMeshO::CoordType RandomBaricentric(math::RandomGenerator &rnd){
+    CMeshO::CoordType interp;
     interp[1] = rnd.generate01();
     interp[2] = rnd.generate01();
 
@@ -271,11 +284,12 @@ void ColorizeMesh(MeshModel* m){
 @param Facepointer f - pointer to the face
 @param CoordType int_point - intersection point this is a return parameter for the function.
 @param FacePointer face - pointer to the new face
+@param RandomGenerator rnd - random stream of the calling thread
 
 @return the intersection edge index if there is an intersection -1 elsewhere
 Step
 */
-int ComputeIntersection(CMeshO::CoordType /*p1*/,CMeshO::CoordType p2,CMeshO::FacePointer &f,CMeshO::FacePointer &new_f,CMeshO::CoordType &int_point){
+int ComputeIntersection(CMeshO::CoordType /*p1*/,CMeshO::CoordType p2,CMeshO::FacePointer &f,CMeshO::FacePointer &new_f,CMeshO::CoordType &int_point,math::RandomGenerator &rnd){
 
     CMeshO::CoordType v0=f->V(0)->P();
     CMeshO::CoordType v1=f->V(1)->P();
@@ -313,7 +327,7 @@ int ComputeIntersection(CMeshO::CoordType /*p1*/,CMeshO::CoordType p2,CMeshO::Fa
             n_face++;
         }
         if(n_face!=0){
-            int r=(rand()%(n_face-1))+2;
+            int r=(rnd.generate(n_face-1))+2;
             for(int i=0;i<r;i++){
                 p.FlipE();
                 p.FlipF();
@@ -350,85 +364,74 @@ void ComputeNormalDustAmount(MeshModel* m,CMeshO::CoordType u,Scalarm k,Scalarm
 @param  MeshModel* m - Pointer to the new mesh
 @param int r - scaling factor
 @param int n_ray - number of rays emitted
+@param unsigned int seed - seed of the random ray origins
 
 @return nothing
 */
-void ComputeSurfaceExposure(MeshModel* m, int /*r*/, int n_ray){
+void ComputeSurfaceExposure(MeshModel* m, int /*r*/, int n_ray, unsigned int seed){
 
     CMeshO::PerFaceAttributeHandle<Scalarm> eh=vcg::tri::Allocator<CMeshO>::AddPerFaceAttribute<Scalarm>(m->cm,std::string("exposure"));
 
-	Scalarm dh = Scalarm(1.2);
-	Scalarm exp = Scalarm(0);
-	Scalarm di = Scalarm(0);
-	Scalarm xi = Scalarm(0);
-
-//    CMeshO::FacePointer face;
-    CMeshO::CoordType p_c;
-    MetroMeshFaceGrid f_grid;
-    f_grid.Set(m->cm.face.begin(),m->cm.face.end());
-    MarkerFace markerFunctor;
-    markerFunctor.SetMesh(&(m->cm));
-    RayTriangleIntersectionFunctor<false> RSectFunct;
-    CMeshO::FaceIterator fi;
-    for(fi=m->cm.face.begin();fi!=m->cm.face.end();++fi){
-        xi=0;
-        eh[fi]=0;
-
-        for(int i=0;i<n_ray;i++){
-            //For every f_face  get the central point
-            p_c=fromBarCoords(RandomBaricentric(),&*fi);
-            //Create a ray with p_c as origin and direction N
-            p_c=p_c+TriangleNormal(*fi).Normalize()*0.1f;
-            Ray3<Scalarm> ray=Ray3<Scalarm>(p_c,fi->N());
-            di=0;
-//            face=0;
-            /*face=*/f_grid.DoRay<RayTriangleIntersectionFunctor<false>,MarkerFace>(RSectFunct,markerFunctor,ray,1000,di);
-
-            if(di!=0){
-                xi=xi+(dh/(dh-di));
-
+    const Scalarm dh = Scalarm(1.2);
+    std::shared_ptr<const meshlab::FaceBvh> bvhPtr = m->faceBvh();
+    const meshlab::FaceBvh& bvh = *bvhPtr;
+
+    const int faceNum = int(m->cm.face.size());
+    const int blockSize = 1024;
+    const int blockNum = (faceNum+blockSize-1)/blockSize;
+#pragma omp parallel for schedule(dynamic)
+    for(int b=0;b<blockNum;b++){
+        math::SubtractiveRingRNG rnd(StreamSeed(seed,b));
+        const int end=std::min(faceNum,(b+1)*blockSize);
+        for(int i=b*blockSize;i<end;i++){
+            CMeshO::FaceType &f=m->cm.face[i];
+            if(f.IsD()) continue;
+            Scalarm xi=0;
+            for(int k=0;k<n_ray;k++){
+                //For every face get a random point
+                Point3m p_c=fromBarCoords(RandomBaricentric(rnd),&f);
+                //Create a ray with p_c as origin and direction N
+                p_c=p_c+TriangleNormal(f).Normalize()*0.1f;
+                int hitFace;
+                Scalarm di;
+                if(bvh.firstHit(p_c,f.N(),0,1000,-1,i,hitFace,di) && di!=0)
+                    xi=xi+(dh/(dh-di));
             }
+            eh[i]=1-(xi/n_ray);
         }
-        exp=1-(xi/n_ray);
-        eh[fi]=exp;
-
     }
 }
 
 
-void ComputeParticlesFallsPosition(MeshModel* base_mesh,MeshModel* cloud_mesh,CMeshO::CoordType dir){
-    CMeshO::VertexIterator vi;
-    MetroMeshFaceGrid f_grid;
-    f_grid.Set(base_mesh->cm.face.begin(),base_mesh->cm.face.end());
-    MarkerFace markerFunctor;
-    markerFunctor.SetMesh(&(base_mesh->cm));
-    RayTriangleIntersectionFunctor<false> RSectFunct;
+void ComputeParticlesFallsPosition(MeshModel* base_mesh,const meshlab::FaceBvh &bvh,MeshModel* cloud_mesh,CMeshO::CoordType dir){
     CMeshO::PerVertexAttributeHandle<Particle<CMeshO> > ph= tri::Allocator<CMeshO>::GetPerVertexAttribute<Particle<CMeshO> >(cloud_mesh->cm,"ParticleInfo");
-    std::vector<CMeshO::VertexPointer> ToDelVec;
-    for(vi=cloud_mesh->cm.vert.begin();vi!=cloud_mesh->cm.vert.end();++vi){
-        Particle<CMeshO> info=ph[vi];
-        if((*vi).IsS()){
-            Point3m p_c=vi->P()+info.face->N().normalized()*0.1f;
-            Ray3<Scalarm> ray=Ray3<Scalarm>(p_c,dir);
-            Scalarm di;
-            CMeshO::FacePointer new_f=f_grid.DoRay<RayTriangleIntersectionFunctor<false>,MarkerFace>(RSectFunct,markerFunctor,ray,base_mesh->cm.bbox.Diag(),di);
-            if(new_f!=0){
-                ph[vi].face=new_f;
-                Scalarm u;
-                Scalarm v;
-                Scalarm t;
-                IntersectionRayTriangle<Scalarm>(ray,new_f->P(0),new_f->P(1),new_f->P(2),t,u,v);
-                Point3m bc(1-u-v,u,v);
-                vi->P()=fromBarCoords(bc,new_f);
-                vi->ClearS();
-                new_f->C()=Color4b::Red;
-            }else{
-                ToDelVec.push_back(&*vi);
-            }
+    const int vertNum=int(cloud_mesh->cm.vert.size());
+    const Scalarm maxDist=base_mesh->cm.bbox.Diag();
+    Point3m d=dir;
+    d.Normalize();
+
+    //The falls are traced concurrently, the hit faces are colored and the lost
+    //particles deleted afterwards
+    std::vector<int> hitFace(vertNum,-1);
+    std::vector<char> lost(vertNum,0);
+#pragma omp parallel for schedule(dynamic,256)
+    for(int i=0;i<vertNum;i++){
+        CMeshO::VertexType &v=cloud_mesh->cm.vert[i];
+        if(v.IsD() || !v.IsS()) continue;
+        Point3m p_c=v.P()+ph[i].face->N().normalized()*0.1f;
+        Scalarm t;
+        if(bvh.firstHit(p_c,d,0,maxDist,-1,-1,hitFace[i],t)){
+            ph[i].face=&base_mesh->cm.face[hitFace[i]];
+            v.P()=p_c+d*t;
+            v.ClearS();
+        }else{
+            hitFace[i]=-1;
+            lost[i]=1;
         }
     }
-    for(unsigned int i=0;i<ToDelVec.size();i++){
-        if(!ToDelVec[i]->IsD()) Allocator<CMeshO>::DeleteVertex(cloud_mesh->cm,*ToDelVec[i]);
+    for(int i=0;i<vertNum;i++){
+        if(hitFace[i]>=0) base_mesh->cm.face[hitFace[i]].C()=Color4b::Red;
+        if(lost[i]) Allocator<CMeshO>::DeleteVertex(cloud_mesh->cm,cloud_mesh->cm.vert[i]);
     }
 }
 
@@ -487,10 +490,9 @@ bool GenerateParticles(MeshModel* m,std::vector<CMeshO::CoordType> &cpv,/*std::v
 
 */
 void associateParticles(MeshModel* b_m,MeshModel* c_m,Scalarm &m,Scalarm &v,CMeshO::CoordType g){
-    MetroMeshFaceGrid   unifGridFace;
     Point3m closestPt;
     CMeshO::PerVertexAttributeHandle<Particle<CMeshO> > ph= tri::Allocator<CMeshO>::AddPerVertexAttribute<Particle<CMeshO> > (c_m->cm,std::string("ParticleInfo"));
-    unifGridFace.Set(b_m->cm.face.begin(),b_m->cm.face.end());
+    std::shared_ptr<MetroMeshFaceGrid> unifGridFace = b_m->faceGrid();
     MarkerFace markerFunctor;
     markerFunctor.SetMesh(&(b_m->cm));
     Scalarm dist=1;
@@ -499,7 +501,7 @@ void associateParticles(MeshModel* b_m,MeshModel* c_m,Scalarm &m,Scalarm &v,CMes
     vcg::face::PointDistanceBaseFunctor<CMeshO::ScalarType> PDistFunct;
     for(vi=c_m->cm.vert.begin();vi!=c_m->cm.vert.end();++vi){
         Particle<CMeshO>* part = new Particle<CMeshO>();
-        CMeshO::FacePointer f=unifGridFace.GetClosest(PDistFunct,markerFunctor,vi->P(),dist_upper_bound,dist,closestPt);
+        CMeshO::FacePointer f=unifGridFace->GetClosest(PDistFunct,markerFunctor,vi->P(),dist_upper_bound,dist,closestPt);
         part->face=f;
         part->face->Q()=part->face->Q()+1;
         part->mass=m;
@@ -545,9 +547,10 @@ void prepareMesh(MeshModel* m){
 
     //clean Mesh
     tri::Allocator<CMeshO>::CompactFaceVector(m->cm);
-    tri::Clean<CMeshO>::RemoveUnreferencedVertex(m->cm);
-    tri::Clean<CMeshO>::RemoveDuplicateVertex(m->cm);
+    int removed = tri::Clean<CMeshO>::RemoveUnreferencedVertex(m->cm);
+    removed += tri::Clean<CMeshO>::RemoveDuplicateVertex(m->cm);
     tri::Allocator<CMeshO>::CompactVertexVector(m->cm);
+    if(removed>0) m->setGeometryChanged();
 
     tri::UpdateFlags<CMeshO>::FaceClear(m->cm);
     //update Mesh
@@ -565,14 +568,17 @@ void prepareMesh(MeshModel* m){
 
 /**
 @def This function move a particle over the mesh
+
+If crossings is not null the base mesh is left untouched and the crossed faces
+are appended to it, so that many particles can be moved concurrently.
 */
-void MoveParticle(Particle<CMeshO> &info,CMeshO::VertexPointer p,Scalarm l,int t,Point3m dir,Point3m g,Scalarm a){
+void MoveParticle(Particle<CMeshO> &info,CMeshO::VertexPointer p,Scalarm l,int t,Point3m dir,Point3m g,Scalarm a,math::RandomGenerator &rnd,std::vector<FaceCrossing> *crossings){
     if(CheckFallPosition(info.face,g,a)){
         p->SetS();
         return;
     }
     Scalarm time=t;
-    if(dir.Norm()==0) dir=getRandomDirection();
+    if(dir.Norm()==0) dir=getRandomDirection(rnd);
     Point3m new_pos;
     Point3m current_pos;
     Point3m int_pos;
@@ -582,7 +588,7 @@ void MoveParticle(Particle<CMeshO> &info,CMeshO::VertexPointer p,Scalarm l,int t
     current_pos=p->P();
     new_pos=StepForward(current_pos,info.v,info.mass,current_face,g+dir,l,time);
     while(!IsOnFace(new_pos,current_face)){
-        int edge=ComputeIntersection(current_pos,new_pos,current_face,new_face,int_pos);
+        int edge=ComputeIntersection(current_pos,new_pos,current_face,new_face,int_pos,rnd);
         if(edge!=-1){
 //            Point3m n = new_face->N();
             if(CheckFallPosition(new_face,g,a))  p->SetS();
@@ -590,14 +596,16 @@ void MoveParticle(Particle<CMeshO> &info,CMeshO::VertexPointer p,Scalarm l,int t
             info.v=GetNewVelocity(info.v,current_face,new_face,g+dir,g,info.mass,elapsed_time);
             time=time-elapsed_time;
             current_pos=int_pos;
-            current_face->Q()+=elapsed_time*5;
+            if(crossings) crossings->push_back({current_face,nullptr,elapsed_time});
+            else current_face->Q()+=elapsed_time*5;
             current_face=new_face;
             new_pos=int_pos;
             if(time>0){
                 if(p->IsS()) break;
                 new_pos=StepForward(current_pos,info.v,info.mass,current_face,g+dir,l,time);
             }
-            current_face->C()=Color4b::Green;//Just Debug!!!!
+            if(crossings) crossings->back().to=current_face;
+            else current_face->C()=Color4b::Green;//Just Debug!!!!
         }else{
             //We are on a border
             new_pos=int_pos;
@@ -619,9 +627,10 @@ This function compute the repulsion between particles
 @param MeshModel* c_m - cloud of points
 @param int k          - max number of particle to repulse
 @param Scalarm l        - length of the step
+@param RandomGenerator rnd - random stream
 @return nothing       - adhesion factor
 */
-void ComputeRepulsion(MeshModel* b_m,MeshModel *c_m,int k,Scalarm /*l*/,Point3m g,Scalarm a){
+void ComputeRepulsion(MeshModel* b_m,MeshModel *c_m,int k,Scalarm /*l*/,Point3m g,Scalarm a,math::RandomGenerator &rnd){
     CMeshO::PerVertexAttributeHandle<Particle<CMeshO> > ph = Allocator<CMeshO>::GetPerVertexAttribute<Particle<CMeshO> >(c_m->cm,"ParticleInfo");
     MetroMeshVertexGrid v_grid;
     std::vector< Point3<Scalarm> > v_points;
@@ -633,11 +642,11 @@ void ComputeRepulsion(MeshModel* b_m,MeshModel *c_m,int k,Scalarm /*l*/,Point3m
         vcg::tri::GetKClosestVertex(c_m->cm,v_grid,k,vi->P(),EPSILON,vp,distances,v_points);
         for(unsigned int i=0;i<vp.size();i++){CMeshO::VertexPointer v = vp[i];
             if(v->P()!=vi->P() && !v->IsD() && !vi->IsD()){
-                Ray3<Scalarm> ray(vi->P(),fromBarCoords(RandomBaricentric(),ph[vp[i]].face));
+                Ray3<Scalarm> ray(vi->P(),fromBarCoords(RandomBaricentric(rnd),ph[vp[i]].face));
                 ray.Normalize();
                 Point3m dir=ray.Direction();
                 dir.Normalize();
-                MoveParticle(ph[vp[i]],vp[i],0.01,1,dir,g,a);
+                MoveParticle(ph[vp[i]],vp[i],0.01,1,dir,g,a,rnd);
             }
         }
     }
@@ -645,25 +654,45 @@ void ComputeRepulsion(MeshModel* b_m,MeshModel *c_m,int k,Scalarm /*l*/,Point3m
 /**
 @def This function simulate the movement of the cloud mesh, it requires that every point is associated with a Particle data structure
 
+The particles are moved concurrently in batches, each with its own random
+stream; the faces they cross are updated afterwards in particle order, so the
+result does not depend on the number of threads.
+
 @param MeshModel cloud  - Mesh of points
+@param FaceBvh   bvh    - hierarchy of the faces of base
 @param Point3m   force  - Direction of the force
 @param Scalarm     l      - Length of the  movementstep
 @param Scalarm     t   - Time Step
+@param unsigned int seed - seed of the random streams
 
 @return nothing
 */
-void MoveCloudMeshForward(MeshModel *cloud,MeshModel *base,Point3m g,Point3m force,Scalarm l,Scalarm a,Scalarm t,int r_step){
+void MoveCloudMeshForward(MeshModel *cloud,MeshModel *base,const meshlab::FaceBvh &bvh,Point3m g,Point3m force,Scalarm l,Scalarm a,Scalarm t,int r_step,unsigned int seed){
 
     CMeshO::PerVertexAttributeHandle<Particle<CMeshO> > ph = Allocator<CMeshO>::GetPerVertexAttribute<Particle<CMeshO> >(cloud->cm,"ParticleInfo");
-    CMeshO::VertexIterator vi;
-    for(vi=cloud->cm.vert.begin();vi!=cloud->cm.vert.end();++vi)
-        if(!vi->IsD()) MoveParticle(ph[vi],&*vi,l,t,force,g,a);
-
+    const int vertNum = int(cloud->cm.vert.size());
+    const int batchSize = 1024;
+    const int batchNum = (vertNum+batchSize-1)/batchSize;
+    std::vector< std::vector<FaceCrossing> > crossings(batchNum);
+#pragma omp parallel for schedule(dynamic)
+    for(int b=0;b<batchNum;b++){
+        math::SubtractiveRingRNG rnd(StreamSeed(seed,b));
+        const int end=std::min(vertNum,(b+1)*batchSize);
+        for(int i=b*batchSize;i<end;i++)
+            if(!cloud->cm.vert[i].IsD()) MoveParticle(ph[i],&cloud->cm.vert[i],l,t,force,g,a,rnd,&crossings[b]);
+    }
+    for(const std::vector<FaceCrossing> &bc : crossings){
+        for(const FaceCrossing &c : bc){
+            c.from->Q()+=c.time*5;
+            if(c.to) c.to->C()=Color4b::Green;//Just Debug!!!!
+        }
+    }
 
     //Handle falls Particle
-    ComputeParticlesFallsPosition(base,cloud,g);
+    ComputeParticlesFallsPosition(base,bvh,cloud,g);
     //Compute Particles Repulsion
+    math::SubtractiveRingRNG rnd(StreamSeed(seed,-1));
     for(int i=0;i<r_step;i++)
-        ComputeRepulsion(base,cloud,50,l,g,a);
+        ComputeRepulsion(base,cloud,50,l,g,a,rnd);
 }
 
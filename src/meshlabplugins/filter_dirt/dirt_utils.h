@@ -32,6 +32,8 @@
 #include <time.h>
 #include <limits>
 #include <common/ml_document/mesh_model.h>
+#include <common/utilities/face_bvh.h>
+#include <vcg/math/random_generator.h>
 #include "particle.h"
 
 using namespace vcg;
@@ -43,15 +45,27 @@ typedef FaceTmark<CMeshO> MarkerFace;
 
 #define EPSILON 0.0001
 
+/**
+Face crossed by a particle during a step: the time spent on "from" is added to
+its quality and "to", if not null, is marked. Recorded by the particles moved
+concurrently and applied to the base mesh after the step.
+*/
+struct FaceCrossing{
+    CMeshO::FacePointer from;
+    CMeshO::FacePointer to;
+    Scalarm time;
+};
+
 CMeshO::CoordType RandomBaricentric();
+CMeshO::CoordType RandomBaricentric(math::RandomGenerator &rnd);
 CMeshO::CoordType fromBarCoords(Point3m bc,CMeshO::FacePointer f);
 CMeshO::CoordType GetSafePosition(CMeshO::CoordType p,CMeshO::FacePointer f);
 CMeshO::CoordType StepForward(CMeshO::CoordType p,CMeshO::CoordType v,Scalarm m,CMeshO::FacePointer &face,CMeshO::CoordType force,Scalarm l,Scalarm t=1);
-CMeshO::CoordType getRandomDirection();
+CMeshO::CoordType getRandomDirection(math::RandomGenerator &rnd);
 CMeshO::CoordType getVelocityComponent(Scalarm v,CMeshO::FacePointer f,CMeshO::CoordType g);
 CMeshO::CoordType GetNewVelocity(CMeshO::CoordType i_v,CMeshO::FacePointer face,CMeshO::FacePointer new_face,CMeshO::CoordType force,CMeshO::CoordType g,Scalarm m,Scalarm t);
 
-int ComputeIntersection(CMeshO::CoordType p1,CMeshO::CoordType p2,CMeshO::FacePointer &f,CMeshO::FacePointer &new_f,CMeshO::CoordType &int_point);
+int ComputeIntersection(CMeshO::CoordType p1,CMeshO::CoordType p2,CMeshO::FacePointer &f,CMeshO::FacePointer &new_f,CMeshO::CoordType &int_point,math::RandomGenerator &rnd);
 Scalarm GetElapsedTime(CMeshO::CoordType p1,CMeshO::CoordType p2, CMeshO::CoordType p3, Scalarm t,Scalarm l);
 
 bool CheckFallPosition(CMeshO::FacePointer f,Point3m g,Scalarm a);
@@ -62,13 +76,13 @@ bool GenerateParticles(MeshModel* m,std::vector<CMeshO::CoordType> &cpv,int d,Sc
 void ColorizeMesh(MeshModel* m);
 void DrawDust(MeshModel *base_mesh,MeshModel *cloud_mesh);
 void ComputeNormalDustAmount(MeshModel* m,CMeshO::CoordType u,Scalarm k,Scalarm s);
-void ComputeSurfaceExposure(MeshModel* m,int r,int n_ray);
-void ComputeParticlesFallsPosition(MeshModel* cloud_mesh,MeshModel* base_mesh,CMeshO::CoordType dir);
+void ComputeSurfaceExposure(MeshModel* m,int r,int n_ray,unsigned int seed=0);
+void ComputeParticlesFallsPosition(MeshModel* base_mesh,const meshlab::FaceBvh &bvh,MeshModel* cloud_mesh,CMeshO::CoordType dir);
 void associateParticles(MeshModel* b_m,MeshModel* c_m,Scalarm &m,Scalarm &v,CMeshO::CoordType g);
 void prepareMesh(MeshModel* m);
-void MoveParticle(Particle<CMeshO> &info,CMeshO::VertexPointer p,Scalarm l,int t,Point3m dir,Point3m g,Scalarm a);
-void ComputeRepulsion(MeshModel* b_m,MeshModel *c_m,int k,Scalarm l,Point3m g,Scalarm a);
-void MoveCloudMeshForward(MeshModel *cloud,MeshModel *base,Point3m g,Point3m force,Scalarm l,Scalarm a,Scalarm t,int r_step);
+void MoveParticle(Particle<CMeshO> &info,CMeshO::VertexPointer p,Scalarm l,int t,Point3m dir,Point3m g,Scalarm a,math::RandomGenerator &rnd,std::vector<FaceCrossing> *crossings=nullptr);
+void ComputeRepulsion(MeshModel* b_m,MeshModel *c_m,int k,Scalarm l,Point3m g,Scalarm a,math::RandomGenerator &rnd);
+void MoveCloudMeshForward(MeshModel *cloud,MeshModel *base,const meshlab::FaceBvh &bvh,Point3m g,Point3m force,Scalarm l,Scalarm a,Scalarm t,int r_step,unsigned int seed=0);
 
 
 #endif // DIRT_UTILS_H
@@ -131,6 +131,18 @@ RichParameterList FilterDirt::initParameterList(const QAction* filter, const Mes
 		par.addParam(
 			RichFloat("slippiness", 1.0f, "s", "The surface slippines(large s means less sticky)"));
 		par.addParam(RichFloat("adhesion", 0.2f, "k", "Factor to model the general adhesion"));
+		par.addParam(RichInt(
+			"exposure_rays",
+			1,
+			"Exposure rays x face",
+			"Number of rays shot from random points of each face to estimate how much it is "
+			"exposed"));
+		par.addParam(RichInt(
+			"seed",
+			0,
+			"Random seed",
+			"Seed of the random ray origins; the same seed gives the same result regardless of "
+			"the number of threads"));
 		par.addParam(RichBool(
 			"draw_texture", false, "Draw Dust", "create a new texture saved in dirt_texture.png"));
 		// par.addParam(RichBool("colorize_mesh",false,"Map to Color","Color the mesh with colors
@@ -192,7 +204,9 @@ std::map<std::string, QVariant> FilterDirt::applyFilter(
 		Scalarm k    = par.getFloat("adhesion");
 		bool    draw = par.getBool("draw_texture");
 		// bool colorize=par.getBool("colorize_mesh");
-		int n_p = par.getInt("nparticles");
+		int          n_p    = par.getInt("nparticles");
+		int          n_rays = par.getInt("exposure_rays");
+		unsigned int seed   = par.getInt("seed");
 
 		MeshModel* currMM = md.mm();
 
@@ -214,7 +228,7 @@ std::map<std::string, QVariant> FilterDirt::applyFilter(
 		if (cb)
 			(*cb)(30, "Computing Mesh Exposure...");
 
-		ComputeSurfaceExposure(currMM, 1, 1);
+		ComputeSurfaceExposure(currMM, 1, std::max(n_rays, 1), seed);
 
 		if (cb)
 			(*cb)(50, "Generating Particles...");
@@ -265,9 +279,10 @@ std::map<std::string, QVariant> FilterDirt::applyFilter(
 		}
 
 		// Move Cloud Mesh
-		float frac = 100 / s;
+		std::shared_ptr<const meshlab::FaceBvh> bvh  = base_mesh->faceBvh();
+		float                                   frac = 100 / s;
 		for (int i = 0; i < s; i++) {
-			MoveCloudMeshForward(cloud_mesh, base_mesh, g, dir, l, adhesion, 1, 1);
+			MoveCloudMeshForward(cloud_mesh, base_mesh, *bvh, g, dir, l, adhesion, 1, 1, i);
 			if (cb)
 				(*cb)(i * frac, "Moving...");
 		}
@@ -23,6 +23,8 @@
 
 #include "filter_icp.h"
 
+#include <common/utilities/mesh_tree_process.h>
+
 #define PAR_SOURCE_MESH         "SourceMesh"
 #define PAR_BASE_MESH           "BaseMesh"
 #define PAR_REFERENCE_MESH      "ReferenceMesh"
@@ -331,7 +333,7 @@ std::map<std::string, QVariant> FilterIcpPlugin::globalAlignment(MeshDocument& m
 
     // Start the global alignment
     log("Starting the global alignment filter...");
-    meshTree.Process(this->alignParameters, this->meshTreeParameters);
+    meshlab::processMeshTree(meshTree, this->alignParameters, this->meshTreeParameters);
     log("Global alignment completed!");
     meshTree.clear();
 
@@ -466,9 +468,11 @@ std::map<std::string, QVariant> FilterIcpPlugin::checkOverlappingMeshes(MeshDocu
     occupancyGrid.Init(meshNumber, meshDocument.bbox(), occupancyGridSize);
 
     /* Add each meshes contained in the document inside the Occupancy Grid */
+    auto meshes = std::vector<MeshModel*>{};
     for (auto& mesh : meshDocument.meshIterator()) {
-        occupancyGrid.AddMesh(mesh.cm, mesh.cm.Tr, mesh.id());
+        meshes.push_back(&mesh);
     }
+    meshlab::addMeshesToOccupancyGrid(occupancyGrid, meshes);
 
     /* Compute the Occupancy Grid to see the overlapping meshes */
     occupancyGrid.Compute();
@@ -21,8 +21,13 @@
 *                                                                           *
 ****************************************************************************/
 #include <cmath>
+#include <algorithm>
+#include <limits>
 #include "VisibilityCheck.h"
 #include <wrap/gl/shot.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 VisibilityCheck* VisibilityCheck::s_Instance = NULL;
 
@@ -590,3 +595,90 @@ void VisibilityCheck_ShadowMap::checkVisibility()
 
     m_Context.unbindReadDrawFramebuffer();
 }
+
+
+
+
+
+
+size_t VisibilityCheck_CPU::rastersPerBatch()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+
+void VisibilityCheck_CPU::prefetch( const std::vector<RasterModel*> &rasters, std::vector<std::shared_ptr<const meshlab::DepthMap>> &maps )
+{
+    std::vector<Shotm> shots;
+    for( RasterModel *rm : rasters )
+        shots.push_back( rm->shot );
+
+    int rendered = 0;
+    maps = m_DepthMaps.depthMaps( *m_Mesh, shots, &rendered );
+    m_RenderedMaps += rendered;
+}
+
+
+void VisibilityCheck_CPU::setRaster( RasterModel *rm )
+{
+    if( rm && rm!=m_Raster )
+    {
+        std::vector<std::shared_ptr<const meshlab::DepthMap>> maps;
+        prefetch( std::vector<RasterModel*>(1,rm), maps );
+        m_Raster = rm;
+        m_DepthMap = maps[0];
+    }
+}
+
+
+void VisibilityCheck_CPU::checkVisibility()
+{
+    const Shotm &shot = m_Raster->shot;
+    const meshlab::DepthMap &depth = *m_DepthMap;
+    const Point3m viewpoint = shot.GetViewPoint();
+
+    m_VertVisible.assign( m_Mesh->vert.size(), 0 );
+
+    #pragma omp parallel for schedule(static)
+    for( int v=0; v<(int)m_Mesh->vert.size(); ++v )
+    {
+        const CVertexO &vert = m_Mesh->vert[v];
+        if( vert.IsD() || (viewpoint-vert.cP()) * vert.cN() < 0.0f )
+            continue;
+
+        const float z = shot.ConvertWorldToCameraCoordinates( vert.cP() )[2];
+        if( z <= 0.0f )
+            continue;
+
+        const Point2m p = shot.Project( vert.cP() );
+        const int x = (int) std::floor( p[0] );
+        const int y = (int) std::floor( p[1] );
+        if( !depth.isInside(x,y) )
+            continue;
+
+        // Equivalent of the glPolygonOffset(2,2) used when rendering the shadow map: the
+        // depth slope is estimated on the side of the pixel that does not cross a silhouette.
+        const float d = depth.at( x, y );
+        float slope = 0.0f;
+        for( int axis=0; axis<2; ++axis )
+        {
+            float s = std::numeric_limits<float>::infinity();
+            for( int side=-1; side<=1; side+=2 )
+            {
+                const int nx = axis==0? x+side : x;
+                const int ny = axis==1? y+side : y;
+                if( depth.isInside(nx,ny) && std::isfinite(depth.at(nx,ny)) )
+                    s = std::min( s, std::abs(depth.at(nx,ny)-d) );
+            }
+            if( std::isfinite(s) )
+                slope = std::max( slope, s );
+        }
+
+        if( z <= d + 2.0f*slope + 1e-4f*d )
+            m_VertVisible[v] = 1;
+    }
+}
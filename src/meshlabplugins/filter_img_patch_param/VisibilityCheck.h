@@ -29,7 +29,10 @@
 
 #include <common/ml_document/raster_model.h>
 #include <common/ml_shared_data_context/ml_plugin_gl_context.h>
+#include <common/utilities/depth_map_cache.h>
 #include <wrap/glw/glw.h>
+#include <list>
+#include <memory>
 
 #define USE_VBO
 
@@ -147,6 +150,74 @@ public:
 };
 
 
+// Same test of VisibilityCheck_ShadowMap, made on the CPU against the depth maps
+// of a meshlab::DepthMapCache, so that no OpenGL context is needed. The depth maps
+// of the rasters are rendered concurrently, a batch of rasters at a time, and kept
+// in the cache for the next filters working on the same rasters and geometry.
+class VisibilityCheck_CPU
+{
+private:
+    meshlab::DepthMapCache                          &m_DepthMaps;
+    CMeshO                                          *m_Mesh;
+    RasterModel                                     *m_Raster;
+    std::shared_ptr<const meshlab::DepthMap>        m_DepthMap;
+    std::vector<unsigned char>                      m_VertVisible;
+    int                                             m_RenderedMaps;
+
+    static size_t rastersPerBatch();
+    void        prefetch( const std::vector<RasterModel*> &rasters, std::vector<std::shared_ptr<const meshlab::DepthMap>> &maps );
+
+public:
+    inline      VisibilityCheck_CPU( meshlab::DepthMapCache &cache ) : m_DepthMaps(cache), m_Mesh(NULL), m_Raster(NULL), m_RenderedMaps(0) {}
+
+    void        setMesh( CMeshO *mesh )                                             { m_Mesh = mesh; }
+    void        setRaster( RasterModel *rm );
+    void        checkVisibility();
+
+    // Runs checkVisibility() for each raster of the list, and then calls visit(rm).
+    template <class Visitor>
+    void        forEachRaster( const std::list<RasterModel*> &rasters, Visitor visit );
+
+    // Number of depth maps actually rendered, the others have been found in the cache.
+    inline int  renderedMaps() const                                                { return m_RenderedMaps; }
+
+    inline bool isVertVisible( const unsigned int n ) const                         { return m_VertVisible[n] != 0; }
+    inline bool isVertVisible( const CVertexO *v ) const                            { return isVertVisible( v - &m_Mesh->vert[0] ); }
+    inline bool isVertVisible( const CMeshO::VertexIterator &v ) const              { return isVertVisible( &*v ); }
+
+    inline bool isFaceVisible( const unsigned int n ) const                         { return isFaceVisible( &m_Mesh->face[n] ); }
+    inline bool isFaceVisible( const CFaceO *f ) const                              { return isVertVisible(f->cV(0)) || isVertVisible(f->cV(1)) || isVertVisible(f->cV(2)); }
+    inline bool isFaceVisible( const CMeshO::FaceIterator &f ) const                { return isFaceVisible( &*f ); }
+};
+
+
+template <class Visitor>
+void VisibilityCheck_CPU::forEachRaster( const std::list<RasterModel*> &rasters, Visitor visit )
+{
+    // One depth map per thread is rendered at the same time, only the maps of the
+    // current batch are kept alive outside the cache.
+    const size_t batchSize = rastersPerBatch();
+
+    std::vector<RasterModel*> batch;
+    std::vector<std::shared_ptr<const meshlab::DepthMap>> maps;
+    for( auto it=rasters.begin(); it!=rasters.end(); )
+    {
+        batch.clear();
+        for( ; it!=rasters.end() && batch.size()<batchSize; ++it )
+            batch.push_back( *it );
+        prefetch( batch, maps );
+
+        for( size_t i=0; i<batch.size(); ++i )
+        {
+            m_Raster = batch[i];
+            m_DepthMap = maps[i];
+            checkVisibility();
+            visit( batch[i] );
+        }
+    }
+}
+
+
 
 
 #endif // FILTER_IMG_PATCH_PARAM_PLUGIN__VISIBILITYCHECK_H
@@ -43,13 +43,46 @@ VisibleSet::VisibleSet(glw::Context &ctx,
 	visibility.setMesh(meshid,&mesh );
 	visibility.m_plugcontext = plugctx;
 
+	initDepthRange( rasterList );
 
+	for( RasterModel *rm : rasterList)
+	{
+		visibility.setRaster( rm );
+		visibility.checkVisibility();
+		addVisibleFaces( visibility, mesh, rm );
+	}
+
+	VisibilityCheck::ReleaseInstance();
+}
+
+
+VisibleSet::VisibleSet(meshlab::DepthMapCache &depthMaps,
+		CMeshO &mesh,
+		std::list<RasterModel*>& rasterList,
+		int weightMask) :
+	m_Mesh(mesh),
+	m_FaceVis(mesh.fn),
+	m_WeightMask(weightMask)
+{
+	VisibilityCheck_CPU visibility( depthMaps );
+	visibility.setMesh( &mesh );
+
+	initDepthRange( rasterList );
+
+	visibility.forEachRaster( rasterList, [&]( RasterModel *rm ) {
+		addVisibleFaces( visibility, mesh, rm );
+	});
+}
+
+
+void VisibleSet::initDepthRange( std::list<RasterModel*> &rasterList )
+{
 	float depthMin =  std::numeric_limits<float>::max();
 	m_DepthMax = -std::numeric_limits<float>::max();
 
 	for(RasterModel *rm: rasterList) {
 		CMeshO::ScalarType zNear, zFar;
-		GlShot< Shotm >::GetNearFarPlanes( rm->shot, mesh.bbox, zNear, zFar );
+		GlShot< Shotm >::GetNearFarPlanes( rm->shot, m_Mesh.bbox, zNear, zFar );
 
 		if( zNear < depthMin )
 			depthMin = zNear;
@@ -63,23 +96,19 @@ VisibleSet::VisibleSet(glw::Context &ctx,
 		m_DepthMax = depthMin + 1000.0f;
 
 	m_DepthRangeInv = 1.0f / (m_DepthMax-depthMin);
+}
 
 
-	for( RasterModel *rm : rasterList)
-	{
-		visibility.setRaster( rm );
-		visibility.checkVisibility();
-
-		for( int f=0; f<mesh.fn; ++f ){
-			if( visibility.isFaceVisible(f) ) {
-				float w = getWeight( rm, mesh.face[f] );
-				if( w >= 0.0f )
-					m_FaceVis[f].add( w, rm );
-			}
+template <class Visibility>
+void VisibleSet::addVisibleFaces( const Visibility &visibility, CMeshO &mesh, RasterModel *rm )
+{
+	for( int f=0; f<mesh.fn; ++f ){
+		if( visibility.isFaceVisible(f) ) {
+			float w = getWeight( rm, mesh.face[f] );
+			if( w >= 0.0f )
+				m_FaceVis[f].add( w, rm );
 		}
 	}
-
-	VisibilityCheck::ReleaseInstance();
 }
 
 
@@ -29,6 +29,7 @@
 
 #include <common/ml_document/raster_model.h>
 #include <common/ml_shared_data_context/ml_plugin_gl_context.h>
+#include <common/utilities/depth_map_cache.h>
 #include <wrap/glw/glw.h>
 
 
@@ -78,12 +79,22 @@ private:
 
     inline int          id( const CFaceO& f ) const                         { return &f - &m_Mesh.face[0]; }
 
+    void                initDepthRange( std::list<RasterModel*> &rasterList );
+    template <class Visibility>
+    void                addVisibleFaces( const Visibility &visibility, CMeshO &mesh, RasterModel *rm );
+
 public:
     VisibleSet( glw::Context &ctx,MLPluginGLContext* plugctx,int meshid,
                 CMeshO &mesh,
                 std::list<RasterModel*> &rasterList,
                 int weightMask );
 
+    // Same visibility set computed on the CPU, with VisibilityCheck_CPU.
+    VisibleSet( meshlab::DepthMapCache &depthMaps,
+                CMeshO &mesh,
+                std::list<RasterModel*> &rasterList,
+                int weightMask );
+
     float               getWeight( const RasterModel *rm, CFaceO &f );
 
     inline const FaceVisInfo&  operator[]( const int f ) const                     { return m_FaceVis[f]; }
@@ -125,6 +125,21 @@ bool FilterImgPatchParamPlugin::requiresGLContext(const QAction* action) const
 	return false;
 }
 
+bool FilterImgPatchParamPlugin::canRunWithoutGLContext(const QAction* action) const
+{
+	switch(ID(action)){
+	case FP_PATCH_PARAM_ONLY:
+	case FP_RASTER_VERT_COVERAGE:
+	case FP_RASTER_FACE_COVERAGE:
+		return true; // the visibility is computed on the CPU
+	case FP_PATCH_PARAM_AND_TEXTURING:
+		return false; // the texture is painted with OpenGL
+	default:
+		assert(0);
+	}
+	return false;
+}
+
 
 FilterPlugin::FilterClass FilterImgPatchParamPlugin::getClass(const QAction *act ) const
 {
@@ -218,6 +233,10 @@ RichParameterList FilterImgPatchParamPlugin::initParameterList(
 		break;
 	}
 	}
+	par.addParam( RichBool( "useGPU",
+							true,
+							"Use GPU visibility check",
+							"If true, the visibility of the mesh from each raster is computed with OpenGL shadow maps. Otherwise the depth maps are rendered by a software rasterizer, several rasters at a time, and kept in memory for the next runs on the same rasters and geometry; no OpenGL is needed, except for painting the texture" ) );
 	return par;
 }
 
@@ -229,7 +248,21 @@ std::map<std::string, QVariant> FilterImgPatchParamPlugin::applyFilter(
 		unsigned int& /*postConditionMask*/,
 		vcg::CallBackPos * /*cb*/ )
 {
-	if (glContext != nullptr){
+	bool useGPU = par.getBool("useGPU");
+	const bool validContext = glContext != nullptr && glContext->isValid();
+	if( useGPU && !validContext )
+	{
+		log(GLLogStream::SYSTEM, "No OpenGL context available, the visibility is computed on the CPU");
+		useGPU = false;
+	}
+
+	// The texture is painted with OpenGL even when the visibility is computed on the CPU.
+	const bool useGL = useGPU || ID(act) == FP_PATCH_PARAM_AND_TEXTURING;
+	if( useGL && !validContext )
+		throw MLException("Fatal error: glContext not initialized");
+
+	if( useGL )
+	{
 		glContext->makeCurrent();
 		if( !GLExtensionsManager::initializeGLextensions_notThrowing() )
 		{
@@ -242,43 +275,76 @@ std::map<std::string, QVariant> FilterImgPatchParamPlugin::applyFilter(
 		m_Context = new glw::Context();
 		m_Context->acquire();
 
-		if( !VisibilityCheck::GetInstance(*m_Context) )
+		if( useGPU && !VisibilityCheck::GetInstance(*m_Context) )
 		{
 			throw MLException("VisibilityCheck failed");
 		}
 		VisibilityCheck::ReleaseInstance();
+	}
 
-		bool retValue = true;
+	bool retValue = true;
 
-		CMeshO &mesh = md.mm()->cm;
+	CMeshO &mesh = md.mm()->cm;
 
-		std::list<Shotm> initialShots;
-		std::list<RasterModel*> activeRasters;
-		for(RasterModel& rm : md.rasterIterator()) {
-			initialShots.push_back(rm.shot);
-			rm.shot.ApplyRigidTransformation( vcg::Inverse(mesh.Tr) );
-			if( rm.isVisible() )
-				activeRasters.push_back(&rm );
-		}
+	std::list<Shotm> initialShots;
+	std::list<RasterModel*> activeRasters;
+	for(RasterModel& rm : md.rasterIterator()) {
+		initialShots.push_back(rm.shot);
+		rm.shot.ApplyRigidTransformation( vcg::Inverse(mesh.Tr) );
+		if( rm.isVisible() )
+			activeRasters.push_back(&rm );
+	}
 
-		if( activeRasters.empty() ) {
+	if( activeRasters.empty() ) {
+		if( useGL )
 			glContext->doneCurrent();
-			throw MLException("You need to have at least one valid raster layer in your project, to apply this filter"); // text
-		}
+		throw MLException("You need to have at least one valid raster layer in your project, to apply this filter"); // text
+	}
 
-		switch( ID(act) )
-		{
-		case FP_PATCH_PARAM_ONLY:
-		{
-			if (vcg::tri::Clean<CMeshO>::CountNonManifoldEdgeFF(md.mm()->cm)>0) {
+	switch( ID(act) )
+	{
+	case FP_PATCH_PARAM_ONLY:
+	{
+		if (vcg::tri::Clean<CMeshO>::CountNonManifoldEdgeFF(md.mm()->cm)>0) {
+			if( useGL )
 				glContext->doneCurrent();
-				throw MLException("Mesh has some not 2-manifold faces, this filter requires manifoldness"); // text
-			}
-			vcg::tri::Allocator<CMeshO>::CompactFaceVector(md.mm()->cm);
-			vcg::tri::Allocator<CMeshO>::CompactVertexVector(md.mm()->cm);
-			vcg::tri::UpdateTopology<CMeshO>::FaceFace(md.mm()->cm);
-			vcg::tri::UpdateTopology<CMeshO>::VertexFace(md.mm()->cm);
+			throw MLException("Mesh has some not 2-manifold faces, this filter requires manifoldness"); // text
+		}
+		vcg::tri::Allocator<CMeshO>::CompactFaceVector(md.mm()->cm);
+		vcg::tri::Allocator<CMeshO>::CompactVertexVector(md.mm()->cm);
+		vcg::tri::UpdateTopology<CMeshO>::FaceFace(md.mm()->cm);
+		vcg::tri::UpdateTopology<CMeshO>::VertexFace(md.mm()->cm);
+		if( glContext != nullptr )
 			glContext->meshAttributesUpdated(md.mm()->id(),true,MLRenderingData::RendAtts());
+		RasterPatchMap patches;
+		PatchVec nullPatches;
+		patchBasedTextureParameterization(
+					patches,
+					nullPatches,
+					md.mm()->id(),
+					mesh,
+					activeRasters,
+					par,
+					useGPU);
+
+		break;
+	}
+	case FP_PATCH_PARAM_AND_TEXTURING:
+	{
+		if (vcg::tri::Clean<CMeshO>::CountNonManifoldEdgeFF(md.mm()->cm)>0) {
+			glContext->doneCurrent();
+			throw MLException("Mesh has some not 2-manifold faces, this filter requires manifoldness"); // text
+		}
+		vcg::tri::Allocator<CMeshO>::CompactEveryVector(md.mm()->cm);
+		vcg::tri::UpdateTopology<CMeshO>::FaceFace(md.mm()->cm);
+		vcg::tri::UpdateTopology<CMeshO>::VertexFace(md.mm()->cm);
+		glContext->meshAttributesUpdated(md.mm()->id(),true,MLRenderingData::RendAtts());
+		QString texName = par.getString( "textureName" ).simplified();
+		int pathEnd = std::max( texName.lastIndexOf('/'), texName.lastIndexOf('\\') );
+		if( pathEnd != -1 )
+			texName = texName.right( texName.size()-pathEnd-1 );
+
+		if( (retValue = texName.size()!=0) ) {
 			RasterPatchMap patches;
 			PatchVec nullPatches;
 			patchBasedTextureParameterization(
@@ -287,61 +353,37 @@ std::map<std::string, QVariant> FilterImgPatchParamPlugin::applyFilter(
 						md.mm()->id(),
 						mesh,
 						activeRasters,
-						par);
-
-			break;
-		}
-		case FP_PATCH_PARAM_AND_TEXTURING:
-		{
-			if (vcg::tri::Clean<CMeshO>::CountNonManifoldEdgeFF(md.mm()->cm)>0) {
-				glContext->doneCurrent();
-				throw MLException("Mesh has some not 2-manifold faces, this filter requires manifoldness"); // text
+						par,
+						useGPU);
+
+			TexturePainter painter( *m_Context, par.getInt("textureSize") );
+			if( (retValue = painter.isInitialized()) ) {
+				QElapsedTimer t; t.start();
+				painter.paint( patches );
+				if( par.getBool("colorCorrection") )
+					painter.rectifyColor( patches, par.getInt("colorCorrectionFilterSize") );
+				log( "TEXTURE PAINTING: %.3f sec.", 0.001f*t.elapsed() );
+
+				QImage tex = painter.getTexture();
+				md.mm()->clearTextures();
+				md.mm()->addTexture(texName.toStdString(), tex);
 			}
-			vcg::tri::Allocator<CMeshO>::CompactEveryVector(md.mm()->cm);
-			vcg::tri::UpdateTopology<CMeshO>::FaceFace(md.mm()->cm);
-			vcg::tri::UpdateTopology<CMeshO>::VertexFace(md.mm()->cm);
-			glContext->meshAttributesUpdated(md.mm()->id(),true,MLRenderingData::RendAtts());
-			QString texName = par.getString( "textureName" ).simplified();
-			int pathEnd = std::max( texName.lastIndexOf('/'), texName.lastIndexOf('\\') );
-			if( pathEnd != -1 )
-				texName = texName.right( texName.size()-pathEnd-1 );
-
-			if( (retValue = texName.size()!=0) ) {
-				RasterPatchMap patches;
-				PatchVec nullPatches;
-				patchBasedTextureParameterization(
-							patches,
-							nullPatches,
-							md.mm()->id(),
-							mesh,
-							activeRasters,
-							par);
-
-				TexturePainter painter( *m_Context, par.getInt("textureSize") );
-				if( (retValue = painter.isInitialized()) ) {
-					QElapsedTimer t; t.start();
-					painter.paint( patches );
-					if( par.getBool("colorCorrection") )
-						painter.rectifyColor( patches, par.getInt("colorCorrectionFilterSize") );
-					log( "TEXTURE PAINTING: %.3f sec.", 0.001f*t.elapsed() );
-
-					QImage tex = painter.getTexture();
-					md.mm()->clearTextures();
-					md.mm()->addTexture(texName.toStdString(), tex);
-				}
-			}
-			if (!retValue)
-				throw MLException(act->text() + " filter failed.");
-
-			break;
 		}
-		case FP_RASTER_VERT_COVERAGE:
-		{
+		if (!retValue)
+			throw MLException(act->text() + " filter failed.");
+
+		break;
+	}
+	case FP_RASTER_VERT_COVERAGE:
+	{
+		for( CMeshO::VertexIterator vi=mesh.vert.begin(); vi!=mesh.vert.end(); ++vi )
+			vi->Q() = 0.0f;
+
+		QElapsedTimer t; t.start();
+		if( useGPU ) {
 			VisibilityCheck &visibility = *VisibilityCheck::GetInstance( *m_Context );
 			visibility.setMesh(md.mm()->id(),&mesh );
 			visibility.m_plugcontext = glContext;
-			for( CMeshO::VertexIterator vi=mesh.vert.begin(); vi!=mesh.vert.end(); ++vi )
-				vi->Q() = 0.0f;
 
 			for( RasterModel *rm: activeRasters ) {
 				visibility.setRaster( rm );
@@ -350,23 +392,38 @@ std::map<std::string, QVariant> FilterImgPatchParamPlugin::applyFilter(
 					if( visibility.isVertVisible(vi) )
 						vi->Q() += 1.0f;
 			}
-
-			if( par.getBool("normalizeQuality") ) {
-				const float normFactor = 1.0f / md.rasterNumber();
+			log( "VISIBILITY CHECK (GPU): %.3f sec.", 0.001f*t.elapsed() );
+		}
+		else {
+			VisibilityCheck_CPU visibility( m_DepthMaps );
+			visibility.setMesh( &mesh );
+			visibility.forEachRaster( activeRasters, [&]( RasterModel* ) {
 				for( CMeshO::VertexIterator vi=mesh.vert.begin(); vi!=mesh.vert.end(); ++vi )
-					vi->Q() *= normFactor;
-			}
+					if( visibility.isVertVisible(vi) )
+						vi->Q() += 1.0f;
+			});
+			log( "VISIBILITY CHECK (CPU): %.3f sec.", 0.001f*t.elapsed() );
+			log( "  * %i of %i depth maps rendered, the others reused.", visibility.renderedMaps(), int(activeRasters.size()) );
+		}
 
-			break;
+		if( par.getBool("normalizeQuality") ) {
+			const float normFactor = 1.0f / md.rasterNumber();
+			for( CMeshO::VertexIterator vi=mesh.vert.begin(); vi!=mesh.vert.end(); ++vi )
+				vi->Q() *= normFactor;
 		}
-		case FP_RASTER_FACE_COVERAGE: {
+
+		break;
+	}
+	case FP_RASTER_FACE_COVERAGE: {
+		for( CMeshO::FaceIterator fi=mesh.face.begin(); fi!=mesh.face.end(); ++fi )
+			fi->Q() = 0.0f;
+
+		QElapsedTimer t; t.start();
+		if( useGPU ) {
 			VisibilityCheck &visibility = *VisibilityCheck::GetInstance( *m_Context );
 			visibility.setMesh(md.mm()->id(),&mesh );
 			visibility.m_plugcontext = glContext;
 
-			for( CMeshO::FaceIterator fi=mesh.face.begin(); fi!=mesh.face.end(); ++fi )
-				fi->Q() = 0.0f;
-
 			for( RasterModel *rm: activeRasters ) {
 				visibility.setRaster( rm );
 				visibility.checkVisibility();
@@ -374,25 +431,40 @@ std::map<std::string, QVariant> FilterImgPatchParamPlugin::applyFilter(
 					if( visibility.isFaceVisible(fi) )
 						fi->Q() += 1.0f;
 			}
-
-			if( par.getBool("normalizeQuality") )
-			{
-				const float normFactor = 1.0f / md.rasterNumber();
-				for( CMeshO::FaceIterator fi=mesh.face.begin(); fi!=mesh.face.end(); ++fi )
-					fi->Q() *= normFactor;
-			}
-			
-			break;
+			log( "VISIBILITY CHECK (GPU): %.3f sec.", 0.001f*t.elapsed() );
 		}
-		default:
-			wrongActionCalled(act);
+		else {
+			VisibilityCheck_CPU visibility( m_DepthMaps );
+			visibility.setMesh( &mesh );
+			visibility.forEachRaster( activeRasters, [&]( RasterModel* ) {
+				for( CMeshO::FaceIterator fi=mesh.face.begin(); fi!=mesh.face.end(); ++fi )
+					if( visibility.isFaceVisible(fi) )
+						fi->Q() += 1.0f;
+			});
+			log( "VISIBILITY CHECK (CPU): %.3f sec.", 0.001f*t.elapsed() );
+			log( "  * %i of %i depth maps rendered, the others reused.", visibility.renderedMaps(), int(activeRasters.size()) );
 		}
 
-		for(RasterModel& rm: md.rasterIterator() ) {
-			rm.shot = *initialShots.begin();
-			initialShots.erase( initialShots.begin() );
+		if( par.getBool("normalizeQuality") )
+		{
+			const float normFactor = 1.0f / md.rasterNumber();
+			for( CMeshO::FaceIterator fi=mesh.face.begin(); fi!=mesh.face.end(); ++fi )
+				fi->Q() *= normFactor;
 		}
+		
+		break;
+	}
+	default:
+		wrongActionCalled(act);
+	}
+
+	for(RasterModel& rm: md.rasterIterator() ) {
+		rm.shot = *initialShots.begin();
+		initialShots.erase( initialShots.begin() );
+	}
 
+	if( useGL )
+	{
 		VisibilityCheck::ReleaseInstance();
 
 		delete m_Context;
@@ -400,15 +472,13 @@ std::map<std::string, QVariant> FilterImgPatchParamPlugin::applyFilter(
 
 		glPopAttrib();
 		glContext->doneCurrent();
-
-		return std::map<std::string, QVariant>();
-	}
-	else {
-		throw MLException("Fatal error: glContext not initialized");
 	}
+
+	return std::map<std::string, QVariant>();
 }
 
 
+
 void FilterImgPatchParamPlugin::getNeighbors( CVertexO *v,
 											  NeighbSet &neighb ) const
 {
@@ -920,7 +990,8 @@ void FilterImgPatchParamPlugin::patchBasedTextureParameterization(
 		int meshid,
 		CMeshO &mesh,
 		std::list<RasterModel*> &rasterList,
-		const RichParameterList &par)
+		const RichParameterList &par,
+		bool useGPU)
 {
 	// Computes the visibility set for all mesh faces. It contains the set of all images
 	// into which the face is visible, as well as a reference image, namely the one with
@@ -933,8 +1004,10 @@ void FilterImgPatchParamPlugin::patchBasedTextureParameterization(
 		weightMask |= VisibleSet::W_IMG_BORDER;
 	if( par.getBool("useAlphaWeight") )
 		weightMask |= VisibleSet::W_IMG_ALPHA;
-	VisibleSet faceVis( *m_Context,glContext,meshid, mesh, rasterList, weightMask );
-	log( "VISIBILITY CHECK: %.3f sec.", 0.001f*t.elapsed() );
+	VisibleSet faceVis = useGPU?
+		VisibleSet( *m_Context,glContext,meshid, mesh, rasterList, weightMask ) :
+		VisibleSet( m_DepthMaps, mesh, rasterList, weightMask );
+	log( "VISIBILITY CHECK (%s): %.3f sec.", useGPU? "GPU" : "CPU", 0.001f*t.elapsed() );
 	
 	
 	// Boundary optimization: the goal is to produce more regular boundaries between surface regions
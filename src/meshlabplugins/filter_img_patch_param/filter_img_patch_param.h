@@ -29,6 +29,7 @@
 
 #include <QObject>
 #include <common/plugins/interfaces/filter_plugin.h>
+#include <common/utilities/depth_map_cache.h>
 #include <vcg/math/similarity2.h>
 #include "Patch.h"
 #include <wrap/glw/glw.h>
@@ -51,6 +52,7 @@ class FilterImgPatchParamPlugin : public QObject, public FilterPlugin
 
 	typedef std::set<CFaceO*> NeighbSet;
 	glw::Context        *m_Context;
+	meshlab::DepthMapCache m_DepthMaps; // depth maps of the CPU visibility check, kept between runs
 
 
 	void getNeighbors(
@@ -98,7 +100,8 @@ class FilterImgPatchParamPlugin : public QObject, public FilterPlugin
 			int meshid,
 			CMeshO &mesh,
 			std::list<RasterModel*>& rasterList,
-			const RichParameterList& par);
+			const RichParameterList& par,
+			bool useGPU);
 
 	float computeTotalPatchArea(const RasterPatchMap& patches );
 	int computePatchCount(const RasterPatchMap& patches );
@@ -121,6 +124,7 @@ public:
 
 	int getRequirements(const QAction* act );
 	bool requiresGLContext(const QAction* action) const;
+	bool canRunWithoutGLContext(const QAction* action) const;
 	//virtual int postCondition( QAction *act ) const;
 
 	std::map<std::string, QVariant> applyFilter(
@@ -26,10 +26,13 @@
 #include <time.h>
 
 #include "filter_layer.h"
+#include "flatten_layers.h"
+#include "split_connected.h"
 
 #include <QDir>
 #include <QImageReader>
 #include <QXmlStreamWriter>
+#include <common/utilities/merge_vertices.h>
 #include <vcg/complex/append.h>
 
 using namespace std;
@@ -411,30 +414,24 @@ std::map<std::string, QVariant> FilterLayerPlugin::applyFilter(
 
 		MeshModel* destModel = md.addNewMesh("", "Merged Mesh", true);
 
-		std::list<unsigned int> toBeDeletedList;
+		std::list<unsigned int>    toBeDeletedList;
+		std::vector<const CMeshO*> layers;
 
-		unsigned int cnt = 0;
 		for (MeshModel& mmp : md.meshIterator()) {
-			++cnt;
 			if (mmp.isVisible() || !mergeVisible) {
 				if (mmp.id() != destModel->id()) {
-					cb(cnt * 100 / md.meshNumber(), "Merging layers...");
-					tri::UpdatePosition<CMeshO>::Matrix(mmp.cm, mmp.cm.Tr, true);
 					toBeDeletedList.push_back(mmp.id());
-					if (!alsoUnreferenced) {
-						vcg::tri::Clean<CMeshO>::RemoveUnreferencedVertex(mmp.cm);
-					}
+					layers.push_back(&mmp.cm);
+					// destModel is still empty, enabling the data is cheap
 					destModel->updateDataMask(&mmp);
-					tri::Append<CMeshO, CMeshO>::Mesh(destModel->cm, mmp.cm);
 
 					for (const std::string& txt : mmp.cm.textures) {
 						destModel->addTexture(txt, mmp.getTexture(txt));
 					}
-
-					tri::UpdatePosition<CMeshO>::Matrix(mmp.cm, Inverse(mmp.cm.Tr), true);
 				}
 			}
 		}
+		FlattenLayers(layers, destModel->cm, alsoUnreferenced, cb);
 
 		if (deleteLayer) {
 			log("Deleted %d merged layers", toBeDeletedList.size());
@@ -444,10 +441,14 @@ std::map<std::string, QVariant> FilterLayerPlugin::applyFilter(
 		}
 
 		if (mergeVertices) {
-			int delvert = tri::Clean<CMeshO>::RemoveDuplicateVertex(destModel->cm);
+			int delvert = meshlab::removeDuplicateVertices(destModel->cm);
 			log("Removed %d duplicated vertices", delvert);
 		}
 
+		if (destModel->hasDataMask(MeshModel::MM_FACEFACETOPO))
+			tri::UpdateTopology<CMeshO>::FaceFace(destModel->cm);
+		if (destModel->hasDataMask(MeshModel::MM_VERTFACETOPO))
+			tri::UpdateTopology<CMeshO>::VertexFace(destModel->cm);
 		destModel->updateBoxAndNormals();
 		log("Merged all the layers to single mesh of %i vertices", md.mm()->cm.vn);
 	} break;
@@ -456,39 +457,29 @@ std::map<std::string, QVariant> FilterLayerPlugin::applyFilter(
 		MeshModel* currentModel = md.mm();
 		CMeshO&    cm           = md.mm()->cm;
 		bool removeSourceMesh = par.getBool("delete_source_mesh");
-		md.mm()->updateDataMask(MeshModel::MM_FACEFACETOPO);
-		std::vector<std::pair<int, CMeshO::FacePointer>> connectedCompVec;
-		int numCC = tri::Clean<CMeshO>::ConnectedComponents(cm, connectedCompVec);
-		log("Found %i Connected Components", numCC);
+		meshlab::ConnectedComponents cc = meshlab::connectedComponents(cm);
+		log("Found %i Connected Components", (int) cc.size());
 		tri::UpdateSelection<CMeshO>::FaceClear(cm);
 		tri::UpdateSelection<CMeshO>::VertexClear(cm);
 
-		for (size_t i = 0; i < connectedCompVec.size(); ++i) {
-			// select verts and faces of ith connected component
-			connectedCompVec[i].second->SetS();
-			tri::UpdateSelection<CMeshO>::FaceConnectedFF(cm /*,true*/);
-			tri::UpdateSelection<CMeshO>::VertexFromFaceLoose(cm);
-
-			// create a new mesh from the selection
-			MeshModel* destModel = md.addNewMesh("", QString("CC %1").arg(i), true);
-			destModel->updateDataMask(currentModel);
-			tri::Append<CMeshO, CMeshO>::Mesh(destModel->cm, cm, true);
-
-			// clear selection from source mesh and from newly created mesh
-			tri::UpdateSelection<CMeshO>::FaceClear(cm);
-			tri::UpdateSelection<CMeshO>::VertexClear(cm);
-			tri::UpdateSelection<CMeshO>::FaceClear(destModel->cm);
-			tri::UpdateSelection<CMeshO>::VertexClear(destModel->cm);
-
-			// append any textures... (todo: append only the ACTUALLY USED ones)
-			for (const std::string& txt : cm.textures) {
-				destModel->addTexture(txt, md.mm()->getTexture(txt));
+		// the layers are created up front, then filled all at once
+		std::vector<MeshModel*> destModels(cc.size());
+		std::vector<CMeshO*>    destMeshes(cc.size());
+		for (size_t i = 0; i < cc.size(); ++i) {
+			destModels[i] = md.addNewMesh("", QString("CC %1").arg(i), true);
+			destModels[i]->updateDataMask(currentModel);
+			destMeshes[i] = &destModels[i]->cm;
+		}
+		SplitConnectedComponents(cm, cc, destMeshes, cb);
+
+		for (MeshModel* destModel : destModels) {
+			for (const std::string& txt : destModel->cm.textures) {
+				destModel->addTexture(txt, currentModel->getTexture(txt));
 			}
 
 			// init new layer
 			destModel->updateBoxAndNormals();
 			destModel->cm.Tr = currentModel->cm.Tr;
-
 		}
 		if (removeSourceMesh)
 			md.delMesh(currentModel->id());
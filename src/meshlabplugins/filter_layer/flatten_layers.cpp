@@ -0,0 +1,266 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "flatten_layers.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace vcg;
+
+namespace {
+
+/** elements copied by a single task, to balance layers of different sizes */
+const int CHUNK_SIZE = 1 << 16;
+
+struct Chunk
+{
+	int layer;
+	int begin;
+	int end;
+};
+
+std::vector<Chunk> SplitInChunks(const std::vector<int>& sizes)
+{
+	std::vector<Chunk> chunks;
+	for (int l = 0; l < (int) sizes.size(); ++l)
+		for (int b = 0; b < sizes[l]; b += CHUNK_SIZE)
+			chunks.push_back({l, b, std::min(b + CHUNK_SIZE, sizes[l])});
+	return chunks;
+}
+
+/** where the elements of a layer are copied in dest */
+struct LayerRange
+{
+	std::vector<int> vertRemap; // among the appended vertices, -1 if not copied
+	int              faceBase = 0;
+	int              edgeBase = 0;
+	std::vector<int> texRemap;
+	Matrix44m        tr;
+	Matrix33m        normalTr;
+	bool             transformed = false;
+};
+
+/**
+ * The matrix applied to the normals, as in
+ * vcg::tri::UpdateNormal::PerVertexMatrix: the linear part of tr, without
+ * its uniform scaling.
+ */
+Matrix33m NormalMatrix(const Matrix44m& tr)
+{
+	Matrix33m m(tr, 3);
+	Scalarm   scale = std::cbrt(m.Determinant());
+	if (scale != 0)
+		m *= Scalarm(1) / scale;
+	return m;
+}
+
+inline void RemapTexture(short& n, const std::vector<int>& texRemap)
+{
+	if (n >= 0 && n < (int) texRemap.size())
+		n = texRemap[n];
+}
+
+} // namespace
+
+void FlattenLayers(
+	const std::vector<const CMeshO*>& layers,
+	CMeshO&                           dest,
+	bool                              alsoUnreferenced,
+	vcg::CallBackPos*                 cb)
+{
+	const int               nLayers = (int) layers.size();
+	std::vector<LayerRange> ranges(nLayers);
+
+	// textures, in the order tri::Append would add them
+	for (int l = 0; l < nLayers; ++l) {
+		for (const std::string& txt : layers[l]->textures) {
+			auto it = std::find(dest.textures.begin(), dest.textures.end(), txt);
+			ranges[l].texRemap.push_back((int) (it - dest.textures.begin()));
+			if (it == dest.textures.end())
+				dest.textures.push_back(txt);
+		}
+	}
+
+	// vertices kept in each layer
+	std::vector<int> vertCount(nLayers, 0);
+#pragma omp parallel for schedule(dynamic)
+	for (int l = 0; l < nLayers; ++l) {
+		const CMeshO& m = *layers[l];
+		LayerRange&   r = ranges[l];
+		r.vertRemap.assign(m.vert.size(), -1);
+		for (size_t i = 0; i < m.vert.size(); ++i)
+			if (!m.vert[i].IsD())
+				r.vertRemap[i] = 0;
+		if (!alsoUnreferenced) {
+			std::vector<char> referenced(m.vert.size(), 0);
+			for (const CFaceO& f : m.face)
+				if (!f.IsD())
+					for (int j = 0; j < 3; ++j)
+						referenced[tri::Index(m, f.cV(j))] = 1;
+			for (const CEdgeO& e : m.edge)
+				if (!e.IsD())
+					for (int j = 0; j < 2; ++j)
+						referenced[tri::Index(m, e.cV(j))] = 1;
+			for (size_t i = 0; i < m.vert.size(); ++i)
+				if (!referenced[i])
+					r.vertRemap[i] = -1;
+		}
+		int cnt = 0;
+		for (int& v : r.vertRemap)
+			if (v == 0)
+				v = cnt++;
+		vertCount[l] = cnt;
+
+		r.tr       = m.Tr;
+		r.transformed = m.Tr != Matrix44m::Identity();
+		r.normalTr = NormalMatrix(m.Tr);
+	}
+
+	// ranges of each layer in dest
+	std::vector<int> vertOffset(nLayers);
+	int              vn = 0, fn = 0, en = 0;
+	for (int l = 0; l < nLayers; ++l) {
+		vertOffset[l] = vn;
+		vn += vertCount[l];
+		ranges[l].faceBase = fn;
+		fn += layers[l]->fn;
+		ranges[l].edgeBase = en;
+		en += layers[l]->en;
+	}
+	const int vertBase = (int) dest.vert.size();
+	const int faceBase = (int) dest.face.size();
+	const int edgeBase = (int) dest.edge.size();
+	tri::Allocator<CMeshO>::AddVertices(dest, vn);
+	tri::Allocator<CMeshO>::AddFaces(dest, fn);
+	tri::Allocator<CMeshO>::AddEdges(dest, en);
+
+	const bool vertNormal = tri::HasPerVertexNormal(dest);
+	const bool vertTex    = tri::HasPerVertexTexCoord(dest);
+	const bool wedgeTex   = tri::HasPerWedgeTexCoord(dest);
+
+	std::vector<int> vertSizes(nLayers), faceSizes(nLayers), edgeSizes(nLayers);
+	for (int l = 0; l < nLayers; ++l) {
+		vertSizes[l] = (int) layers[l]->vert.size();
+		faceSizes[l] = (int) layers[l]->face.size();
+		edgeSizes[l] = (int) layers[l]->edge.size();
+	}
+	std::vector<Chunk> vertChunks = SplitInChunks(vertSizes);
+	std::vector<Chunk> faceChunks = SplitInChunks(faceSizes);
+	std::vector<Chunk> edgeChunks = SplitInChunks(edgeSizes);
+	const int nChunks = (int) (vertChunks.size() + faceChunks.size() + edgeChunks.size());
+	std::atomic<int> done(0);
+	auto progress = [&]() {
+		int chunksDone = done.fetch_add(1) + 1;
+		bool mainThread = true;
+#ifdef _OPENMP
+		mainThread = omp_get_thread_num() == 0;
+#endif
+		if (cb != nullptr && mainThread)
+			cb(100 * chunksDone / nChunks, "Merging layers...");
+	};
+
+	// the deleted elements are skipped, so each element is copied after the
+	// ones preceding it in its layer
+	std::vector<std::vector<int>> faceRemap(nLayers), edgeRemap(nLayers);
+#pragma omp parallel for schedule(dynamic)
+	for (int l = 0; l < nLayers; ++l) {
+		const CMeshO& m = *layers[l];
+		for (int& v : ranges[l].vertRemap)
+			if (v >= 0)
+				v += vertOffset[l];
+		faceRemap[l].assign(m.face.size(), -1);
+		int cnt = ranges[l].faceBase + faceBase;
+		for (size_t i = 0; i < m.face.size(); ++i)
+			if (!m.face[i].IsD())
+				faceRemap[l][i] = cnt++;
+		edgeRemap[l].assign(m.edge.size(), -1);
+		cnt = ranges[l].edgeBase + edgeBase;
+		for (size_t i = 0; i < m.edge.size(); ++i)
+			if (!m.edge[i].IsD())
+				edgeRemap[l][i] = cnt++;
+	}
+
+#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < (int) vertChunks.size(); ++c) {
+		const Chunk&      ch = vertChunks[c];
+		const CMeshO&     m  = *layers[ch.layer];
+		const LayerRange& r  = ranges[ch.layer];
+		for (int i = ch.begin; i < ch.end; ++i) {
+			if (r.vertRemap[i] < 0)
+				continue;
+			CVertexO& v = dest.vert[vertBase + r.vertRemap[i]];
+			v.ImportData(m.vert[i]);
+			if (r.transformed) {
+				v.P() = r.tr * v.cP();
+				if (vertNormal)
+					v.N() = r.normalTr * v.cN();
+			}
+			if (vertTex)
+				RemapTexture(v.T().n(), r.texRemap);
+		}
+		progress();
+	}
+
+#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < (int) faceChunks.size(); ++c) {
+		const Chunk&      ch = faceChunks[c];
+		const CMeshO&     m  = *layers[ch.layer];
+		const LayerRange& r  = ranges[ch.layer];
+		for (int i = ch.begin; i < ch.end; ++i) {
+			if (faceRemap[ch.layer][i] < 0)
+				continue;
+			const CFaceO& sf = m.face[i];
+			CFaceO&       f  = dest.face[faceRemap[ch.layer][i]];
+			f.ImportData(sf);
+			for (int j = 0; j < 3; ++j) {
+				f.V(j) = &dest.vert[vertBase + r.vertRemap[tri::Index(m, sf.cV(j))]];
+				if (wedgeTex)
+					RemapTexture(f.WT(j).n(), r.texRemap);
+			}
+		}
+		progress();
+	}
+
+#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < (int) edgeChunks.size(); ++c) {
+		const Chunk&      ch = edgeChunks[c];
+		const CMeshO&     m  = *layers[ch.layer];
+		const LayerRange& r  = ranges[ch.layer];
+		for (int i = ch.begin; i < ch.end; ++i) {
+			if (edgeRemap[ch.layer][i] < 0)
+				continue;
+			const CEdgeO& se = m.edge[i];
+			CEdgeO&       e  = dest.edge[edgeRemap[ch.layer][i]];
+			e.ImportData(se);
+			for (int j = 0; j < 2; ++j)
+				e.V(j) = &dest.vert[vertBase + r.vertRemap[tri::Index(m, se.cV(j))]];
+		}
+		progress();
+	}
+}
@@ -0,0 +1,52 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef FILTER_LAYER_FLATTEN_LAYERS_H
+#define FILTER_LAYER_FLATTEN_LAYERS_H
+
+#include <vector>
+
+#include <common/ml_document/cmesh.h>
+
+/**
+ * Appends all the layers to dest, each one with its transformation matrix Tr
+ * applied to the positions and the normals of the copied vertices, as
+ * vcg::tri::Append does after transforming the layer with
+ * vcg::tri::UpdatePosition::Matrix. The layers are left untouched.
+ *
+ * The textures of the layers are added to the textures of dest, if not
+ * already present, and the texture indices are remapped.
+ * If alsoUnreferenced is false, the vertices not referenced by any face or
+ * edge are not copied.
+ *
+ * dest must be empty and have all the optional components of the layers
+ * enabled. It is sized once for all the layers, that are then copied
+ * concurrently, each one in its own range of the vectors of dest.
+ */
+void FlattenLayers(
+	const std::vector<const CMeshO*>& layers,
+	CMeshO&                           dest,
+	bool                              alsoUnreferenced,
+	vcg::CallBackPos*                 cb = nullptr);
+
+#endif // FILTER_LAYER_FLATTEN_LAYERS_H
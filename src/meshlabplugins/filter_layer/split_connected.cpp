@@ -0,0 +1,152 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "split_connected.h"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace vcg;
+
+namespace {
+
+/**
+ * Keeps in d only the textures of m referenced by the texture coordinates of
+ * d, renumbering the texture indices.
+ */
+void CopyUsedTextures(const CMeshO& m, CMeshO& d, bool wedgeTex, bool vertTex)
+{
+	const int        nTex = (int) m.textures.size();
+	std::vector<int> texMap(nTex, -1);
+	auto mark = [&](short n) {
+		if (n >= 0 && n < nTex)
+			texMap[n] = 0;
+	};
+	if (wedgeTex)
+		for (const CFaceO& f : d.face)
+			for (int j = 0; j < 3; ++j)
+				mark(f.cWT(j).n());
+	if (vertTex)
+		for (const CVertexO& v : d.vert)
+			mark(v.cT().n());
+
+	for (int t = 0; t < nTex; ++t) {
+		if (texMap[t] == 0) {
+			texMap[t] = (int) d.textures.size();
+			d.textures.push_back(m.textures[t]);
+		}
+	}
+
+	auto remap = [&](short& n) {
+		if (n >= 0 && n < nTex)
+			n = texMap[n];
+	};
+	if (wedgeTex)
+		for (CFaceO& f : d.face)
+			for (int j = 0; j < 3; ++j)
+				remap(f.WT(j).n());
+	if (vertTex)
+		for (CVertexO& v : d.vert)
+			remap(v.T().n());
+}
+
+} // namespace
+
+void SplitConnectedComponents(
+	const CMeshO&                       m,
+	const meshlab::ConnectedComponents& cc,
+	const std::vector<CMeshO*>&         dest,
+	vcg::CallBackPos*                   cb)
+{
+	const int nComp = (int) cc.size();
+
+	// faces of each component, in index order
+	std::vector<int> compStart(nComp + 1, 0);
+	for (int c : cc.faceComponent)
+		if (c >= 0)
+			++compStart[c + 1];
+	std::partial_sum(compStart.begin(), compStart.end(), compStart.begin());
+	std::vector<int> compFaces(compStart[nComp]);
+	std::vector<int> fill(compStart.begin(), compStart.end() - 1);
+	for (int i = 0; i < (int) cc.faceComponent.size(); ++i)
+		if (cc.faceComponent[i] >= 0)
+			compFaces[fill[cc.faceComponent[i]]++] = i;
+	fill.clear();
+
+	const bool wedgeTex = tri::HasPerWedgeTexCoord(m);
+	const bool vertTex  = tri::HasPerVertexTexCoord(m);
+
+	std::atomic<int> done(0);
+#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < nComp; ++c) {
+		CMeshO&    d     = *dest[c];
+		const int* faces = compFaces.data() + compStart[c];
+		const int  nf    = compStart[c + 1] - compStart[c];
+
+		// vertices of the component, in index order
+		std::vector<int> verts;
+		verts.reserve(3 * nf);
+		for (int k = 0; k < nf; ++k)
+			for (int j = 0; j < 3; ++j)
+				verts.push_back((int) tri::Index(m, m.face[faces[k]].cV(j)));
+		std::sort(verts.begin(), verts.end());
+		verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+
+		tri::Allocator<CMeshO>::AddVertices(d, verts.size());
+		for (size_t k = 0; k < verts.size(); ++k) {
+			d.vert[k].ImportData(m.vert[verts[k]]);
+			d.vert[k].ClearS();
+		}
+
+		tri::Allocator<CMeshO>::AddFaces(d, nf);
+		for (int k = 0; k < nf; ++k) {
+			const CFaceO& sf = m.face[faces[k]];
+			CFaceO&       df = d.face[k];
+			df.ImportData(sf);
+			df.ClearS();
+			for (int j = 0; j < 3; ++j) {
+				int vi = (int) tri::Index(m, sf.cV(j));
+				df.V(j) =
+					&d.vert[std::lower_bound(verts.begin(), verts.end(), vi) - verts.begin()];
+			}
+		}
+
+		if (wedgeTex || vertTex)
+			CopyUsedTextures(m, d, wedgeTex, vertTex);
+		else
+			d.textures = m.textures;
+
+		int compDone = done.fetch_add(1) + 1;
+		bool mainThread = true;
+#ifdef _OPENMP
+		mainThread = omp_get_thread_num() == 0;
+#endif
+		if (cb != nullptr && mainThread)
+			cb(100 * compDone / nComp, "Splitting connected components...");
+	}
+}
@@ -0,0 +1,52 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef FILTER_LAYER_SPLIT_CONNECTED_H
+#define FILTER_LAYER_SPLIT_CONNECTED_H
+
+#include <vector>
+
+#include <common/ml_document/cmesh.h>
+#include <common/utilities/connected_components.h>
+
+/**
+ * Copies each connected component of m in its own mesh of dest, indexed as
+ * cc.components, with the same result of appending the selected component
+ * with vcg::tri::Append: the vertices and the faces keep their relative
+ * order and all their data, selection excluded.
+ *
+ * The destination meshes must be empty and have the same optional components
+ * of m enabled. Their textures are only the ones of m actually referenced by
+ * the texture coordinates of the component, with the texture indices
+ * remapped; when m has no texture coordinates all the textures are kept.
+ *
+ * The faces are bucketed by component in a single pass, then the components
+ * are filled concurrently.
+ */
+void SplitConnectedComponents(
+	const CMeshO&                       m,
+	const meshlab::ConnectedComponents& cc,
+	const std::vector<CMeshO*>&         dest,
+	vcg::CallBackPos*                   cb = nullptr);
+
+#endif // FILTER_LAYER_SPLIT_CONNECTED_H
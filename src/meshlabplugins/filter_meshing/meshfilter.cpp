@@ -36,6 +36,7 @@
 #include <vcg/complex/algorithms/isotropic_remeshing.h>
 #include <vcg/space/fitting3.h>
 #include <wrap/gl/glu_tessellator_cap.h>
+#include "parallel_remeshing.h"
 #include "quadric_simp.h"
 
 using namespace std;
@@ -110,6 +111,7 @@ ExtraMeshFilterPlugin::ExtraMeshFilterPlugin(void)
 	lastisor_SwapFlag            = true;
 	lastisor_ProjectFlag         = true;
 	lastisor_FeatureDeg          = 30.0f;
+	lastisor_ParallelRegions     = false;
 }
 
 QString ExtraMeshFilterPlugin::pluginName() const
@@ -476,6 +478,7 @@ RichParameterList ExtraMeshFilterPlugin::initParameterList(const QAction * actio
 		parlst.addParam(RichBool ("SwapFlag", lastisor_SwapFlag, "Edge-Swap Step", "If checked the remeshing operations will include a edge-swap step, aimed at improving the vertex valence of the resulting mesh."));
 		parlst.addParam(RichBool ("SmoothFlag", lastisor_SmoothFlag, "Smooth Step", "If checked the remeshing operations will include a smoothing step, aimed at relaxing the vertex positions in a Laplacian sense."));
 		parlst.addParam(RichBool ("ReprojectFlag", lastisor_ProjectFlag, "Reproject Step", "If checked the remeshing operations will include a step to reproject the mesh vertices on the original surface."));
+		parlst.addParam(RichBool ("ParallelRegions", lastisor_ParallelRegions, "Remesh regions in parallel", "If checked large meshes are split in regions that are remeshed concurrently, keeping fixed the faces along the region boundaries; these faces are then remeshed in a final pass."));
 
 		break;
 	case FP_CLOSE_HOLES:
@@ -1015,10 +1018,6 @@ std::map<std::string, QVariant> ExtraMeshFilterPlugin::applyFilter(
 
 		m.updateBoxAndNormals();
 
-		CMeshO toProjectCopy = m.cm;
-
-		toProjectCopy.face.EnableMark();
-
 		tri::IsotropicRemeshing<CMeshO>::Params params;
 		params.SetTargetLen(par.getAbsPerc("TargetLen"));
 		params.SetFeatureAngleDeg(par.getFloat("FeatureDeg"));
@@ -1045,13 +1044,21 @@ std::map<std::string, QVariant> ExtraMeshFilterPlugin::applyFilter(
 		lastisor_SmoothFlag          = params.smoothFlag;
 		lastisor_ProjectFlag         = params.projectFlag;
 		lastisor_CheckSurfDist       = params.surfDistCheck;
+		lastisor_ParallelRegions     = par.getBool("ParallelRegions");
 
 		lastisor_MaxSurfDist= par.getFloat("MaxSurfDist");
 		lastisor_FeatureDeg = par.getFloat("FeatureDeg");
 
 		try
 		{
-			tri::IsotropicRemeshing<CMeshO>::Do(m.cm, toProjectCopy, params, cb);
+			if (lastisor_ParallelRegions) {
+				ParallelIsotropicRemeshing(m.cm, params, cb);
+			}
+			else {
+				CMeshO toProjectCopy = m.cm;
+				toProjectCopy.face.EnableMark();
+				tri::IsotropicRemeshing<CMeshO>::Do(m.cm, toProjectCopy, params, cb);
+			}
 		}
 		catch(vcg::MissingPreconditionException& excp)
 		{
@@ -127,6 +127,7 @@ protected:
 	bool lastisor_SwapFlag;
 	bool lastisor_SmoothFlag;
 	bool lastisor_ProjectFlag;
+	bool lastisor_ParallelRegions;
 
 };
 #endif
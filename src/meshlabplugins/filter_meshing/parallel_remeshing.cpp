@@ -0,0 +1,445 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "parallel_remeshing.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <vcg/complex/algorithms/clean.h>
+
+using namespace vcg;
+
+namespace {
+
+typedef tri::IsotropicRemeshing<CMeshO> Remeshing;
+typedef std::array<int, 3>              Triangle;
+
+const int MIN_REGION_FACES = 100000;
+const int LOCKED_RINGS     = 2;
+
+/* The remeshed faces of a patch, in terms of the vertices of the whole mesh:
+ * an index v >= 0 is a vertex of the mesh, v < 0 is the (-v-1)-th new vertex.
+ * Positions and attributes are read back from the remeshed copy, or from the
+ * whole mesh when the patch was left as it is (copy is null) */
+struct PatchResult
+{
+	std::unique_ptr<CMeshO>          copy;
+	std::vector<int>                 newVerts;   // vertices of the copy
+	std::vector<std::pair<int, int>> movedVerts; // vertex of the mesh, of the copy
+	std::vector<Triangle>            faces;
+	std::vector<int>                 faceSource; // face of the copy, or of the mesh
+	std::vector<char>                faceSelected;
+	std::vector<char>                faceLocked;
+};
+
+/* Allocates a user bit of the faces, released on every exit path */
+struct FaceBitGuard
+{
+	const int bit;
+	FaceBitGuard() : bit(CFaceO::NewBitFlag()) {}
+	~FaceBitGuard() { CFaceO::DeleteBitFlag(bit); }
+};
+
+/* Enables on sub the optional attributes enabled on m, so that ImportData
+ * carries them and the remeshing interpolates them */
+void EnableAttributes(const CMeshO& m, CMeshO& sub)
+{
+	if (m.vert.IsTexCoordEnabled())
+		sub.vert.EnableTexCoord();
+	if (m.vert.IsCurvatureDirEnabled())
+		sub.vert.EnableCurvatureDir();
+	if (m.vert.IsRadiusEnabled())
+		sub.vert.EnableRadius();
+	if (m.face.IsQualityEnabled())
+		sub.face.EnableQuality();
+	if (m.face.IsColorEnabled())
+		sub.face.EnableColor();
+	if (m.face.IsCurvatureDirEnabled())
+		sub.face.EnableCurvatureDir();
+	if (m.face.IsWedgeTexCoordEnabled())
+		sub.face.EnableWedgeTexCoord();
+}
+
+/* Copies position and attributes of src, keeping the flags of dst */
+template <class Element>
+void ImportKeepingFlags(Element& dst, const Element& src)
+{
+	int flags = dst.Flags();
+	dst.ImportData(src);
+	dst.Flags() = flags;
+}
+
+/* Splits the faces in count regions of about the same size, cutting each time
+ * the longest side of the bounding box of the barycenters */
+std::vector<std::vector<int>> SplitInRegions(const CMeshO& m, int count)
+{
+	std::vector<int>     faces;
+	std::vector<Point3m> bary(m.face.size());
+	for (int i = 0; i < (int) m.face.size(); ++i) {
+		if (!m.face[i].IsD()) {
+			faces.push_back(i);
+			bary[i] = Barycenter(m.face[i]);
+		}
+	}
+
+	struct Range
+	{
+		int begin, end, count;
+	};
+	std::vector<std::vector<int>> regions;
+	std::vector<Range>            stack(1, {0, (int) faces.size(), count});
+	while (!stack.empty()) {
+		Range r = stack.back();
+		stack.pop_back();
+		if (r.count <= 1) {
+			regions.emplace_back(faces.begin() + r.begin, faces.begin() + r.end);
+			continue;
+		}
+		Box3m box;
+		for (int i = r.begin; i < r.end; ++i)
+			box.Add(bary[faces[i]]);
+		int axis      = box.MaxDim();
+		int leftCount = r.count / 2;
+		int mid       = r.begin + int((long long) (r.end - r.begin) * leftCount / r.count);
+		std::nth_element(
+			faces.begin() + r.begin,
+			faces.begin() + mid,
+			faces.begin() + r.end,
+			[&](int a, int b) { return bary[a][axis] < bary[b][axis]; });
+		stack.push_back({r.begin, mid, leftCount});
+		stack.push_back({mid, r.end, r.count - leftCount});
+	}
+	return regions;
+}
+
+/* Number of faces incident on each vertex */
+std::vector<int> FaceValence(const CMeshO& m)
+{
+	std::vector<int> valence(m.vert.size(), 0);
+	for (const CFaceO& f : m.face)
+		if (!f.IsD())
+			for (int k = 0; k < 3; ++k)
+				valence[tri::Index(m, f.cV(k))]++;
+	return valence;
+}
+
+/* Remeshes a copy of the given faces of m; the faces within LOCKED_RINGS rings
+ * from the vertices shared with the rest of the mesh are not changed, and
+ * neither are the faces out of the selection if selectedOnly is set (the
+ * selection is kept in the user bit selBit of the faces of the copy) */
+PatchResult RemeshPatch(
+	const CMeshO&            m,
+	const std::vector<int>&  patch,
+	const std::vector<int>&  valence,
+	const Remeshing::Params& params,
+	bool                     selectedOnly,
+	int                      selBit)
+{
+	std::vector<int> verts;
+	verts.reserve(patch.size() * 3);
+	for (int f : patch)
+		for (int k = 0; k < 3; ++k)
+			verts.push_back((int) tri::Index(m, m.face[f].cV(k)));
+	std::sort(verts.begin(), verts.end());
+	verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+	auto localIndex = [&](int v) {
+		return int(std::lower_bound(verts.begin(), verts.end(), v) - verts.begin());
+	};
+
+	std::unique_ptr<CMeshO> copy(new CMeshO());
+	CMeshO&                 sub = *copy;
+	EnableAttributes(m, sub);
+	sub.vert.EnableVFAdjacency();
+	sub.vert.EnableMark();
+	sub.face.EnableFFAdjacency();
+	sub.face.EnableVFAdjacency();
+	sub.face.EnableMark();
+	tri::Allocator<CMeshO>::AddVertices(sub, verts.size());
+	for (size_t i = 0; i < verts.size(); ++i)
+		ImportKeepingFlags(sub.vert[i], m.vert[verts[i]]);
+	tri::Allocator<CMeshO>::AddFaces(sub, patch.size());
+	std::vector<int> patchValence(verts.size(), 0);
+	for (size_t i = 0; i < patch.size(); ++i) {
+		ImportKeepingFlags(sub.face[i], m.face[patch[i]]);
+		for (int k = 0; k < 3; ++k) {
+			int v            = localIndex((int) tri::Index(m, m.face[patch[i]].cV(k)));
+			sub.face[i].V(k) = &sub.vert[v];
+			patchValence[v]++;
+		}
+		if (m.face[patch[i]].IsS())
+			sub.face[i].SetUserBit(selBit);
+	}
+
+	// the vertices shared with other faces stay where they are, together with
+	// some rings of faces around them
+	std::vector<char> sharedVert(verts.size());
+	for (size_t v = 0; v < verts.size(); ++v)
+		sharedVert[v] = patchValence[v] < valence[verts[v]];
+	std::vector<char> lockedVert = sharedVert;
+	std::vector<char> lockedFace(patch.size(), 0);
+	for (int ring = 0; ring < LOCKED_RINGS; ++ring) {
+		for (size_t i = 0; i < patch.size(); ++i)
+			for (int k = 0; k < 3; ++k)
+				if (lockedVert[tri::Index(sub, sub.face[i].V(k))])
+					lockedFace[i] = 1;
+		for (size_t i = 0; i < patch.size(); ++i)
+			if (lockedFace[i])
+				for (int k = 0; k < 3; ++k)
+					lockedVert[tri::Index(sub, sub.face[i].V(k))] = 1;
+	}
+	bool anyFree = false;
+	for (size_t i = 0; i < patch.size(); ++i) {
+		if (!lockedFace[i] && (!selectedOnly || sub.face[i].IsUserBit(selBit))) {
+			sub.face[i].SetS();
+			anyFree = true;
+		}
+	}
+
+	if (anyFree) {
+		tri::UpdateSelection<CMeshO>::VertexFromFaceStrict(sub);
+		tri::UpdateBounding<CMeshO>::Box(sub);
+		tri::UpdateNormal<CMeshO>::PerVertexNormalizedPerFaceNormalized(sub);
+		CMeshO toProject = sub;
+		toProject.face.EnableMark();
+
+		CMeshO::PerVertexAttributeHandle<int> gid =
+			tri::Allocator<CMeshO>::GetPerVertexAttribute<int>(sub, std::string("globalIndex"));
+		for (size_t v = 0; v < verts.size(); ++v)
+			gid[v] = verts[v] + 1; // 0 for the vertices added by the remeshing
+
+		Remeshing::Params patchParams = params;
+		patchParams.selectedOnly      = true;
+		Remeshing::Do(sub, toProject, patchParams);
+
+		PatchResult      res;
+		std::vector<int> resultIndex(sub.vert.size());
+		for (size_t v = 0; v < sub.vert.size(); ++v) {
+			if (sub.vert[v].IsD())
+				continue;
+			int g = gid[v] - 1;
+			if (g >= 0) {
+				resultIndex[v] = g;
+				if (!sharedVert[localIndex(g)])
+					res.movedVerts.push_back({g, (int) v});
+			}
+			else {
+				resultIndex[v] = -(int) res.newVerts.size() - 1;
+				res.newVerts.push_back((int) v);
+			}
+		}
+		for (size_t i = 0; i < sub.face.size(); ++i) {
+			const CFaceO& f = sub.face[i];
+			if (f.IsD())
+				continue;
+			res.faces.push_back(
+				{resultIndex[tri::Index(sub, f.cV(0))],
+				 resultIndex[tri::Index(sub, f.cV(1))],
+				 resultIndex[tri::Index(sub, f.cV(2))]});
+			res.faceSource.push_back((int) i);
+			res.faceSelected.push_back(f.IsUserBit(selBit));
+			// unselected only because of the locked rings
+			res.faceLocked.push_back(!f.IsS() && (!selectedOnly || f.IsUserBit(selBit)));
+		}
+		tri::Allocator<CMeshO>::DeletePerVertexAttribute(sub, gid);
+		res.copy = std::move(copy);
+		return res;
+	}
+
+	// nothing to remesh: the patch is left as it is
+	PatchResult res;
+	for (size_t i = 0; i < patch.size(); ++i) {
+		const CFaceO& f = m.face[patch[i]];
+		res.faces.push_back(
+			{(int) tri::Index(m, f.cV(0)), (int) tri::Index(m, f.cV(1)), (int) tri::Index(m, f.cV(2))});
+		res.faceSource.push_back(patch[i]);
+		res.faceSelected.push_back(f.IsS());
+		res.faceLocked.push_back(lockedFace[i] && (!selectedOnly || f.IsS()));
+	}
+	return res;
+}
+
+/* Replaces the faces of the patches with the remeshed ones, together with
+ * their vertex and face attributes; returns the indices of the new faces that
+ * were locked */
+std::vector<int> ApplyPatches(
+	CMeshO&                              m,
+	const std::vector<std::vector<int>>& patches,
+	const std::vector<PatchResult>&      results)
+{
+	size_t nVerts = 0, nFaces = 0;
+	for (size_t p = 0; p < patches.size(); ++p) {
+		for (int f : patches[p])
+			tri::Allocator<CMeshO>::DeleteFace(m, m.face[f]);
+		for (const std::pair<int, int>& mv : results[p].movedVerts)
+			ImportKeepingFlags(m.vert[mv.first], results[p].copy->vert[mv.second]);
+		nVerts += results[p].newVerts.size();
+		nFaces += results[p].faces.size();
+	}
+
+	size_t firstVert = m.vert.size();
+	size_t firstFace = m.face.size();
+	if (nVerts > 0)
+		tri::Allocator<CMeshO>::AddVertices(m, nVerts);
+	if (nFaces > 0)
+		tri::Allocator<CMeshO>::AddFaces(m, nFaces);
+
+	std::vector<int> locked;
+	size_t           vi = firstVert, fi = firstFace;
+	for (const PatchResult& res : results) {
+		for (size_t i = 0; i < res.newVerts.size(); ++i)
+			ImportKeepingFlags(m.vert[vi + i], res.copy->vert[res.newVerts[i]]);
+		// the faces of an untouched patch are still in m, only marked deleted
+		const CMeshO& source = res.copy ? *res.copy : m;
+		for (size_t i = 0; i < res.faces.size(); ++i, ++fi) {
+			CFaceO& f = m.face[fi];
+			ImportKeepingFlags(f, source.face[res.faceSource[i]]);
+			for (int k = 0; k < 3; ++k) {
+				int v  = res.faces[i][k];
+				f.V(k) = &m.vert[v >= 0 ? v : vi + (-v - 1)];
+			}
+			if (res.faceSelected[i])
+				f.SetS();
+			else
+				f.ClearS();
+			if (res.faceLocked[i])
+				locked.push_back((int) fi);
+		}
+		vi += res.newVerts.size();
+	}
+	return locked;
+}
+
+/* The given faces, with all the faces within the given number of rings */
+std::vector<int> GrowFaceSet(const CMeshO& m, const std::vector<int>& faces, int rings)
+{
+	std::vector<int> start(m.vert.size() + 1, 0);
+	for (const CFaceO& f : m.face)
+		if (!f.IsD())
+			for (int k = 0; k < 3; ++k)
+				start[tri::Index(m, f.cV(k)) + 1]++;
+	for (size_t v = 0; v < m.vert.size(); ++v)
+		start[v + 1] += start[v];
+	std::vector<int> incident(start.back());
+	std::vector<int> pos(start.begin(), start.end() - 1);
+	for (int i = 0; i < (int) m.face.size(); ++i)
+		if (!m.face[i].IsD())
+			for (int k = 0; k < 3; ++k)
+				incident[pos[tri::Index(m, m.face[i].cV(k))]++] = i;
+
+	std::vector<char> inSet(m.face.size(), 0);
+	std::vector<int>  grown = faces;
+	for (int f : grown)
+		inSet[f] = 1;
+	for (int ring = 0; ring < rings; ++ring) {
+		size_t n = grown.size();
+		for (size_t i = 0; i < n; ++i) {
+			for (int k = 0; k < 3; ++k) {
+				size_t v = tri::Index(m, m.face[grown[i]].cV(k));
+				for (int j = start[v]; j < start[v + 1]; ++j) {
+					if (!inSet[incident[j]]) {
+						inSet[incident[j]] = 1;
+						grown.push_back(incident[j]);
+					}
+				}
+			}
+		}
+	}
+	return grown;
+}
+
+} // namespace
+
+void ParallelIsotropicRemeshing(
+	CMeshO&                                      m,
+	vcg::tri::IsotropicRemeshing<CMeshO>::Params params,
+	vcg::CallBackPos*                            cb)
+{
+	int nThreads = 1;
+#ifdef _OPENMP
+	nThreads = omp_get_max_threads();
+#endif
+	int nRegions = std::min(m.fn / MIN_REGION_FACES, 4 * nThreads);
+	if (nRegions < 2 || nThreads == 1) {
+		CMeshO toProjectCopy = m;
+		toProjectCopy.face.EnableMark();
+		Remeshing::Do(m, toProjectCopy, params, cb);
+		return;
+	}
+
+	const bool         selectedOnly = params.selectedOnly;
+	const FaceBitGuard selection;
+	const int          selBit = selection.bit;
+
+	// remeshing of the regions
+	std::vector<std::vector<int>> regions = SplitInRegions(m, nRegions);
+	std::vector<int>              valence = FaceValence(m);
+	std::vector<PatchResult>      results(regions.size());
+	std::string                   error;
+	std::atomic<int>              done(0);
+#pragma omp parallel for schedule(dynamic)
+	for (int r = 0; r < (int) regions.size(); ++r) {
+		try {
+			results[r] = RemeshPatch(m, regions[r], valence, params, selectedOnly, selBit);
+		}
+		catch (vcg::MissingPreconditionException& e) {
+#pragma omp critical(parallelRemeshingError)
+			error = e.what();
+		}
+		int  regionsDone = done.fetch_add(1) + 1;
+		bool mainThread = true;
+#ifdef _OPENMP
+		mainThread = omp_get_thread_num() == 0;
+#endif
+		if (cb != nullptr && mainThread)
+			cb(80 * regionsDone / (int) regions.size(), "Remeshing regions...");
+	}
+	if (!error.empty())
+		throw vcg::MissingPreconditionException(error);
+	std::vector<int> band = ApplyPatches(m, regions, results);
+	results.clear();
+
+	// remeshing of the faces left locked along the region boundaries
+	if (cb != nullptr)
+		cb(80, "Remeshing region boundaries...");
+	std::vector<std::vector<int>> bandPatch(1, GrowFaceSet(m, band, LOCKED_RINGS));
+	valence = FaceValence(m);
+	results.push_back(RemeshPatch(m, bandPatch[0], valence, params, selectedOnly, selBit));
+	ApplyPatches(m, bandPatch, results);
+	results.clear();
+
+	tri::Clean<CMeshO>::RemoveUnreferencedVertex(m);
+	tri::Allocator<CMeshO>::CompactEveryVector(m);
+	tri::UpdateTopology<CMeshO>::FaceFace(m);
+	tri::UpdateTopology<CMeshO>::VertexFace(m);
+	if (cb != nullptr)
+		cb(100, "Remeshing done");
+}
@@ -0,0 +1,49 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef FILTER_MESHING_PARALLEL_REMESHING_H
+#define FILTER_MESHING_PARALLEL_REMESHING_H
+
+#include <common/ml_document/cmesh.h>
+#include <vcg/complex/algorithms/isotropic_remeshing.h>
+
+/**
+ * Isotropic remeshing with the same parameters of
+ * vcg::tri::IsotropicRemeshing, run concurrently on regions of the mesh.
+ *
+ * The faces are split in regions of balanced size, that are remeshed
+ * independently; in each region the two rings of faces around the vertices
+ * shared with other regions are locked, so the regions can be stitched back
+ * along the untouched shared vertices. The band of the locked faces, widened
+ * by two rings, is then remeshed with its own outer rings locked.
+ *
+ * The mesh must be compact and have FF and VF adjacency, face and vertex
+ * marks enabled, as required by the vcg remeshing; meshes too small to be
+ * split are remeshed as a whole.
+ */
+void ParallelIsotropicRemeshing(
+	CMeshO&                                      m,
+	vcg::tri::IsotropicRemeshing<CMeshO>::Params params,
+	vcg::CallBackPos*                            cb);
+
+#endif // FILTER_MESHING_PARALLEL_REMESHING_H
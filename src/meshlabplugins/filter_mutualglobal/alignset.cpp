@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #include <GL/glew.h>
@@ -30,6 +32,7 @@ AlignSet::AlignSet()
 	: mode(COMBINE)
 	, target(NULL)
 	, render(NULL)
+	, useCPU(false)
 	, vbo(0)
 	, nbo(0)
 	, cbo(0)
@@ -291,6 +294,11 @@ void AlignSet::initializeGL() {
 
 bool AlignSet::ProjectedImageChanged(const QImage & img)
 {
+	if (useCPU) {
+		projectors[0].image = img.convertToFormat(QImage::Format_ARGB32).scaled(wt,ht);
+		return true;
+	}
+
 	QImage tmp = QGLWidget::convertToGLFormat(img);
 	tmp=tmp.scaled(wt,ht);
 	//tmp.save("pippo.png");
@@ -337,6 +345,12 @@ bool AlignSet::ProjectedImageChanged(const QImage & img)
 
 bool AlignSet::ProjectedMultiImageChanged()
 {
+	if (useCPU) {
+		for (int j = 0; j < 3; j++)
+			projectors[j].image = arcImages[j]->convertToFormat(QImage::Format_ARGB32).scaled(wt,ht);
+		return true;
+	}
+
 	assert(glGetError() == 0);
 
 	glPushAttrib(GL_ALL_ATTRIB_BITS);
@@ -452,6 +466,11 @@ bool AlignSet::ProjectedMultiImageChanged()
 
 bool AlignSet::RenderShadowMap(void)
 {
+	if (useCPU) {
+		renderProjector(projectors[0], shotPro);
+		return true;
+	}
+
 	glPushAttrib(GL_ALL_ATTRIB_BITS);
 
 	assert(glGetError() == 0);
@@ -555,6 +574,11 @@ bool AlignSet::RenderShadowMap(void)
 
 bool AlignSet::RenderMultiShadowMap(void)
 {
+	if (useCPU) {
+		for (int j = 0; j < 3; j++)
+			renderProjector(projectors[j], *arcShots[j]);
+		return true;
+	}
 
 	glPushAttrib(GL_ALL_ATTRIB_BITS);
 
@@ -942,7 +966,58 @@ void AlignSet::resize(int max_side) {
 #endif
 }
 
+void AlignSet::updateMeshBuffers() {
+  if (useCPU) return; //the rasterizer reads the mesh directly
+
+  vcg::Point3f *vertices = new vcg::Point3f[mesh->vn];
+  vcg::Point3f *normals = new vcg::Point3f[mesh->vn];
+  vcg::Color4b *colors = new vcg::Color4b[mesh->vn];
+  unsigned int *indices = new unsigned int[mesh->fn*3];
+
+  for(int i = 0; i < mesh->vn; i++) {
+    vertices[i] = mesh->vert[i].P();
+    normals[i] = mesh->vert[i].N();
+    colors[i] = mesh->vert[i].C();
+  }
+
+  for(int i = 0; i < mesh->fn; i++)
+    for(int k = 0; k < 3; k++)
+      indices[k+i*3] = mesh->face[i].V(k) - &*mesh->vert.begin();
+
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB, vbo);
+  glBufferDataARB(GL_ARRAY_BUFFER_ARB, mesh->vn*sizeof(vcg::Point3f),
+                  vertices, GL_STATIC_DRAW_ARB);
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB, nbo);
+  glBufferDataARB(GL_ARRAY_BUFFER_ARB, mesh->vn*sizeof(vcg::Point3f),
+                  normals, GL_STATIC_DRAW_ARB);
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB, cbo);
+  glBufferDataARB(GL_ARRAY_BUFFER_ARB, mesh->vn*sizeof(vcg::Color4b),
+                  colors, GL_STATIC_DRAW_ARB);
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+
+  glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, ibo);
+  glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mesh->fn*3*sizeof(unsigned int),
+                  indices, GL_STATIC_DRAW_ARB);
+  glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+
+  // it is safe to delete after copying data to VBO
+  delete []vertices;
+  delete []normals;
+  delete []colors;
+  delete []indices;
+}
+
 void AlignSet::renderScene(vcg::Shot<Scalarm> &view, int component, bool save) {
+  if (useCPU) {
+    renderSceneCPU(view);
+    delete [] render;
+    render = new unsigned char[wt*ht];
+    readRender(component);
+    if (save)
+      rend.save("rendering.jpg");
+    return;
+  }
+
   QSize fbosize(wt,ht);
   QGLFramebufferObjectFormat frmt;
   frmt.setInternalTextureFormat(GL_RGBA);
@@ -1230,6 +1305,13 @@ void AlignSet::renderScene(vcg::Shot<Scalarm> &view, int component, bool save) {
 }
 
 void AlignSet::readRender(int component) {
+  if (useCPU) {
+    if (component < 4)
+      for (int i = 0; i < wt*ht; i++)
+        render[i] = frame[i][component];
+    return;
+  }
+
   QSize fbosize(wt,ht);
   QGLFramebufferObjectFormat frmt;
   frmt.setInternalTextureFormat(GL_RGBA);
@@ -1251,6 +1333,145 @@ void AlignSet::readRender(int component) {
   fbo.release();
 }
 
+void AlignSet::renderProjector(Projector &pr, const vcg::Shot<Scalarm> &shot) {
+  pr.shot = shot;
+  if (pr.depth.width() != wt || pr.depth.height() != ht)
+    pr.depth.resize(wt, ht);
+  pr.depth.render(*mesh, pr.shot);
+
+  Scalarm _near=0.1, _far=10000;
+  GlShot< vcg::Shot<Scalarm> >::GetNearFarPlanes(pr.shot, mesh->bbox, _near, _far);
+  if(_near <= 0) _near = 0.1;
+  if(_far < _near) _far = 1000;
+  pr.nearPlane = 0.5*_near;
+  pr.farPlane = 2*_far;
+}
+
+// Color of the projected image at the world point p, as sampled by the
+// projected texture shaders: false if p is outside the frustum or in shadow.
+bool AlignSet::projectedColor(const Projector &pr, const Point3m &p, vcg::Point4f &color) const {
+  Scalarm z = pr.shot.ConvertWorldToCameraCoordinates(p)[2];
+  if (z <= 0) return false;
+  vcg::Point2<Scalarm> pp = pr.shot.Project(p);
+  double u = pp[0]/pr.shot.Intrinsics.ViewportPx[0];
+  double v = pp[1]/pr.shot.Intrinsics.ViewportPx[1];
+  if (u < 0 || u > 1 || v < 0 || v > 1) return false;
+
+  //the shadow test compares window depths with a fixed tolerance
+  int x = std::min(int(u*pr.depth.width()), pr.depth.width()-1);
+  int y = std::min(int(v*pr.depth.height()), pr.depth.height()-1);
+  double n = pr.nearPlane, f = pr.farPlane;
+  double shadow = pr.depth.depth(x, y);
+  double depth = (1/n - 1/z) / (1/n - 1/f);
+  double shadowDepth = std::isinf(shadow) ? 1.0 : (1/n - 1/shadow) / (1/n - 1/f);
+  if (depth - shadowDepth >= 0.001) return false;
+
+  x = std::min(int(u*pr.image.width()), pr.image.width()-1);
+  y = std::min(int(v*pr.image.height()), pr.image.height()-1);
+  QRgb c = pr.image.pixel(x, pr.image.height()-1-y);
+  color = vcg::Point4f(qRed(c), qGreen(c), qBlue(c), qAlpha(c)) / 255.0f;
+  return true;
+}
+
+// Same shading of the programs created in initializeGL, on the visibility
+// buffer of the rasterizer: the vertex attributes are moved to eye space and
+// interpolated in each pixel. The shadow maps of the projected modes are
+// rendered by RenderShadowMap and RenderMultiShadowMap as on the GPU.
+void AlignSet::renderSceneCPU(vcg::Shot<Scalarm> &view) {
+  if (rasterizer.width() != wt || rasterizer.height() != ht)
+    rasterizer.resize(wt, ht);
+  rasterizer.render(*mesh, view);
+
+  const vcg::Matrix44<Scalarm> rot = view.Extrinsics.Rot();
+  const Point3m viewpoint = view.GetViewPoint();
+  const int nv = (int) mesh->vert.size();
+  std::vector<vcg::Point4f> colors(nv);
+  std::vector<vcg::Point3f> normals(nv), reflections(nv);
+#pragma omp parallel for
+  for (int i = 0; i < nv; i++) {
+    const CVertexO &v = mesh->vert[i];
+    if (v.IsD()) continue;
+    colors[i] = vcg::Point4f(v.cC()[0], v.cC()[1], v.cC()[2], v.cC()[3]) / 255.0f;
+    Point3m n = rot * v.cN();
+    normals[i] = vcg::Point3f::Construct(n);
+    n.Normalize();
+    Point3m position = rot * (v.cP() - viewpoint);
+    reflections[i] = vcg::Point3f::Construct(position - n * (2 * (n * position)));
+  }
+
+  frame.resize(wt*ht);
+#pragma omp parallel for schedule(dynamic)
+  for (int y = 0; y < ht; y++) {
+    for (int x = 0; x < wt; x++) {
+      vcg::Point4f out(0, 0, 0, 0); //clear color
+      int e = rasterizer.element(x, y);
+      if (e >= 0) {
+        int vi[3] = {e, e, e};
+        Point3m b(1, 0, 0);
+        if (!rasterizer.isPointCloud()) {
+          for (int k = 0; k < 3; k++)
+            vi[k] = (int) vcg::tri::Index(*mesh, mesh->face[e].cV(k));
+          b = rasterizer.barycentric(x, y);
+        }
+        float b0 = b[0], b1 = b[1], b2 = b[2];
+        vcg::Point4f color = colors[vi[0]]*b0 + colors[vi[1]]*b1 + colors[vi[2]]*b2;
+        vcg::Point3f normal = normals[vi[0]]*b0 + normals[vi[1]]*b1 + normals[vi[2]]*b2;
+        vcg::Point3f reflection = reflections[vi[0]]*b0 + reflections[vi[1]]*b1 + reflections[vi[2]]*b2;
+        vcg::Point3f ncolor = normal.Normalize()*0.5f + vcg::Point3f(0.5f, 0.5f, 0.5f);
+        vcg::Point3f rcolor = reflection.Normalize()*0.5f + vcg::Point3f(0.5f, 0.5f, 0.5f);
+        float t = color[0]*color[0];
+        vcg::Point4f combine = color*(1-t) + vcg::Point4f(ncolor[0], ncolor[1], ncolor[2], 1)*t;
+        Point3m p = mesh->vert[vi[0]].cP()*b[0] + mesh->vert[vi[1]].cP()*b[1] + mesh->vert[vi[2]].cP()*b[2];
+        vcg::Point4f image;
+        switch(mode) {
+        case COLOR: out = color; break;
+        case SILHOUETTE: out = vcg::Point4f(1, 1, 1, 1); break; //no color array, default gl_Color
+        case NORMALMAP: out = vcg::Point4f(ncolor[0], ncolor[1], ncolor[2], 1); break;
+        case COMBINE: out = combine; break;
+        case SPECULAR: out = vcg::Point4f(rcolor[0], rcolor[1], rcolor[2], 1); break;
+        case SPECAMB: out = color*(1-t) + vcg::Point4f(rcolor[0], rcolor[1], rcolor[2], 1)*t; break;
+        case PROJIMG:
+          out = projectedColor(projectors[0], p, image) ? image : combine;
+          break;
+        case PROJMULTIIMG: {
+          vcg::Point4f clr(0, 0, 0, 0);
+          float w = 0;
+          for (int j = 0; j < 3; j++) {
+            if (projectedColor(projectors[j], p, image)) {
+              clr += image*arcMI[j];
+              w += arcMI[j];
+            }
+          }
+          if (w > 0) {
+            for (int k = 0; k < 4; k++)
+              out[k] = color[k]*clr[k]/w;
+          }
+          else out = combine;
+          break;
+        }
+        default: assert(0);
+        }
+      }
+      vcg::Color4b &pixel = frame[x + y*wt];
+      for (int k = 0; k < 4; k++)
+        pixel[k] = (unsigned char) (std::min(std::max(out[k], 0.0f), 1.0f)*255 + 0.5f);
+    }
+  }
+
+  //same content of fbo.toImage(), with top-down rows
+  rend = QImage(wt, ht, QImage::Format_ARGB32);
+  uchar *bits = rend.bits();
+  const int bytesPerLine = rend.bytesPerLine();
+#pragma omp parallel for
+  for (int y = 0; y < ht; y++) {
+    QRgb *line = (QRgb *) (bits + (ht-1-y)*bytesPerLine);
+    for (int x = 0; x < wt; x++) {
+      const vcg::Color4b &c = frame[x + y*wt];
+      line[x] = qRgba(c[0], c[1], c[2], c[3]);
+    }
+  }
+}
+
 GLuint AlignSet::createShaderFromFiles(QString name) {
   QString vert = "shaders/" + name + ".vert";
   QString frag = "shaders/" + name + ".frag";
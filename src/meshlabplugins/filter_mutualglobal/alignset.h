@@ -8,6 +8,7 @@
 
 // local headers
 #include <common/ml_document/mesh_model.h>
+#include <common/utilities/shot_rasterizer.h>
 #include "alignGlobal.h"
 
 // VCG headers
@@ -70,6 +71,7 @@ class AlignSet {
   GLint programs[RENDERING_MODE_LAST];
 
   unsigned char *target, *render; //buffers for rendered images 
+  bool useCPU; //render with a software rasterizer, no GL context is needed
 
   AlignSet();
   ~AlignSet();
@@ -83,6 +85,7 @@ class AlignSet {
   bool setFocal(double f); //return false if unchanged
   void setPixelSizeMm(double ccdWidth);
 
+  void updateMeshBuffers(); //copy the mesh into the vertex buffer objects
   void renderScene(vcg::Shot<Scalarm>& shot, int component, bool save=false);
   void readRender(int component);
 
@@ -120,6 +123,22 @@ class AlignSet {
   int    depthW;
   int    depthH;
 
+  //software counterpart of a shadow map and of its projected texture
+  struct Projector {
+	vcg::Shot<Scalarm> shot;
+	QImage image;
+	meshlab::ShotRasterizer depth;
+	Scalarm nearPlane, farPlane;
+  };
+
+  meshlab::ShotRasterizer rasterizer;
+  std::vector<vcg::Color4b> frame; //last software rendering, bottom-up rows
+  Projector projectors[3];
+
+  void renderSceneCPU(vcg::Shot<Scalarm>& view);
+  void renderProjector(Projector& pr, const vcg::Shot<Scalarm>& shot);
+  bool projectedColor(const Projector& pr, const Point3m& p, vcg::Point4f& color) const;
+
 	
 	
 };
@@ -114,6 +114,17 @@ bool FilterMutualGlobal::requiresGLContext(const QAction* action) const
 	return false;
 }
 
+bool FilterMutualGlobal::canRunWithoutGLContext(const QAction* action) const
+{
+	switch(ID(action)) {
+	case FP_IMAGE_GLOBALIGN:
+		return true; // the mesh is rendered on the CPU
+	default:
+		assert(0);
+	}
+	return false;
+}
+
 // This function define the needed parameters for each filter. Return true if the filter has some parameters
 // it is called every time, so you can set the default value of parameters according to the mesh
 // For each parameter you need to define,
@@ -158,6 +169,7 @@ RichParameterList FilterMutualGlobal::initParameterList(const QAction *action, c
 			parlst.addParam(RichBool("Pre-alignment",false,"Pre-alignment step","Pre-alignment step"));
 			parlst.addParam(RichBool("Estimate Focal",true,"Estimate focal length","Estimate focal length"));
 			parlst.addParam(RichBool("Fine",true,"Fine Alignment","Fine alignment"));
+			parlst.addParam(RichBool("useGPU",true,"Use GPU rendering","If true, the mesh and the projected images are rendered with OpenGL. Otherwise they are rendered by a tile based software rasterizer using all the cores, the pre-alignment optimizes the rasters concurrently, and no OpenGL is needed."));
 
 		  /*parlst.addParam(RichBool ("UpdateNormals",
 											true,
@@ -187,9 +199,12 @@ std::map<std::string, QVariant> FilterMutualGlobal::applyFilter(
 		unsigned int& /*postConditionMask*/,
 		vcg::CallBackPos *cb)
 {
-	if (glContext == nullptr){
-		throw MLException("Fatal error: glContext not initialized");
+	bool useGPU = par.getBool("useGPU");
+	if (useGPU && (glContext == nullptr || !glContext->isValid())) {
+		log(GLLogStream::SYSTEM, "No OpenGL context available, the mesh is rendered on the CPU");
+		useGPU = false;
 	}
+	alignset.useCPU = !useGPU;
 	QElapsedTimer filterTime;
 	filterTime.start();
 
@@ -220,9 +235,11 @@ std::map<std::string, QVariant> FilterMutualGlobal::applyFilter(
 
 			}
 
-			this->glContext->makeCurrent();
+			if (!alignset.useCPU) {
+				this->glContext->makeCurrent();
 
-			this->initGL();
+				this->initGL();
+			}
 
 			if (par.getBool("Pre-alignment")) {
 				preAlignment(md, par, cb);
@@ -244,7 +261,8 @@ std::map<std::string, QVariant> FilterMutualGlobal::applyFilter(
 				}
 			}
 
-			this->glContext->doneCurrent();
+			if (!alignset.useCPU)
+				this->glContext->doneCurrent();
 			log("Done!");
 			break;
 
@@ -357,6 +375,31 @@ QString FilterMutualGlobal::filterScriptFunctionName( ActionIDType filterID )
 	return QString();
 }
 
+static void PreAlignRaster(AlignSet& align, Solver& solver, MutualInfo& mutual, RasterModel& rm)
+{
+	align.image=&rm.currentPlane->image;
+	align.shot=rm.shot;
+
+	align.resize(800);
+
+	align.shot.Intrinsics.ViewportPx[0]=int((double)align.shot.Intrinsics.ViewportPx[1]*align.image->width()/align.image->height());
+	align.shot.Intrinsics.CenterPx[0]=(int)(align.shot.Intrinsics.ViewportPx[0]/2);
+
+	if (solver.fine_alignment)
+		solver.optimize(&align, &mutual, align.shot);
+	else
+		solver.iterative(&align, &mutual, align.shot);
+
+	rm.shot=align.shot;
+	float ratio= (float) rm.currentPlane->image.height()/(float)align.shot.Intrinsics.ViewportPx[1];
+	rm.shot.Intrinsics.ViewportPx[0]=rm.currentPlane->image.width();
+	rm.shot.Intrinsics.ViewportPx[1]=rm.currentPlane->image.height();
+	rm.shot.Intrinsics.PixelSizeMm[1]/=ratio;
+	rm.shot.Intrinsics.PixelSizeMm[0]/=ratio;
+	rm.shot.Intrinsics.CenterPx[0]=(int)((float)rm.shot.Intrinsics.ViewportPx[0]/2.0);
+	rm.shot.Intrinsics.CenterPx[1]=(int)((float)rm.shot.Intrinsics.ViewportPx[1]/2.0);
+}
+
 bool FilterMutualGlobal::preAlignment(MeshDocument &md, const RichParameterList & par, vcg::CallBackPos *cb)
 {
 	Solver solver;
@@ -399,78 +442,41 @@ bool FilterMutualGlobal::preAlignment(MeshDocument &md, const RichParameterList
 			break;
 		}
 
-		vcg::Point3f *vertices = new vcg::Point3f[alignset.mesh->vn];
-		vcg::Point3f *normals = new vcg::Point3f[alignset.mesh->vn];
-		vcg::Color4b *colors = new vcg::Color4b[alignset.mesh->vn];
-		unsigned int *indices = new unsigned int[alignset.mesh->fn*3];
-
-		for(int i = 0; i < alignset.mesh->vn; i++) {
-			vertices[i] = alignset.mesh->vert[i].P();
-			normals[i] = alignset.mesh->vert[i].N();
-			colors[i] = alignset.mesh->vert[i].C();
+		alignset.updateMeshBuffers();
+
+		std::vector<RasterModel*> rasters;
+		for (RasterModel& rm : md.rasterIterator())
+			rasters.push_back(&rm);
+
+		// the rasters are aligned independently: without OpenGL each one is
+		// optimized by its own thread, with its own render buffers
+#pragma omp parallel for schedule(dynamic) if(alignset.useCPU)
+		for (int r = 0; r < (int) rasters.size(); r++) {
+			if (!rasters[r]->isVisible())
+				continue;
+			if (alignset.useCPU) {
+				AlignSet align;
+				align.useCPU = true;
+				align.mesh = alignset.mesh;
+				align.mode = alignset.mode;
+				Solver rasterSolver;
+				rasterSolver.optimize_focal = solver.optimize_focal;
+				rasterSolver.fine_alignment = solver.fine_alignment;
+				MutualInfo rasterMutual;
+				PreAlignRaster(align, rasterSolver, rasterMutual, *rasters[r]);
+			}
+			else
+				PreAlignRaster(alignset, solver, mutual, *rasters[r]);
 		}
 
-		for(int i = 0; i < alignset.mesh->fn; i++)
-			for(int k = 0; k < 3; k++)
-				indices[k+i*3] = alignset.mesh->face[i].V(k) - &*alignset.mesh->vert.begin();
-
-		glBindBufferARB(GL_ARRAY_BUFFER_ARB, alignset.vbo);
-		glBufferDataARB(GL_ARRAY_BUFFER_ARB, alignset.mesh->vn*sizeof(vcg::Point3f),
-						vertices, GL_STATIC_DRAW_ARB);
-		glBindBufferARB(GL_ARRAY_BUFFER_ARB, alignset.nbo);
-		glBufferDataARB(GL_ARRAY_BUFFER_ARB, alignset.mesh->vn*sizeof(vcg::Point3f),
-						normals, GL_STATIC_DRAW_ARB);
-		glBindBufferARB(GL_ARRAY_BUFFER_ARB, alignset.cbo);
-		glBufferDataARB(GL_ARRAY_BUFFER_ARB, alignset.mesh->vn*sizeof(vcg::Color4b),
-						colors, GL_STATIC_DRAW_ARB);
-		glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
-
-		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, alignset.ibo);
-		glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, alignset.mesh->fn*3*sizeof(unsigned int),
-						indices, GL_STATIC_DRAW_ARB);
-		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
-
-
-		// it is safe to delete after copying data to VBO
-		delete []vertices;
-		delete []normals;
-		delete []colors;
-		delete []indices;
-
-		unsigned int r = 0;
-		for (RasterModel& rm : md.rasterIterator()) {
-			if(rm.isVisible()) {
-				alignset.image=&rm.currentPlane->image;
-				alignset.shot=rm.shot;
-
-				alignset.resize(800);
-
-				alignset.shot.Intrinsics.ViewportPx[0]=int((double)alignset.shot.Intrinsics.ViewportPx[1]*alignset.image->width()/alignset.image->height());
-				alignset.shot.Intrinsics.CenterPx[0]=(int)(alignset.shot.Intrinsics.ViewportPx[0]/2);
-
-				if (solver.fine_alignment)
-					solver.optimize(&alignset, &mutual, alignset.shot);
-				else {
-					solver.iterative(&alignset, &mutual, alignset.shot);
+		for (unsigned int r = 0; r < rasters.size(); r++) {
+			if (rasters[r]->isVisible()) {
+				if (!solver.fine_alignment)
 					log("Vado di rough",r);
-				}
-
-				rm.shot=alignset.shot;
-				float ratio= (float) rm.currentPlane->image.height()/(float)alignset.shot.Intrinsics.ViewportPx[1];
-				rm.shot.Intrinsics.ViewportPx[0]=rm.currentPlane->image.width();
-				rm.shot.Intrinsics.ViewportPx[1]=rm.currentPlane->image.height();
-				rm.shot.Intrinsics.PixelSizeMm[1]/=ratio;
-				rm.shot.Intrinsics.PixelSizeMm[0]/=ratio;
-				rm.shot.Intrinsics.CenterPx[0]=(int)((float)rm.shot.Intrinsics.ViewportPx[0]/2.0);
-				rm.shot.Intrinsics.CenterPx[1]=(int)((float)rm.shot.Intrinsics.ViewportPx[1]/2.0);
-
 				log("Image %d completed",r);
-
 			}
-			else{
+			else
 				log("Image %d skipped",r);
-			}
-			++r;
 		}
 	}
 
@@ -500,44 +506,7 @@ std::vector<AlignPair> FilterMutualGlobal::CalcPairs(MeshDocument &md, bool glob
 	/*solver.optimize_focal=true;
 	solver.fine_alignment=true;*/
 
-	{
-		vcg::Point3f *vertices = new vcg::Point3f[alignset.mesh->vn];
-		vcg::Point3f *normals = new vcg::Point3f[alignset.mesh->vn];
-		vcg::Color4b *colors = new vcg::Color4b[alignset.mesh->vn];
-		unsigned int *indices = new unsigned int[alignset.mesh->fn*3];
-
-		for(int i = 0; i < alignset.mesh->vn; i++) {
-			vertices[i] = alignset.mesh->vert[i].P();
-			normals[i] = alignset.mesh->vert[i].N();
-			colors[i] = alignset.mesh->vert[i].C();
-		}
-
-		for(int i = 0; i < alignset.mesh->fn; i++)
-		for(int k = 0; k < 3; k++)
-		indices[k+i*3] = alignset.mesh->face[i].V(k) - &*alignset.mesh->vert.begin();
-
-		glBindBufferARB(GL_ARRAY_BUFFER_ARB, alignset.vbo);
-		glBufferDataARB(GL_ARRAY_BUFFER_ARB, alignset.mesh->vn*sizeof(vcg::Point3f),
-				  vertices, GL_STATIC_DRAW_ARB);
-		glBindBufferARB(GL_ARRAY_BUFFER_ARB, alignset.nbo);
-		glBufferDataARB(GL_ARRAY_BUFFER_ARB, alignset.mesh->vn*sizeof(vcg::Point3f),
-				  normals, GL_STATIC_DRAW_ARB);
-		glBindBufferARB(GL_ARRAY_BUFFER_ARB, alignset.cbo);
-		glBufferDataARB(GL_ARRAY_BUFFER_ARB, alignset.mesh->vn*sizeof(vcg::Color4b),
-				  colors, GL_STATIC_DRAW_ARB);
-		glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
-
-		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, alignset.ibo);
-		glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, alignset.mesh->fn*3*sizeof(unsigned int),
-				  indices, GL_STATIC_DRAW_ARB);
-		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
-
-		// it is safe to delete after copying data to VBO
-		delete []vertices;
-		delete []normals;
-		delete []colors;
-		delete []indices;
-	}
+	alignset.updateMeshBuffers();
 
 	//alignset.mode=AlignSet::PROJIMG;
 
@@ -895,43 +864,7 @@ bool FilterMutualGlobal::AlignNode(MeshDocument &md, Node node)
 	/*this->initGL();*/
 	alignset.resize(800);
 
-	vcg::Point3f *vertices = new vcg::Point3f[alignset.mesh->vn];
-	vcg::Point3f *normals = new vcg::Point3f[alignset.mesh->vn];
-	vcg::Color4b *colors = new vcg::Color4b[alignset.mesh->vn];
-	unsigned int *indices = new unsigned int[alignset.mesh->fn*3];
-
-	for(int i = 0; i < alignset.mesh->vn; i++) {
-		vertices[i] = alignset.mesh->vert[i].P();
-		normals[i] = alignset.mesh->vert[i].N();
-		colors[i] = alignset.mesh->vert[i].C();
-	}
-
-	for(int i = 0; i < alignset.mesh->fn; i++)
-		for(int k = 0; k < 3; k++)
-			indices[k+i*3] = alignset.mesh->face[i].V(k) - &*alignset.mesh->vert.begin();
-
-	glBindBufferARB(GL_ARRAY_BUFFER_ARB, alignset.vbo);
-	glBufferDataARB(GL_ARRAY_BUFFER_ARB, alignset.mesh->vn*sizeof(vcg::Point3f),
-			  vertices, GL_STATIC_DRAW_ARB);
-	glBindBufferARB(GL_ARRAY_BUFFER_ARB, alignset.nbo);
-	glBufferDataARB(GL_ARRAY_BUFFER_ARB, alignset.mesh->vn*sizeof(vcg::Point3f),
-			  normals, GL_STATIC_DRAW_ARB);
-	glBindBufferARB(GL_ARRAY_BUFFER_ARB, alignset.cbo);
-	glBufferDataARB(GL_ARRAY_BUFFER_ARB, alignset.mesh->vn*sizeof(vcg::Color4b),
-			  colors, GL_STATIC_DRAW_ARB);
-	glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
-
-	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, alignset.ibo);
-	glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, alignset.mesh->fn*3*sizeof(unsigned int),
-			  indices, GL_STATIC_DRAW_ARB);
-	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
-
-
-	// it is safe to delete after copying data to VBO
-	delete []vertices;
-	delete []normals;
-	delete []colors;
-	delete []indices;
+	alignset.updateMeshBuffers();
 
 	//alignset.shot=par.getShotf("Shot");
 
@@ -978,43 +911,7 @@ bool FilterMutualGlobal::UpdateGraph(MeshDocument &md, SubGraph graph, int n)
 
 	alignset.mesh=&md.mm()->cm;
 
-	vcg::Point3f *vertices = new vcg::Point3f[alignset.mesh->vn];
-	vcg::Point3f *normals = new vcg::Point3f[alignset.mesh->vn];
-	vcg::Color4b *colors = new vcg::Color4b[alignset.mesh->vn];
-	unsigned int *indices = new unsigned int[alignset.mesh->fn*3];
-
-	for(int i = 0; i < alignset.mesh->vn; i++) {
-		vertices[i] = alignset.mesh->vert[i].P();
-		normals[i] = alignset.mesh->vert[i].N();
-		colors[i] = alignset.mesh->vert[i].C();
-	}
-
-	for(int i = 0; i < alignset.mesh->fn; i++)
-		for(int k = 0; k < 3; k++)
-			indices[k+i*3] = alignset.mesh->face[i].V(k) - &*alignset.mesh->vert.begin();
-
-	glBindBufferARB(GL_ARRAY_BUFFER_ARB, alignset.vbo);
-	glBufferDataARB(GL_ARRAY_BUFFER_ARB, alignset.mesh->vn*sizeof(vcg::Point3f),
-	  vertices, GL_STATIC_DRAW_ARB);
-	glBindBufferARB(GL_ARRAY_BUFFER_ARB, alignset.nbo);
-	glBufferDataARB(GL_ARRAY_BUFFER_ARB, alignset.mesh->vn*sizeof(vcg::Point3f),
-	  normals, GL_STATIC_DRAW_ARB);
-	glBindBufferARB(GL_ARRAY_BUFFER_ARB, alignset.cbo);
-	glBufferDataARB(GL_ARRAY_BUFFER_ARB, alignset.mesh->vn*sizeof(vcg::Color4b),
-	  colors, GL_STATIC_DRAW_ARB);
-	glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
-
-	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, alignset.ibo);
-	glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, alignset.mesh->fn*3*sizeof(unsigned int),
-	  indices, GL_STATIC_DRAW_ARB);
-	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
-
-
-	// it is safe to delete after copying data to VBO
-	delete []vertices;
-	delete []normals;
-	delete []colors;
-	delete []indices;
+	alignset.updateMeshBuffers();
 
 	for (unsigned int h=0; h<graph.nodes.size(); h++) {
 		for (unsigned int l=0; l<graph.nodes[h].arcs.size(); l++) {
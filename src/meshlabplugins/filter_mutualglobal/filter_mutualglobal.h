@@ -66,6 +66,7 @@ public:
 	int postCondition(const QAction*) const { return MeshModel::MM_NONE; };
 	FilterClass getClass(const QAction* a) const;
 	bool requiresGLContext(const QAction* action) const;
+	bool canRunWithoutGLContext(const QAction* action) const;
 	QString filterScriptFunctionName(ActionIDType filterID);
 	bool preAlignment(MeshDocument &md, const RichParameterList& par, vcg::CallBackPos *cb);
 	std::vector<SubGraph> buildGraph(MeshDocument &md, bool globalign=true);
@@ -38,8 +38,6 @@ double Solver::operator()(int ndim, double *x) {
     //cout << p[i] << "\t";
   }
   //cout << endl;
-  static int iter = 0;
-  iter++;
 /*  double orig = p.scale[6];
   //p.scale[6] *= pow(iter/(double)maxiter, 4);
   double v = 4*(iter/(double)maxiter) - 2;
@@ -119,11 +117,11 @@ double Solver::operator()(int ndim, double *x) {
 	break;
    }
    case AlignSet::NODE: {
-		assert(glGetError() == 0);
+		assert(align->useCPU || glGetError() == 0);
 		//QImage comb; std::vector<QImage> projimg;
 		/*align->mode=AlignSet::COMBINE;
 		align->renderScene(shot,1,true);
-		assert(glGetError() == 0);
+		assert(align->useCPU || glGetError() == 0);
 		comb=align->rend;*/
 		align->mode=AlignSet::PROJMULTIIMG;
 		
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 
 #include <GL/glew.h>
@@ -25,7 +26,7 @@
 using namespace std;
 
 AlignSet::AlignSet(): mode(COMBINE),
-    target(NULL), render(NULL),error(0)
+    target(NULL), render(NULL),error(0), useCPU(false)
 {
         _cont = NULL;
         box.SetNull();
@@ -161,6 +162,14 @@ void AlignSet::resize(int max_side) {
 
 void AlignSet::renderScene(vcg::Shot<MESHLAB_SCALAR> &view, int component) 
 {
+    if (useCPU) {
+        renderSceneCPU();
+        if (render) delete[] render;
+        render = new unsigned char[wt*ht];
+        readRender(component);
+        return;
+    }
+
     QSize fbosize(wt,ht);
     QGLFramebufferObjectFormat frmt;
     frmt.setInternalTextureFormat(GL_RGBA);
@@ -275,6 +284,13 @@ void AlignSet::renderScene(vcg::Shot<MESHLAB_SCALAR> &view, int component)
 }
 
 void AlignSet::readRender(int component) {
+    if (useCPU) {
+        if (component < 4)
+            for (int i = 0; i < wt*ht; i++)
+                render[i] = frame[i][component];
+        return;
+    }
+
     QSize fbosize(wt,ht);
     QGLFramebufferObjectFormat frmt;
     frmt.setInternalTextureFormat(GL_RGBA);
@@ -296,6 +312,69 @@ void AlignSet::readRender(int component) {
     fbo.release();
 }
 
+// Same shading of the programs created in initializeGL, on the visibility
+// buffer of the rasterizer: the vertex attributes are moved to eye space and
+// interpolated in each pixel. The shot is the one set by GlShot::SetView.
+void AlignSet::renderSceneCPU()
+{
+    if (rasterizer.width() != wt || rasterizer.height() != ht)
+        rasterizer.resize(wt, ht);
+    rasterizer.render(*mesh, shot);
+
+    const vcg::Matrix44<MESHLAB_SCALAR> rot = shot.Extrinsics.Rot();
+    const Point3m viewpoint = shot.GetViewPoint();
+    const int nv = (int) mesh->vert.size();
+    std::vector<vcg::Point4f> colors(nv);
+    std::vector<vcg::Point3f> normals(nv), reflections(nv);
+#pragma omp parallel for
+    for (int i = 0; i < nv; i++) {
+        const CVertexO &v = mesh->vert[i];
+        if (v.IsD()) continue;
+        colors[i] = vcg::Point4f(v.cC()[0], v.cC()[1], v.cC()[2], v.cC()[3]) / 255.0f;
+        Point3m n = rot * v.cN();
+        normals[i] = vcg::Point3f::Construct(n);
+        n.Normalize();
+        Point3m position = rot * (v.cP() - viewpoint);
+        reflections[i] = vcg::Point3f::Construct(position - n * (2 * (n * position)));
+    }
+
+    frame.resize(wt*ht);
+#pragma omp parallel for schedule(static)
+    for (int y = 0; y < ht; y++) {
+        for (int x = 0; x < wt; x++) {
+            vcg::Point4f out(0, 0, 0, 0); //clear color
+            int e = rasterizer.element(x, y);
+            if (e >= 0) {
+                int vi[3] = {e, e, e};
+                vcg::Point3f b(1, 0, 0);
+                if (!rasterizer.isPointCloud()) {
+                    for (int k = 0; k < 3; k++)
+                        vi[k] = (int) vcg::tri::Index(*mesh, mesh->face[e].cV(k));
+                    b = vcg::Point3f::Construct(rasterizer.barycentric(x, y));
+                }
+                vcg::Point4f color = colors[vi[0]]*b[0] + colors[vi[1]]*b[1] + colors[vi[2]]*b[2];
+                vcg::Point3f normal = normals[vi[0]]*b[0] + normals[vi[1]]*b[1] + normals[vi[2]]*b[2];
+                vcg::Point3f reflection = reflections[vi[0]]*b[0] + reflections[vi[1]]*b[1] + reflections[vi[2]]*b[2];
+                vcg::Point3f ncolor = normal.Normalize()*0.5f + vcg::Point3f(0.5f, 0.5f, 0.5f);
+                vcg::Point3f rcolor = reflection.Normalize()*0.5f + vcg::Point3f(0.5f, 0.5f, 0.5f);
+                float t = color[0]*color[0];
+                switch(mode) {
+                case COLOR: out = color; break;
+                case SILHOUETTE: out = vcg::Point4f(1, 1, 1, 1); break; //no color array, default gl_Color
+                case NORMALMAP: out = vcg::Point4f(ncolor[0], ncolor[1], ncolor[2], 1); break;
+                case COMBINE: out = color*(1-t) + vcg::Point4f(ncolor[0], ncolor[1], ncolor[2], 1)*t; break;
+                case SPECULAR: out = vcg::Point4f(rcolor[0], rcolor[1], rcolor[2], 1); break;
+                case SPECAMB: out = color*(1-t) + vcg::Point4f(rcolor[0], rcolor[1], rcolor[2], 1)*t; break;
+                default: assert(0);
+                }
+            }
+            vcg::Color4b &pixel = frame[x + y*wt];
+            for (int k = 0; k < 4; k++)
+                pixel[k] = (unsigned char) (std::min(std::max(out[k], 0.0f), 1.0f)*255 + 0.5f);
+        }
+    }
+}
+
 GLuint AlignSet::createShaderFromFiles(QString name) {
     QString vert = "shaders/" + name + ".vert";
     QString frag = "shaders/" + name + ".frag";
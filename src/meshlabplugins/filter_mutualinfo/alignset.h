@@ -8,6 +8,7 @@
 
 // local headers
 #include <common/ml_document/mesh_model.h>
+#include <common/utilities/shot_rasterizer.h>
 
 // VCG headers
 #include <vcg/math/shot.h>
@@ -45,6 +46,7 @@ class AlignSet {
 
   unsigned char *target, *render; //buffers for rendered images 
   double error; //alignment error in px
+  bool useCPU; //render with a software rasterizer, no GL context is needed
 
   AlignSet();
   ~AlignSet();
@@ -71,6 +73,11 @@ class AlignSet {
 
  private:
   MLPluginGLContext* _cont;
+
+  meshlab::ShotRasterizer rasterizer;
+  std::vector<vcg::Color4b> frame; //last software rendering, bottom-up rows
+
+  void renderSceneCPU();
   
  
   GLuint createShaderFromFiles(QString basename); // converted into shader/basename.vert .frag
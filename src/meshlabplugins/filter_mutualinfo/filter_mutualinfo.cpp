@@ -96,6 +96,17 @@ bool FilterMutualInfoPlugin::requiresGLContext(const QAction* action) const
 	return false;
 }
 
+bool FilterMutualInfoPlugin::canRunWithoutGLContext(const QAction* action) const
+{
+	switch(ID(action)) {
+	case FP_IMAGE_MUTUALINFO:
+		return true; // the mesh is rendered on the CPU
+	default :
+		assert(0);
+	}
+	return false;
+}
+
 FilterPlugin::FilterArity FilterMutualInfoPlugin::filterArity(const QAction*) const
 {
 	return SINGLE_MESH;
@@ -121,6 +132,7 @@ RichParameterList FilterMutualInfoPlugin::initParameterList(const QAction *actio
 		parlst.addParam(RichFloat("Tolerance", 0.1, "Tolerance", "Threshold to stop convergence"));
 		parlst.addParam(RichFloat("ExpectedVariance", 2.0, "Expected Variance", "Expected Variance"));
 		parlst.addParam(RichInt("BackgroundWeight", 2, "Background Weight", "Weight of background pixels (1, as all the other pixels; 2, one half of the other pixels etc etc)"));
+		parlst.addParam(RichBool("useGPU", true, "Use GPU rendering", "If true, the mesh is rendered with OpenGL at each evaluation of the alignment. Otherwise it is rendered by a tile based software rasterizer using all the cores, and no OpenGL is needed."));
 		break;
 	default :
 		assert(0);
@@ -135,9 +147,12 @@ std::map<std::string, QVariant> FilterMutualInfoPlugin::applyFilter(
 		unsigned int& /*postConditionMask*/,
 		vcg::CallBackPos* )
 {
-	if (glContext == nullptr){
-		throw MLException("Fatal error: glContext not initialized");
+	bool useGPU = par.getBool("useGPU");
+	if (useGPU && (glContext == nullptr || !glContext->isValid())) {
+		log(GLLogStream::SYSTEM, "No OpenGL context available, the mesh is rendered on the CPU");
+		useGPU = false;
 	}
+	align.useCPU = !useGPU;
 	switch(ID(action))	 {
 	case FP_IMAGE_MUTUALINFO :
 		imageMutualInfoAlign(
@@ -226,13 +241,19 @@ void FilterMutualInfoPlugin::imageMutualInfoAlign(
 
 	///// Initialize GLContext
 
-	log( "Initialize GL");
-	align.setGLContext(glContext);
-	glContext->makeCurrent();
-	if (initGLMutualInfo() == false)
-		throw MLException("Error while initializing GL.");
+	if (align.useCPU) {
+		align.setGLContext(nullptr);
+		align.resize(800);
+	}
+	else {
+		log( "Initialize GL");
+		align.setGLContext(glContext);
+		glContext->makeCurrent();
+		if (initGLMutualInfo() == false)
+			throw MLException("Error while initializing GL.");
 
-	log( "Done");
+		log( "Done");
+	}
 
 	///// Mutual info calculation: every 30 iterations, the mail glarea is updated
 	int rounds=(int)(solver.maxiter/30);
@@ -263,7 +284,8 @@ void FilterMutualInfoPlugin::imageMutualInfoAlign(
 
 		md.documentUpdated();
 	}
-	this->glContext->doneCurrent();
+	if (!align.useCPU)
+		this->glContext->doneCurrent();
 }
 
 bool FilterMutualInfoPlugin::initGLMutualInfo()
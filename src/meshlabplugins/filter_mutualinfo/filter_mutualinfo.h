@@ -48,6 +48,7 @@ public:
 	QString filterInfo(ActionIDType filter) const;
 	FilterClass getClass(const QAction* a) const;
 	bool requiresGLContext(const QAction* action) const;
+	bool canRunWithoutGLContext(const QAction* action) const;
 	FilterArity filterArity(const QAction*) const;
 	RichParameterList initParameterList(const QAction*, const MeshDocument &);
 	std::map<std::string, QVariant> applyFilter(
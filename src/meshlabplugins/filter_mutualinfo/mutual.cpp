@@ -7,6 +7,10 @@
 #include <QImage> /*debug*/
 #include "mutual.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 MutualInfo::MutualInfo(unsigned int _nbins, int _bweight, bool _use_background):
   bweight(_bweight), use_background(_use_background),
@@ -103,13 +107,34 @@ void MutualInfo::histogram(int width, int height,
   int s = 0; 
   while ( bins>>=1) { ++s; }
 
-  for(int y = starty; y < endy; y++) {
-    int offset = width*y + startx;
-    for(int x = startx; x < endx; x++, offset++) {
-      unsigned char a = target[offset]>>k; //instead of /side;
-      unsigned char b = render[offset]>>k; //instead of /side;
-      histo2D[a + (b<<s)] += 2;//bweight; //instead of nbins*s
+  //the scattered increments do not vectorize: the rows are split among the
+  //threads, each filling its own joint histogram, and the histograms are summed
+  const int size = nbins*nbins;
+#pragma omp parallel
+  {
+    int thread = 0, nthreads = 1;
+#ifdef _OPENMP
+    thread = omp_get_thread_num();
+    nthreads = omp_get_num_threads();
+#endif
+#pragma omp single
+    partial.assign((nthreads-1)*size, 0);
+
+    unsigned int *histo = thread == 0 ? histo2D : &partial[(thread-1)*size];
+#pragma omp for schedule(static)
+    for(int y = starty; y < endy; y++) {
+      int offset = width*y + startx;
+      for(int x = startx; x < endx; x++, offset++) {
+        unsigned char a = target[offset]>>k; //instead of /side;
+        unsigned char b = render[offset]>>k; //instead of /side;
+        histo[a + (b<<s)] += 2;//bweight; //instead of nbins*s
+      }
     }
+
+#pragma omp for schedule(static)
+    for(int i = 0; i < size; i++)
+      for(int t = 1; t < nthreads; t++)
+        histo2D[i] += partial[(t-1)*size + i];
   }
   //weight of background is divided.
   //background is when b = 0 -> first row of histo2D
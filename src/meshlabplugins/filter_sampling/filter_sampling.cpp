@@ -126,7 +126,8 @@ public:
 
 
 /* This sampler is used to transfer the detail of a mesh onto another one.
- * It keep internally the spatial indexing structure used to find the closest point
+ * It keeps the spatial indexing structure used to find the closest point,
+ * taken from the cache of the source MeshModel
  */
 class LocalRedetailSampler
 {
@@ -141,8 +142,8 @@ public:
   CallBackPos *cb;
   int sampleNum;  // the expected number of samples. Used only for the callback
   int sampleCnt;
-  MetroMeshGrid   unifGridFace;
-  VertexMeshGrid   unifGridVert;
+  std::shared_ptr<MetroMeshGrid>   unifGridFace;
+  std::shared_ptr<VertexMeshGrid>   unifGridVert;
   bool useVertexSampling;
 
   // Parameters
@@ -156,20 +157,20 @@ public:
   bool selectionFlag;
   bool storeDistanceAsQualityFlag;
   float dist_upper_bound;
-  void init(CMeshO *_m, CallBackPos *_cb=0, int targetSz=0)
+  void init(MeshModel *_mm, CallBackPos *_cb=0, int targetSz=0)
   {
     coordFlag=false;
     colorFlag=false;
     qualityFlag=false;
     selectionFlag=false;
     storeDistanceAsQualityFlag=false;
-    m=_m;
+    m=&_mm->cm;
     tri::UpdateNormal<CMeshO>::PerFaceNormalized(*m);
     if(m->fn==0) useVertexSampling = true;
     else useVertexSampling = false;
 
-    if(useVertexSampling) unifGridVert.Set(m->vert.begin(),m->vert.end());
-    else  unifGridFace.Set(m->face.begin(),m->face.end());
+    if(useVertexSampling) unifGridVert = _mm->vertexGrid();
+    else  unifGridFace = _mm->faceGrid();
     markerFunctor.SetMesh(m);
     // sampleNum and sampleCnt are used only for the progress callback.
     cb=_cb;
@@ -190,7 +191,7 @@ public:
     if(useVertexSampling)
     {
       CMeshO::VertexType   *nearestV=0;
-      nearestV =  tri::GetClosestVertex<CMeshO,VertexMeshGrid>(*m,unifGridVert,startPt,dist_upper_bound,dist); //(PDistFunct,markerFunctor,startPt,dist_upper_bound,dist,closestPt);
+      nearestV =  tri::GetClosestVertex<CMeshO,VertexMeshGrid>(*m,*unifGridVert,startPt,dist_upper_bound,dist); //(PDistFunct,markerFunctor,startPt,dist_upper_bound,dist,closestPt);
       if(cb) cb(sampleCnt++*100/sampleNum,"Resampling Vertex attributes");
       if(storeDistanceAsQualityFlag)  p.Q() = dist;
       if(dist == dist_upper_bound) return ;
@@ -207,7 +208,7 @@ public:
       vcg::face::PointDistanceBaseFunctor<CMeshO::ScalarType> PDistFunct;
       dist=dist_upper_bound;
       if(cb) cb(sampleCnt++*100/sampleNum,"Resampling Vertex attributes");
-      nearestF =  unifGridFace.GetClosest(PDistFunct,markerFunctor,startPt,dist_upper_bound,dist,closestPt);
+      nearestF =  unifGridFace->GetClosest(PDistFunct,markerFunctor,startPt,dist_upper_bound,dist,closestPt);
       if(dist == dist_upper_bound) return ;
 
       Point3m interp;
@@ -237,18 +238,20 @@ class SimpleDistanceSampler
 
 public:
 
-	SimpleDistanceSampler(CMeshO* _m, bool signedDist, double maxd) :markerFunctor(_m)
+	SimpleDistanceSampler(MeshModel* _mm, bool signedDist, double maxd) :markerFunctor(&_mm->cm)
 	{
-		m = _m;
+		mm = _mm;
+		m = &_mm->cm;
 		useSigned = signedDist;
 		maxDistABS = maxd;
 		init();
 	}
 
-	CMeshO *m;           /// the reference mesh
+	MeshModel *mm;       /// the reference mesh, owning the spatial indices
+	CMeshO *m;
 
-	MetroMeshVertexGrid   unifGridVert;
-	MetroMeshFaceGrid     unifGridFace;
+	std::shared_ptr<MetroMeshVertexGrid>   unifGridVert;
+	std::shared_ptr<MetroMeshFaceGrid>     unifGridFace;
 
 	bool useVertexSampling;
 	CMeshO::ScalarType dist_upper_bound;  // samples that have a distance beyond this threshold distance are not considered.
@@ -274,12 +277,12 @@ public:
 		if (m->fn == 0) // if no faces, we can only use points
 		{
 			useVertexSampling = true;
-			unifGridVert.Set(m->vert.begin(), m->vert.end());
+			unifGridVert = mm->vertexGrid();
 		}
 		else 
 		{
 			useVertexSampling = false;
-			unifGridFace.Set(m->face.begin(), m->face.end());
+			unifGridFace = mm->faceGrid();
 			markerFunctor.SetMesh(m);
 		}
 
@@ -309,7 +312,7 @@ public:
 
 		if (useVertexSampling)
 		{
-			nearestV = tri::GetClosestVertex<CMeshO, MetroMeshVertexGrid>(*m, unifGridVert, startPt, maxDistABS, dist);
+			nearestV = tri::GetClosestVertex<CMeshO, MetroMeshVertexGrid>(*m, *unifGridVert, startPt, maxDistABS, dist);
 			if (nearestV == NULL) return (maxDistABS*2.0);
 
 			closestPt = nearestV->P();
@@ -317,7 +320,7 @@ public:
 		}
 		else
 		{
-			nearestF = unifGridFace.GetClosest(PDistFunct, markerFunctor, startPt, maxDistABS, dist, closestPt);
+			nearestF = unifGridFace->GetClosest(PDistFunct, markerFunctor, startPt, maxDistABS, dist, closestPt);
 			if (nearestF == NULL) return (maxDistABS*2.0);
 
 			closestNm = nearestF->N();
@@ -1229,7 +1232,7 @@ std::map<std::string, QVariant> FilterDocSampling::applyFilter(
 		}
 		mm1->updateDataMask(MeshModel::MM_FACEMARK);
 		
-		SimpleDistanceSampler ds(&(mm1->cm), useSigned, maxDistABS);
+		SimpleDistanceSampler ds(mm1, useSigned, maxDistABS);
 		
 		tri::SurfaceSampling<CMeshO, SimpleDistanceSampler>::AllVertex(mm0->cm, ds);
 		
@@ -1289,7 +1292,7 @@ std::map<std::string, QVariant> FilterDocSampling::applyFilter(
 		tri::UpdateNormal<CMeshO>::PerFaceNormalized(srcMesh->cm);
 		
 		LocalRedetailSampler rs;
-		rs.init(&(srcMesh->cm),cb,trgMesh->cm.vn);
+		rs.init(srcMesh,cb,trgMesh->cm.vn);
 		
 		rs.dist_upper_bound = upperbound;
 		rs.colorFlag = colorT;
@@ -1513,4 +1516,14 @@ FilterPlugin::FilterArity FilterDocSampling::filterArity(const QAction * filter
     return FilterPlugin::NONE;
 }
 
+bool FilterDocSampling::isFilterResultCacheable(const QAction* action) const
+{
+	switch(ID(action)) {
+	case FP_POISSONDISK_SAMPLING :
+		return true;
+	default:
+		return false;
+	}
+}
+
 MESHLAB_PLUGIN_NAME_EXPORTER(FilterDocSampling)
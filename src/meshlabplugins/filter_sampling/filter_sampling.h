@@ -66,6 +66,7 @@ public:
 	int postCondition(const QAction* ) const;
 	FilterClass getClass(const QAction*) const;
 	FilterArity filterArity(const QAction* filter) const;
+	bool isFilterResultCacheable(const QAction* action) const;
 };
 
 #endif
@@ -244,3 +244,8 @@ FilterPlugin::FilterArity FilterScreenedPoissonPlugin::filterArity(const QAction
 	return VARIABLE;
 }
 
+bool FilterScreenedPoissonPlugin::isFilterResultCacheable(const QAction* a) const
+{
+	return ID(a) == FP_SCREENED_POISSON;
+}
+
@@ -58,6 +58,7 @@ public:
 	RichParameterList initParameterList(const QAction* a, const MeshModel&);
 	int postCondition(const QAction* filter) const;
 	FilterArity filterArity(const QAction*) const;
+	bool isFilterResultCacheable(const QAction*) const;
 
 };
 
@@ -1,4 +1,5 @@
 #include "filter_sdfgpu.h"
+#include "sdf_ray_caster.h"
 #include <common/GLExtensionsManager.h>
 
 #include <vcg/complex/complex.h>
@@ -10,6 +11,7 @@
 #include <wrap/qt/checkGLError.h>
 #include <stdio.h>
 #include <assert.h>
+#include <random>
 using namespace std;
 using namespace vcg;
 
@@ -48,6 +50,14 @@ RichParameterList SdfGpuPlugin::initParameterList(const QAction *action, const M
 	par.addParam(  RichInt("numberRays",128, "Number of rays: ",
 						   "The number of rays that will be casted around "
         "the normals."));
+	par.addParam(RichBool("useGPU", true, "Use GPU depth peeling",
+						  "If true, the rays are sampled on the GPU with depth peeling. Otherwise they are traced on the CPU "
+        "against a bounding volume hierarchy using all the cores: no OpenGL is needed and the peeling parameters are not used "
+        "(the depth complexity still casts a grid of rays as large as the depth texture)."));
+	if(ID(action) != SDF_DEPTH_COMPLEXITY)
+		par.addParam(RichFloat("timeBudget", 0, "CPU time budget (sec)",
+							   "Only when the GPU is not used. Maximum time spent tracing rays: when it is exceeded the remaining "
+            "directions are skipped, and the result is computed from the traced ones. 0 means no limit."));
 	par.addParam(RichInt("DepthTextureSize", 512, "Depth texture size",
 						 "Size of the depth texture for depth peeling. Higher resolutions provide better sampling of the mesh, with a small performance penalty."));
 	par.addParam(RichInt("peelingIteration", 10, "Peeling Iteration",
@@ -91,7 +101,7 @@ RichParameterList SdfGpuPlugin::initParameterList(const QAction *action, const M
 
 		par.addParam(RichBool("removeOutliers",false,"Remove outliers","The outliers removal is made on the fly with a supersampling of the depth buffer. "
             "For each ray that we trace, we take multiple depth values near the point of intersection and we output only the median of these values. "
-            "Some mesh can benefit from this additional calculation. "));
+            "Some mesh can benefit from this additional calculation. Only used on the GPU, where the depth buffer is sampled. "));
 	}
 	return par;
 }
@@ -159,11 +169,15 @@ std::map<std::string, QVariant> SdfGpuPlugin::applyFilter(
 		unsigned int& /*postConditionMask*/,
 		vcg::CallBackPos *cb)
 {
-	if (glContext == nullptr){
-		throw MLException("Fatal error: glContext not initialized");
-	}
 	MeshModel* mm = md.mm();
 
+	bool useGPU = pars.getBool("useGPU");
+	if(useGPU && (glContext == nullptr || !glContext->isValid()))
+	{
+		log(GLLogStream::SYSTEM, "No OpenGL context available, the rays are traced on the CPU");
+		useGPU = false;
+	}
+
 	//RETRIEVE PARAMETERS
 	mOnPrimitive  = (ONPRIMITIVE) pars.getEnum("onPrimitive");
 	// assert( mOnPrimitive==ON_VERTICES && "Face mode not supported yet" );
@@ -187,6 +201,13 @@ std::map<std::string, QVariant> SdfGpuPlugin::applyFilter(
 	//MESH CLEAN UP
 	setupMesh( md, mOnPrimitive );
 
+	if(!useGPU)
+	{
+		double timeBudget = (ID(action) != SDF_DEPTH_COMPLEXITY) ? pars.getFloat("timeBudget") : 0;
+		traceRaysCPU(action, *mm, numViews, peel, timeBudget, cb);
+		return std::map<std::string, QVariant>();
+	}
+
 	//glContext->makeCurrent();
 	//GL INIT
 	if(!initGL(*mm))
@@ -606,12 +627,13 @@ void SdfGpuPlugin::setupMesh(MeshDocument& md, ONPRIMITIVE onPrimitive )
 		break;
 	}
 
-	if(!vcg::tri::HasPerVertexAttribute(m,"maxQualityDir") && onPrimitive == ON_VERTICES)
-		mMaxQualityDirPerVertex = vcg::tri::Allocator<CMeshO>::AddPerVertexAttribute<Point3f>(m,std::string("maxQualityDir"));
-	else if(!vcg::tri::HasPerFaceAttribute(m,"maxQualityDir") && onPrimitive == ON_FACES)
-		mMaxQualityDirPerFace = vcg::tri::Allocator<CMeshO>::AddPerFaceAttribute<Point3f>(m,std::string("maxQualityDir"));
+	if(onPrimitive == ON_VERTICES)
+		mMaxQualityDirPerVertex = vcg::tri::Allocator<CMeshO>::GetPerVertexAttribute<Point3f>(m,std::string("maxQualityDir"));
+	else
+		mMaxQualityDirPerFace = vcg::tri::Allocator<CMeshO>::GetPerFaceAttribute<Point3f>(m,std::string("maxQualityDir"));
 
-	glContext->meshAttributesUpdated(mm->id(),true,MLRenderingData::RendAtts());
+	if(glContext != nullptr)
+		glContext->meshAttributesUpdated(mm->id(),true,MLRenderingData::RendAtts());
 
 }
 
@@ -1113,6 +1135,116 @@ void SdfGpuPlugin::TraceRay(const QAction* action, int peelingIteration,const Po
 	checkGLError::debugInfo("Error during depth peeling");
 }
 
+void SdfGpuPlugin::traceRaysCPU(const QAction* action, MeshModel& mm, unsigned int numViews, int peel, double timeBudget, vcg::CallBackPos* cb)
+{
+	CMeshO& m = mm.cm;
+
+	//Same directions of the GPU path, shuffled so that a time budget cuts a uniform subset of them
+	std::vector<Point3m> unifDirVec;
+	GenNormal<Scalarm>::Fibonacci(numViews,unifDirVec);
+	for(Point3m& d : unifDirVec)
+		d.Normalize();
+	std::shuffle(unifDirVec.begin(), unifDirVec.end(), std::mt19937(0));
+
+	log(GLLogStream::SYSTEM, "Number of rays: %i ", unifDirVec.size() );
+
+	meshlab::FaceBvh bvh(m);
+
+	if(ID(action) == SDF_DEPTH_COMPLEXITY)
+	{
+		std::vector<int> complexity = SdfDepthComplexity(bvh, unifDirVec, mPeelingTextureSize, PIXEL_COUNT_THRESHOLD, cb);
+		vector<int> mDepthDistrib(peel,0);
+		for(int c : complexity)
+		{
+			mDepthComplexity = std::max<unsigned int>(mDepthComplexity, c);
+			if(c >= (int)mDepthDistrib.size())
+				mDepthDistrib.resize(c+1,0);
+			mDepthDistrib[c]++;
+		}
+
+		log(GLLogStream::SYSTEM, "Mesh depth complexity %i\n", mDepthComplexity );
+		log(GLLogStream::SYSTEM, "Depth complexity             NumberOfViews\n", mDepthComplexity );
+		for(size_t j = 0; j < mDepthDistrib.size(); j++)
+		{
+			log(GLLogStream::SYSTEM, "   %i                             %i\n", j, mDepthDistrib[j] );
+		}
+		mDepthComplexity = 0;
+		return;
+	}
+
+	//Ray origins: vertices or barycenters of the faces, with their normals
+	const int numElems = (mOnPrimitive == ON_VERTICES) ? m.vn : m.fn;
+	std::vector<Point3m> origins(numElems), normals(numElems);
+	std::vector<int>     ignoreVertex(numElems,-1), ignoreFace(numElems,-1);
+	for(int i = 0; i < numElems; ++i)
+	{
+		if(mOnPrimitive == ON_VERTICES)
+		{
+			origins[i]      = m.vert[i].cP();
+			normals[i]      = m.vert[i].cN();
+			ignoreVertex[i] = i;
+		}
+		else
+		{
+			origins[i]    = Barycenter(m.face[i]);
+			normals[i]    = m.face[i].cN();
+			ignoreFace[i] = i;
+		}
+		if(normals[i].Norm() > 0)
+			normals[i].Normalize();
+	}
+
+	SdfRayParams params;
+	params.obscurance = ID(action) == SDF_OBSCURANCE;
+	params.timeBudget = timeBudget;
+	if(params.obscurance)
+		params.tau = mTau;
+	else
+	{
+		params.minCos      = mMinCos;
+		params.removeFalse = mRemoveFalse;
+	}
+	std::vector<SdfRayResult> results;
+	int tracedRays = TraceSdfRays(bvh, origins, normals, ignoreVertex, ignoreFace, unifDirVec, params, results, cb);
+	if(tracedRays < (int)unifDirVec.size())
+		log(GLLogStream::SYSTEM, "Time budget exceeded: traced %i of %i rays", tracedRays, (int)unifDirVec.size());
+
+	//Store the result in the mesh, as applySdfPerVertex/applySdfPerFace/applyObscurancePerVertex/applyObscurancePerFace
+	for(int i = 0; i < numElems; ++i)
+	{
+		const SdfRayResult& r = results[i];
+		Scalarm q;
+		if(params.obscurance)
+			q = r.value / tracedRays;
+		else
+			//weighted average of the ray lengths, already in mesh units
+			q = (r.weight > 0.0) ? (r.value / r.weight) : 0.0;
+
+		Point3f dir = Point3f::Construct(r.dir);
+		if(dir.Norm() > 0)
+			dir.Normalize();
+
+		if(mOnPrimitive == ON_VERTICES)
+		{
+			m.vert[i].Q()             = q;
+			mMaxQualityDirPerVertex[i] = dir;
+		}
+		else
+		{
+			m.face[i].Q()           = q;
+			mMaxQualityDirPerFace[i] = dir;
+		}
+	}
+
+	if(params.obscurance)
+	{
+		if(mOnPrimitive == ON_VERTICES)
+			tri::UpdateColor<CMeshO>::PerVertexQualityGray(m,0.0f,0.0f);
+		else
+			tri::UpdateColor<CMeshO>::PerFaceQualityGray(m);
+	}
+}
+
 FilterPlugin::FilterArity SdfGpuPlugin::filterArity(const QAction *) const
 {
 	return FilterPlugin::SINGLE_MESH;
@@ -1131,5 +1263,19 @@ bool SdfGpuPlugin::requiresGLContext(const QAction* action) const
 	return false;
 }
 
+bool SdfGpuPlugin::canRunWithoutGLContext(const QAction* action) const
+{
+	// the rays are traced on the CPU when there is no context
+	switch(ID(action)){
+	case SDF_SDF:
+	case SDF_DEPTH_COMPLEXITY:
+	case SDF_OBSCURANCE:
+		return true;
+	default:
+		assert(0);
+	}
+	return false;
+}
+
 MESHLAB_PLUGIN_NAME_EXPORTER(SdfGpuPlugin)
 
@@ -39,6 +39,7 @@ class SdfGpuPlugin : public QObject, public FilterPlugin
 	FilterArity filterArity(const QAction* act) const;
 	
 	bool requiresGLContext(const QAction* action) const;
+	bool canRunWithoutGLContext(const QAction* action) const;
 	
 	//Main plugin function
 	std::map<std::string, QVariant> applyFilter(
@@ -96,6 +97,9 @@ class SdfGpuPlugin : public QObject, public FilterPlugin
 	//Copy obscurance values from result texture to the mesh (face color)
 	void applyObscurancePerFace(MeshModel &m, float numberOfRays);
 	
+	//Sdf, obscurance or depth complexity with the rays traced on the CPU, without OpenGL
+	void traceRaysCPU(const QAction* action, MeshModel& mm, unsigned int numViews, int peel, double timeBudget, vcg::CallBackPos* cb);
+	
 	void preRender(unsigned int peelingIteration);
 	
 	bool postRender(unsigned int peelingIteration);
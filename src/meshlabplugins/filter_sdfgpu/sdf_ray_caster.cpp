@@ -0,0 +1,153 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "sdf_ray_caster.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <QElapsedTimer>
+
+using namespace vcg;
+
+namespace {
+
+/** directions traced for all the origins before checking the time budget */
+const int DIR_BATCH = 8;
+
+} // namespace
+
+int TraceSdfRays(
+	const meshlab::FaceBvh&     bvh,
+	const std::vector<Point3m>& origins,
+	const std::vector<Point3m>& normals,
+	const std::vector<int>&     ignoreVertex,
+	const std::vector<int>&     ignoreFace,
+	const std::vector<Point3m>& dirs,
+	const SdfRayParams&         params,
+	std::vector<SdfRayResult>&  results,
+	vcg::CallBackPos*           cb)
+{
+	const int n     = (int) origins.size();
+	const int nDirs = (int) dirs.size();
+	results.assign(n, SdfRayResult());
+
+	// the faces around the origin are skipped, the offset only guards
+	// against the hits on its neighbours
+	const Scalarm tMin = 1e-5 * bvh.bbox().Diag();
+	const Scalarm tMax = std::numeric_limits<Scalarm>::max();
+
+	QElapsedTimer timer;
+	timer.start();
+	int traced = 0;
+	while (traced < nDirs) {
+		const int batchEnd = std::min(traced + DIR_BATCH, nDirs);
+#pragma omp parallel for schedule(dynamic, 256)
+		for (int i = 0; i < n; ++i) {
+			SdfRayResult&  r   = results[i];
+			const Point3m& nrm = normals[i];
+			for (int k = traced; k < batchEnd; ++k) {
+				const Point3m& d        = dirs[k];
+				Scalarm        cosAngle = std::max<Scalarm>(0, nrm * d);
+				int            face;
+				Scalarm        t;
+				if (params.obscurance) {
+					if (cosAngle <= 0)
+						continue;
+					// unoccluded rays count as occluded at infinite distance
+					Scalarm obscurance = cosAngle;
+					if (bvh.firstHit(origins[i], d, tMin, tMax, ignoreVertex[i], ignoreFace[i], face, t))
+						obscurance *= 1 - std::exp(-params.tau * t);
+					r.value += obscurance;
+					r.dir += d * obscurance;
+				}
+				else {
+					if (cosAngle < params.minCos)
+						continue;
+					if (!bvh.firstHit(origins[i], -d, tMin, tMax, ignoreVertex[i], ignoreFace[i], face, t))
+						continue;
+					if (params.removeFalse && bvh.faceNormal(face) * nrm > 0)
+						continue;
+					Scalarm sdf = t * cosAngle;
+					if (sdf == 0)
+						continue;
+					r.value += sdf;
+					r.weight += cosAngle;
+					r.dir += d * sdf;
+				}
+			}
+		}
+		traced = batchEnd;
+		if (cb != nullptr)
+			cb(100 * traced / nDirs, "Tracing rays...");
+		if (params.timeBudget > 0 && timer.elapsed() > params.timeBudget * 1000)
+			break;
+	}
+	return traced;
+}
+
+std::vector<int> SdfDepthComplexity(
+	const meshlab::FaceBvh&     bvh,
+	const std::vector<Point3m>& dirs,
+	int                         gridSize,
+	int                         pixelThreshold,
+	vcg::CallBackPos*           cb)
+{
+	std::vector<int> complexity(dirs.size(), 0);
+	const Box3m      bbox   = bvh.bbox();
+	const Scalarm    radius = bbox.Diag() / 2;
+	const Scalarm    cell   = 2 * radius / gridSize;
+	std::vector<int> hits(gridSize * gridSize);
+	for (size_t k = 0; k < dirs.size(); ++k) {
+		// orthographic view from outside the box, as the camera of the GPU path
+		const Point3m& d = dirs[k];
+		Point3m        u = std::abs(d.X()) < 0.9 ? Point3m(1, 0, 0) : Point3m(0, 1, 0);
+		u                = (u ^ d).Normalize();
+		Point3m v        = d ^ u;
+		Point3m eye      = bbox.Center() + d * (radius + cell);
+
+#pragma omp parallel for schedule(dynamic, 64)
+		for (int p = 0; p < gridSize * gridSize; ++p) {
+			Scalarm su = -radius + (p % gridSize + Scalarm(0.5)) * cell;
+			Scalarm sv = -radius + (p / gridSize + Scalarm(0.5)) * cell;
+			hits[p]  = bvh.countHits(eye + u * su + v * sv, -d);
+		}
+
+		// rays crossing at least l layers
+		int              maxHits = *std::max_element(hits.begin(), hits.end());
+		std::vector<int> atLeast(maxHits + 2, 0);
+		for (int h : hits)
+			++atLeast[h];
+		for (int l = maxHits - 1; l >= 0; --l)
+			atLeast[l] += atLeast[l + 1];
+		int layers = 1;
+		while (layers + 1 <= maxHits && atLeast[layers + 1] > pixelThreshold)
+			++layers;
+		complexity[k] = layers - 1;
+
+		if (cb != nullptr)
+			cb(int(100 * (k + 1) / dirs.size()), "Tracing rays...");
+	}
+	return complexity;
+}
@@ -0,0 +1,86 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef FILTER_SDFGPU_SDF_RAY_CASTER_H
+#define FILTER_SDFGPU_SDF_RAY_CASTER_H
+
+#include <vector>
+
+#include <common/utilities/face_bvh.h>
+
+/** per-element accumulators, as the result textures of the GPU path */
+struct SdfRayResult
+{
+	Scalarm value  = 0; // sdf or obscurance sum
+	Scalarm weight = 0; // sum of the cosines of the sdf rays
+	Point3m dir    = Point3m(0, 0, 0);
+};
+
+struct SdfRayParams
+{
+	bool    obscurance  = false; // obscurance instead of sdf
+	Scalarm minCos      = 0;     // cosine of half the cone amplitude (sdf)
+	bool    removeFalse = true;  // discard hits on faces facing as the origin (sdf)
+	Scalarm tau         = 0.1f;  // obscurance exponent
+	double  timeBudget  = 0;     // seconds, 0 for no limit
+};
+
+/**
+ * Traces from each origin the rays along dirs with the same weights of the
+ * shaders of the GPU path: the sdf inside the mesh along -dir for the
+ * directions within the cone around the normal, or the obscurance along dir
+ * for all the directions in the hemisphere of the normal. Distances are in
+ * mesh units, so the sdf needs no rescaling.
+ *
+ * ignoreVertex/ignoreFace tell, for each origin, the vertex or the face it
+ * lies on (-1 if none). The origins are processed concurrently, a batch of
+ * directions at a time; once the time budget is exceeded no other batch is
+ * traced.
+ *
+ * @return the number of traced directions
+ */
+int TraceSdfRays(
+	const meshlab::FaceBvh&     bvh,
+	const std::vector<Point3m>& origins,
+	const std::vector<Point3m>& normals,
+	const std::vector<int>&     ignoreVertex,
+	const std::vector<int>&     ignoreFace,
+	const std::vector<Point3m>& dirs,
+	const SdfRayParams&         params,
+	std::vector<SdfRayResult>&  results,
+	vcg::CallBackPos*           cb);
+
+/**
+ * Depth complexity seen from each direction of dirs, as counted by the depth
+ * peeling of the GPU path: the number of layers, after the first one, crossed
+ * by more than pixelThreshold of the gridSize x gridSize parallel rays
+ * covering the bounding box of the mesh.
+ */
+std::vector<int> SdfDepthComplexity(
+	const meshlab::FaceBvh&     bvh,
+	const std::vector<Point3m>& dirs,
+	int                         gridSize,
+	int                         pixelThreshold,
+	vcg::CallBackPos*           cb);
+
+#endif // FILTER_SDFGPU_SDF_RAY_CASTER_H
@@ -30,6 +30,7 @@
 #include <vcg/space/colorspace.h>
 
 #include <QCoreApplication>
+#include <common/utilities/connected_components.h>
 
 using namespace vcg;
 
@@ -636,7 +637,18 @@ std::map<std::string, QVariant> SelectionFilterPlugin::applyFilter(
 		log("Deleted %i faces, %i vertices.", ffn - m.cm.fn, vvn - m.cm.vn);
 	} break;
 
-	case FP_SELECT_CONNECTED: tri::UpdateSelection<CMeshO>::FaceConnectedFF(m.cm); break;
+	case FP_SELECT_CONNECTED: {
+		meshlab::ConnectedComponents cc = meshlab::connectedComponents(m.cm);
+		std::vector<bool>            selectedCC(cc.size(), false);
+		for (size_t i = 0; i < m.cm.face.size(); ++i)
+			if (!m.cm.face[i].IsD() && m.cm.face[i].IsS())
+				selectedCC[cc.faceComponent[i]] = true;
+		for (size_t i = 0; i < m.cm.face.size(); ++i) {
+			int c = cc.faceComponent[i];
+			if (c >= 0 && selectedCC[c])
+				m.cm.face[i].SetS();
+		}
+	} break;
 
 	case FP_SELECTBYANGLE: {
 		CMeshO::FaceIterator fi;
@@ -918,8 +930,7 @@ int SelectionFilterPlugin::getRequirements(const QAction* action)
 {
 	switch (ID(action)) {
 	case CP_SELECT_NON_MANIFOLD_FACE:
-	case CP_SELECT_NON_MANIFOLD_VERTEX:
-	case FP_SELECT_CONNECTED: return MeshModel::MM_FACEFACETOPO;
+	case CP_SELECT_NON_MANIFOLD_VERTEX: return MeshModel::MM_FACEFACETOPO;
 
 	case CP_SELECT_TEXBORDER: return MeshModel::MM_FACEFACETOPO;
 	case CP_SELFINTERSECT_SELECT: return MeshModel::MM_FACEMARK | MeshModel::MM_FACEFACETOPO;
@@ -27,12 +27,12 @@
 #include <float.h>
 #include <stdlib.h>
 #include "filter_texture.h"
-#include "pushpull.h"
 #include "rastering.h"
 #include <vcg/complex/algorithms/update/texture.h>
 #include<wrap/io_trimesh/export_ply.h>
 #include <vcg/complex/algorithms/parametrization/voronoi_atlas.h>
 #include <common/utilities/load_save.h>
+#include <common/utilities/pull_push.h>
 #include <QStandardPaths>
 
 using namespace vcg;
@@ -766,8 +766,7 @@ std::map<std::string, QVariant> FilterTexturePlugin::applyFilter(
 
 		// Rasterizing triangles
 		RasterSampler rs(trgImgs);
-		rs.InitCallback(cb, m.cm.fn, 0, 80);
-		tri::SurfaceSampling<CMeshO,RasterSampler>::Texture(m.cm,rs,textW,textH,true);
+		TiledTextureRaster(m.cm, rs, textW, textH, true, cb, 0, 80);
 
 		// Undo topology changes
 		tri::UpdateTopology<CMeshO>::FaceFace(m.cm);
@@ -777,19 +776,13 @@ std::map<std::string, QVariant> FilterTexturePlugin::applyFilter(
 		{
 			// Revert alpha values for border edge pixels to 255
 			cb(81, "Cleaning up texture ...");
-			for (int y = 0; y<textH; ++y)
-				for (int x = 0; x<textW; ++x)
-				{
-					QRgb px = trgImgs[texInd].pixel(x, y);
-					if (qAlpha(px) < 255 && (!pp || qAlpha(px) > 0))
-						trgImgs[texInd].setPixel(x, y, px | 0xff000000);
-				}
+			RevertBorderAlpha(trgImgs[texInd], pp);
 
 			// PullPush
 			if (pp)
 			{
 				cb(85, "Filling texture holes...");
-				PullPush(trgImgs[texInd], qRgba(0, 0, 0, 0));
+				meshlab::pullPush(trgImgs[texInd], qRgba(0, 0, 0, 0));
 			}
 		}
 
@@ -849,7 +842,7 @@ std::map<std::string, QVariant> FilterTexturePlugin::applyFilter(
 		
 		tri::UpdateNormal<CMeshO>::PerFaceNormalized(srcMesh->cm);
 		// Colorizing vertices
-		VertexSampler vs(srcMesh->cm, srcImgs, upperbound);
+		VertexSampler vs(*srcMesh, srcImgs, upperbound);
 		vs.InitCallback(cb, trgMesh->cm.vn);
 		tri::SurfaceSampling<CMeshO,VertexSampler>::VertexUniform(trgMesh->cm,vs,trgMesh->cm.vn);
 		
@@ -1023,15 +1016,13 @@ void FilterTexturePlugin::transferToTexture(
 	tri::UpdateNormal<CMeshO>::PerFaceNormalized(srcMesh->cm);
 	if (vertexSampling)
 	{
-		TransferColorSampler sampler(srcMesh->cm, trgImgs, upperbound, vertexMode); // color sampling
-		sampler.InitCallback(cb, trgMesh->cm.fn, 0, 80);
-		tri::SurfaceSampling<CMeshO, TransferColorSampler>::Texture(trgMesh->cm, sampler, textW, textH, false);
+		TransferColorSampler sampler(*srcMesh, trgImgs, upperbound, vertexMode); // color sampling
+		TiledTextureRaster(trgMesh->cm, sampler, textW, textH, false, cb, 0, 80);
 	}
 	else
 	{
-		TransferColorSampler sampler(srcMesh->cm, trgImgs, &srcImgs, upperbound); // texture sampling
-		sampler.InitCallback(cb, trgMesh->cm.fn, 0, 80);
-		tri::SurfaceSampling<CMeshO, TransferColorSampler>::Texture(trgMesh->cm, sampler, textW, textH, false);
+		TransferColorSampler sampler(*srcMesh, trgImgs, &srcImgs, upperbound); // texture sampling
+		TiledTextureRaster(trgMesh->cm, sampler, textW, textH, false, cb, 0, 80);
 	}
 
 	// the meshes have to return to their original position
@@ -1052,19 +1043,13 @@ void FilterTexturePlugin::transferToTexture(
 	{
 		// Revert alpha values for border edge pixels to 255
 		cb(81, "Cleaning up texture ...");
-		for (int y = 0; y<textH; ++y)
-			for (int x = 0; x<textW; ++x)
-			{
-				QRgb px = trgImgs[trgTexInd].pixel(x, y);
-				if (qAlpha(px) < 255 && (!pp || qAlpha(px) > 0))
-					trgImgs[trgTexInd].setPixel(x, y, px | 0xff000000);
-			}
+		RevertBorderAlpha(trgImgs[trgTexInd], pp);
 
 		// PullPush
 		if (pp)
 		{
 			cb(85, "Filling texture holes...");
-			PullPush(trgImgs[trgTexInd], qRgba(0, 0, 0, 0));
+			meshlab::pullPush(trgImgs[trgTexInd], qRgba(0, 0, 0, 0));
 		}
 	}
 
@@ -24,10 +24,87 @@
 #ifndef _RASTERING_H
 #define _RASTERING_H
 
+#include <atomic>
+
 #include <common/ml_document/mesh_model.h>
 #include <vcg/complex/algorithms/point_sampling.h>
 #include <vcg/space/triangle2.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+ * Direct access to the texels of a set of ARGB32 images.
+ * The scanline pointers are taken once at construction time: QImage::setPixel
+ * and QImage::scanLine may detach the image and therefore cannot be called
+ * concurrently, while writing distinct texels through these pointers can.
+ */
+class TexelBuffers
+{
+    std::vector<uchar*> bits;
+    std::vector<int> bytesPerLine, widths, heights;
+
+public:
+    TexelBuffers(std::vector<QImage> &imgs)
+    {
+        for (QImage &img : imgs)
+        {
+            assert(img.format() == QImage::Format_ARGB32 || img.format() == QImage::Format_RGB32);
+            bits.push_back(img.bits());
+            bytesPerLine.push_back(img.bytesPerLine());
+            widths.push_back(img.width());
+            heights.push_back(img.height());
+        }
+    }
+
+    int width(int i) const  { return widths[i]; }
+    int height(int i) const { return heights[i]; }
+
+    QRgb *texel(int i, int x, int y) const
+    {
+        return reinterpret_cast<QRgb*>(bits[i] + (size_t)y * bytesPerLine[i]) + x;
+    }
+};
+
+/*
+ * Read-only counterpart of TexelBuffers; source images that are not already
+ * 32 bit are converted once, so that the lookups do not need QImage::pixel.
+ */
+class ConstTexelBuffers
+{
+    std::vector<QImage> converted;
+    std::vector<const uchar*> bits;
+    std::vector<int> bytesPerLine, widths, heights;
+
+public:
+    ConstTexelBuffers() {}
+    ConstTexelBuffers(const std::vector<QImage> &imgs)
+    {
+        converted.reserve(imgs.size());
+        for (const QImage &img : imgs)
+        {
+            if (img.format() == QImage::Format_ARGB32 || img.format() == QImage::Format_RGB32)
+                converted.push_back(img);
+            else
+                converted.push_back(img.convertToFormat(QImage::Format_ARGB32));
+            bits.push_back(converted.back().constBits());
+            bytesPerLine.push_back(converted.back().bytesPerLine());
+            widths.push_back(converted.back().width());
+            heights.push_back(converted.back().height());
+        }
+    }
+
+    size_t size() const     { return bits.size(); }
+    int width(int i) const  { return widths[i]; }
+    int height(int i) const { return heights[i]; }
+
+    QRgb texel(int i, int x, int y) const
+    {
+        return reinterpret_cast<const QRgb*>(bits[i] + (size_t)y * bytesPerLine[i])[x];
+    }
+};
+
 class VertexSampler
 {
     typedef vcg::GridStaticPtr<CMeshO::FaceType, CMeshO::ScalarType > MetroMeshGrid;
@@ -36,7 +113,7 @@ class VertexSampler
     std::vector <QImage> &srcImgs;
     float dist_upper_bound;
 
-    MetroMeshGrid unifGridFace;
+    std::shared_ptr<MetroMeshGrid> unifGridFace;
     MarkerFace markerFunctor;
     vcg::face::PointDistanceBaseFunctor<CMeshO::ScalarType> PDistFunct;
 
@@ -45,11 +122,11 @@ class VertexSampler
     int vertexNo, vertexCnt, start, offset;
 
 public:
-	VertexSampler(CMeshO &_srcMesh, std::vector <QImage> &_srcImg, float upperBound) :
+	VertexSampler(MeshModel &_srcMesh, std::vector <QImage> &_srcImg, float upperBound) :
 	srcImgs(_srcImg), dist_upper_bound(upperBound)
     {
-        unifGridFace.Set(_srcMesh.face.begin(),_srcMesh.face.end());
-        markerFunctor.SetMesh(&_srcMesh);
+        unifGridFace = _srcMesh.faceGrid();
+        markerFunctor.SetMesh(&_srcMesh.cm);
     }
 
     void InitCallback(vcg::CallBackPos *_cb, int _vertexNo, int _start=0, int _offset=100)
@@ -70,7 +147,7 @@ public:
         CMeshO::CoordType closestPt;
         CMeshO::ScalarType dist=dist_upper_bound;
         CMeshO::FaceType *nearestF;
-        nearestF =  unifGridFace.GetClosest(PDistFunct, markerFunctor, v.cP(), dist_upper_bound, dist, closestPt);
+        nearestF =  unifGridFace->GetClosest(PDistFunct, markerFunctor, v.cP(), dist_upper_bound, dist, closestPt);
         if (dist == dist_upper_bound) return;
 
         // Convert point to barycentric coords
@@ -103,7 +180,7 @@ public:
 
 class RasterSampler
 {
-    std::vector<QImage> &trgImgs;
+    TexelBuffers trgImgs;
 
     // Callback stuff
     vcg::CallBackPos *cb;
@@ -111,7 +188,7 @@ class RasterSampler
     int faceNo, faceCnt, start, offset;
 
 public:
-	RasterSampler(std::vector<QImage> &_imgs) : trgImgs(_imgs) {}
+	RasterSampler(std::vector<QImage> &_imgs) : trgImgs(_imgs), cb(nullptr), currFace(nullptr) {}
 
     void InitCallback(vcg::CallBackPos *_cb, int _faceNo, int _start=0, int _offset=100)
     {
@@ -139,10 +216,15 @@ public:
         if (edgeDist != 0.0)
             alpha=254-edgeDist*128;
 
-        if (alpha == 255 || qAlpha(trgImgs[f.cWT(0).N()].pixel(tp.X(), trgImgs[f.cWT(0).N()].height() - 1 - tp.Y())) < alpha)
+        int texInd = f.cWT(0).N();
+        int x = tp.X(), y = trgImgs.height(texInd) - 1 - tp.Y();
+        if (x < 0 || x >= trgImgs.width(texInd) || y < 0 || y >= trgImgs.height(texInd))
+            return;
+        QRgb *texel = trgImgs.texel(texInd, x, y);
+        if (alpha == 255 || qAlpha(*texel) < alpha)
         {
             c.lerp(f.cV(0)->cC(), f.cV(1)->cC(), f.cV(2)->cC(), p);
-			trgImgs[f.cWT(0).N()].setPixel(tp.X(), trgImgs[f.cWT(0).N()].height() - 1 - tp.Y(), qRgba(c[0], c[1], c[2], alpha));
+            *texel = qRgba(c[0], c[1], c[2], alpha);
         }
         if (cb)
         {
@@ -157,12 +239,12 @@ class TransferColorSampler
     typedef vcg::GridStaticPtr<CMeshO::FaceType, CMeshO::ScalarType > MetroMeshGrid;
     typedef vcg::GridStaticPtr<CMeshO::VertexType, CMeshO::ScalarType > VertexMeshGrid;
 
-    std::vector <QImage> &trgImgs;
-    std::vector <QImage> *srcImgs;
+    TexelBuffers trgImgs;
+    ConstTexelBuffers srcImgs;
     float dist_upper_bound;
     bool fromTexture;
-    MetroMeshGrid unifGridFace;
-    VertexMeshGrid   unifGridVert;
+    std::shared_ptr<MetroMeshGrid> unifGridFace;
+    std::shared_ptr<VertexMeshGrid>   unifGridVert;
     bool usePointCloudSampling;
 
     // Callback stuff
@@ -172,7 +254,9 @@ class TransferColorSampler
     int faceNo, faceCnt, start, offset;
     int vertexMode;
     float minQ,maxQ;
-    typedef vcg::tri::FaceTmark<CMeshO> MarkerFace;
+    // the marks stored in the mesh are shared state: queries issued by
+    // concurrent rasterization threads must not use them
+    typedef vcg::tri::EmptyTMark<CMeshO> MarkerFace;
     MarkerFace markerFunctor;
 
     /*QRgb GetBilinearPixelColor(float _u, float _v, int alpha)
@@ -206,29 +290,28 @@ class TransferColorSampler
     }*/
 
 public:
-    TransferColorSampler(CMeshO &_srcMesh, std::vector <QImage> &_trgImgs, float upperBound, int _vertexMode)
-    : trgImgs(_trgImgs), dist_upper_bound(upperBound)
+    TransferColorSampler(MeshModel &_srcMesh, std::vector <QImage> &_trgImgs, float upperBound, int _vertexMode)
+    : trgImgs(_trgImgs), dist_upper_bound(upperBound), cb(nullptr), currFace(nullptr)
     {
-        srcMesh=&_srcMesh;
-        usePointCloudSampling = _srcMesh.face.empty();
-        if(usePointCloudSampling) unifGridVert.Set(_srcMesh.vert.begin(),_srcMesh.vert.end());
-                        else  unifGridFace.Set(_srcMesh.face.begin(),_srcMesh.face.end());
-        markerFunctor.SetMesh(&_srcMesh);
+        srcMesh=&_srcMesh.cm;
+        usePointCloudSampling = srcMesh->face.empty();
+        if(usePointCloudSampling) unifGridVert = _srcMesh.vertexGrid();
+                        else  unifGridFace = _srcMesh.faceGrid();
         fromTexture = false;
         vertexMode=_vertexMode;
         if(vertexMode==2)
         {
-            std::pair<float,float> minmax = vcg::tri::Stat<CMeshO>::ComputePerVertexQualityMinMax(_srcMesh);
+            std::pair<float,float> minmax = vcg::tri::Stat<CMeshO>::ComputePerVertexQualityMinMax(*srcMesh);
             minQ=minmax.first;
             maxQ=minmax.second;
         }
     }
 
-	TransferColorSampler(CMeshO &_srcMesh, std::vector <QImage> &_trgImgs, std::vector <QImage> *_srcImgs, float upperBound)
-		: trgImgs(_trgImgs), srcImgs(_srcImgs), dist_upper_bound(upperBound)
+	TransferColorSampler(MeshModel &_srcMesh, std::vector <QImage> &_trgImgs, std::vector <QImage> *_srcImgs, float upperBound)
+		: trgImgs(_trgImgs), srcImgs(*_srcImgs), dist_upper_bound(upperBound), cb(nullptr), currFace(nullptr)
     {
-        unifGridFace.Set(_srcMesh.face.begin(),_srcMesh.face.end());
-        markerFunctor.SetMesh(&_srcMesh);
+        srcMesh=&_srcMesh.cm;
+        unifGridFace = _srcMesh.faceGrid();
         fromTexture = true;
         usePointCloudSampling=false;
         vertexMode=-1;
@@ -275,7 +358,9 @@ public:
         {
             CMeshO::VertexType   *nearestV=0;
             CMeshO::ScalarType dist=dist_upper_bound;
-            nearestV =  vcg::tri::GetClosestVertex<CMeshO,VertexMeshGrid>(*srcMesh,unifGridVert,startPt,dist_upper_bound,dist); //(PDistFunct,markerFunctor,startPt,dist_upper_bound,dist,closestPt);
+            CMeshO::CoordType closestPt;
+            vcg::vertex::PointDistanceFunctor<CMeshO::ScalarType> PDistFunct;
+            nearestV =  unifGridVert->GetClosest(PDistFunct,markerFunctor,startPt,dist_upper_bound,dist,closestPt);
             //if(cb) cb(sampleCnt++*100/sampleNum,"Resampling Vertex attributes");
             //if(storeDistanceAsQualityFlag)  p.Q() = dist;
             if(dist == dist_upper_bound) return ;
@@ -300,11 +385,12 @@ public:
                     rr = gg = bb = q;
                 } break;
             }
+            int texInd = f.cWT(0).N();
             int cx = tp.X();
-            int cy = trgImgs[f.cWT(0).N()].height() - 1 - tp.Y();
-            if (cx >= 0 && cx < trgImgs[f.cWT(0).N()].size().width()) {
-                if (cy >= 0 && cy < trgImgs[f.cWT(0).N()].size().height()){
-                    trgImgs[f.cWT(0).N()].setPixel(cx, cy, qRgba(rr, gg, bb, 255));
+            int cy = trgImgs.height(texInd) - 1 - tp.Y();
+            if (cx >= 0 && cx < trgImgs.width(texInd)) {
+                if (cy >= 0 && cy < trgImgs.height(texInd)){
+                    *trgImgs.texel(texInd, cx, cy) = qRgba(rr, gg, bb, 255);
                 }
             }
         }
@@ -314,7 +400,7 @@ public:
             vcg::face::PointDistanceBaseFunctor<CMeshO::ScalarType> PDistFunct;
             CMeshO::ScalarType dist=dist_upper_bound;
             CMeshO::FaceType *nearestF;
-            nearestF =  unifGridFace.GetClosest(PDistFunct, markerFunctor, startPt, dist_upper_bound, dist, closestPt);
+            nearestF =  unifGridFace->GetClosest(PDistFunct, markerFunctor, startPt, dist_upper_bound, dist, closestPt);
             if (dist == dist_upper_bound) return;
 
             // Convert point to barycentric coords
@@ -338,19 +424,26 @@ public:
               interp[2]=1.0-interp[1]-interp[0];
             }
 
-		if (alpha == 255 || qAlpha(trgImgs[f.cWT(0).N()].pixel(tp.X(), trgImgs[f.cWT(0).N()].height() - 1 - tp.Y())) < alpha)
+            int texInd = f.cWT(0).N();
+            int cx = tp.X();
+            int cy = trgImgs.height(texInd) - 1 - tp.Y();
+            if (cx < 0 || cx >= trgImgs.width(texInd) || cy < 0 || cy >= trgImgs.height(texInd))
+                return;
+            QRgb *texel = trgImgs.texel(texInd, cx, cy);
+
+		if (alpha == 255 || qAlpha(*texel) < alpha)
         {
             if (fromTexture)
             {
-				int w = (*srcImgs)[nearestF->cWT(0).N()].width(), h = (*srcImgs)[nearestF->cWT(0).N()].height();
+				int w = srcImgs.width(nearestF->cWT(0).N()), h = srcImgs.height(nearestF->cWT(0).N());
                 int x, y;
                 x = w * (interp[0]*nearestF->cWT(0).U()+interp[1]*nearestF->cWT(1).U()+interp[2]*nearestF->cWT(2).U());
                 y = h * (1.0 - (interp[0]*nearestF->cWT(0).V()+interp[1]*nearestF->cWT(1).V()+interp[2]*nearestF->cWT(2).V()));
                 // texture repeat mode
                 x = (x%w + w)%w;
                 y = (y%h + h)%h;
-				QRgb px = (*srcImgs)[nearestF->cWT(0).N()].pixel(x, y);
-				trgImgs[f.cWT(0).N()].setPixel(tp.X(), trgImgs[f.cWT(0).N()].height() - 1 - tp.Y(), qRgba(qRed(px), qGreen(px), qBlue(px), alpha));
+				QRgb px = srcImgs.texel(nearestF->cWT(0).N(), x, y);
+				*texel = qRgba(qRed(px), qGreen(px), qBlue(px), alpha);
             }
             else
             {
@@ -377,7 +470,7 @@ public:
                 } break;
                 default: assert(0);
                 }
-				trgImgs[f.cWT(0).N()].setPixel(tp.X(), trgImgs[f.cWT(0).N()].height() - 1 - tp.Y(), qRgba(c[0], c[1], c[2], alpha));
+				*texel = qRgba(c[0], c[1], c[2], alpha);
             }
         }
             if (cb)
@@ -389,4 +482,110 @@ public:
     }
 };
 
+/*
+ * Forwards to the wrapped sampler only the samples that fall inside a given
+ * rectangle of the texture (in rasterization coordinates).
+ */
+template <class Sampler>
+class TileClipSampler
+{
+    Sampler &sampler;
+    int x0, y0, x1, y1;
+
+public:
+    TileClipSampler(Sampler &_sampler, int _x0, int _y0, int _x1, int _y1) :
+        sampler(_sampler), x0(_x0), y0(_y0), x1(_x1), y1(_y1) {}
+
+    void AddTextureSample(const CMeshO::FaceType &f, const CMeshO::CoordType &p, const vcg::Point2i &tp, float edgeDist=0.0)
+    {
+        if (tp.X() >= x0 && tp.X() < x1 && tp.Y() >= y0 && tp.Y() < y1)
+            sampler.AddTextureSample(f, p, tp, edgeDist);
+    }
+};
+
+/*
+ * Parallel replacement of tri::SurfaceSampling<CMeshO,Sampler>::Texture.
+ *
+ * The texture is split in square tiles and each face is binned into the tiles
+ * covered by its texture-space bounding box. Tiles are then rasterized
+ * concurrently: every tile rasterizes its faces (in mesh order) keeping only
+ * the texels it owns, so no texel is written by two threads and each texel
+ * sees the same sequence of samples as in the serial rasterization. The
+ * sampler AddTextureSample must be safe to call concurrently for distinct
+ * texels.
+ */
+template <class Sampler>
+void TiledTextureRaster(CMeshO &m, Sampler &sampler, int textureWidth, int textureHeight,
+                        bool correctSafePointsBaryCoords, vcg::CallBackPos *cb=nullptr, int start=0, int offset=100)
+{
+    typedef vcg::Point2<CMeshO::ScalarType> Point2s;
+    const int tileSize = 128;
+    const int tilesX = (textureWidth + tileSize - 1) / tileSize;
+    const int tilesY = (textureHeight + tileSize - 1) / tileSize;
+
+    std::vector<std::vector<CMeshO::FaceType*>> tileFaces(tilesX * tilesY);
+    for (CMeshO::FaceIterator fi = m.face.begin(); fi != m.face.end(); ++fi)
+    {
+        if (fi->IsD()) continue;
+        vcg::Box2<CMeshO::ScalarType> bb;
+        for (int i = 0; i < 3; ++i)
+            bb.Add(Point2s(fi->WT(i).U() * textureWidth - 0.5, fi->WT(i).V() * textureHeight - 0.5));
+        // SingleFaceRaster visits one texel beyond the rounded bounding box
+        int bx0 = std::max(0, (int)std::floor(bb.min.X()) - 2) / tileSize;
+        int by0 = std::max(0, (int)std::floor(bb.min.Y()) - 2) / tileSize;
+        int bx1 = std::min(textureWidth - 1, (int)std::ceil(bb.max.X()) + 2);
+        int by1 = std::min(textureHeight - 1, (int)std::ceil(bb.max.Y()) + 2);
+        if (bx1 < 0 || by1 < 0) continue;
+        bx1 /= tileSize;
+        by1 /= tileSize;
+        for (int ty = by0; ty <= by1; ++ty)
+            for (int tx = bx0; tx <= bx1; ++tx)
+                tileFaces[ty * tilesX + tx].push_back(&*fi);
+    }
+
+    const int tileNum = tilesX * tilesY;
+    std::atomic<int> tileCnt(0);
+#pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < tileNum; ++t)
+    {
+        const int tx = t % tilesX, ty = t / tilesX;
+        TileClipSampler<Sampler> clip(sampler, tx * tileSize, ty * tileSize,
+                                      std::min((tx + 1) * tileSize, textureWidth),
+                                      std::min((ty + 1) * tileSize, textureHeight));
+        for (CMeshO::FaceType *f : tileFaces[t])
+        {
+            Point2s ti[3];
+            for (int i = 0; i < 3; ++i)
+                ti[i] = Point2s(f->WT(i).U() * textureWidth - 0.5, f->WT(i).V() * textureHeight - 0.5);
+            vcg::tri::SurfaceSampling<CMeshO, TileClipSampler<Sampler>>::SingleFaceRaster(*f, clip, ti[0], ti[1], ti[2], correctSafePointsBaryCoords);
+        }
+
+        int done = tileCnt.fetch_add(1) + 1;
+#ifdef _OPENMP
+        if (omp_get_thread_num() != 0) continue;
+#endif
+        if (cb) cb(start + done * offset / tileNum, "Rasterizing faces ...");
+    }
+}
+
+/*
+ * After rasterization, texels touched only by the safety border of the faces
+ * have alpha < 255: make them opaque (the ones left fully transparent are
+ * kept as holes when they are going to be filled by pull-push).
+ */
+inline void RevertBorderAlpha(QImage &img, bool keepHoles)
+{
+    uchar *bits = img.bits();
+    const int bytesPerLine = img.bytesPerLine();
+    const int w = img.width(), h = img.height();
+#pragma omp parallel for
+    for (int y = 0; y < h; ++y)
+    {
+        QRgb *line = reinterpret_cast<QRgb*>(bits + (size_t)y * bytesPerLine);
+        for (int x = 0; x < w; ++x)
+            if (qAlpha(line[x]) < 255 && (!keepHoles || qAlpha(line[x]) > 0))
+                line[x] |= 0xff000000;
+    }
+}
+
 #endif
@@ -26,6 +26,11 @@
 #include "utils.h"
 #include "mesh_attribute.h"
 
+#include <chrono>
+#include <random>
+#include <numeric>
+#include <limits>
+
 #include <vcg/complex/algorithms/outline_support.h>
 #include <vcg/space/rasterized_outline2_packer.h>
 #include <wrap/qt/outline2_rasterizer.h>
@@ -33,9 +38,142 @@
 
 typedef vcg::RasterizedOutline2Packer<float, QtOutline2Rasterizer> RasterizationBasedPacker;
 
+/* A packing configuration: packer parameters and the order in which the
+ * outlines are handed to the packer (seed 0 keeps the input order) */
+struct PackingTrial {
+    RasterizationBasedPacker::Parameters params;
+    unsigned seed;
+};
+
+struct PackingResult {
+    int n = 0;
+    double usedArea = std::numeric_limits<double>::max();
+    std::vector<vcg::Similarity2f> transforms;
+    std::vector<int> polyToContainer;
+};
+
+static std::vector<PackingTrial> GeneratePackingTrials(const RasterizationBasedPacker::Parameters& baseParams)
+{
+    typedef RasterizationBasedPacker::Parameters Params;
+
+    std::vector<PackingTrial> trials;
+    trials.push_back({baseParams, 0});
+
+    // rotations are kept at multiples of 90 degrees, as IntegerShift() requires
+    const Params::CostFuncEnum costFunctions[] = { Params::LowestHorizon, Params::MixedCost, Params::MinWastedSpace };
+
+    // cheap variants first, then shuffled orders, then the permutation search;
+    // the latter only if it is enabled in the base parameters, since it is
+    // turned off on purpose for large atlases
+    for (bool permutations : { false, true }) {
+        if (permutations && !baseParams.permutations)
+            continue;
+        for (auto costFunction : costFunctions) {
+            for (bool innerHorizon : { true, false }) {
+                for (bool doubleHorizon : { false, true }) {
+                    Params p = baseParams;
+                    p.permutations = permutations;
+                    p.costFunction = costFunction;
+                    p.innerHorizon = innerHorizon;
+                    p.doubleHorizon = doubleHorizon;
+                    bool isBase = (p.permutations == baseParams.permutations && p.costFunction == baseParams.costFunction
+                                   && p.innerHorizon == baseParams.innerHorizon && p.doubleHorizon == baseParams.doubleHorizon);
+                    if (!isBase)
+                        trials.push_back({p, 0});
+                }
+            }
+        }
+        if (!permutations) {
+            for (unsigned seed = 1; seed <= 4; ++seed)
+                trials.push_back({baseParams, seed});
+        }
+    }
+
+    return trials;
+}
+
+static PackingResult RunPackingTrial(const PackingTrial& trial, const std::vector<Outline2f>& outlines, vcg::Point2i container, double packingScale)
+{
+    std::vector<unsigned> order(outlines.size());
+    std::iota(order.begin(), order.end(), 0);
+    if (trial.seed > 0)
+        std::shuffle(order.begin(), order.end(), std::mt19937(trial.seed));
+
+    std::vector<Outline2f> orderedOutlines;
+    orderedOutlines.reserve(outlines.size());
+    for (unsigned i : order)
+        orderedOutlines.push_back(outlines[i]);
+
+    std::vector<vcg::Similarity2f> transforms;
+    std::vector<int> polyToContainer;
+    int n = RasterizationBasedPacker::PackBestEffortAtScale(orderedOutlines, {container}, transforms, polyToContainer, trial.params, packingScale);
+
+    PackingResult result;
+    result.n = n;
+    result.transforms.resize(outlines.size());
+    result.polyToContainer.resize(outlines.size(), -1);
+
+    vcg::Box2f usedBox;
+    for (unsigned k = 0; k < order.size(); ++k) {
+        result.transforms[order[k]] = transforms[k];
+        result.polyToContainer[order[k]] = polyToContainer[k];
+        if (polyToContainer[k] != -1) {
+            for (const auto& p : orderedOutlines[k])
+                usedBox.Add(transforms[k] * p);
+        }
+    }
+    if (n > 0)
+        result.usedArea = usedBox.DimX() * usedBox.DimY();
+
+    return result;
+}
 
-int Pack(const std::vector<ChartHandle>& charts, TextureObjectHandle textureObject, std::vector<TextureSize>& texszVec)
+/* Packs the outlines into the container evaluating the packing trials on
+ * worker threads, and returns the densest packing (the one that packs the most
+ * outlines in the smallest bounding box). The first (base) trial is always
+ * evaluated, the others only if they start before the time budget is
+ * exhausted; with no budget the other trials are skipped altogether */
+static PackingResult PackConcurrently(const std::vector<PackingTrial>& trials, const std::vector<Outline2f>& outlines, vcg::Point2i container,
+                                      double packingScale, std::chrono::steady_clock::time_point t0, double timeBudget)
 {
+    const int ntrials = (timeBudget > 0) ? (int) trials.size() : 1;
+
+    std::vector<PackingResult> results(ntrials);
+    std::vector<char> evaluated(ntrials, 0);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < ntrials; ++i) {
+        if (i > 0) {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (elapsed > timeBudget)
+                continue;
+        }
+        results[i] = RunPackingTrial(trials[i], outlines, container, packingScale);
+        evaluated[i] = 1;
+    }
+
+    // ties are broken by trial index, so that the same set of evaluated trials
+    // always gives the same packing
+    int best = 0;
+    int count = 0;
+    for (int i = 0; i < ntrials; ++i) {
+        if (!evaluated[i])
+            continue;
+        count++;
+        if (results[i].n > results[best].n || (results[i].n == results[best].n && results[i].usedArea < results[best].usedArea))
+            best = i;
+    }
+
+    LOG_INFO << "Evaluated " << count << " packing configurations, selected configuration " << best;
+
+    return results[best];
+}
+
+
+int Pack(const std::vector<ChartHandle>& charts, TextureObjectHandle textureObject, std::vector<TextureSize>& texszVec, double timeBudget)
+{
+    auto t0 = std::chrono::steady_clock::now();
+
     // Pack the atlas
 
     texszVec.clear();
@@ -76,6 +214,8 @@ int Pack(const std::vector<ChartHandle>& charts, TextureObjectHandle textureObje
     packingParams.gutterWidth = 4;
     packingParams.minmax = false; // not used
 
+    std::vector<PackingTrial> trials = GeneratePackingTrials(packingParams);
+
     int totPacked = 0;
 
     std::vector<int> containerIndices(outlines.size(), -1); // -1 means not packed to any container
@@ -101,10 +241,11 @@ int Pack(const std::vector<ChartHandle>& charts, TextureObjectHandle textureObje
         std::vector<int> polyToContainer;
         int n = 0;
         do {
-            transforms.clear();
-            polyToContainer.clear();
             LOG_INFO << "Packing into grid of size " << containerVec[nc].X() << " " << containerVec[nc].Y();
-            n = RasterizationBasedPacker::PackBestEffortAtScale(outlines_iter, {containerVec[nc]}, transforms, polyToContainer, packingParams, packingScale);
+            PackingResult result = PackConcurrently(trials, outlines_iter, containerVec[nc], packingScale, t0, timeBudget);
+            n = result.n;
+            transforms = std::move(result.transforms);
+            polyToContainer = std::move(result.polyToContainer);
             if (n == 0) {
                 containerVec[nc].X() *= 1.1;
                 containerVec[nc].Y() *= 1.1;
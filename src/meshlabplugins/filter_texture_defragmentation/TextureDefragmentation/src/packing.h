@@ -30,8 +30,11 @@
 
 /* Pack the texture atlas encoded in the graph. Assumes the segmentation
  * correctly reflects the texture coordinates.
+ * Several packing configurations are evaluated concurrently and the densest
+ * is kept; configurations beyond the default one are only started within
+ * timeBudget seconds, so with a zero budget only the default is evaluated.
  * Returns the actual number of charts packed */
-int Pack(const std::vector<ChartHandle>& charts, TextureObjectHandle textureObject, std::vector<TextureSize>& texszVec);
+int Pack(const std::vector<ChartHandle>& charts, TextureObjectHandle textureObject, std::vector<TextureSize>& texszVec, double timeBudget = 0);
 
 /* Computes the UV outline(s) of the given chart. If the chart has no outlines,
  * which can happen for some inputs on small closed components that are ignored
@@ -31,6 +31,7 @@
 #include "logging.h"
 
 
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <unordered_set>
@@ -41,34 +42,20 @@
 constexpr double PENALTY_MULTIPLIER = 2.0;
 
 
-struct Perf {
-    double t_init;
-    double t_seamdata;
-    double t_alignmerge;
-    double t_optimization_area;
-    double t_optimize;
-    double t_optimize_build;
-    double t_optimize_arap;
-    double t_check_before;
-    double t_check_after;
-    double t_accept;
-    double t_reject;
-    Timer timer;
-};
-
-
-static void InsertNewClusterInQueue(ClusteredSeamHandle csh, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params);
+static void InsertNewClustersInQueue(const std::vector<ClusteredSeamHandle>& cshvec, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params);
+static void CommitClusterInQueue(ClusteredSeamHandle csh, CostInfo ci, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params);
+static std::vector<CostInfo> ComputeCosts(const std::vector<ClusteredSeamHandle>& cshvec, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params);
 static CostInfo ComputeCost(ClusteredSeamHandle csh, GraphHandle graph, const AlgoParameters& params, double penalty);
 static inline double GetPenalty(ClusteredSeamHandle csh, AlgoStateHandle state);
 static inline bool Valid(const WeightedSeam& ws, ConstAlgoStateHandle state);
 static inline void PurgeQueue(AlgoStateHandle state);
 static void ComputeSeamData(SeamData& sd, ClusteredSeamHandle csh, GraphHandle graph, AlgoStateHandle state);
-static OffsetMap AlignAndMerge(ClusteredSeamHandle csh, SeamData& sd, const MatchingTransform& mi, const AlgoParameters& params);
-static void ComputeOptimizationArea(SeamData& sd, Mesh& mesh, OffsetMap& om);
+static OffsetMap AlignAndMerge(ClusteredSeamHandle csh, SeamData& sd, const MatchingTransform& mi, AlgoStateHandle state, const AlgoParameters& params);
+static void ComputeOptimizationArea(SeamData& sd, Mesh& mesh, OffsetMap& om, AlgoStateHandle state);
 static std::unordered_set<Mesh::VertexPointer> ComputeVerticesWithinOffsetThreshold(Mesh& m, const OffsetMap& om, const SeamData& sd);
-static CheckStatus CheckBoundaryAfterAlignment(SeamData& sd);
+static CheckStatus CheckBoundaryAfterAlignment(SeamData& sd, AlgoStateHandle state);
 static CheckStatus CheckAfterLocalOptimization(SeamData& sd, AlgoStateHandle state, const AlgoParameters& params);
-static CheckStatus OptimizeChart(SeamData& sd, GraphHandle graph, bool fixIntersectingEdges);
+static CheckStatus OptimizeChart(SeamData& sd, GraphHandle graph, AlgoStateHandle state, bool fixIntersectingEdges);
 static void AcceptMove(const SeamData& sd, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params);
 static void RejectMove(const SeamData& sd, AlgoStateHandle state, GraphHandle graph, CheckStatus status);
 static void EraseSeam(ClusteredSeamHandle csh, AlgoStateHandle state, GraphHandle graph);
@@ -77,18 +64,10 @@ static void RestoreChartAttributes(ChartHandle c, Mesh& m, std::vector<int>::con
 static CostInfo ReduceSeam(ClusteredSeamHandle csh, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params);
 
 
-Perf perf = {};
-
-#define PERF_TIMER_RESET (perf = {}, perf.timer.Reset())
-#define PERF_TIMER_START double perf_timer_t0 = perf.timer.TimeElapsed()
-#define PERF_TIMER_ACCUMULATE(field) perf.field += perf.timer.TimeElapsed() - perf_timer_t0
-#define PERF_TIMER_ACCUMULATE_FROM_PREVIOUS(field) perf.field += perf.timer.TimeSinceLastCheck()
-
-//static int statsCheck[10] = {};
-//static int feasibility[6] = {};
-
-static std::vector<int> statsCheck(CheckStatus::_END, 0);
-static std::vector<int> feasibility(CostInfo::MatchingValue::_END, 0);
+#define PERF_TIMER_RESET (state->stats.timer.Reset())
+#define PERF_TIMER_START double perf_timer_t0 = state->stats.timer.TimeElapsed()
+#define PERF_TIMER_ACCUMULATE(field) state->stats.field += state->stats.timer.TimeElapsed() - perf_timer_t0
+#define PERF_TIMER_ACCUMULATE_FROM_PREVIOUS(field) state->stats.field += state->stats.timer.TimeSinceLastCheck()
 
 static vcg::Color4b statusColor[] = {
     vcg::Color4b::White, // PASS=0,
@@ -111,68 +90,56 @@ static vcg::Color4b mvColor[] = {
     vcg::Color4b::Magenta //   UNFEASIBLE_MATCHING,
 };
 
-static int accept = 0;
-static int reject = 0;
-
-static int num_retry = 0;
-static int retry_success = 0;
-
-double mincost = 100000;
-double maxcost = -1;
-
-double min_energy = 10000000000;
-double max_energy = 0;
-
-static void ClearGlobals()
+static void ResetCounters(AlgoStateHandle state)
 {
-    for (unsigned i = 0; i < statsCheck.size(); ++i)
-        statsCheck[i] = 0;
-    for (unsigned i = 0; i < feasibility.size(); ++i)
-        feasibility[i] = 0;
-    accept = 0;
-    reject = 0;
-
-    num_retry = 0;
-    retry_success = 0;
+    AlgoStats& stats = state->stats;
+    std::fill(stats.statsCheck.begin(), stats.statsCheck.end(), 0);
+    std::fill(stats.feasibility.begin(), stats.feasibility.end(), 0);
+    stats.accept = 0;
+    stats.reject = 0;
+
+    stats.num_retry = 0;
+    stats.retry_success = 0;
 }
 
-void LogExecutionStats()
+static void LogExecutionStats(AlgoStateHandle state)
 {
+    AlgoStats& stats = state->stats;
     LOG_INFO    << "======== EXECUTION STATS ========";
-    LOG_INFO    << "INIT       " << std::fixed << std::setprecision(3) << perf.t_init / perf.timer.TimeElapsed()                                << " , " << std::defaultfloat << std::setprecision(6)<< perf.t_init << " secs";
-    LOG_INFO    << "SEAM       " << std::fixed << std::setprecision(3) << perf.t_seamdata / perf.timer.TimeElapsed()                            << " , " << std::defaultfloat << std::setprecision(6)<< perf.t_seamdata << " secs";
-    LOG_INFO    << "MERGE      " << std::fixed << std::setprecision(3) << perf.t_alignmerge / perf.timer.TimeElapsed()                          << " , " << std::defaultfloat << std::setprecision(6)<< perf.t_alignmerge << " secs";
-    LOG_INFO    << "AREA OPT   " << std::fixed << std::setprecision(3) << perf.t_optimization_area / perf.timer.TimeElapsed()                   << " , " << std::defaultfloat << std::setprecision(6)<< perf.t_optimization_area << " secs";
-    LOG_INFO    << "OPTIMIZE   " << std::fixed << std::setprecision(3) << perf.t_optimize / perf.timer.TimeElapsed()                            << " , " << std::defaultfloat << std::setprecision(6)<< perf.t_optimize << " secs";
-    LOG_VERBOSE << "  BUILD    " << std::fixed << std::setprecision(3) << perf.t_optimize_build / perf.timer.TimeElapsed()                      << " , " << std::defaultfloat << std::setprecision(6)<< perf.t_optimize_build << " secs";
-    LOG_VERBOSE << "  ARAP     " << std::fixed << std::setprecision(3) << perf.t_optimize_arap / perf.timer.TimeElapsed()                       << " , " << std::defaultfloat << std::setprecision(6)<< perf.t_optimize_arap << " secs";
-    LOG_INFO    << "CHECK      " << std::fixed << std::setprecision(3) << (perf.t_check_before + perf.t_check_after) / perf.timer.TimeElapsed() << " , " << std::defaultfloat << std::setprecision(6)<< (perf.t_check_before + perf.t_check_after) << " secs";
-    LOG_VERBOSE << "  BEFORE   " << std::fixed << std::setprecision(3) << perf.t_check_before / perf.timer.TimeElapsed()                        << " , " << std::defaultfloat << std::setprecision(6)<< perf.t_check_before << " secs";
-    LOG_VERBOSE << "  AFTER    " << std::fixed << std::setprecision(3) << perf.t_check_after / perf.timer.TimeElapsed()                         << " , " << std::defaultfloat << std::setprecision(6)<< perf.t_check_after << " secs";
-    LOG_INFO    << "ACCEPT     " << std::fixed << std::setprecision(3) << perf.t_accept / perf.timer.TimeElapsed()                              << " , " << std::defaultfloat << std::setprecision(6)<< perf.t_accept << " secs";
-    LOG_INFO    << "  count:                    " << accept;
-    LOG_INFO    << "  with retry:               " << retry_success;
-    LOG_VERBOSE << "  min energy:               " << min_energy;
-    LOG_VERBOSE << "  max energy:               " << max_energy;
-    LOG_INFO    << "REJECT     " << std::fixed << std::setprecision(3) << perf.t_reject / perf.timer.TimeElapsed()                              << " , " << std::defaultfloat << std::setprecision(6)<< perf.t_reject << " secs";
-    LOG_INFO    << "  count:                    " << reject;
-    LOG_INFO    << "  with retry:               " << num_retry - retry_success;
-    LOG_VERBOSE << "  local overlaps            " << statsCheck[FAIL_LOCAL_OVERLAP];
-    LOG_VERBOSE << "  global overlaps before    " << statsCheck[FAIL_GLOBAL_OVERLAP_BEFORE];
-    LOG_VERBOSE << "  global overlaps after opt " << statsCheck[FAIL_GLOBAL_OVERLAP_AFTER_OPT];
-    LOG_VERBOSE << "  global overlaps after bnd " << statsCheck[FAIL_GLOBAL_OVERLAP_AFTER_BND];
-    LOG_VERBOSE << "  global overlaps unfixable " << statsCheck[FAIL_GLOBAL_OVERLAP_UNFIXABLE];
-    LOG_VERBOSE << "  distortion (local)        " << statsCheck[FAIL_DISTORTION_LOCAL];
-    LOG_VERBOSE << "  distortion (global)       " << statsCheck[FAIL_DISTORTION_GLOBAL];
-    LOG_VERBOSE << "  topology                  " << statsCheck[FAIL_TOPOLOGY];
-    LOG_VERBOSE << "  numerical error           " << statsCheck[FAIL_NUMERICAL_ERROR];
+    LOG_INFO    << "INIT       " << std::fixed << std::setprecision(3) << stats.t_init / stats.timer.TimeElapsed()                                << " , " << std::defaultfloat << std::setprecision(6)<< stats.t_init << " secs";
+    LOG_INFO    << "SEAM       " << std::fixed << std::setprecision(3) << stats.t_seamdata / stats.timer.TimeElapsed()                            << " , " << std::defaultfloat << std::setprecision(6)<< stats.t_seamdata << " secs";
+    LOG_INFO    << "MERGE      " << std::fixed << std::setprecision(3) << stats.t_alignmerge / stats.timer.TimeElapsed()                          << " , " << std::defaultfloat << std::setprecision(6)<< stats.t_alignmerge << " secs";
+    LOG_INFO    << "AREA OPT   " << std::fixed << std::setprecision(3) << stats.t_optimization_area / stats.timer.TimeElapsed()                   << " , " << std::defaultfloat << std::setprecision(6)<< stats.t_optimization_area << " secs";
+    LOG_INFO    << "OPTIMIZE   " << std::fixed << std::setprecision(3) << stats.t_optimize / stats.timer.TimeElapsed()                            << " , " << std::defaultfloat << std::setprecision(6)<< stats.t_optimize << " secs";
+    LOG_VERBOSE << "  BUILD    " << std::fixed << std::setprecision(3) << stats.t_optimize_build / stats.timer.TimeElapsed()                      << " , " << std::defaultfloat << std::setprecision(6)<< stats.t_optimize_build << " secs";
+    LOG_VERBOSE << "  ARAP     " << std::fixed << std::setprecision(3) << stats.t_optimize_arap / stats.timer.TimeElapsed()                       << " , " << std::defaultfloat << std::setprecision(6)<< stats.t_optimize_arap << " secs";
+    LOG_INFO    << "CHECK      " << std::fixed << std::setprecision(3) << (stats.t_check_before + stats.t_check_after) / stats.timer.TimeElapsed() << " , " << std::defaultfloat << std::setprecision(6)<< (stats.t_check_before + stats.t_check_after) << " secs";
+    LOG_VERBOSE << "  BEFORE   " << std::fixed << std::setprecision(3) << stats.t_check_before / stats.timer.TimeElapsed()                        << " , " << std::defaultfloat << std::setprecision(6)<< stats.t_check_before << " secs";
+    LOG_VERBOSE << "  AFTER    " << std::fixed << std::setprecision(3) << stats.t_check_after / stats.timer.TimeElapsed()                         << " , " << std::defaultfloat << std::setprecision(6)<< stats.t_check_after << " secs";
+    LOG_INFO    << "ACCEPT     " << std::fixed << std::setprecision(3) << stats.t_accept / stats.timer.TimeElapsed()                              << " , " << std::defaultfloat << std::setprecision(6)<< stats.t_accept << " secs";
+    LOG_INFO    << "  count:                    " << stats.accept;
+    LOG_INFO    << "  with retry:               " << stats.retry_success;
+    LOG_VERBOSE << "  min energy:               " << stats.min_energy;
+    LOG_VERBOSE << "  max energy:               " << stats.max_energy;
+    LOG_INFO    << "REJECT     " << std::fixed << std::setprecision(3) << stats.t_reject / stats.timer.TimeElapsed()                              << " , " << std::defaultfloat << std::setprecision(6)<< stats.t_reject << " secs";
+    LOG_INFO    << "  count:                    " << stats.reject;
+    LOG_INFO    << "  with retry:               " << stats.num_retry - stats.retry_success;
+    LOG_VERBOSE << "  local overlaps            " << stats.statsCheck[FAIL_LOCAL_OVERLAP];
+    LOG_VERBOSE << "  global overlaps before    " << stats.statsCheck[FAIL_GLOBAL_OVERLAP_BEFORE];
+    LOG_VERBOSE << "  global overlaps after opt " << stats.statsCheck[FAIL_GLOBAL_OVERLAP_AFTER_OPT];
+    LOG_VERBOSE << "  global overlaps after bnd " << stats.statsCheck[FAIL_GLOBAL_OVERLAP_AFTER_BND];
+    LOG_VERBOSE << "  global overlaps unfixable " << stats.statsCheck[FAIL_GLOBAL_OVERLAP_UNFIXABLE];
+    LOG_VERBOSE << "  distortion (local)        " << stats.statsCheck[FAIL_DISTORTION_LOCAL];
+    LOG_VERBOSE << "  distortion (global)       " << stats.statsCheck[FAIL_DISTORTION_GLOBAL];
+    LOG_VERBOSE << "  topology                  " << stats.statsCheck[FAIL_TOPOLOGY];
+    LOG_VERBOSE << "  numerical error           " << stats.statsCheck[FAIL_NUMERICAL_ERROR];
     LOG_VERBOSE << "    FEASIBILITY";
-    LOG_VERBOSE << "      feasible              " << feasibility[CostInfo::FEASIBLE];
-    LOG_VERBOSE << "      unfeasible boundary   " << feasibility[CostInfo::UNFEASIBLE_BOUNDARY];
-    LOG_VERBOSE << "      unfeasible matching   " << feasibility[CostInfo::UNFEASIBLE_MATCHING];
-    LOG_INFO    << "TOTAL      " << std::fixed << std::setprecision(3) << perf.timer.TimeElapsed() / perf.timer.TimeElapsed()          << " , " << std::defaultfloat << std::setprecision(6)<< perf.timer.TimeElapsed() << " secs";
-    LOG_VERBOSE << "Minimum computed cost is " << mincost;
-    LOG_VERBOSE << "Maximum computed cost is " << maxcost;
+    LOG_VERBOSE << "      feasible              " << stats.feasibility[CostInfo::FEASIBLE];
+    LOG_VERBOSE << "      unfeasible boundary   " << stats.feasibility[CostInfo::UNFEASIBLE_BOUNDARY];
+    LOG_VERBOSE << "      unfeasible matching   " << stats.feasibility[CostInfo::UNFEASIBLE_MATCHING];
+    LOG_INFO    << "TOTAL      " << std::fixed << std::setprecision(3) << stats.timer.TimeElapsed() / stats.timer.TimeElapsed()          << " , " << std::defaultfloat << std::setprecision(6)<< stats.timer.TimeElapsed() << " secs";
+    LOG_VERBOSE << "Minimum computed cost is " << stats.mincost;
+    LOG_VERBOSE << "Maximum computed cost is " << stats.maxcost;
     LOG_INFO    << "===================================";
 }
 
@@ -260,10 +227,11 @@ void PrepareMesh(Mesh& m, int *vndup)
 
 AlgoStateHandle InitializeState(GraphHandle graph, const AlgoParameters& algoParameters)
 {
+    AlgoStateHandle state = std::make_shared<AlgoState>();
+
     PERF_TIMER_RESET;
     PERF_TIMER_START;
 
-    AlgoStateHandle state = std::make_shared<AlgoState>();
     ARAP::ComputeEnergyFromStoredWedgeTC(graph->mesh, &state->arapNum, &state->arapDenom);
     state->inputUVBorderLength = 0;
     state->currentUVBorderLength = 0;
@@ -284,8 +252,8 @@ AlgoStateHandle InitializeState(GraphHandle graph, const AlgoParameters& algoPar
             nself++;
         else
             ndisconnecting++;
-        InsertNewClusterInQueue(csh, state, graph, algoParameters);
     }
+    InsertNewClustersInQueue(cshvec, state, graph, algoParameters);
     LOG_INFO << "Found " << ndisconnecting << " disconnecting seams";
     LOG_INFO << "Found " << nself << " non-disconnecting seams";
 
@@ -306,7 +274,7 @@ AlgoStateHandle InitializeState(GraphHandle graph, const AlgoParameters& algoPar
 
 void GreedyOptimization(GraphHandle graph, AlgoStateHandle state, const AlgoParameters& params)
 {
-    ClearGlobals();
+    ResetCounters(state);
 
     Timer timer;
 
@@ -348,52 +316,52 @@ void GreedyOptimization(GraphHandle graph, AlgoStateHandle state, const AlgoPara
                 ++k;
                 if ((k % 200) == 0) {
                     LOG_INFO << "Logging execution stats after " << k << " iterations";
-                    LogExecutionStats();
+                    LogExecutionStats(state);
                 }
                 SeamData sd;
                 ComputeSeamData(sd, ws.first, graph, state);
                 LOG_DEBUG << "  Chart ids are " << sd.a->id << " " << sd.b->id << " (areas = " << sd.a->AreaUV() << ", " << sd.b->AreaUV() << ")";
 
-                OffsetMap om = AlignAndMerge(ws.first, sd, state->transform[ws.first], params);
+                OffsetMap om = AlignAndMerge(ws.first, sd, state->transform[ws.first], state, params);
 
-                ComputeOptimizationArea(sd, graph->mesh, om);
+                ComputeOptimizationArea(sd, graph->mesh, om, state);
 
                 // when merging two charts, check if they collide outside the optimization area
 
-                CheckStatus status = (sd.a != sd.b) ? CheckBoundaryAfterAlignment(sd) : PASS;
+                CheckStatus status = (sd.a != sd.b) ? CheckBoundaryAfterAlignment(sd, state) : PASS;
 
                 if (status == PASS)
-                    status = OptimizeChart(sd, graph, false);
+                    status = OptimizeChart(sd, graph, state, false);
 
                 if (status == PASS)
                     status = CheckAfterLocalOptimization(sd, state, params);
 
                 while (status == FAIL_GLOBAL_OVERLAP_AFTER_OPT || status == FAIL_GLOBAL_OVERLAP_AFTER_BND) {
                     LOG_DEBUG << "Global overlaps detected after ARAP optimization, fixing edges";
-                    CheckStatus iterStatus = OptimizeChart(sd, graph, true);
+                    CheckStatus iterStatus = OptimizeChart(sd, graph, state, true);
                     if (iterStatus == _END)
                         break;
                     else
                         status = CheckAfterLocalOptimization(sd, state, params);
                 }
 
-                statsCheck[status]++;
+                state->stats.statsCheck[status]++;
 
                 if (status == PASS) {
                     AcceptMove(sd, state, graph, params);
                     ColorizeSeam(sd.csh, vcg::Color4b(255, 69, 0, 255));
-                    accept++;
+                    state->stats.accept++;
                     LOG_DEBUG << "Accepted operation";
                 } else {
                     RejectMove(sd, state, graph, status);
-                    reject++;
+                    state->stats.reject++;
                     LOG_DEBUG << "Rejected operation";
                 }
             }
         }
     }
     PrintStateInfo(state, graph, params);
-    LogExecutionStats();
+    LogExecutionStats(state);
     LOG_INFO << "Atlas energy after optimization is " << ARAP::ComputeEnergyFromStoredWedgeTC(graph->mesh, nullptr, nullptr);
 }
 
@@ -413,12 +381,40 @@ void Finalize(GraphHandle graph, int *vndup)
 
 // -- static functions ---------------------------------------------------------
 
-static void InsertNewClusterInQueue(ClusteredSeamHandle csh, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params)
+// the costs of the clusters are evaluated concurrently, and the clusters are
+// then pushed in the queue in the order they are given, so that the outcome
+// does not depend on the number of threads
+static void InsertNewClustersInQueue(const std::vector<ClusteredSeamHandle>& cshvec, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params)
 {
-    ColorizeSeam(csh, vcg::Color4b::White);
+    std::vector<CostInfo> civec = ComputeCosts(cshvec, state, graph, params);
+    for (unsigned i = 0; i < cshvec.size(); ++i)
+        CommitClusterInQueue(cshvec[i], civec[i], state, graph, params);
+}
+
+static std::vector<CostInfo> ComputeCosts(const std::vector<ClusteredSeamHandle>& cshvec, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params)
+{
+    // ComputeCost() only reads the graph, but the charts lazily update their
+    // cached areas and border lengths, and GetPenalty() may insert into the
+    // penalty map: do both before entering the parallel region
+    std::vector<double> penalty(cshvec.size());
+    for (unsigned i = 0; i < cshvec.size(); ++i) {
+        ChartPair charts = GetCharts(cshvec[i], graph);
+        charts.first->AreaUV();
+        charts.second->AreaUV();
+        penalty[i] = GetPenalty(cshvec[i], state);
+    }
 
-    CostInfo ci = ComputeCost(csh, graph, params, GetPenalty(csh, state));
+    std::vector<CostInfo> civec(cshvec.size());
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int) cshvec.size(); ++i)
+        civec[i] = ComputeCost(cshvec[i], graph, params, penalty[i]);
+
+    return civec;
+}
 
+static void CommitClusterInQueue(ClusteredSeamHandle csh, CostInfo ci, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params)
+{
     if (params.reduce) {
         while (ci.mvalue == CostInfo::UNFEASIBLE_MATCHING) {
             ci = ReduceSeam(csh, state, graph, params);
@@ -427,11 +423,11 @@ static void InsertNewClusterInQueue(ClusteredSeamHandle csh, AlgoStateHandle sta
 
     ColorizeSeam(csh, mvColor[ci.mvalue]);
 
-    feasibility[ci.mvalue]++;
+    state->stats.feasibility[ci.mvalue]++;
 
     if (ci.cost != Infinity()) {
-        mincost = std::min(mincost, ci.cost);
-        maxcost = std::max(maxcost, ci.cost);
+        state->stats.mincost = std::min(state->stats.mincost, ci.cost);
+        state->stats.maxcost = std::max(state->stats.maxcost, ci.cost);
     }
 
     state->queue.push(std::make_pair(csh, ci.cost));
@@ -606,7 +602,7 @@ static void ComputeSeamData(SeamData& sd, ClusteredSeamHandle csh, GraphHandle g
     sd.b = charts.second;
 
     if (state->failed[sd.a->id].count(sd.b->id) > 0)
-        num_retry++;
+        state->stats.num_retry++;
 
     Mesh& m = graph->mesh;
 
@@ -648,7 +644,7 @@ static void WedgeTexFromVertexTex(ChartHandle c)
             fptr->WT(i).P() = fptr->V(i)->T().P();
 }
 
-static OffsetMap AlignAndMerge(ClusteredSeamHandle csh, SeamData& sd, const MatchingTransform& mi, const AlgoParameters& params)
+static OffsetMap AlignAndMerge(ClusteredSeamHandle csh, SeamData& sd, const MatchingTransform& mi, AlgoStateHandle state, const AlgoParameters& params)
 {
     PERF_TIMER_START;
 
@@ -778,7 +774,7 @@ static OffsetMap AlignAndMerge(ClusteredSeamHandle csh, SeamData& sd, const Matc
     return om;
 }
 
-static void ComputeOptimizationArea(SeamData& sd, Mesh& mesh, OffsetMap& om)
+static void ComputeOptimizationArea(SeamData& sd, Mesh& mesh, OffsetMap& om, AlgoStateHandle state)
 {
     PERF_TIMER_START;
 
@@ -964,7 +960,7 @@ static CheckStatus CheckBoundaryAfterAlignmentInner(SeamData& sd)
     return PASS;
 }
 
-static CheckStatus CheckBoundaryAfterAlignment(SeamData& sd)
+static CheckStatus CheckBoundaryAfterAlignment(SeamData& sd, AlgoStateHandle state)
 {
     PERF_TIMER_START;
     LOG_DEBUG << "Running CheckBoundaryAfterAlignment()";
@@ -1103,7 +1099,7 @@ static CheckStatus CheckAfterLocalOptimization(SeamData& sd, AlgoStateHandle sta
     return status;
 }
 
-static CheckStatus OptimizeChart(SeamData& sd, GraphHandle graph, bool fixIntersectingEdges)
+static CheckStatus OptimizeChart(SeamData& sd, GraphHandle graph, AlgoStateHandle state, bool fixIntersectingEdges)
 {
     PERF_TIMER_START;
 
@@ -1272,10 +1268,10 @@ static void AcceptMove(const SeamData& sd, AlgoStateHandle state, GraphHandle gr
 {
     PERF_TIMER_START;
 
-    if (min_energy > sd.si.finalEnergy)
-        min_energy = sd.si.finalEnergy;
-    if (max_energy < sd.si.finalEnergy)
-        max_energy = sd.si.finalEnergy;
+    if (state->stats.min_energy > sd.si.finalEnergy)
+        state->stats.min_energy = sd.si.finalEnergy;
+    if (state->stats.max_energy < sd.si.finalEnergy)
+        state->stats.max_energy = sd.si.finalEnergy;
 
     state->changeSet.insert(sd.optimizationArea.begin(), sd.optimizationArea.end());
 
@@ -1378,12 +1374,15 @@ static void AcceptMove(const SeamData& sd, AlgoStateHandle state, GraphHandle gr
     state->arapDenom += (sd.outputArapDenom - sd.inputArapDenom);
 
     if (state->failed[sd.a->id].count(sd.b->id) > 0)
-        retry_success++;
+        state->stats.retry_success++;
 
     // Erase seam
     EraseSeam(sd.csh, state, graph);
     state->penalty.erase(sd.csh);
 
+    // clusters whose cost must be re-evaluated, in the order they are pushed
+    std::vector<ClusteredSeamHandle> reinsert;
+
     for (auto csh : independentClusters) {
         auto it = state->status.find(csh);
         ensure(it != state->status.end());
@@ -1404,16 +1403,16 @@ static void AcceptMove(const SeamData& sd, AlgoStateHandle state, GraphHandle gr
         if (invalidate || (params.ignoreOnReject && mv == CostInfo::REJECTED))
             InvalidateCluster(csh, state, graph, clusterStatus, 1.0);
         else
-            InsertNewClusterInQueue(csh, state, graph, params);
+            reinsert.push_back(csh);
     }
 
     for (auto csh : sharedClusters)
         EraseSeam(csh, state, graph);
 
     std::vector<ClusteredSeamHandle> cshvec = ClusterSeamsByChartId(shared);
-    for (auto csh : cshvec) {
-        InsertNewClusterInQueue(csh, state, graph, params);
-    }
+    reinsert.insert(reinsert.end(), cshvec.begin(), cshvec.end());
+
+    InsertNewClustersInQueue(reinsert, state, graph, params);
 
     if (params.visitComponents) {
         // if potential islands are allowed to ignore the boundary length limit,
@@ -1426,10 +1425,10 @@ static void AcceptMove(const SeamData& sd, AlgoStateHandle state, GraphHandle gr
                 if (state->mvalue[csh] == CostInfo::MatchingValue::UNFEASIBLE_BOUNDARY)
                     unfeasibleBoundaryAdj.insert(csh);
 
-        for (ClusteredSeamHandle csh : unfeasibleBoundaryAdj) {
+        for (ClusteredSeamHandle csh : unfeasibleBoundaryAdj)
             EraseSeam(csh, state, graph);
-            InsertNewClusterInQueue(csh, state, graph, params);
-        }
+
+        InsertNewClustersInQueue(std::vector<ClusteredSeamHandle>(unfeasibleBoundaryAdj.begin(), unfeasibleBoundaryAdj.end()), state, graph, params);
     }
 
     PERF_TIMER_ACCUMULATE(t_accept);
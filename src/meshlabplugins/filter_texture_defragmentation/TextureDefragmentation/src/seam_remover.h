@@ -33,6 +33,7 @@
 #include "mesh_graph.h"
 #include "matching.h"
 #include "arap.h"
+#include "timer.h"
 
 #include "seams.h"
 #include "intersection.h"
@@ -131,6 +132,35 @@ struct CostInfo {
     MatchingValue mvalue;
 };
 
+// timings and counters of a single optimization run
+struct AlgoStats {
+    double t_init              = 0;
+    double t_seamdata          = 0;
+    double t_alignmerge        = 0;
+    double t_optimization_area = 0;
+    double t_optimize          = 0;
+    double t_optimize_build    = 0;
+    double t_optimize_arap     = 0;
+    double t_check_before      = 0;
+    double t_check_after       = 0;
+    double t_accept            = 0;
+    double t_reject            = 0;
+    Timer timer;
+
+    std::vector<int> statsCheck  = std::vector<int>(CheckStatus::_END, 0);
+    std::vector<int> feasibility = std::vector<int>(CostInfo::MatchingValue::_END, 0);
+
+    int accept        = 0;
+    int reject        = 0;
+    int num_retry     = 0;
+    int retry_success = 0;
+
+    double mincost    = 100000;
+    double maxcost    = -1;
+    double min_energy = 10000000000;
+    double max_energy = 0;
+};
+
 struct AlgoState {
 
     struct WeightedSeamCmp {
@@ -162,6 +192,8 @@ struct AlgoState {
 
     double inputUVBorderLength;
     double currentUVBorderLength;
+
+    AlgoStats stats;
 };
 
 void PrepareMesh(Mesh& m, int *vndup);
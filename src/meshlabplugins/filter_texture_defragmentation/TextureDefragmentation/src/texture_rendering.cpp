@@ -34,9 +34,12 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 
 #include <QImage>
 
+#include <vcg/space/point4.h>
+
 
 
 static const char *vs_text[] = {
@@ -107,6 +110,19 @@ static std::shared_ptr<QImage> RenderTexture(std::vector<Mesh::FacePointer>& fve
                                              bool filter, RenderMode imode,
                                              int textureWidth, int textureHeight);
 
+/* Copy of an input texture with its mipmap chain. Rows are stored bottom-up as
+ * in the OpenGL texture, so that lookups follow the conventions of the shader */
+struct MipmappedTexture {
+    std::vector<int> w;
+    std::vector<int> h;
+    std::vector<std::vector<QRgb>> levels;
+};
+
+static std::shared_ptr<QImage> RenderTextureCPU(std::vector<Mesh::FacePointer>& fvec,
+                                                Mesh &m, const std::vector<MipmappedTexture>& inputTextures,
+                                                bool filter, RenderMode imode,
+                                                int textureWidth, int textureHeight);
+
 
 int FacesByTextureIndex(Mesh& m, std::vector<std::vector<Mesh::FacePointer>>& fv)
 {
@@ -337,3 +353,369 @@ static std::shared_ptr<QImage> RenderTexture(std::vector<Mesh::FacePointer>& fve
 
     return textureImage;
 }
+
+// -- CPU rendering ------------------------------------------------------------
+
+/* The CPU path reproduces the OpenGL one: each face is rasterized in the output
+ * texture with pixel centers at half-integer coordinates and the top-left fill
+ * rule, and the input texture is looked up with repeat wrapping, trilinear
+ * filtering and the same lod selection as 16x anisotropic filtering. The output
+ * is split in square tiles that are rendered concurrently; within a tile, faces
+ * are drawn in the same order as in the OpenGL path */
+
+constexpr int RENDER_TILE_SIZE = 64;
+constexpr float MAX_ANISOTROPY = 16.0f;
+
+static inline vcg::Point4f UnpackColor(QRgb c)
+{
+    return vcg::Point4f(qRed(c), qGreen(c), qBlue(c), qAlpha(c));
+}
+
+static inline QRgb PackColor(const vcg::Point4f& c)
+{
+    auto channel = [](float v) { return (int) std::round(std::min(255.0f, std::max(0.0f, v))); };
+    return qRgba(channel(c[0]), channel(c[1]), channel(c[2]), channel(c[3]));
+}
+
+static inline int WrapIndex(int i, int n)
+{
+    i %= n;
+    return (i < 0) ? i + n : i;
+}
+
+static MipmappedTexture BuildMipmappedTexture(const QImage& image)
+{
+    ensure(!image.isNull());
+    QImage img = image.convertToFormat(QImage::Format_ARGB32);
+
+    MipmappedTexture tex;
+    int w = img.width();
+    int h = img.height();
+    tex.w.push_back(w);
+    tex.h.push_back(h);
+    tex.levels.emplace_back(std::size_t(w) * h);
+    for (int y = 0; y < h; ++y) {
+        const QRgb *line = (const QRgb *) img.constScanLine(h - 1 - y);
+        std::copy(line, line + w, tex.levels.back().begin() + std::size_t(y) * w);
+    }
+
+    while (w > 1 || h > 1) {
+        int nw = std::max(1, w / 2);
+        int nh = std::max(1, h / 2);
+        const std::vector<QRgb>& prev = tex.levels.back();
+        std::vector<QRgb> next(std::size_t(nw) * nh);
+
+        #pragma omp parallel for
+        for (int y = 0; y < nh; ++y) {
+            int y0 = std::min(2 * y, h - 1);
+            int y1 = std::min(2 * y + 1, h - 1);
+            for (int x = 0; x < nw; ++x) {
+                int x0 = std::min(2 * x, w - 1);
+                int x1 = std::min(2 * x + 1, w - 1);
+                vcg::Point4f c = UnpackColor(prev[std::size_t(y0) * w + x0]) + UnpackColor(prev[std::size_t(y0) * w + x1])
+                               + UnpackColor(prev[std::size_t(y1) * w + x0]) + UnpackColor(prev[std::size_t(y1) * w + x1]);
+                next[std::size_t(y) * nw + x] = PackColor(c / 4.0f);
+            }
+        }
+
+        w = nw;
+        h = nh;
+        tex.w.push_back(w);
+        tex.h.push_back(h);
+        tex.levels.push_back(std::move(next));
+    }
+
+    return tex;
+}
+
+static vcg::Point4f SampleNearest(const MipmappedTexture& tex, double s, double t)
+{
+    int x = WrapIndex((int) std::floor(s * tex.w[0]), tex.w[0]);
+    int y = WrapIndex((int) std::floor(t * tex.h[0]), tex.h[0]);
+    return UnpackColor(tex.levels[0][std::size_t(y) * tex.w[0] + x]);
+}
+
+static vcg::Point4f SampleBilinear(const MipmappedTexture& tex, int level, double s, double t)
+{
+    int w = tex.w[level];
+    int h = tex.h[level];
+    double x = s * w - 0.5;
+    double y = t * h - 0.5;
+    double fx = std::floor(x);
+    double fy = std::floor(y);
+    float ax = float(x - fx);
+    float ay = float(y - fy);
+
+    int x0 = WrapIndex((int) fx, w);
+    int x1 = WrapIndex((int) fx + 1, w);
+    int y0 = WrapIndex((int) fy, h);
+    int y1 = WrapIndex((int) fy + 1, h);
+
+    const std::vector<QRgb>& texels = tex.levels[level];
+    vcg::Point4f c00 = UnpackColor(texels[std::size_t(y0) * w + x0]);
+    vcg::Point4f c10 = UnpackColor(texels[std::size_t(y0) * w + x1]);
+    vcg::Point4f c01 = UnpackColor(texels[std::size_t(y1) * w + x0]);
+    vcg::Point4f c11 = UnpackColor(texels[std::size_t(y1) * w + x1]);
+
+    return (c00 * (1 - ax) + c10 * ax) * (1 - ay) + (c01 * (1 - ax) + c11 * ax) * ay;
+}
+
+static vcg::Point4f SampleTrilinear(const MipmappedTexture& tex, double s, double t, float lod)
+{
+    int maxLevel = (int) tex.levels.size() - 1;
+    if (lod <= 0)
+        return SampleBilinear(tex, 0, s, t);
+    if (lod >= maxLevel)
+        return SampleBilinear(tex, maxLevel, s, t);
+
+    int l0 = (int) lod;
+    float a = lod - l0;
+    return SampleBilinear(tex, l0, s, t) * (1 - a) + SampleBilinear(tex, l0 + 1, s, t) * a;
+}
+
+/* Same B-spline lookup as the fragment shader, built from four filtered fetches */
+static vcg::Point4f SampleBicubic(const MipmappedTexture& tex, double s, double t, float lod)
+{
+    double tw = tex.w[0];
+    double th = tex.h[0];
+    double coord[2] = { s * tw - 0.5, t * th - 0.5 };
+    double h0[2], h1[2], g1[2];
+    for (int i = 0; i < 2; ++i) {
+        double idx = std::floor(coord[i]);
+        double fraction = coord[i] - idx;
+        double one_frac = 1.0 - fraction;
+        double one_frac2 = one_frac * one_frac;
+        double fraction2 = fraction * fraction;
+        double w0 = (1.0/6.0) * one_frac2 * one_frac;
+        double w1 = (2.0/3.0) - 0.5 * fraction2 * (2.0 - fraction);
+        double w2 = (2.0/3.0) - 0.5 * one_frac2 * (2.0 - one_frac);
+        double w3 = (1.0/6.0) * fraction2 * fraction;
+        double g0 = w0 + w1;
+        g1[i] = w2 + w3;
+        h0[i] = (w1 / g0) - 0.5 + idx;
+        h1[i] = (w3 / g1[i]) + 1.5 + idx;
+    }
+    vcg::Point4f tex00 = SampleTrilinear(tex, h0[0] / tw, h0[1] / th, lod);
+    vcg::Point4f tex10 = SampleTrilinear(tex, h1[0] / tw, h0[1] / th, lod);
+    vcg::Point4f tex01 = SampleTrilinear(tex, h0[0] / tw, h1[1] / th, lod);
+    vcg::Point4f tex11 = SampleTrilinear(tex, h1[0] / tw, h1[1] / th, lod);
+    float a = float(g1[1]);
+    tex00 = tex00 * (1 - a) + tex01 * a;
+    tex10 = tex10 * (1 - a) + tex11 * a;
+    float b = float(g1[0]);
+    return tex00 * (1 - b) + tex10 * b;
+}
+
+struct RasterFace {
+    vcg::Point2d p[3];  // vertex positions in output pixel units, counterclockwise
+    vcg::Point2d uv[3]; // normalized input texture coordinates
+    int ti;             // input texture index
+    QRgb color;
+    float lod;
+};
+
+static inline double EdgeFunction(const vcg::Point2d& a, const vcg::Point2d& b, const vcg::Point2d& p)
+{
+    return (b.X() - a.X()) * (p.Y() - a.Y()) - (b.Y() - a.Y()) * (p.X() - a.X());
+}
+
+static inline bool IsTopLeft(const vcg::Point2d& a, const vcg::Point2d& b)
+{
+    double dx = b.X() - a.X();
+    double dy = b.Y() - a.Y();
+    return (dy == 0 && dx < 0) || (dy < 0);
+}
+
+std::vector<std::shared_ptr<QImage>> RenderTextureCPU(Mesh& m, TextureObjectHandle textureObject, const std::vector<TextureSize> &texSizes,
+                                                      bool filter, RenderMode imode)
+{
+    std::vector<std::vector<Mesh::FacePointer>> facesByTexture;
+    int nTex = FacesByTextureIndex(m, facesByTexture);
+
+    ensure(nTex <= (int) texSizes.size());
+
+    // copy the input textures that are actually referenced by the mesh
+    auto WTCSh = GetWedgeTexCoordStorageAttribute(m);
+    std::vector<bool> used(textureObject->ArraySize(), false);
+    for (auto& f : m.face) {
+        int ti = WTCSh[&f].tc[0].N();
+        ensure(ti >= 0 && ti < (int) used.size());
+        used[ti] = true;
+    }
+
+    std::vector<MipmappedTexture> inputTextures(textureObject->ArraySize());
+    if (imode != FaceColor) {
+        for (std::size_t i = 0; i < textureObject->ArraySize(); ++i)
+            if (used[i])
+                inputTextures[i] = BuildMipmappedTexture(textureObject->texInfoVec[i].texture);
+    }
+
+    std::vector<std::shared_ptr<QImage>> newTextures;
+    for (int i = 0; i < nTex; ++i) {
+        std::shared_ptr<QImage> teximg = RenderTextureCPU(facesByTexture[i], m, inputTextures, filter, imode, texSizes[i].w, texSizes[i].h);
+        newTextures.push_back(teximg);
+    }
+
+    return newTextures;
+}
+
+static std::shared_ptr<QImage> RenderTextureCPU(std::vector<Mesh::FacePointer>& fvec,
+                                                Mesh &m, const std::vector<MipmappedTexture>& inputTextures,
+                                                bool filter, RenderMode imode,
+                                                int textureWidth, int textureHeight)
+{
+    auto WTCSh = GetWedgeTexCoordStorageAttribute(m);
+
+    // sort the faces in increasing order of input texture unit, as the OpenGL path does
+    auto FaceComparatorByInputTexIndex = [&WTCSh](const Mesh::FacePointer& f1, const Mesh::FacePointer& f2) {
+        return WTCSh[f1].tc[0].N() < WTCSh[f2].tc[0].N();
+    };
+
+    std::sort(fvec.begin(), fvec.end(), FaceComparatorByInputTexIndex);
+
+    // setup the faces and bin them by output tile
+    int tilesX = (textureWidth + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+    int tilesY = (textureHeight + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+    std::vector<std::vector<int>> tileFaces(std::size_t(tilesX) * tilesY);
+
+    std::vector<RasterFace> rfvec;
+    rfvec.reserve(fvec.size());
+    for (auto fptr : fvec) {
+        RasterFace rf;
+        rf.ti = WTCSh[fptr].tc[0].N();
+        rf.color = qRgba(fptr->C()[0], fptr->C()[1], fptr->C()[2], fptr->C()[3]);
+        for (int i = 0; i < 3; ++i) {
+            rf.p[i] = vcg::Point2d(fptr->cWT(i).U() * textureWidth, fptr->cWT(i).V() * textureHeight);
+            rf.uv[i] = WTCSh[fptr].tc[i].P();
+            if (imode != FaceColor) {
+                rf.uv[i].X() /= inputTextures[rf.ti].w[0];
+                rf.uv[i].Y() /= inputTextures[rf.ti].h[0];
+            }
+        }
+
+        double area = EdgeFunction(rf.p[0], rf.p[1], rf.p[2]);
+        if (area == 0 || !std::isfinite(area))
+            continue;
+        if (area < 0) {
+            std::swap(rf.p[1], rf.p[2]);
+            std::swap(rf.uv[1], rf.uv[2]);
+            area = -area;
+        }
+
+        // the map from output pixels to input texels is affine on each face,
+        // so the lod is constant and can be computed once from its jacobian
+        rf.lod = 0;
+        if (imode == Linear || imode == Cubic) {
+            vcg::Point2d e1 = rf.p[1] - rf.p[0];
+            vcg::Point2d e2 = rf.p[2] - rf.p[0];
+            vcg::Point2d texSize(inputTextures[rf.ti].w[0], inputTextures[rf.ti].h[0]);
+            vcg::Point2d f1 = vcg::Point2d((rf.uv[1] - rf.uv[0]).X() * texSize.X(), (rf.uv[1] - rf.uv[0]).Y() * texSize.Y());
+            vcg::Point2d f2 = vcg::Point2d((rf.uv[2] - rf.uv[0]).X() * texSize.X(), (rf.uv[2] - rf.uv[0]).Y() * texSize.Y());
+            double px = ((f1 * e2.Y() - f2 * e1.Y()) / area).Norm();
+            double py = ((f2 * e1.X() - f1 * e2.X()) / area).Norm();
+            double pmax = std::max(px, py);
+            double pmin = std::min(px, py);
+            if (pmax > 0) {
+                double n = (pmin > 0) ? std::min<double>(std::ceil(pmax / pmin), MAX_ANISOTROPY) : MAX_ANISOTROPY;
+                rf.lod = (float) std::log2(pmax / n);
+            }
+        }
+
+        double xmin = std::min(rf.p[0].X(), std::min(rf.p[1].X(), rf.p[2].X()));
+        double xmax = std::max(rf.p[0].X(), std::max(rf.p[1].X(), rf.p[2].X()));
+        double ymin = std::min(rf.p[0].Y(), std::min(rf.p[1].Y(), rf.p[2].Y()));
+        double ymax = std::max(rf.p[0].Y(), std::max(rf.p[1].Y(), rf.p[2].Y()));
+        int tx0 = std::max(0, (int) std::floor(xmin) / RENDER_TILE_SIZE);
+        int tx1 = std::min(tilesX - 1, (int) std::floor(xmax) / RENDER_TILE_SIZE);
+        int ty0 = std::max(0, (int) std::floor(ymin) / RENDER_TILE_SIZE);
+        int ty1 = std::min(tilesY - 1, (int) std::floor(ymax) / RENDER_TILE_SIZE);
+        if (tx0 > tx1 || ty0 > ty1)
+            continue;
+
+        int rfi = (int) rfvec.size();
+        rfvec.push_back(rf);
+        for (int ty = ty0; ty <= ty1; ++ty)
+            for (int tx = tx0; tx <= tx1; ++tx)
+                tileFaces[std::size_t(ty) * tilesX + tx].push_back(rfi);
+    }
+
+    std::shared_ptr<QImage> textureImage = std::make_shared<QImage>(textureWidth, textureHeight, QImage::Format_ARGB32);
+    textureImage->fill(qRgba(0, 255, 0, 128));
+
+    // scanlines are addressed bottom-up to match the OpenGL framebuffer
+    uchar *bits = textureImage->bits();
+    int bytesPerLine = textureImage->bytesPerLine();
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int tile = 0; tile < tilesX * tilesY; ++tile) {
+        int tx = tile % tilesX;
+        int ty = tile / tilesX;
+        int px0 = tx * RENDER_TILE_SIZE;
+        int py0 = ty * RENDER_TILE_SIZE;
+        int px1 = std::min(px0 + RENDER_TILE_SIZE, textureWidth) - 1;
+        int py1 = std::min(py0 + RENDER_TILE_SIZE, textureHeight) - 1;
+
+        for (int rfi : tileFaces[tile]) {
+            const RasterFace& rf = rfvec[rfi];
+            double area = EdgeFunction(rf.p[0], rf.p[1], rf.p[2]);
+
+            double xmin = std::min(rf.p[0].X(), std::min(rf.p[1].X(), rf.p[2].X()));
+            double xmax = std::max(rf.p[0].X(), std::max(rf.p[1].X(), rf.p[2].X()));
+            double ymin = std::min(rf.p[0].Y(), std::min(rf.p[1].Y(), rf.p[2].Y()));
+            double ymax = std::max(rf.p[0].Y(), std::max(rf.p[1].Y(), rf.p[2].Y()));
+            int x0 = std::max(px0, (int) std::ceil(xmin - 0.5));
+            int x1 = std::min(px1, (int) std::floor(xmax - 0.5));
+            int y0 = std::max(py0, (int) std::ceil(ymin - 0.5));
+            int y1 = std::min(py1, (int) std::floor(ymax - 0.5));
+
+            bool topLeft[3] = {
+                IsTopLeft(rf.p[1], rf.p[2]),
+                IsTopLeft(rf.p[2], rf.p[0]),
+                IsTopLeft(rf.p[0], rf.p[1])
+            };
+
+            for (int y = y0; y <= y1; ++y) {
+                QRgb *line = (QRgb *) (bits + std::size_t(textureHeight - 1 - y) * bytesPerLine);
+                for (int x = x0; x <= x1; ++x) {
+                    vcg::Point2d pc(x + 0.5, y + 0.5);
+                    double w[3] = {
+                        EdgeFunction(rf.p[1], rf.p[2], pc),
+                        EdgeFunction(rf.p[2], rf.p[0], pc),
+                        EdgeFunction(rf.p[0], rf.p[1], pc)
+                    };
+                    bool inside = true;
+                    for (int i = 0; i < 3; ++i)
+                        inside = inside && (w[i] > 0 || (w[i] == 0 && topLeft[i]));
+                    if (!inside)
+                        continue;
+
+                    if (imode == FaceColor) {
+                        line[x] = rf.color;
+                        continue;
+                    }
+
+                    vcg::Point2d uv = (rf.uv[0] * w[0] + rf.uv[1] * w[1] + rf.uv[2] * w[2]) / area;
+                    const MipmappedTexture& tex = inputTextures[rf.ti];
+                    switch (imode) {
+                    case Nearest:
+                        line[x] = (uv.X() < 0) ? qRgba(0, 255, 0, 255) : (PackColor(SampleNearest(tex, uv.X(), uv.Y())) | 0xff000000);
+                        break;
+                    case Linear:
+                        line[x] = (uv.X() < 0) ? qRgba(0, 255, 0, 255) : (PackColor(SampleTrilinear(tex, uv.X(), uv.Y(), rf.lod)) | 0xff000000);
+                        break;
+                    case Cubic:
+                        line[x] = PackColor(SampleBicubic(tex, uv.X(), uv.Y(), rf.lod));
+                        break;
+                    default:
+                        ensure(0 && "Should never happen");
+                    }
+                }
+            }
+        }
+    }
+
+    if (filter)
+        vcg::PullPush(*textureImage, qRgba(0, 255, 0, 128));
+
+    return textureImage;
+}
@@ -40,5 +40,11 @@ std::vector<std::shared_ptr<QImage>>
 RenderTexture(Mesh& m, TextureObjectHandle textureObject, const std::vector<TextureSize> &texSizes,
               bool filter, RenderMode imode);
 
+/* Same as RenderTexture(), but rasterizes the faces on the CPU. This does not
+ * require an OpenGL context */
+std::vector<std::shared_ptr<QImage>>
+RenderTextureCPU(Mesh& m, TextureObjectHandle textureObject, const std::vector<TextureSize> &texSizes,
+                 bool filter, RenderMode imode);
+
 #endif // TEXTURE_RENDERING_H
 
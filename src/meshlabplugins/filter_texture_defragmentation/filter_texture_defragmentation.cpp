@@ -27,6 +27,7 @@
 
 #include <QFileInfo>
 #include <QDir>
+#include <QElapsedTimer>
 
 #include <vcg/complex/append.h>
 #include <vcg/complex/algorithms/update/topology.h>
@@ -134,6 +135,17 @@ bool FilterTextureDefragPlugin::requiresGLContext(const QAction* a) const
 	}
 }
 
+bool FilterTextureDefragPlugin::canRunWithoutGLContext(const QAction* a) const
+{
+	switch (ID(a)) {
+	case FP_TEXTURE_DEFRAG:
+		return true; // the textures are rendered on the CPU
+	default:
+		assert(0);
+		return false;
+	}
+}
+
 int FilterTextureDefragPlugin::postCondition(const QAction *a) const
 {
 	switch (ID(a)) {
@@ -201,6 +213,12 @@ RichParameterList FilterTextureDefragPlugin::initParameterList(const QAction *ac
 		                    0.0,
 		                    "Time limit (seconds)",
 		                    "Time limit for the defragmentation process (zero means unlimited)."));
+		parlst.addParam(RichFloat(
+		                    "packingTimeBudget",
+		                    0.0,
+		                    "Packing time budget (seconds)",
+		                    "Time spent trying alternative packing configurations on worker threads; the densest packing is kept. "
+		                    "With zero, only the default configuration is evaluated."));
 		break;
 	default:
 		break;
@@ -365,7 +383,7 @@ std::map<std::string, QVariant> FilterTextureDefragPlugin::applyFilter(
 		}
 
 		std::vector<TextureSize> texszVec;
-		int npacked = Pack(chartsToPack, textureObject, texszVec);
+		int npacked = Pack(chartsToPack, textureObject, texszVec, par.getFloat("packingTimeBudget"));
 
 		// this should never happen
 		if (npacked < (int) chartsToPack.size())
@@ -375,10 +393,22 @@ std::map<std::string, QVariant> FilterTextureDefragPlugin::applyFilter(
 
 		IntegerShift(defragMesh, chartsToPack, texszVec, anchorMap, flipped);
 
-		glContext->makeCurrent();
-		GLExtensionsManager::initializeGLextensions();
-		std::vector<std::shared_ptr<QImage>> newTextures = RenderTexture(defragMesh, textureObject, texszVec, true, RenderMode::Linear);
-		glContext->doneCurrent();
+		// resample the textures with OpenGL when a context is available, and
+		// fall back to the CPU rasterizer otherwise (e.g. on headless machines)
+		std::vector<std::shared_ptr<QImage>> newTextures;
+		QElapsedTimer renderTime;
+		renderTime.start();
+		if (glContext != nullptr && glContext->isValid()) {
+			glContext->makeCurrent();
+			GLExtensionsManager::initializeGLextensions();
+			newTextures = RenderTexture(defragMesh, textureObject, texszVec, true, RenderMode::Linear);
+			glContext->doneCurrent();
+			log("Texture Defragmentation: textures rendered with OpenGL in %lld ms", renderTime.elapsed());
+		}
+		else {
+			newTextures = RenderTextureCPU(defragMesh, textureObject, texszVec, true, RenderMode::Linear);
+			log("Texture Defragmentation: textures rendered on the CPU in %lld ms", renderTime.elapsed());
+		}
 
 		// Copy wedge tex coords from defragMesh to cm
 		if (mm.cm.FN() != defragMesh.FN())
@@ -21,16 +21,19 @@
  *                                                                           *
  ****************************************************************************/
 #include "filter_unsharp.h"
+#include "laplacian_smoother.h"
+
+#include <QRegularExpression>
 
 #include <vcg/complex/algorithms/clean.h>
 #include <vcg/complex/algorithms/crease_cut.h>
-#include <vcg/complex/algorithms/harmonic.h>
 #include <vcg/complex/algorithms/smooth.h>
 
 using namespace vcg;
 using namespace std;
 
 enum WeightModeParam { WMP_AVG = 0, WMP_AREA, WMP_ANGLE, WMP_AS_DEF };
+enum HarmonicConstraintParam { HCP_TWO_POINTS = 0, HCP_POINT_LIST, HCP_SELECTION };
 
 FilterUnsharp::FilterUnsharp()
 {
@@ -282,12 +285,18 @@ QString FilterUnsharp::filterInfo(ActionIDType filterId) const
 	case FP_SCALAR_HARMONIC_FIELD:
 		return QString(
 			"Generates a scalar harmonic field over the mesh. Input scalar values must be assigned "
-			"to two vertices "
-			"as Dirichlet boundary conditions. Applying the filter, a discrete Laplace operator "
-			"generates the harmonic "
+			"to two or more vertices "
+			"as Dirichlet boundary conditions: two points, a list of points or the selected "
+			"vertices (with their quality as value). Applying the filter, a discrete Laplace "
+			"operator generates the harmonic "
 			"field values for all the mesh vertices, which are stored in the "
 			"<a href='https://stackoverflow.com/questions/58610746'>quality per vertex "
 			"attribute</a> of the mesh.<br>"
+			"When the points of the list have more than one value, one field is computed for each "
+			"value; all the fields are stored in the per vertex attributes <i>harmonic</i>, "
+			"<i>harmonic_1</i>, <i>harmonic_2</i>... and the first one also in the quality.<br>"
+			"The factorization of the system is kept until the mesh changes, so running again the "
+			"filter with different values on the same vertices is much faster.<br>"
 			"For more details see:"
 			"<b>Dynamic Harmonic Fields for Surface Processing</b> by <i>Kai Xua, Hao Zhang, "
 			"Daniel Cohen-Or, Yueshan Xionga</i>. "
@@ -388,7 +397,7 @@ int FilterUnsharp::postCondition(const QAction* a) const
 	case FP_RECOMPUTE_VERTEX_NORMAL:
 	case FP_VERTEX_NORMAL_NORMALIZE: return MeshModel::MM_VERTNORMAL;
 	case FP_UNSHARP_VERTEX_COLOR: return MeshModel::MM_VERTCOLOR;
-	case FP_SCALAR_HARMONIC_FIELD: return MeshModel::MM_VERTQUALITY;
+	case FP_SCALAR_HARMONIC_FIELD: return MeshModel::MM_VERTQUALITY | MeshModel::MM_VERTCOLOR;
 	default: assert(0); return MeshModel::MM_ALL;
 	}
 }
@@ -702,6 +711,15 @@ RichParameterList FilterUnsharp::initParameterList(const QAction* action, const
 			   "<0 and >100 linearly extrapolate between the two mesh <br>")));
 	} break;
 	case FP_SCALAR_HARMONIC_FIELD:
+		parlst.addParam(RichEnum(
+			"constraintMode",
+			HCP_TWO_POINTS,
+			QStringList() << "Point 1 and Point 2"
+						  << "Point list"
+						  << "Selected vertices",
+			"Constraints",
+			"Where the boundary conditions of the field are taken from: the two points below, "
+			"the point list, or the selected vertices (using their quality as value)."));
 		parlst.addParam(RichPosition(
 			"point1",
 			md.mm()->cm.bbox.min,
@@ -731,6 +749,14 @@ RichParameterList FilterUnsharp::initParameterList(const QAction* action, const
 			true,
 			"Colorize",
 			"Colorize the mesh to provide an indication of the obtained harmonic field."));
+		parlst.addParam(RichString(
+			"pointList",
+			"",
+			"Point list",
+			"Used with the <i>Point list</i> constraints: a list of entries separated by ';', each "
+			"one made of the x y z coordinates of a point followed by one or more values. The "
+			"vertex closest to each point is constrained; every entry must have the same number "
+			"of values, and one field is computed for each of them."));
 		break;
 	}
 	return parlst;
@@ -763,7 +789,7 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 		break;
 	case FP_VERTEX_QUALITY_SMOOTHING:
 		tri::UpdateFlags<CMeshO>::FaceBorderFromNone(m.cm);
-		tri::Smooth<CMeshO>::VertexQualityLaplacian(m.cm);
+		LaplacianSmoother(m.cm).vertexQualityLaplacian(1);
 		break;
 
 	case FP_LAPLACIAN_SMOOTH: {
@@ -778,8 +804,7 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 		if (!boundarySmooth)
 			tri::UpdateFlags<CMeshO>::FaceClearB(m.cm);
 
-		tri::Smooth<CMeshO>::VertexCoordLaplacian(
-			m.cm, stepSmoothNum, Selected, cotangentWeight, cb);
+		LaplacianSmoother(m.cm).vertexCoordLaplacian(stepSmoothNum, Selected, cotangentWeight, cb);
 		log("Smoothed %d vertices", Selected ? m.cm.svn : m.cm.vn);
 		m.updateBoxAndNormals();
 	} break;
@@ -887,7 +912,7 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 		Scalarm mu            = par.getFloat("mu");
 
 		size_t cnt = tri::UpdateSelection<CMeshO>::VertexFromFaceStrict(m.cm);
-		tri::Smooth<CMeshO>::VertexCoordTaubin(m.cm, stepSmoothNum, lambda, mu, cnt > 0, cb);
+		LaplacianSmoother(m.cm).vertexCoordTaubin(stepSmoothNum, lambda, mu, cnt > 0, cb);
 		log("Smoothed %d vertices", cnt > 0 ? cnt : m.cm.vn);
 		m.updateBoxAndNormals();
 	} break;
@@ -959,7 +984,7 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 		for (int i = 0; i < m.cm.vn; ++i)
 			geomOrig[i] = m.cm.vert[i].P();
 
-		tri::Smooth<CMeshO>::VertexCoordLaplacian(m.cm, smoothIter);
+		LaplacianSmoother(m.cm).vertexCoordLaplacian(smoothIter);
 
 		for (int i = 0; i < m.cm.vn; ++i)
 			m.cm.vert[i].P() = geomOrig[i] * alphaorig + (geomOrig[i] - m.cm.vert[i].P()) * alpha;
@@ -978,7 +1003,7 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 		for (int i = 0; i < m.cm.vn; ++i)
 			colorOrig[i].Import(m.cm.vert[i].C());
 
-		tri::Smooth<CMeshO>::VertexColorLaplacian(m.cm, smoothIter);
+		LaplacianSmoother(m.cm).vertexColorLaplacian(smoothIter);
 		for (int i = 0; i < m.cm.vn; ++i) {
 			Color4f colorDelta = colorOrig[i] - Color4f::Construct(m.cm.vert[i].C());
 			Color4f newCol     = colorOrig[i] * alphaorig + colorDelta * alpha; // Unsharp formula
@@ -997,7 +1022,7 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 		for (int i = 0; i < m.cm.vn; ++i)
 			qualityOrig[i] = m.cm.vert[i].Q();
 
-		tri::Smooth<CMeshO>::VertexQualityLaplacian(m.cm, smoothIter);
+		LaplacianSmoother(m.cm).vertexQualityLaplacian(smoothIter);
 		for (int i = 0; i < m.cm.vn; ++i) {
 			float qualityDelta = qualityOrig[i] - m.cm.vert[i].Q();
 			m.cm.vert[i].Q() = qualityOrig[i] * alphaorig + qualityDelta * alpha; // Unsharp formula
@@ -1035,58 +1060,118 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 
 		CMeshO& m = md.mm()->cm;
 		vcg::tri::Allocator<CMeshO>::CompactEveryVector(m);
-		if (vcg::tri::Clean<CMeshO>::CountConnectedComponents(m) > 1) {
-			throw MLException(
-				"A mesh composed by a single connected component is required by the filter to "
-				"properly work.");
-		}
-		if (vcg::tri::Clean<CMeshO>::CountNonManifoldEdgeFF(md.mm()->cm) > 0) {
-			throw MLException(
-				"Mesh has some not 2-manifold faces, this filter requires manifoldness");
-		}
-		if (vcg::tri::Clean<CMeshO>::CountNonManifoldVertexFF(md.mm()->cm) > 0) {
-			throw MLException(
-				"Mesh has some not 2-manifold vertices, this filter requires manifoldness");
+		// the checks have already been passed if the mesh has not changed
+		if (!harmonicSolver.setMesh(*md.mm())) {
+			if (vcg::tri::Clean<CMeshO>::CountConnectedComponents(m) > 1) {
+				harmonicSolver.clear();
+				throw MLException(
+					"A mesh composed by a single connected component is required by the filter to "
+					"properly work.");
+			}
+			if (vcg::tri::Clean<CMeshO>::CountNonManifoldEdgeFF(md.mm()->cm) > 0) {
+				harmonicSolver.clear();
+				throw MLException(
+					"Mesh has some not 2-manifold faces, this filter requires manifoldness");
+			}
+			if (vcg::tri::Clean<CMeshO>::CountNonManifoldVertexFF(md.mm()->cm) > 0) {
+				harmonicSolver.clear();
+				throw MLException(
+					"Mesh has some not 2-manifold vertices, this filter requires manifoldness");
+			}
 		}
 
-		md.mm()->updateDataMask(
-			MeshModel::MM_VERTMARK | MeshModel::MM_FACEMARK | MeshModel::MM_FACEFLAG);
-		// Get the two vertices with value set
-		vcg::GridStaticPtr<CVertexO, Scalarm> vg;
-		vg.Set(m.vert.begin(), m.vert.end());
-
-		vcg::vertex::PointDistanceFunctor<Scalarm> pd;
-		vcg::tri::Tmark<CMeshO, CVertexO>          mv;
-		mv.SetMesh(&m);
-		mv.UnMarkAll();
-		Point3m   closestP;
-		Scalarm   minDist = 0;
-		CVertexO* vp0     = vcg::GridClosest(
-			vg, pd, mv, par.getPoint3m("point1"), m.bbox.Diag(), minDist, closestP);
-		CVertexO* vp1 = vcg::GridClosest(
-			vg, pd, mv, par.getPoint3m("point2"), m.bbox.Diag(), minDist, closestP);
-		if (vp0 == NULL || vp1 == NULL || vp0 == vp1) {
-			throw MLException("Error occurred for selected points.");
+		std::vector<int>            constrained;
+		HarmonicFieldSolver::Matrix values;
+		switch (par.getEnum("constraintMode")) {
+		case HCP_TWO_POINTS: {
+			// Get the two vertices with value set
+			CVertexO* vp0 = harmonicSolver.closestVertex(par.getPoint3m("point1"), m.bbox.Diag());
+			CVertexO* vp1 = harmonicSolver.closestVertex(par.getPoint3m("point2"), m.bbox.Diag());
+			if (vp0 == NULL || vp1 == NULL || vp0 == vp1) {
+				throw MLException("Error occurred for selected points.");
+			}
+			constrained = {(int) vcg::tri::Index(m, vp0), (int) vcg::tri::Index(m, vp1)};
+			values.resize(2, 1);
+			values(0, 0) = FieldScalar(par.getFloat("value1"));
+			values(1, 0) = FieldScalar(par.getFloat("value2"));
+		} break;
+		case HCP_POINT_LIST: {
+			QStringList entries =
+				par.getString("pointList").split(QRegularExpression("[;\\n]"), Qt::SkipEmptyParts);
+			std::vector<std::vector<FieldScalar>> entryValues;
+			for (const QString& entry : entries) {
+				QStringList tokens = entry.split(QRegularExpression("[\\s,]+"), Qt::SkipEmptyParts);
+				if (tokens.isEmpty())
+					continue;
+				std::vector<FieldScalar> numbers;
+				for (const QString& t : tokens) {
+					bool ok = false;
+					numbers.push_back(t.toDouble(&ok));
+					if (!ok)
+						throw MLException("Invalid number \"" + t + "\" in the point list.");
+				}
+				if (numbers.size() < 4)
+					throw MLException(
+						"Each entry of the point list needs the x y z coordinates and at least "
+						"one value.");
+				if (!entryValues.empty() && numbers.size() != entryValues.front().size() + 3)
+					throw MLException(
+						"All the entries of the point list must have the same number of values.");
+				CVertexO* vp = harmonicSolver.closestVertex(
+					Point3m(numbers[0], numbers[1], numbers[2]), m.bbox.Diag());
+				if (vp == NULL)
+					throw MLException("Error occurred for point \"" + entry.trimmed() + "\".");
+				constrained.push_back(vcg::tri::Index(m, vp));
+				entryValues.push_back(std::vector<FieldScalar>(numbers.begin() + 3, numbers.end()));
+			}
+			if (constrained.size() < 2)
+				throw MLException("At least two points are required in the point list.");
+			values.resize(constrained.size(), entryValues.front().size());
+			for (unsigned int i = 0; i < entryValues.size(); ++i)
+				for (unsigned int k = 0; k < entryValues[i].size(); ++k)
+					values(i, k) = entryValues[i][k];
+		} break;
+		case HCP_SELECTION: {
+			if (!md.mm()->hasDataMask(MeshModel::MM_VERTQUALITY))
+				throw MLException(
+					"The quality of the selected vertices is used as value: the mesh has no "
+					"per vertex quality.");
+			std::vector<FieldScalar> q;
+			for (const CVertexO& v : m.vert) {
+				if (v.IsS()) {
+					constrained.push_back(vcg::tri::Index(m, &v));
+					q.push_back(v.cQ());
+				}
+			}
+			if (constrained.size() < 2)
+				throw MLException("At least two vertices must be selected.");
+			values.resize(constrained.size(), 1);
+			for (unsigned int i = 0; i < q.size(); ++i)
+				values(i, 0) = q[i];
+		} break;
+		default: assert(0);
 		}
 
-		vcg::tri::Harmonic<CMeshO, FieldScalar>::ConstraintVec constraints;
-		constraints.push_back(vcg::tri::Harmonic<CMeshO, FieldScalar>::Constraint(
-			vp0, FieldScalar(par.getFloat("value1"))));
-		constraints.push_back(vcg::tri::Harmonic<CMeshO, FieldScalar>::Constraint(
-			vp1, FieldScalar(par.getFloat("value2"))));
+		cb(10, "Factorizing the system...");
+		if (harmonicSolver.factorize(constrained))
+			log("Reused the factorization of the previous harmonic field");
 
-		CMeshO::PerVertexAttributeHandle<FieldScalar> handle =
-			vcg::tri::Allocator<CMeshO>::GetPerVertexAttribute<FieldScalar>(m, "harmonic");
+		cb(80, "Solving...");
+		HarmonicFieldSolver::Matrix field = harmonicSolver.solve(values);
 
-		bool ok =
-			vcg::tri::Harmonic<CMeshO, FieldScalar>::ComputeScalarField(m, constraints, handle);
-
-		if (!ok) {
-			throw MLException("An error occurred.");
+		for (int k = 0; k < field.cols(); ++k) {
+			std::string name = k == 0 ? "harmonic" : "harmonic_" + std::to_string(k);
+			CMeshO::PerVertexAttributeHandle<FieldScalar> handle =
+				vcg::tri::Allocator<CMeshO>::GetPerVertexAttribute<FieldScalar>(m, name);
+			for (int i = 0; i < (int) m.vert.size(); ++i)
+				handle[i] = field(i, k);
 		}
+
 		md.mm()->updateDataMask(MeshModel::MM_VERTQUALITY);
-		for (auto vi = m.vert.begin(); vi != m.vert.end(); ++vi)
-			vi->Q() = handle[vi];
+		for (int i = 0; i < (int) m.vert.size(); ++i)
+			m.vert[i].Q() = field(i, 0);
+		if (field.cols() > 1)
+			log("Computed %d harmonic fields", (int) field.cols());
 
 		if (par.getBool("colorize")) {
 			md.mm()->updateDataMask(MeshModel::MM_VERTCOLOR);
@@ -26,6 +26,8 @@
 #include <QObject>
 #include <common/plugins/interfaces/filter_plugin.h>
 
+#include "harmonic_field.h"
+
 class FilterUnsharp : public QObject, public FilterPlugin
 {
 	Q_OBJECT
@@ -78,6 +80,10 @@ public:
 	int               postCondition(const QAction*) const;
 	int               getPreConditions(const QAction*) const;
 	FilterArity       filterArity(const QAction* filter) const;
+
+private:
+	// kept between runs to reuse the factorization of FP_SCALAR_HARMONIC_FIELD
+	HarmonicFieldSolver harmonicSolver;
 };
 
 #endif // FILTER_UNSHARP_PLUGIN_H
@@ -0,0 +1,196 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2007-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+#include "harmonic_field.h"
+
+#include <cstring>
+#include <limits>
+
+#include <common/mlexception.h>
+#include <vcg/complex/algorithms/closest.h>
+
+HarmonicFieldSolver::HarmonicFieldSolver() : model(nullptr), mesh(nullptr), meshId(-1), signature(0)
+{
+}
+
+HarmonicFieldSolver::~HarmonicFieldSolver()
+{
+}
+
+bool HarmonicFieldSolver::setMesh(MeshModel& mm)
+{
+	CMeshO&       m   = mm.cm;
+	std::uint64_t sig = meshSignature(m);
+	if (mesh == &m && meshId == mm.id() && signature == sig)
+		return true;
+	clear();
+	model     = &mm;
+	mesh      = &m;
+	meshId    = mm.id();
+	signature = sig;
+	return false;
+}
+
+CVertexO* HarmonicFieldSolver::closestVertex(const Point3m& p, Scalarm maxDist)
+{
+	assert(model != nullptr);
+	auto                                       grid = model->vertexGrid();
+	vcg::vertex::PointDistanceFunctor<Scalarm> pd;
+	vcg::tri::EmptyTMark<CMeshO>               mv;
+	Point3m                                    closestP;
+	Scalarm                                    minDist = 0;
+	return vcg::GridClosest(*grid, pd, mv, p, maxDist, minDist, closestP);
+}
+
+bool HarmonicFieldSolver::factorize(const std::vector<int>& constrained)
+{
+	assert(mesh != nullptr);
+	if (solver && constrained == constrainedVerts)
+		return true;
+	solver.reset();
+
+	CMeshO&   m = *mesh;
+	const int n = (int) m.vert.size();
+
+	std::vector<int> constrainedIndex(n, -1);
+	for (unsigned int k = 0; k < constrained.size(); ++k) {
+		if (constrainedIndex[constrained[k]] != -1)
+			throw MLException("The same vertex has been constrained more than once.");
+		constrainedIndex[constrained[k]] = k;
+	}
+	freeIndex.assign(n, -1);
+	int freeNum = 0;
+	for (int i = 0; i < n; ++i)
+		if (constrainedIndex[i] == -1)
+			freeIndex[i] = freeNum++;
+
+	// cotangent Laplacian, split in the free-free block and in the weights
+	// that link free vertices to the constrained ones
+	typedef Eigen::Triplet<Scalarm> Triplet;
+	std::vector<Triplet>            ff, fc;
+	std::vector<Scalarm>            diag(freeNum, 0);
+	ff.reserve(m.fn * 6);
+	auto addEdge = [&](int a, int b, Scalarm w) {
+		for (int k = 0; k < 2; ++k) {
+			if (freeIndex[a] != -1) {
+				diag[freeIndex[a]] += w;
+				if (freeIndex[b] != -1)
+					ff.push_back(Triplet(freeIndex[a], freeIndex[b], -w));
+				else
+					fc.push_back(Triplet(freeIndex[a], constrainedIndex[b], w));
+			}
+			std::swap(a, b);
+		}
+	};
+	for (const CFaceO& f : m.face) {
+		if (f.IsD())
+			continue;
+		for (int i = 0; i < 3; ++i) {
+			const Point3m e1    = f.cP1(i) - f.cP(i);
+			const Point3m e2    = f.cP2(i) - f.cP(i);
+			const Scalarm cross = (e1 ^ e2).Norm();
+			if (cross <= std::numeric_limits<Scalarm>::min())
+				continue;
+			// half cotangent of the angle opposite to the edge
+			addEdge(
+				vcg::tri::Index(m, f.cV1(i)),
+				vcg::tri::Index(m, f.cV2(i)),
+				Scalarm(0.5) * (e1 * e2) / cross);
+		}
+	}
+	for (int i = 0; i < freeNum; ++i)
+		ff.push_back(Triplet(i, i, diag[i]));
+
+	SparseMatrix A(freeNum, freeNum);
+	A.setFromTriplets(ff.begin(), ff.end());
+	freeConstrainedWeights.resize(freeNum, (int) constrained.size());
+	freeConstrainedWeights.setFromTriplets(fc.begin(), fc.end());
+
+	std::unique_ptr<Solver> s(new Solver());
+	if (freeNum > 0) {
+		s->compute(A);
+		if (s->info() != Eigen::Success)
+			throw MLException(
+				"Unable to factorize the harmonic field system: every connected component "
+				"needs at least one constraint.");
+	}
+	solver           = std::move(s);
+	constrainedVerts = constrained;
+	return false;
+}
+
+HarmonicFieldSolver::Matrix HarmonicFieldSolver::solve(const Matrix& values) const
+{
+	assert(solver && values.rows() == (Eigen::Index) constrainedVerts.size());
+	const int n = (int) freeIndex.size();
+	Matrix    result(n, values.cols());
+
+	Matrix freeValues;
+	if (freeConstrainedWeights.rows() > 0) {
+		Matrix rhs = freeConstrainedWeights * values;
+		freeValues = solver->solve(rhs);
+	}
+	for (int i = 0; i < n; ++i)
+		if (freeIndex[i] != -1)
+			result.row(i) = freeValues.row(freeIndex[i]);
+	for (unsigned int k = 0; k < constrainedVerts.size(); ++k)
+		result.row(constrainedVerts[k]) = values.row(k);
+	return result;
+}
+
+void HarmonicFieldSolver::clear()
+{
+	model     = nullptr;
+	mesh      = nullptr;
+	meshId    = -1;
+	signature = 0;
+	constrainedVerts.clear();
+	freeIndex.clear();
+	freeConstrainedWeights = SparseMatrix();
+	solver.reset();
+}
+
+/* FNV-1a style hash (on 64 bit words) of the face indices and of the vertex
+ * positions: the system depends on both. */
+std::uint64_t HarmonicFieldSolver::meshSignature(const CMeshO& m)
+{
+	std::uint64_t h   = 14695981039346656037ull;
+	auto          mix = [&h](std::uint64_t w) {
+		h ^= w;
+		h *= 1099511628211ull;
+	};
+	mix(m.vert.size());
+	mix(m.face.size());
+	for (const CVertexO& v : m.vert) {
+		for (int k = 0; k < 3; ++k) {
+			double c = v.cP()[k];
+			std::uint64_t w;
+			std::memcpy(&w, &c, sizeof(w));
+			mix(w);
+		}
+	}
+	for (const CFaceO& f : m.face) {
+		for (int k = 0; k < 3; ++k)
+			mix(f.IsD() ? ~std::uint64_t(0) : (std::uint64_t) vcg::tri::Index(m, f.cV(k)));
+	}
+	return h;
+}
@@ -0,0 +1,100 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2007-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+#ifndef FILTER_UNSHARP_HARMONIC_FIELD_H
+#define FILTER_UNSHARP_HARMONIC_FIELD_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include <common/ml_document/mesh_model.h>
+
+/**
+ * @brief Harmonic scalar fields over a mesh with Dirichlet constraints.
+ *
+ * The field minimizes the cotangent-weighted Dirichlet energy while taking
+ * the given values on the constrained vertices; constrained values are
+ * eliminated from the system, so they are interpolated exactly.
+ *
+ * The factorization of the system depends only on the mesh (connectivity and
+ * vertex positions) and on which vertices are constrained, and it is kept
+ * between calls: solving the same mesh again with different constraint values,
+ * or with several sets of values at once (one per column), is just a
+ * back-substitution.
+ */
+class HarmonicFieldSolver
+{
+public:
+	typedef Eigen::Matrix<Scalarm, Eigen::Dynamic, Eigen::Dynamic> Matrix;
+
+	HarmonicFieldSolver();
+	~HarmonicFieldSolver();
+
+	/**
+	 * Sets the (compacted) mesh on which the fields will be computed.
+	 * Returns true if the mesh did not change since the last call, meaning that
+	 * the cached data is still valid; otherwise the cache is cleared.
+	 */
+	bool setMesh(MeshModel& mm);
+
+	/** Vertex closest to p, or nullptr if none is within maxDist; the vertex
+	 * grid is the one cached by the MeshModel */
+	CVertexO* closestVertex(const Point3m& p, Scalarm maxDist);
+
+	/**
+	 * Factorizes the system for the given constrained vertex indices, unless
+	 * the factorization for the same constraints is already available (in that
+	 * case returns true). Throws MLException on failure.
+	 */
+	bool factorize(const std::vector<int>& constrained);
+
+	/**
+	 * Computes one field per column of values; values has one row per
+	 * constrained vertex, in the order given to factorize. The result has one
+	 * row per vertex.
+	 */
+	Matrix solve(const Matrix& values) const;
+
+	void clear();
+
+	static std::uint64_t meshSignature(const CMeshO& m);
+
+private:
+	typedef Eigen::SparseMatrix<Scalarm>       SparseMatrix;
+	typedef Eigen::SimplicialLDLT<SparseMatrix> Solver;
+
+	MeshModel*    model;
+	CMeshO*       mesh;
+	int           meshId;
+	std::uint64_t signature;
+
+	std::vector<int>        constrainedVerts;
+	std::vector<int>        freeIndex; // row of each vertex in the reduced system, -1 if constrained
+	SparseMatrix            freeConstrainedWeights;
+	std::unique_ptr<Solver> solver;
+};
+
+#endif // FILTER_UNSHARP_HARMONIC_FIELD_H
@@ -0,0 +1,260 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2007-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+#include "laplacian_smoother.h"
+
+#include <numeric>
+
+using namespace vcg;
+
+LaplacianSmoother::LaplacianSmoother(CMeshO& m) : m(m), vn((int) m.vert.size())
+{
+	interiorOffsets.assign(vn + 1, 0);
+	borderOffsets.assign(vn + 1, 0);
+	for (const CFaceO& f : m.face) {
+		if (f.IsD())
+			continue;
+		for (int j = 0; j < 3; ++j) {
+			std::vector<int>& offsets = f.IsB(j) ? borderOffsets : interiorOffsets;
+			++offsets[tri::Index(m, f.cV0(j)) + 1];
+			++offsets[tri::Index(m, f.cV1(j)) + 1];
+		}
+	}
+	std::partial_sum(interiorOffsets.begin(), interiorOffsets.end(), interiorOffsets.begin());
+	std::partial_sum(borderOffsets.begin(), borderOffsets.end(), borderOffsets.begin());
+
+	interiorAdj.resize(interiorOffsets[vn]);
+	interiorOpposite.resize(interiorOffsets[vn]);
+	borderAdj.resize(borderOffsets[vn]);
+
+	// same visiting order of tri::Smooth, so that the neighbors of each vertex
+	// are summed in the same order
+	std::vector<int> interiorPos(interiorOffsets.begin(), interiorOffsets.end() - 1);
+	std::vector<int> borderPos(borderOffsets.begin(), borderOffsets.end() - 1);
+	for (const CFaceO& f : m.face) {
+		if (f.IsD())
+			continue;
+		for (int j = 0; j < 3; ++j) {
+			const int v0 = tri::Index(m, f.cV0(j));
+			const int v1 = tri::Index(m, f.cV1(j));
+			if (f.IsB(j)) {
+				borderAdj[borderPos[v0]++] = v1;
+				borderAdj[borderPos[v1]++] = v0;
+			}
+			else {
+				const int v2                      = tri::Index(m, f.cV2(j));
+				interiorOpposite[interiorPos[v0]] = v2;
+				interiorAdj[interiorPos[v0]++]    = v1;
+				interiorOpposite[interiorPos[v1]] = v2;
+				interiorAdj[interiorPos[v1]++]    = v0;
+			}
+		}
+	}
+}
+
+std::vector<char> LaplacianSmoother::updatable(bool smoothSelected) const
+{
+	std::vector<char> upd(vn);
+	for (int i = 0; i < vn; ++i)
+		upd[i] = !m.vert[i].IsD() && (!smoothSelected || m.vert[i].IsS());
+	return upd;
+}
+
+void LaplacianSmoother::loadCoords(Coords& c) const
+{
+	c.x.resize(vn);
+	c.y.resize(vn);
+	c.z.resize(vn);
+	for (int i = 0; i < vn; ++i) {
+		const Point3m& p = m.vert[i].cP();
+		c.x[i]           = p[0];
+		c.y[i]           = p[1];
+		c.z[i]           = p[2];
+	}
+}
+
+void LaplacianSmoother::storeCoords(const Coords& c)
+{
+	for (int i = 0; i < vn; ++i)
+		if (!m.vert[i].IsD())
+			m.vert[i].P() = Point3m(c.x[i], c.y[i], c.z[i]);
+}
+
+/* One Jacobi iteration: the neighborhood sum and weight of every vertex are
+ * computed as in tri::Smooth::AccumulateLaplacianInfo (border vertices are
+ * averaged with themselves and their border neighbors only) and passed to
+ * update, which returns the new position. */
+template<class Update>
+void LaplacianSmoother::coordStep(
+	const Coords&            cur,
+	Coords&                  next,
+	const std::vector<char>& upd,
+	bool                     cotangentWeight,
+	Update                   update) const
+{
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i) {
+		Point3m p(cur.x[i], cur.y[i], cur.z[i]);
+		Point3m sum(0, 0, 0);
+		Scalarm cnt = 0;
+		if (borderOffsets[i] != borderOffsets[i + 1]) {
+			sum = p;
+			cnt = 1;
+			for (int k = borderOffsets[i]; k < borderOffsets[i + 1]; ++k) {
+				const int n = borderAdj[k];
+				sum += Point3m(cur.x[n], cur.y[n], cur.z[n]);
+				++cnt;
+			}
+		}
+		else {
+			for (int k = interiorOffsets[i]; k < interiorOffsets[i + 1]; ++k) {
+				const int     n = interiorAdj[k];
+				const Point3m pn(cur.x[n], cur.y[n], cur.z[n]);
+				float         weight = 1.0f;
+				if (cotangentWeight) {
+					const int     o = interiorOpposite[k];
+					const Point3m po(cur.x[o], cur.y[o], cur.z[o]);
+					float         angle = Angle(pn - po, p - po);
+					weight              = tan((M_PI * 0.5) - angle);
+				}
+				sum += pn * weight;
+				cnt += weight;
+			}
+		}
+		if (upd[i] && cnt > 0)
+			p = update(p, sum, cnt);
+		next.x[i] = p[0];
+		next.y[i] = p[1];
+		next.z[i] = p[2];
+	}
+}
+
+void LaplacianSmoother::vertexCoordLaplacian(
+	int               steps,
+	bool              smoothSelected,
+	bool              cotangentWeight,
+	vcg::CallBackPos* cb)
+{
+	const std::vector<char> upd = updatable(smoothSelected);
+	Coords                  cur, next;
+	loadCoords(cur);
+	next = cur;
+	for (int i = 0; i < steps; ++i) {
+		if (cb)
+			cb(100 * i / steps, "Classic Laplacian Smoothing");
+		coordStep(cur, next, upd, cotangentWeight, [](const Point3m& p, const Point3m& sum, Scalarm cnt) {
+			return (p + sum) / (cnt + 1);
+		});
+		std::swap(cur, next);
+	}
+	storeCoords(cur);
+}
+
+void LaplacianSmoother::vertexCoordTaubin(
+	int               steps,
+	float             lambda,
+	float             mu,
+	bool              smoothSelected,
+	vcg::CallBackPos* cb)
+{
+	const std::vector<char> upd = updatable(smoothSelected);
+	Coords                  cur, next;
+	loadCoords(cur);
+	next = cur;
+	for (int i = 0; i < steps; ++i) {
+		if (cb)
+			cb(100 * i / steps, "Taubin Smoothing");
+		coordStep(cur, next, upd, false, [lambda](const Point3m& p, const Point3m& sum, Scalarm cnt) {
+			Point3m delta = sum / cnt - p;
+			return p + delta * lambda;
+		});
+		std::swap(cur, next);
+		coordStep(cur, next, upd, false, [mu](const Point3m& p, const Point3m& sum, Scalarm cnt) {
+			Point3m delta = sum / cnt - p;
+			return p + delta * mu;
+		});
+		std::swap(cur, next);
+	}
+	storeCoords(cur);
+}
+
+void LaplacianSmoother::vertexQualityLaplacian(int steps, bool smoothSelected)
+{
+	const std::vector<char> upd = updatable(smoothSelected);
+	std::vector<Scalarm>    cur(vn), next(vn);
+	for (int i = 0; i < vn; ++i)
+		cur[i] = m.vert[i].IsD() ? 0 : m.vert[i].cQ();
+
+	for (int s = 0; s < steps; ++s) {
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < vn; ++i) {
+			Scalarm sum = 0;
+			int     cnt = interiorOffsets[i + 1] - interiorOffsets[i];
+			for (int k = interiorOffsets[i]; k < interiorOffsets[i + 1]; ++k)
+				sum += cur[interiorAdj[k]];
+			next[i] = (upd[i] && cnt > 0) ? sum / cnt : cur[i];
+		}
+		std::swap(cur, next);
+	}
+
+	for (int i = 0; i < vn; ++i)
+		if (!m.vert[i].IsD())
+			m.vert[i].Q() = cur[i];
+}
+
+void LaplacianSmoother::vertexColorLaplacian(int steps, bool smoothSelected, vcg::CallBackPos* cb)
+{
+	const std::vector<char> upd = updatable(smoothSelected);
+	std::vector<Color4b>    cur(vn), next(vn);
+	for (int i = 0; i < vn; ++i)
+		if (!m.vert[i].IsD())
+			cur[i] = m.vert[i].cC();
+
+	for (int s = 0; s < steps; ++s) {
+		if (cb)
+			cb(100 * s / steps, "Vertex Color Laplacian Smoothing");
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < vn; ++i) {
+			// border vertices are averaged only with their border neighbors
+			const bool   border = borderOffsets[i] != borderOffsets[i + 1];
+			const int*   adj    = border ? borderAdj.data() : interiorAdj.data();
+			const int    begin  = border ? borderOffsets[i] : interiorOffsets[i];
+			const int    end    = border ? borderOffsets[i + 1] : interiorOffsets[i + 1];
+			const int    cnt    = end - begin;
+			unsigned int sum[4] = {0, 0, 0, 0};
+			for (int k = begin; k < end; ++k) {
+				const Color4b& c = cur[adj[k]];
+				for (int ch = 0; ch < 4; ++ch)
+					sum[ch] += c[ch];
+			}
+			if (upd[i] && cnt > 0)
+				next[i] = Color4b(sum[0] / cnt, sum[1] / cnt, sum[2] / cnt, sum[3] / cnt);
+			else
+				next[i] = cur[i];
+		}
+		std::swap(cur, next);
+	}
+
+	for (int i = 0; i < vn; ++i)
+		if (!m.vert[i].IsD())
+			m.vert[i].C() = cur[i];
+}
@@ -0,0 +1,104 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2007-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+#ifndef FILTER_UNSHARP_LAPLACIAN_SMOOTHER_H
+#define FILTER_UNSHARP_LAPLACIAN_SMOOTHER_H
+
+#include <common/ml_document/cmesh.h>
+
+/**
+ * @brief Iterated Laplacian smoothing of per vertex coordinates, quality and
+ * color, computing the same results of the corresponding tri::Smooth
+ * functions.
+ *
+ * The vertex adjacency is extracted once from the faces (and their border
+ * flags) into a compact CSR structure, keeping the order in which tri::Smooth
+ * accumulates the neighbors so that the sums are evaluated in the same order.
+ * Each iteration then reads one buffer and writes another (Jacobi style, as
+ * tri::Smooth does), in parallel over the vertices; values are stored as
+ * separate arrays per component and copied back into the mesh only at the end.
+ *
+ * The border flags of the faces must be up to date when the smoother is built,
+ * and the topology of the mesh must not change while it is used.
+ */
+class LaplacianSmoother
+{
+public:
+	LaplacianSmoother(CMeshO& m);
+
+	/** Same as tri::Smooth::VertexCoordLaplacian */
+	void vertexCoordLaplacian(
+		int               steps,
+		bool              smoothSelected  = false,
+		bool              cotangentWeight = false,
+		vcg::CallBackPos* cb              = nullptr);
+
+	/** Same as tri::Smooth::VertexCoordTaubin */
+	void vertexCoordTaubin(
+		int               steps,
+		float             lambda,
+		float             mu,
+		bool              smoothSelected = false,
+		vcg::CallBackPos* cb             = nullptr);
+
+	/** Same as tri::Smooth::VertexQualityLaplacian */
+	void vertexQualityLaplacian(int steps, bool smoothSelected = false);
+
+	/** Same as tri::Smooth::VertexColorLaplacian */
+	void vertexColorLaplacian(
+		int               steps,
+		bool              smoothSelected = false,
+		vcg::CallBackPos* cb             = nullptr);
+
+private:
+	struct Coords
+	{
+		std::vector<Scalarm> x, y, z;
+	};
+
+	CMeshO& m;
+	int     vn; // size of the vertex vector, deleted vertices included
+
+	// non border edges: for each vertex the neighbors (and the vertex opposite
+	// to the edge, for the cotangent weights) in accumulation order
+	std::vector<int> interiorOffsets;
+	std::vector<int> interiorAdj;
+	std::vector<int> interiorOpposite;
+
+	// border edges: vertices having at least one are smoothed along the border
+	std::vector<int> borderOffsets;
+	std::vector<int> borderAdj;
+
+	std::vector<char> updatable(bool smoothSelected) const;
+	void              loadCoords(Coords& c) const;
+	void              storeCoords(const Coords& c);
+
+	template<class Update>
+	void coordStep(
+		const Coords&            cur,
+		Coords&                  next,
+		const std::vector<char>& upd,
+		bool                     cotangentWeight,
+		Update                   update) const;
+};
+
+#endif // FILTER_UNSHARP_LAPLACIAN_SMOOTHER_H
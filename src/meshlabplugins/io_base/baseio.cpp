@@ -45,6 +45,8 @@
 #include <wrap/io_trimesh/export_gts.h>
 #include <wrap/io_trimesh/export.h>
 
+#include <common/utilities/merge_vertices.h>
+
 using namespace std;
 using namespace vcg;
 
@@ -239,7 +241,7 @@ void BaseMeshIOPlugin::open(const QString &formatName, const QString &fileName,
 		bool stluinf = parlst.getBool("unify_vertices");
 		if (stluinf)
 		{
-			tri::Clean<CMeshO>::RemoveDuplicateVertex(m.cm);
+			meshlab::removeDuplicateVertices(m.cm);
 			tri::Allocator<CMeshO>::CompactEveryVector(m.cm);
 		}
 